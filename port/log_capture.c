@@ -0,0 +1,190 @@
+/**
+ * @file log_capture.c
+ * @brief Linux 主机上把平台调试输出接入 ehshell 日志环，供 logtail 查看，
+ *        eh_debug/eh_merrfl 等最终写到 CONFIG_PACKAGE_EHSHELL_BUILTIN_LOG_CAPTURE_FD (默认stderr)，
+ *        启动时把该描述符换成管道，轮询任务在主事件循环中读出，原样写回原来的描述符，
+ *        同时按行调用 ehshell_log_write
+ *
+ *        等级取行首 EHSHELL_LOG_CAPTURE_SCAN 字节内出现的 ERR/WARN/INFO/DBG(DEBUG)，没有时记为INFO，
+ *        模块名取同一范围内第一个不是等级的 [xxx]
+ *        管道写端为非阻塞，事件循环长时间不读时多出的调试输出被丢弃，不会卡住写日志的一方
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-08
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <eh.h>
+#include <eh_module.h>
+#include <eh_debug.h>
+#include <eh_platform.h>
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_config.h>
+#include <ehshell_log.h>
+
+#include <autoconf.h>
+
+#ifndef CONFIG_PACKAGE_EHSHELL_BUILTIN_LOG_CAPTURE_FD
+#define CONFIG_PACKAGE_EHSHELL_BUILTIN_LOG_CAPTURE_FD       STDERR_FILENO
+#endif
+/* 单行最大长度，超过时先输出已有的部分 */
+#ifndef CONFIG_PACKAGE_EHSHELL_BUILTIN_LOG_CAPTURE_LINE_SIZE
+#define CONFIG_PACKAGE_EHSHELL_BUILTIN_LOG_CAPTURE_LINE_SIZE 256
+#endif
+#define EHSHELL_LOG_CAPTURE_SCAN    48
+
+struct log_capture{
+    int         fd;             /* 被替换的描述符 */
+    int         saved_fd;       /* 原来的输出 */
+    int         pipe_rd;
+    size_t      line_len;
+    char        line[CONFIG_PACKAGE_EHSHELL_BUILTIN_LOG_CAPTURE_LINE_SIZE];
+};
+
+static struct log_capture s_log_capture = {
+    .fd = -1,
+    .saved_fd = -1,
+    .pipe_rd = -1,
+};
+
+static const struct{
+    const char                 *name;
+    enum ehshell_log_level      level;
+}log_capture_levels[] = {
+    {"ERR",     EHSHELL_LOG_LEVEL_ERR},
+    {"WARN",    EHSHELL_LOG_LEVEL_WARN},
+    {"INFO",    EHSHELL_LOG_LEVEL_INFO},
+    {"DEBUG",   EHSHELL_LOG_LEVEL_DEBUG},
+    {"DBG",     EHSHELL_LOG_LEVEL_DEBUG},
+};
+
+static bool log_capture_level_of(const char *word, size_t len, enum ehshell_log_level *level){
+    size_t n;
+    for(size_t i = 0; i < EH_ARRAY_SIZE(log_capture_levels); i++){
+        n = strlen(log_capture_levels[i].name);
+        if(len >= n && strncasecmp(word, log_capture_levels[i].name, n) == 0){
+            *level = log_capture_levels[i].level;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void log_capture_emit(struct log_capture *cap){
+    enum ehshell_log_level level = EHSHELL_LOG_LEVEL_INFO, l;
+    const char *module = NULL;
+    char module_buf[EHSHELL_CONFIG_LOG_MODULE_MAX + 1];
+    size_t scan = cap->line_len < EHSHELL_LOG_CAPTURE_SCAN ? cap->line_len : EHSHELL_LOG_CAPTURE_SCAN;
+    bool has_level = false;
+    size_t i, j;
+    if(cap->line_len == 0)
+        return ;
+    for(i = 0; i < scan; i++){
+        /* 等级必须是单词的开头 */
+        if(!has_level && (i == 0 || !isalnum((unsigned char)cap->line[i - 1])) &&
+            log_capture_level_of(cap->line + i, scan - i, &level)){
+            has_level = true;
+            continue;
+        }
+        if(module || cap->line[i] != '[')
+            continue;
+        for(j = i + 1; j < scan && cap->line[j] != ']'; j++);
+        if(j == scan || j == i + 1 || log_capture_level_of(cap->line + i + 1, j - i - 1, &l))
+            continue;
+        if(j - i - 1 > EHSHELL_CONFIG_LOG_MODULE_MAX)
+            j = i + 1 + EHSHELL_CONFIG_LOG_MODULE_MAX;
+        memcpy(module_buf, cap->line + i + 1, j - i - 1);
+        module_buf[j - i - 1] = '\0';
+        module = module_buf;
+    }
+    ehshell_log_write(level, module, cap->line, cap->line_len);
+    cap->line_len = 0;
+}
+
+static void log_capture_feed(struct log_capture *cap, const char *buf, size_t len){
+    for(size_t i = 0; i < len; i++){
+        if(buf[i] == '\r')
+            continue;
+        if(buf[i] == '\n'){
+            log_capture_emit(cap);
+            continue;
+        }
+        if(cap->line_len == sizeof(cap->line))
+            log_capture_emit(cap);
+        cap->line[cap->line_len++] = buf[i];
+    }
+}
+
+static void log_capture_drain(struct log_capture *cap){
+    char buf[256];
+    ssize_t rl, wl;
+    while((rl = read(cap->pipe_rd, buf, sizeof(buf))) > 0){
+        /* 原来的输出不可写时只进入日志环 */
+        wl = write(cap->saved_fd, buf, (size_t)rl);
+        (void)wl;
+        log_capture_feed(cap, buf, (size_t)rl);
+    }
+}
+
+static void log_capture_poll_task(void *arg){
+    log_capture_drain(arg);
+}
+
+static eh_loop_poll_task_t s_log_capture_poll_task = {
+    .poll_task = log_capture_poll_task,
+    .arg = &s_log_capture,
+    .list_node = EH_LIST_HEAD_INIT(s_log_capture_poll_task.list_node)
+};
+
+int __init log_capture_init(void){
+    struct log_capture *cap = &s_log_capture;
+    int fds[2];
+    cap->fd = CONFIG_PACKAGE_EHSHELL_BUILTIN_LOG_CAPTURE_FD;
+    if(pipe(fds) < 0){
+        eh_mwarnfl(LOG_CAPTURE, "pipe failed %d, debug output not captured", errno);
+        return 0;
+    }
+    cap->saved_fd = dup(cap->fd);
+    if(cap->saved_fd < 0 || dup2(fds[1], cap->fd) < 0){
+        eh_mwarnfl(LOG_CAPTURE, "redirect fd %d failed %d, debug output not captured", cap->fd, errno);
+        if(cap->saved_fd >= 0)
+            close(cap->saved_fd);
+        cap->saved_fd = -1;
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    close(fds[1]);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(cap->fd, F_SETFL, fcntl(cap->fd, F_GETFL) | O_NONBLOCK);
+    cap->pipe_rd = fds[0];
+    eh_loop_poll_task_add(&s_log_capture_poll_task);
+    return 0;
+}
+
+void __exit log_capture_exit(void){
+    struct log_capture *cap = &s_log_capture;
+    if(cap->pipe_rd < 0)
+        return ;
+    eh_loop_poll_task_del(&s_log_capture_poll_task);
+    /* 先恢复原来的输出，再取出管道中剩余的数据 */
+    dup2(cap->saved_fd, cap->fd);
+    log_capture_drain(cap);
+    log_capture_emit(cap);
+    close(cap->pipe_rd);
+    close(cap->saved_fd);
+    cap->pipe_rd = -1;
+    cap->saved_fd = -1;
+}
+
+ehshell_module_shell_export(log_capture_init, log_capture_exit);
@@ -0,0 +1,408 @@
+/**
+ * @file replay_shell.c
+ * @brief Linux 主机上回放 ehshell_recorder 录制的会话，用于性能回归测试
+ *
+ *        EHSHELL_REPLAY_FILE=session.ehrc ./app            按录制时的节奏回放
+ *        EHSHELL_REPLAY_FILE=session.ehrc EHSHELL_REPLAY_FAST=1 ./app
+ *                                                          上一段输入的输出到齐后立即发送下一段
+ *
+ *        每段输入的延迟为写入输入缓冲区到输出达到录制中对应长度的时间，
+ *        输出从第一段输入开始与录制逐字节比较，回放结束后打印报告并退出事件循环
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-24
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_ringbuf.h>
+#include <eh_module.h>
+#include <eh_debug.h>
+#include <eh_platform.h>
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_recorder.h>
+
+#include <autoconf.h>
+
+#ifndef CONFIG_PACKAGE_EHSHELL_BUILTIN_REPLAY_LINE_BUFFER_SIZE
+#define CONFIG_PACKAGE_EHSHELL_BUILTIN_REPLAY_LINE_BUFFER_SIZE  256
+#endif
+#ifndef CONFIG_PACKAGE_EHSHELL_BUILTIN_REPLAY_INPUT_BUFFER_SIZE
+#define CONFIG_PACKAGE_EHSHELL_BUILTIN_REPLAY_INPUT_BUFFER_SIZE 1024
+#endif
+/* 单段输入等待输出的超时时间，超时后记为不一致并继续回放 */
+#ifndef CONFIG_PACKAGE_EHSHELL_BUILTIN_REPLAY_TIMEOUT_MS
+#define CONFIG_PACKAGE_EHSHELL_BUILTIN_REPLAY_TIMEOUT_MS        3000
+#endif
+#define REPLAY_PENDING_MAX      64
+
+struct replay_pending{
+    size_t      target;         /* 输出达到该长度时本段输入完成 */
+    eh_clock_t  start;
+};
+
+struct replay{
+    uint8_t    *log;
+    size_t      log_len;
+    size_t      pos;            /* 下一条记录在log中的位置 */
+    size_t      input_off;      /* 当前输入记录已写入的字节数 */
+    bool        fast;
+    bool        started;
+    bool        finished;
+    /* 录制中的输出，比较的基准 */
+    uint8_t    *expect;
+    size_t      expect_len;
+    size_t      expect_pos;     /* 已发送输入对应的输出长度 */
+    /* 回放时shell的实际输出 */
+    uint8_t    *out;
+    size_t      out_len;
+    size_t      mismatch;       /* 第一个不一致的位置，SIZE_MAX表示一致 */
+    /* 时间 */
+    eh_clock_t  begin;
+    eh_clock_t  end;
+    uint64_t    rec_time_us;    /* 录制时间轴上下一条记录的时间 */
+    /* 延迟统计 */
+    struct replay_pending pending[REPLAY_PENDING_MAX];
+    uint32_t    pending_r, pending_w;
+    uint64_t   *latency_us;
+    uint32_t    latency_count;
+    uint32_t    timeout_count;
+    size_t      input_bytes;
+    uint32_t    input_lines;
+};
+
+static ehshell_t *s_shell = NULL;
+static struct replay s_replay;
+
+static const uint8_t *replay_get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v){
+    unsigned shift = 0;
+    *v = 0;
+    while(p < end && shift < 64){
+        *v |= (uint64_t)(*p & 0x7f) << shift;
+        if((*p++ & 0x80) == 0)
+            return p;
+        shift += 7;
+    }
+    return NULL;
+}
+
+/**
+ * @brief                   解析pos处的记录
+ * @return size_t           成功返回下一条记录的位置，格式错误或到达结尾返回0
+ */
+static size_t replay_parse(const struct replay *r, size_t pos, uint8_t *type, uint64_t *delta_us,
+    const uint8_t **data, size_t *len){
+    const uint8_t *p = r->log + pos, *end = r->log + r->log_len;
+    uint64_t l;
+    if(p >= end)
+        return 0;
+    *type = *p++;
+    if((p = replay_get_varint(p, end, delta_us)) == NULL)
+        return 0;
+    if((p = replay_get_varint(p, end, &l)) == NULL || l > (uint64_t)(end - p))
+        return 0;
+    *data = p;
+    *len = (size_t)l;
+    return (size_t)(p + l - r->log);
+}
+
+static int replay_load(struct replay *r, const char *path){
+    FILE *fp = fopen(path, "rb");
+    long size;
+    size_t pos, next, len;
+    uint8_t type;
+    uint64_t delta_us;
+    const uint8_t *data;
+    uint32_t input_count = 0;
+    if(fp == NULL)
+        return -1;
+    if(fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 5 || fseek(fp, 0, SEEK_SET) != 0)
+        goto error;
+    r->log = eh_malloc((size_t)size);
+    if(r->log == NULL || fread(r->log, 1, (size_t)size, fp) != (size_t)size)
+        goto error;
+    fclose(fp);
+    fp = NULL;
+    r->log_len = (size_t)size;
+    if(memcmp(r->log, EHSHELL_RECORDER_MAGIC, 4) != 0 || r->log[4] != EHSHELL_RECORDER_VERSION)
+        goto error;
+    /* 第一段输入之前的输出不参与比较 */
+    for(pos = 5; (next = replay_parse(r, pos, &type, &delta_us, &data, &len)) != 0; pos = next){
+        if(type == EHSHELL_RECORDER_TYPE_INPUT)
+            input_count++;
+        else if(type == EHSHELL_RECORDER_TYPE_OUTPUT && input_count)
+            r->expect_len += len;
+    }
+    if(pos != r->log_len || input_count == 0)
+        goto error;
+    r->expect = eh_malloc(r->expect_len + 1);
+    r->out = eh_malloc(r->expect_len + 1);
+    r->latency_us = eh_malloc(sizeof(uint64_t) * input_count);
+    if(!r->expect || !r->out || !r->latency_us)
+        goto error;
+    r->expect_len = 0;
+    input_count = 0;
+    for(pos = 5; (next = replay_parse(r, pos, &type, &delta_us, &data, &len)) != 0; pos = next){
+        if(type == EHSHELL_RECORDER_TYPE_INPUT)
+            input_count++;
+        else if(type == EHSHELL_RECORDER_TYPE_OUTPUT && input_count){
+            memcpy(r->expect + r->expect_len, data, len);
+            r->expect_len += len;
+        }
+    }
+    r->pos = 5;
+    r->mismatch = SIZE_MAX;
+    return 0;
+error:
+    if(fp)
+        fclose(fp);
+    return -1;
+}
+
+static void replay_free(struct replay *r){
+    eh_free(r->log);
+    eh_free(r->expect);
+    eh_free(r->out);
+    eh_free(r->latency_us);
+    memset(r, 0, sizeof(*r));
+}
+
+static void replay_pending_done(struct replay *r, eh_clock_t now){
+    struct replay_pending *pending;
+    while(r->pending_r != r->pending_w){
+        pending = &r->pending[r->pending_r % REPLAY_PENDING_MAX];
+        if(r->out_len < pending->target)
+            break;
+        r->latency_us[r->latency_count++] = (uint64_t)eh_clock_to_usec(now - pending->start);
+        r->pending_r++;
+    }
+}
+
+static void replay_shell_write(ehshell_t* ehshell, const char *buf, size_t len){
+    (void) ehshell;
+    struct replay *r = &s_replay;
+    size_t n;
+    if(!r->started || r->finished){
+        /* 第一段输入之前的欢迎信息和提示符 */
+        if(!r->started)
+            r->out_len += len;
+        return ;
+    }
+    n = r->expect_len + 1 - r->out_len;
+    if(n > len)
+        n = len;
+    memcpy(r->out + r->out_len, buf, n);
+    if(r->mismatch == SIZE_MAX){
+        for(size_t i = 0; i < n; i++){
+            if(r->out_len + i >= r->expect_len || r->out[r->out_len + i] != r->expect[r->out_len + i]){
+                r->mismatch = r->out_len + i;
+                break;
+            }
+        }
+    }
+    r->out_len += n;
+    replay_pending_done(r, eh_get_clock_monotonic_time());
+}
+
+static int replay_latency_cmp(const void *a, const void *b){
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void replay_report(struct replay *r){
+    uint64_t elapsed_us = (uint64_t)eh_clock_to_usec(r->end - r->begin);
+    uint64_t sum = 0;
+    if(elapsed_us == 0)
+        elapsed_us = 1;
+    for(uint32_t i = 0; i < r->latency_count; i++)
+        sum += r->latency_us[i];
+    qsort(r->latency_us, r->latency_count, sizeof(uint64_t), replay_latency_cmp);
+    printf("replay: %s mode, %llu.%06llu s\n", r->fast ? "fast" : "timed",
+        (unsigned long long)(elapsed_us / 1000000), (unsigned long long)(elapsed_us % 1000000));
+    printf("replay: input %zu bytes, %u lines, output %zu bytes\n", r->input_bytes, r->input_lines, r->out_len);
+    printf("replay: throughput %llu lines/s, %llu input B/s, %llu output B/s\n",
+        (unsigned long long)((uint64_t)r->input_lines * 1000000 / elapsed_us),
+        (unsigned long long)((uint64_t)r->input_bytes * 1000000 / elapsed_us),
+        (unsigned long long)((uint64_t)r->out_len * 1000000 / elapsed_us));
+    if(r->latency_count){
+        printf("replay: latency us min %llu avg %llu p99 %llu max %llu (%u chunks, %u timeout)\n",
+            (unsigned long long)r->latency_us[0],
+            (unsigned long long)(sum / r->latency_count),
+            (unsigned long long)r->latency_us[(r->latency_count - 1) * 99 / 100],
+            (unsigned long long)r->latency_us[r->latency_count - 1],
+            r->latency_count, r->timeout_count);
+    }
+    if(r->mismatch == SIZE_MAX && r->out_len == r->expect_len)
+        printf("replay: output identical (%zu bytes)\n", r->expect_len);
+    else if(r->mismatch == SIZE_MAX)
+        printf("replay: output differs, %zu of %zu bytes\n", r->out_len, r->expect_len);
+    else
+        printf("replay: output differs at offset %zu\n", r->mismatch);
+}
+
+static void replay_finish(struct replay *r){
+    r->finished = true;
+    r->end = eh_get_clock_monotonic_time();
+    replay_report(r);
+    eh_signal_dispatch_loop_request_quit_from_task(eh_task_main());
+}
+
+/* 一段输入写入完成，开始测量到其后的输出到齐 */
+static void replay_input_sent(struct replay *r, size_t next, eh_clock_t now){
+    struct replay_pending *pending;
+    size_t pos, len;
+    uint8_t type;
+    uint64_t delta_us;
+    const uint8_t *data;
+    for(pos = next; (next = replay_parse(r, pos, &type, &delta_us, &data, &len)) != 0 &&
+        type != EHSHELL_RECORDER_TYPE_INPUT; pos = next){
+        if(type == EHSHELL_RECORDER_TYPE_OUTPUT)
+            r->expect_pos += len;
+    }
+    if(r->pending_w - r->pending_r >= REPLAY_PENDING_MAX){
+        /* 测量队列满，最早的一段按超时处理 */
+        r->pending_r++;
+        r->timeout_count++;
+    }
+    pending = &r->pending[r->pending_w++ % REPLAY_PENDING_MAX];
+    pending->target = r->expect_pos;
+    pending->start = now;
+    replay_pending_done(r, now);
+}
+
+static void replay_shell_poll_task(void* arg){
+    struct replay *r = arg;
+    eh_ringbuf_t* input_ringbuf;
+    eh_clock_t now;
+    size_t next, len;
+    uint8_t type;
+    uint64_t delta_us;
+    const uint8_t *data;
+    int32_t free_size, wl;
+    if(r->finished || !s_shell)
+        return ;
+    now = eh_get_clock_monotonic_time();
+    if(!r->started){
+        /* 等待欢迎信息和提示符输出，之后的输出才与录制比较 */
+        if(r->out_len == 0 && eh_clock_to_msec(now - r->begin) < 100)
+            return ;
+        r->started = true;
+        r->out_len = 0;
+        r->begin = now;
+    }
+    if(r->pending_r != r->pending_w &&
+        eh_clock_to_msec(now - r->pending[r->pending_r % REPLAY_PENDING_MAX].start) >= CONFIG_PACKAGE_EHSHELL_BUILTIN_REPLAY_TIMEOUT_MS){
+        r->pending_r++;
+        r->timeout_count++;
+        if(r->mismatch == SIZE_MAX)
+            r->mismatch = r->out_len;
+    }
+    next = replay_parse(r, r->pos, &type, &delta_us, &data, &len);
+    while(next && type != EHSHELL_RECORDER_TYPE_INPUT){
+        /* 输出记录由shell产生，这里只推进录制时间轴 */
+        r->rec_time_us += delta_us;
+        r->pos = next;
+        next = replay_parse(r, r->pos, &type, &delta_us, &data, &len);
+    }
+    if(next == 0){
+        if(r->pending_r == r->pending_w)
+            replay_finish(r);
+        return ;
+    }
+    if(r->input_bytes == 0){
+        /* 录制开始到第一段输入之间的空闲不回放 */
+        delta_us = 0;
+        r->rec_time_us = 0;
+        r->begin = now;
+    }else if(r->input_off == 0){
+        if(r->fast){
+            if(r->pending_r != r->pending_w)
+                return ;
+        }else if((uint64_t)eh_clock_to_usec(now - r->begin) < r->rec_time_us + delta_us){
+            return ;
+        }
+    }
+    input_ringbuf = ehshell_input_ringbuf(s_shell);
+    free_size = eh_ringbuf_free_size(input_ringbuf);
+    if(free_size <= 0)
+        return ;
+    wl = (int32_t)(len - r->input_off) > free_size ? free_size : (int32_t)(len - r->input_off);
+    wl = eh_ringbuf_write(input_ringbuf, data + r->input_off, wl);
+    if(wl <= 0)
+        return ;
+    for(int32_t i = 0; i < wl; i++)
+        r->input_lines += (data[r->input_off + (size_t)i] == '\r' || data[r->input_off + (size_t)i] == '\n');
+    r->input_off += (size_t)wl;
+    r->input_bytes += (size_t)wl;
+    ehshell_notify_processor(s_shell);
+    if(r->input_off < len)
+        return ;
+    r->input_off = 0;
+    r->rec_time_us += delta_us;
+    r->pos = next;
+    replay_input_sent(r, next, now);
+}
+
+static enum ehshell_quit_result replay_shell_quit(ehshell_t *ehshell){
+    (void)ehshell;
+    return EHSHELL_QUIT_REJECTED;
+}
+
+static const struct ehshell_config shell_config = {
+    .host = "eventos-replay",
+    .input_linebuf_size = CONFIG_PACKAGE_EHSHELL_BUILTIN_REPLAY_LINE_BUFFER_SIZE,
+    .input_ringbuf_size = CONFIG_PACKAGE_EHSHELL_BUILTIN_REPLAY_INPUT_BUFFER_SIZE,
+    .stream_write = replay_shell_write,
+    .stream_finish = NULL,
+    .input_ringbuf_process_finish = NULL,
+    .quit_shell = replay_shell_quit,
+};
+
+static eh_loop_poll_task_t s_replay_poll_task = {
+    .poll_task = replay_shell_poll_task,
+    .arg = &s_replay,
+    .list_node = EH_LIST_HEAD_INIT(s_replay_poll_task.list_node)
+};
+
+int __init replay_shell_init(void){
+    const char *path = getenv("EHSHELL_REPLAY_FILE");
+    const char *fast = getenv("EHSHELL_REPLAY_FAST");
+    if(path == NULL)
+        return 0;
+    if(replay_load(&s_replay, path) < 0){
+        eh_merrfl(REPLAY_SHELL, "load replay file %s failed", path);
+        replay_free(&s_replay);
+        return -1;
+    }
+    s_replay.fast = fast && strcmp(fast, "0") != 0;
+    s_shell = ehshell_create(&shell_config);
+    if(eh_ptr_to_error(s_shell) < 0){
+        eh_merrfl(REPLAY_SHELL, "ehshell_create failed %d", eh_ptr_to_error(s_shell));
+        s_shell = NULL;
+        replay_free(&s_replay);
+        return -1;
+    }
+    s_replay.begin = eh_get_clock_monotonic_time();
+    ehshell_notify_processor(s_shell);
+    eh_loop_poll_task_add(&s_replay_poll_task);
+    return 0;
+}
+
+void __exit replay_shell_exit(void){
+    if(s_shell == NULL)
+        return ;
+    eh_loop_poll_task_del(&s_replay_poll_task);
+    ehshell_destroy(s_shell);
+    s_shell = NULL;
+    replay_free(&s_replay);
+}
+
+ehshell_module_shell_export(replay_shell_init, replay_shell_exit);
@@ -34,11 +34,14 @@ static void rtt_shell_read_poll_task(void* arg){
     uint8_t rtt_buf[16];
     eh_ringbuf_t* input_ringbuf = ehshell_input_ringbuf(s_shell);
     int32_t free_size = eh_ringbuf_free_size(input_ringbuf);
-    if(free_size <= 0)
-        return ;
     rl = SEGGER_RTT_HasData(CONFIG_PACKAGE_EHSHELL_BUILTIN_SEGGER_RTT_DOWN_CHANNEL_NUMBER);
     if(rl <= 0)
         return ;
+    if(free_size <= 0){
+        /* 数据留在RTT缓冲区中，下次轮询再读 */
+        ehshell_input_overflow(s_shell, rl);
+        return ;
+    }
     free_size = free_size > (int32_t)sizeof(rtt_buf) ? (int32_t)sizeof(rtt_buf) : free_size;
     rl = SEGGER_RTT_ReadNoLock(CONFIG_PACKAGE_EHSHELL_BUILTIN_SEGGER_RTT_DOWN_CHANNEL_NUMBER, rtt_buf, (unsigned)free_size);
     if(rl <= 0)
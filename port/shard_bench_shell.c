@@ -0,0 +1,285 @@
+/**
+ * @file shard_bench_shell.c
+ * @brief 分片扩展性测试，依次把同样数量的会话分配到 1, 2, 4 ... N 个分片上，
+ *        主线程用 ehshell_input_write 不断向每个会话写入命令，统计各阶段的命令吞吐
+ *
+ *        EHSHELL_SHARD_BENCH_SESSIONS=64 EHSHELL_SHARD_BENCH_MS=2000 ./app
+ *        全部阶段结束后打印报告并退出事件循环
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-01
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_error.h>
+#include <eh_module.h>
+#include <eh_debug.h>
+#include <eh_platform.h>
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_shard.h>
+
+#include <autoconf.h>
+
+#define SHARD_BENCH_WARMUP_MS       200
+#define SHARD_BENCH_CLOSE_TIMEOUT_MS 5000
+#define SHARD_BENCH_PHASE_MAX       16
+
+enum shard_bench_state{
+    SHARD_BENCH_IDLE,
+    SHARD_BENCH_WARMUP,
+    SHARD_BENCH_MEASURE,
+    SHARD_BENCH_CLOSE,
+    SHARD_BENCH_DONE,
+};
+
+struct shard_bench_session{
+    ehshell_t      *shell;
+    size_t          script_off;     /* 脚本中下一个要写入的位置 */
+    uint64_t        input_bytes;
+    uint64_t        output_bytes;   /* 分片线程写入 */
+    bool            quit_sent;
+    bool            closed;         /* 分片线程写入 */
+};
+
+struct shard_bench_result{
+    size_t          shards;
+    uint64_t        commands_per_sec;
+    uint64_t        output_per_sec;
+};
+
+struct shard_bench{
+    enum shard_bench_state state;
+    struct shard_bench_session *sessions;
+    size_t          session_count;
+    uint32_t        phase_ms;
+    size_t          phases[SHARD_BENCH_PHASE_MAX];
+    size_t          phase_count;
+    size_t          phase;
+    eh_clock_t      phase_start;
+    uint64_t        mark_input;
+    uint64_t        mark_output;
+    struct shard_bench_result results[SHARD_BENCH_PHASE_MAX];
+};
+
+static struct shard_bench s_bench;
+
+/* 每条命令都经过命令表查找和一次完整的输出 */
+static const char shard_bench_script[] = "help quit\r";
+static const char shard_bench_quit[] = "quit\r";
+
+static void shard_bench_stream_write(ehshell_t *ehshell, const char *buf, size_t len){
+    (void)buf;
+    struct shard_bench_session *session = ehshell_get_user_data(ehshell);
+    __atomic_fetch_add(&session->output_bytes, len, __ATOMIC_RELAXED);
+}
+
+static enum ehshell_quit_result shard_bench_quit_shell(ehshell_t *ehshell){
+    struct shard_bench_session *session = ehshell_get_user_data(ehshell);
+    /* quit_shell 在分片线程中执行，可以直接销毁 */
+    ehshell_destroy(ehshell);
+    __atomic_store_n(&session->closed, true, __ATOMIC_RELEASE);
+    return EHSHELL_QUIT_SUCCESS;
+}
+
+static const struct ehshell_config shard_bench_config = {
+    .host = "eventos-shard-bench",
+    .input_linebuf_size = 128,
+    .input_ringbuf_size = 256,
+    .stream_write = shard_bench_stream_write,
+    .quit_shell = shard_bench_quit_shell,
+    .flags = EHSHELL_CONFIG_FLAG_SHARDED,
+};
+
+static void shard_bench_totals(struct shard_bench *b, uint64_t *input, uint64_t *output){
+    *input = 0;
+    *output = 0;
+    for(size_t i = 0; i < b->session_count; i++){
+        *input += b->sessions[i].input_bytes;
+        *output += __atomic_load_n(&b->sessions[i].output_bytes, __ATOMIC_RELAXED);
+    }
+}
+
+static int shard_bench_phase_start(struct shard_bench *b){
+    struct shard_bench_session *session;
+    ehshell_shard_set_limit(b->phases[b->phase]);
+    memset(b->sessions, 0, b->session_count * sizeof(struct shard_bench_session));
+    for(size_t i = 0; i < b->session_count; i++){
+        session = &b->sessions[i];
+        session->shell = ehshell_create(&shard_bench_config);
+        if(eh_ptr_to_error(session->shell) < 0){
+            eh_merrfl(SHARD_BENCH, "ehshell_create failed %d", eh_ptr_to_error(session->shell));
+            session->shell = NULL;
+            session->quit_sent = true;
+            session->closed = true;
+            continue;
+        }
+        ehshell_set_userdata(session->shell, session);
+        ehshell_notify_processor(session->shell);
+    }
+    b->phase_start = eh_get_clock_monotonic_time();
+    b->state = SHARD_BENCH_WARMUP;
+    return 0;
+}
+
+/* 写入尽可能多的脚本，队列满时下次继续 */
+static void shard_bench_feed(struct shard_bench_session *session){
+    const size_t script_len = sizeof(shard_bench_script) - 1;
+    int wl;
+    for(;;){
+        wl = ehshell_input_write(session->shell, shard_bench_script + session->script_off,
+            script_len - session->script_off);
+        if(wl <= 0)
+            return ;
+        session->input_bytes += (size_t)wl;
+        session->script_off = (session->script_off + (size_t)wl) % script_len;
+    }
+}
+
+/* 先写完当前命令，再发送 quit */
+static void shard_bench_close(struct shard_bench_session *session){
+    const size_t script_len = sizeof(shard_bench_script) - 1;
+    int wl;
+    if(session->quit_sent)
+        return ;
+    if(session->script_off){
+        wl = ehshell_input_write(session->shell, shard_bench_script + session->script_off,
+            script_len - session->script_off);
+        if(wl <= 0)
+            return ;
+        session->script_off = (session->script_off + (size_t)wl) % script_len;
+        if(session->script_off)
+            return ;
+    }
+    if(ehshell_input_write(session->shell, shard_bench_quit, sizeof(shard_bench_quit) - 1) ==
+        (int)(sizeof(shard_bench_quit) - 1))
+        session->quit_sent = true;
+}
+
+static void shard_bench_report(struct shard_bench *b){
+    struct shard_bench_result *base = &b->results[0];
+    printf("shard-bench: %zu sessions, %u ms per phase, command \"%.*s\"\n", b->session_count,
+        (unsigned)b->phase_ms, (int)(sizeof(shard_bench_script) - 2), shard_bench_script);
+    printf("%8s %12s %12s %8s\n", "shards", "cmd/s", "out KB/s", "speedup");
+    for(size_t i = 0; i < b->phase_count; i++){
+        struct shard_bench_result *r = &b->results[i];
+        uint64_t speedup = base->commands_per_sec ? r->commands_per_sec * 100 / base->commands_per_sec : 0;
+        printf("%8zu %12llu %12llu %5llu.%02llux\n", r->shards,
+            (unsigned long long)r->commands_per_sec, (unsigned long long)(r->output_per_sec / 1024),
+            (unsigned long long)(speedup / 100), (unsigned long long)(speedup % 100));
+    }
+}
+
+static void shard_bench_poll_task(void *arg){
+    struct shard_bench *b = arg;
+    eh_clock_t now = eh_get_clock_monotonic_time();
+    uint64_t input, output, elapsed_us;
+    size_t closed = 0;
+    switch(b->state){
+        case SHARD_BENCH_IDLE:
+        case SHARD_BENCH_DONE:
+            return ;
+        case SHARD_BENCH_WARMUP:
+        case SHARD_BENCH_MEASURE:
+            for(size_t i = 0; i < b->session_count; i++){
+                if(b->sessions[i].shell)
+                    shard_bench_feed(&b->sessions[i]);
+            }
+            if(b->state == SHARD_BENCH_WARMUP){
+                if(eh_clock_to_msec(now - b->phase_start) < SHARD_BENCH_WARMUP_MS)
+                    return ;
+                /* 输入队列已经填满，之后写入的速度就是处理速度 */
+                shard_bench_totals(b, &b->mark_input, &b->mark_output);
+                b->phase_start = now;
+                b->state = SHARD_BENCH_MEASURE;
+                return ;
+            }
+            if(eh_clock_to_msec(now - b->phase_start) < b->phase_ms)
+                return ;
+            shard_bench_totals(b, &input, &output);
+            elapsed_us = (uint64_t)eh_clock_to_usec(now - b->phase_start);
+            if(elapsed_us == 0)
+                elapsed_us = 1;
+            b->results[b->phase].shards = b->phases[b->phase];
+            b->results[b->phase].commands_per_sec = (input - b->mark_input) * 1000000 /
+                (sizeof(shard_bench_script) - 1) / elapsed_us;
+            b->results[b->phase].output_per_sec = (output - b->mark_output) * 1000000 / elapsed_us;
+            b->phase_start = now;
+            b->state = SHARD_BENCH_CLOSE;
+            return ;
+        case SHARD_BENCH_CLOSE:
+            for(size_t i = 0; i < b->session_count; i++){
+                if(__atomic_load_n(&b->sessions[i].closed, __ATOMIC_ACQUIRE)){
+                    closed++;
+                    continue;
+                }
+                shard_bench_close(&b->sessions[i]);
+            }
+            if(closed < b->session_count){
+                if(eh_clock_to_msec(now - b->phase_start) < SHARD_BENCH_CLOSE_TIMEOUT_MS)
+                    return ;
+                /* 会话无法退出时不能安全地继续，直接结束测试 */
+                eh_merrfl(SHARD_BENCH, "%zu sessions did not quit", b->session_count - closed);
+                b->phase_count = b->phase + 1;
+            }
+            if(++b->phase < b->phase_count){
+                shard_bench_phase_start(b);
+                return ;
+            }
+            shard_bench_report(b);
+            b->state = SHARD_BENCH_DONE;
+            ehshell_shard_set_limit(0);
+            eh_signal_dispatch_loop_request_quit_from_task(eh_task_main());
+            return ;
+    }
+}
+
+static eh_loop_poll_task_t s_shard_bench_poll_task = {
+    .poll_task = shard_bench_poll_task,
+    .arg = &s_bench,
+    .list_node = EH_LIST_HEAD_INIT(s_shard_bench_poll_task.list_node)
+};
+
+int __init shard_bench_shell_init(void){
+    const char *sessions = getenv("EHSHELL_SHARD_BENCH_SESSIONS");
+    const char *phase_ms = getenv("EHSHELL_SHARD_BENCH_MS");
+    size_t shards = ehshell_shard_count();
+    struct shard_bench *b = &s_bench;
+    if(shards == 0){
+        eh_mwarnfl(SHARD_BENCH, "no shard threads, benchmark disabled");
+        return 0;
+    }
+    memset(b, 0, sizeof(struct shard_bench));
+    b->session_count = sessions ? strtoul(sessions, NULL, 10) : shards * 4;
+    b->phase_ms = phase_ms ? (uint32_t)strtoul(phase_ms, NULL, 10) : 2000;
+    if(b->session_count == 0)
+        b->session_count = 1;
+    /* 1, 2, 4 ... 以及全部分片 */
+    for(size_t n = 1; n < shards && b->phase_count < SHARD_BENCH_PHASE_MAX - 1; n *= 2)
+        b->phases[b->phase_count++] = n;
+    b->phases[b->phase_count++] = shards;
+    b->sessions = eh_malloc(b->session_count * sizeof(struct shard_bench_session));
+    if(b->sessions == NULL)
+        return EH_RET_MALLOC_ERROR;
+    shard_bench_phase_start(b);
+    eh_loop_poll_task_add(&s_shard_bench_poll_task);
+    return 0;
+}
+
+void __exit shard_bench_shell_exit(void){
+    if(s_bench.sessions == NULL)
+        return ;
+    eh_loop_poll_task_del(&s_shard_bench_poll_task);
+    eh_free(s_bench.sessions);
+    s_bench.sessions = NULL;
+}
+
+ehshell_module_shell_export(shard_bench_shell_init, shard_bench_shell_exit);
@@ -0,0 +1,237 @@
+/**
+ * @file telnet_deflate.c
+ * @brief 流式 deflate 编码器，窗口为滑动的线性缓冲区，单项哈希表查找匹配，
+ *        每次写入的数据立即编码，不等待后续数据凑满匹配长度
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-26
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+
+#include "telnet_deflate.h"
+
+#define DEFLATE_WINDOW          CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS_WINDOW
+#define DEFLATE_HASH_BITS       9
+#define DEFLATE_HASH_SIZE       (1 << DEFLATE_HASH_BITS)
+#define DEFLATE_MIN_MATCH       3
+#define DEFLATE_MAX_MATCH       258
+#define DEFLATE_MAX_INSERT      4       /* 长匹配只把前几个位置加入哈希表，减少CPU开销 */
+#define DEFLATE_OUT_SIZE        64
+
+#if (DEFLATE_WINDOW & (DEFLATE_WINDOW - 1)) != 0 || DEFLATE_WINDOW < 256 || DEFLATE_WINDOW > 16384
+#error "CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS_WINDOW must be a power of 2 in [256, 16384]"
+#endif
+
+struct telnet_deflate{
+    telnet_deflate_output_t output;
+    void       *arg;
+    uint32_t    raw_bytes;
+    uint32_t    compressed_bytes;
+    uint32_t    bit_buf;
+    uint8_t     bit_cnt;
+    bool        block_open;
+    uint16_t    out_len;
+    uint16_t    win_len;
+    uint16_t    hash[DEFLATE_HASH_SIZE];    /* 位置+1，0表示空 */
+    uint8_t     out[DEFLATE_OUT_SIZE];
+    uint8_t     win[2 * DEFLATE_WINDOW];
+};
+
+static const uint16_t deflate_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t deflate_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const uint16_t deflate_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+static const uint8_t deflate_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+static void deflate_out_flush(struct telnet_deflate *d){
+    if(d->out_len == 0)
+        return ;
+    d->output(d->arg, d->out, d->out_len);
+    d->compressed_bytes += d->out_len;
+    d->out_len = 0;
+}
+
+static void deflate_put_byte(struct telnet_deflate *d, uint8_t b){
+    d->out[d->out_len++] = b;
+    if(d->out_len == DEFLATE_OUT_SIZE)
+        deflate_out_flush(d);
+}
+
+/* deflate的数据位从字节低位开始排列 */
+static void deflate_put_bits(struct telnet_deflate *d, uint32_t value, unsigned nbits){
+    d->bit_buf |= value << d->bit_cnt;
+    d->bit_cnt = (uint8_t)(d->bit_cnt + nbits);
+    while(d->bit_cnt >= 8){
+        deflate_put_byte(d, (uint8_t)d->bit_buf);
+        d->bit_buf >>= 8;
+        d->bit_cnt = (uint8_t)(d->bit_cnt - 8);
+    }
+}
+
+/* 哈夫曼码从高位开始发送，先反转 */
+static void deflate_put_code(struct telnet_deflate *d, uint32_t code, unsigned nbits){
+    uint32_t rev = 0;
+    for(unsigned i = 0; i < nbits; i++){
+        rev = (rev << 1) | (code & 1);
+        code >>= 1;
+    }
+    deflate_put_bits(d, rev, nbits);
+}
+
+/* 固定哈夫曼表的字面量/长度码 */
+static void deflate_put_symbol(struct telnet_deflate *d, unsigned sym){
+    if(sym < 144)
+        deflate_put_code(d, 0x30 + sym, 8);
+    else if(sym < 256)
+        deflate_put_code(d, 0x190 + sym - 144, 9);
+    else if(sym < 280)
+        deflate_put_code(d, sym - 256, 7);
+    else
+        deflate_put_code(d, 0xC0 + sym - 280, 8);
+}
+
+static void deflate_put_match(struct telnet_deflate *d, unsigned len, unsigned dist){
+    unsigned i;
+    for(i = 28; deflate_len_base[i] > len; i--){}
+    deflate_put_symbol(d, 257 + i);
+    if(deflate_len_extra[i])
+        deflate_put_bits(d, len - deflate_len_base[i], deflate_len_extra[i]);
+    for(i = 29; deflate_dist_base[i] > dist; i--){}
+    deflate_put_code(d, i, 5);
+    if(deflate_dist_extra[i])
+        deflate_put_bits(d, dist - deflate_dist_base[i], deflate_dist_extra[i]);
+}
+
+static unsigned deflate_hash(const uint8_t *p){
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761U) >> (32 - DEFLATE_HASH_BITS);
+}
+
+/* 窗口后半满时整体前移，哈希表中的位置同步调整 */
+static void deflate_slide(struct telnet_deflate *d){
+    memmove(d->win, d->win + DEFLATE_WINDOW, DEFLATE_WINDOW);
+    d->win_len = DEFLATE_WINDOW;
+    for(size_t i = 0; i < DEFLATE_HASH_SIZE; i++)
+        d->hash[i] = d->hash[i] > DEFLATE_WINDOW ? (uint16_t)(d->hash[i] - DEFLATE_WINDOW) : 0;
+}
+
+/* 编码窗口中 [pos, end) 的数据，匹配不超过end */
+static void deflate_compress(struct telnet_deflate *d, size_t pos, size_t end){
+    const uint8_t *win = d->win;
+    size_t cand, len, max;
+    unsigned h;
+    while(pos < end){
+        len = 0;
+        if(pos + DEFLATE_MIN_MATCH <= end){
+            h = deflate_hash(win + pos);
+            cand = d->hash[h];
+            d->hash[h] = (uint16_t)(pos + 1);
+            if(cand && pos - (cand - 1) <= DEFLATE_WINDOW){
+                cand--;
+                max = end - pos > DEFLATE_MAX_MATCH ? DEFLATE_MAX_MATCH : end - pos;
+                while(len < max && win[cand + len] == win[pos + len])
+                    len++;
+            }
+        }
+        if(len < DEFLATE_MIN_MATCH){
+            deflate_put_symbol(d, win[pos]);
+            pos++;
+            continue;
+        }
+        deflate_put_match(d, (unsigned)len, (unsigned)(pos - cand));
+        for(size_t i = 1; i < len && i <= DEFLATE_MAX_INSERT && pos + i + DEFLATE_MIN_MATCH <= end; i++)
+            d->hash[deflate_hash(win + pos + i)] = (uint16_t)(pos + i + 1);
+        pos += len;
+    }
+}
+
+struct telnet_deflate *telnet_deflate_create(telnet_deflate_output_t output, void *arg){
+    struct telnet_deflate *d;
+    unsigned cinfo = 0;
+    uint8_t cmf, flg;
+    if(output == NULL)
+        return NULL;
+    d = eh_malloc(sizeof(struct telnet_deflate));
+    if(d == NULL)
+        return NULL;
+    memset(d, 0, offsetof(struct telnet_deflate, win));
+    d->output = output;
+    d->arg = arg;
+    /* zlib头中声明实际的窗口大小，对端可以按需申请内存 */
+    while((256U << cinfo) < DEFLATE_WINDOW)
+        cinfo++;
+    cmf = (uint8_t)((cinfo << 4) | 8);
+    flg = (uint8_t)((31 - ((unsigned)cmf * 256) % 31) % 31);
+    deflate_put_byte(d, cmf);
+    deflate_put_byte(d, flg);
+    deflate_out_flush(d);
+    return d;
+}
+
+void telnet_deflate_destroy(struct telnet_deflate *deflate){
+    eh_free(deflate);
+}
+
+void telnet_deflate_write(struct telnet_deflate *deflate, const uint8_t *buf, size_t len){
+    struct telnet_deflate *d = deflate;
+    size_t n;
+    if(len == 0)
+        return ;
+    if(!d->block_open){
+        /* BFINAL=0, BTYPE=01 固定哈夫曼 */
+        deflate_put_bits(d, 0x2, 3);
+        d->block_open = true;
+    }
+    d->raw_bytes += (uint32_t)len;
+    while(len){
+        if(d->win_len == sizeof(d->win))
+            deflate_slide(d);
+        n = sizeof(d->win) - d->win_len;
+        if(n > len)
+            n = len;
+        memcpy(d->win + d->win_len, buf, n);
+        deflate_compress(d, d->win_len, d->win_len + n);
+        d->win_len = (uint16_t)(d->win_len + n);
+        buf += n;
+        len -= n;
+    }
+}
+
+void telnet_deflate_flush(struct telnet_deflate *deflate){
+    struct telnet_deflate *d = deflate;
+    if(!d->block_open)
+        return ;
+    deflate_put_symbol(d, 256);
+    d->block_open = false;
+    /* 空的存储块，字节对齐后为 00 00 FF FF */
+    deflate_put_bits(d, 0, 3);
+    if(d->bit_cnt)
+        deflate_put_bits(d, 0, 8 - d->bit_cnt);
+    deflate_put_byte(d, 0x00);
+    deflate_put_byte(d, 0x00);
+    deflate_put_byte(d, 0xFF);
+    deflate_put_byte(d, 0xFF);
+    deflate_out_flush(d);
+}
+
+void telnet_deflate_stat(const struct telnet_deflate *deflate, uint32_t *raw, uint32_t *compressed){
+    *raw = deflate->raw_bytes;
+    *compressed = deflate->compressed_bytes;
+}
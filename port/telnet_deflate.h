@@ -0,0 +1,72 @@
+/**
+ * @file telnet_deflate.h
+ * @brief telnet COMPRESS2(MCCP2) 使用的流式 deflate 编码器，
+ *        只输出固定哈夫曼块，LZ77窗口和哈希表大小固定，内存约为 2*窗口 + 1KB
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-26
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _TELNET_DEFLATE_H_
+#define _TELNET_DEFLATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <autoconf.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+/* LZ77窗口大小，2的幂，256 ~ 32768 */
+#ifndef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS_WINDOW
+#define CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS_WINDOW   1024
+#endif
+
+struct telnet_deflate;
+
+/**
+ * @brief                   压缩数据输出回调
+ */
+typedef void (*telnet_deflate_output_t)(void *arg, const uint8_t *buf, size_t len);
+
+/**
+ * @brief                   创建编码器，立即输出zlib头
+ * @param  output           压缩数据输出回调
+ * @param  arg              回调参数
+ * @return struct telnet_deflate*  成功返回编码器，失败返回NULL
+ */
+extern struct telnet_deflate *telnet_deflate_create(telnet_deflate_output_t output, void *arg);
+
+extern void telnet_deflate_destroy(struct telnet_deflate *deflate);
+
+/**
+ * @brief                   压缩数据，输出可能留在编码器中直到 telnet_deflate_flush
+ */
+extern void telnet_deflate_write(struct telnet_deflate *deflate, const uint8_t *buf, size_t len);
+
+/**
+ * @brief                   同步刷新(Z_SYNC_FLUSH)，对端可以解出之前写入的全部数据
+ */
+extern void telnet_deflate_flush(struct telnet_deflate *deflate);
+
+/**
+ * @brief                   获取统计
+ * @param  raw              压缩前字节数
+ * @param  compressed       压缩后字节数
+ */
+extern void telnet_deflate_stat(const struct telnet_deflate *deflate, uint32_t *raw, uint32_t *compressed);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _TELNET_DEFLATE_H_
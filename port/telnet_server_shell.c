@@ -9,6 +9,7 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <eh.h>
 #include <eh_mem.h>
@@ -18,24 +19,84 @@
 #include <eh_debug.h>
 #include <eh_platform.h>
 #include <eh_debug.h>
-#include <eh_signal.h>
-#include <eh_comp_timer.h>
 #include <ehip-ipv4/tcp.h>
 #include <ehip-ipv4/ip.h>
 
 #include <ehshell.h>
 #include <ehshell_module.h>
+#include <ehshell_timer.h>
+#include <ehshell_mirror.h>
+#include <ehshell_coroutine.h>
+#include <eh_formatio.h>
 #include <autoconf.h>
 
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+#include "telnet_deflate.h"
+#endif
+
+#define TELNET_IAC                                  0xFF
+#define TELNET_DONT                                 0xFE
+#define TELNET_DO                                   0xFD
+#define TELNET_WONT                                 0xFC
+#define TELNET_WILL                                 0xFB
+#define TELNET_SB                                   0xFA
+#define TELNET_IP                                   0xF4
+#define TELNET_SE                                   0xF0
+#define TELNET_OPT_ECHO                             1
+#define TELNET_OPT_SGA                              3
+#define TELNET_OPT_LOGOUT                           18
+#define TELNET_OPT_COMPRESS2                        86
+
+/* 支持的选项在位图中的位置 */
+#define TELNET_OPT_BIT_ECHO                         0x01
+#define TELNET_OPT_BIT_SGA                          0x02
+#define TELNET_OPT_BIT_COMPRESS2                    0x04
+
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+#define TELNET_LOCAL_OPTS       (TELNET_OPT_BIT_ECHO | TELNET_OPT_BIT_SGA | TELNET_OPT_BIT_COMPRESS2)
+#else
+#define TELNET_LOCAL_OPTS       (TELNET_OPT_BIT_ECHO | TELNET_OPT_BIT_SGA)
+#endif
+#define TELNET_REMOTE_OPTS      (TELNET_OPT_BIT_SGA)
+
+enum telnet_rx_state{
+    TELNET_RX_DATA,
+    TELNET_RX_CR,           /* 上一个字节是回车，后面的NUL要丢弃 */
+    TELNET_RX_IAC,
+    TELNET_RX_OPT,          /* 等待 WILL/WONT/DO/DONT 的选项字节 */
+    TELNET_RX_SB,
+    TELNET_RX_SB_IAC,
+};
+
 struct telnet_server_client{
     tcp_pcb_t pcb;
-    union{
-        ehshell_t *shell;
-        uint32_t  timer_downcnt;
-    };
-    eh_signal_slot_t    slot_timerout;
+    ehshell_t *shell;
+    uint8_t             rx_state;
+    uint8_t             rx_cmd;
+    uint8_t             local_opts;         /* 本端已开启的选项(WILL被确认) */
+    uint8_t             local_pending;      /* 已发送WILL，等待应答 */
+    uint8_t             remote_opts;        /* 对端已开启的选项(DO被确认) */
+    uint8_t             remote_pending;     /* 已发送DO，等待应答 */
+    bool                reply_pending;      /* 有协商应答等待发送 */
+#if defined(CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT) && CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT > 0
+    ehshell_timer_t     idle_timer;
+#endif
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+    struct telnet_deflate *deflate;         /* 非NULL时之后的全部输出经过压缩 */
+    uint64_t            compress_cpu_us;
+#endif
+    /* tmirror 命令，本连接作为输出端旁观另一个客户端的会话 */
+    struct ehshell_sink     mirror_sink;
+    ehshell_cmd_context_t  *mirror_ctx;
 };
 
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+/* 已关闭连接的压缩统计 */
+static uint64_t telnet_compress_total_raw;
+static uint64_t telnet_compress_total_compressed;
+static uint64_t telnet_compress_total_cpu_us;
+#endif
+
 static tcp_server_pcb_t telnet_server = NULL;
 static struct telnet_server_client *telnet_client_pcbs[CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_MAX_CLIENTS] = {0};
 static int telent_server_get_free_client_index(void){
@@ -53,77 +114,328 @@ static int telent_server_get_index(struct telnet_server_client *client){
     return -1;
 }
 
+static void telnet_server_client_send_raw(struct telnet_server_client *client, const uint8_t *buf, size_t len){
+    eh_ringbuf_t *tx_ringbuf = ehip_tcp_client_get_send_ringbuf(client->pcb);
+    int32_t wl = eh_ringbuf_write(tx_ringbuf, buf, (int32_t)len);
+    if(wl != (int32_t)len)
+        eh_mwarnfl(TELNET_SERVER, "telnet server write ringbuf overflow, wl: %d, len: %d", wl, len);
+}
+
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+static void telnet_server_deflate_output(void *arg, const uint8_t *buf, size_t len){
+    telnet_server_client_send_raw(arg, buf, len);
+}
+
+/* 收到 IAC DO COMPRESS2 后开始压缩，之后的全部输出都经过压缩 */
+static void telnet_server_compress_start(struct telnet_server_client *client){
+    static const uint8_t compress_start[] = {
+        TELNET_IAC, TELNET_SB, TELNET_OPT_COMPRESS2, TELNET_IAC, TELNET_SE,
+    };
+    if(client->deflate)
+        return ;
+    telnet_server_client_send_raw(client, compress_start, sizeof(compress_start));
+    client->deflate = telnet_deflate_create(telnet_server_deflate_output, client);
+    if(client->deflate == NULL)
+        eh_mwarnfl(TELNET_SERVER, "telnet server create deflate failed");
+}
+#endif
+
+/* 发往客户端的telnet流，压缩开启后经过压缩 */
+static void telnet_server_client_output(struct telnet_server_client *client, const uint8_t *buf, size_t len){
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+    if(client->deflate){
+        eh_clock_t start = eh_get_clock_monotonic_time();
+        telnet_deflate_write(client->deflate, buf, len);
+        client->compress_cpu_us += (uint64_t)eh_clock_to_usec(eh_get_clock_monotonic_time() - start);
+        return ;
+    }
+#endif
+    telnet_server_client_send_raw(client, buf, len);
+}
+
+/* 发往客户端的数据，0xFF 转义为 IAC IAC */
+static void telnet_server_client_send(struct telnet_server_client *client, const uint8_t *buf, size_t len){
+    static const uint8_t iac_iac[2] = { TELNET_IAC, TELNET_IAC };
+    const uint8_t *iac;
+    while(len){
+        iac = memchr(buf, TELNET_IAC, len);
+        if(iac == NULL){
+            telnet_server_client_output(client, buf, len);
+            return ;
+        }
+        if(iac > buf)
+            telnet_server_client_output(client, buf, (size_t)(iac - buf));
+        telnet_server_client_output(client, iac_iac, sizeof(iac_iac));
+        len -= (size_t)(iac - buf) + 1;
+        buf = iac + 1;
+    }
+}
+
+static void telnet_server_client_flush(struct telnet_server_client *client){
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+    if(client->deflate){
+        eh_clock_t start = eh_get_clock_monotonic_time();
+        telnet_deflate_flush(client->deflate);
+        client->compress_cpu_us += (uint64_t)eh_clock_to_usec(eh_get_clock_monotonic_time() - start);
+    }
+#endif
+    ehip_tcp_client_request_update(client->pcb, TCP_SNED);
+}
+
 static void telent_server_ehshell_clean_client(int client_index){
     struct telnet_server_client *client = telnet_client_pcbs[client_index];
     if(!client)
         return ;
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+    if(client->deflate){
+        uint32_t raw, compressed;
+        telnet_deflate_stat(client->deflate, &raw, &compressed);
+        telnet_compress_total_raw += raw;
+        telnet_compress_total_compressed += compressed;
+        telnet_compress_total_cpu_us += client->compress_cpu_us;
+        telnet_deflate_destroy(client->deflate);
+        client->deflate = NULL;
+    }
+#endif
     ehip_tcp_client_delete(client->pcb);
-    if(eh_signal_slot_is_connected(&client->slot_timerout)){
-        eh_signal_slot_disconnect(&signal_eh_comp_timer_100ms, &client->slot_timerout);
-    }else{
-        ehshell_destroy(client->shell);
+#if defined(CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT) && CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT > 0
+    ehshell_timer_stop(&client->idle_timer);
+#endif
+    /* 旁观本会话的客户端在会话销毁(移除全部输出端)后结束 tmirror */
+    for(int i = 0; i < CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_MAX_CLIENTS; i++){
+        struct telnet_server_client *viewer = telnet_client_pcbs[i];
+        if(viewer && viewer != client && viewer->mirror_ctx && client->shell &&
+            viewer->mirror_sink.shell == client->shell)
+            ehshell_command_resume_later(viewer->mirror_ctx);
     }
+    /* 本连接的 tmirror 在退出事件中移除输出端 */
+    if(client->shell)
+        ehshell_destroy(client->shell);
+    ehshell_sink_detach(&client->mirror_sink);
     eh_free(client);
     telnet_client_pcbs[client_index] = NULL;
 }
 
-static int telnet_server_ehshell_auto_recv(struct telnet_server_client *client){
-    eh_ringbuf_t* input_ringbuf = ehshell_input_ringbuf(client->shell);
-    int32_t free_size;
+static uint8_t telnet_opt_bit(uint8_t opt){
+    switch(opt){
+        case TELNET_OPT_ECHO:       return TELNET_OPT_BIT_ECHO;
+        case TELNET_OPT_SGA:        return TELNET_OPT_BIT_SGA;
+        case TELNET_OPT_COMPRESS2:  return TELNET_OPT_BIT_COMPRESS2;
+        default:                    return 0;
+    }
+}
+
+static void telnet_server_reply(struct telnet_server_client *client, uint8_t cmd, uint8_t opt){
+    uint8_t reply[3] = { TELNET_IAC, cmd, opt };
+    telnet_server_client_output(client, reply, sizeof(reply));
+    client->reply_pending = true;
+}
+
+/*
+ * 选项协商，只在状态改变时应答，对自己发起的请求的应答不再回复，避免协商循环
+ */
+static void telnet_server_option(struct telnet_server_client *client, uint8_t cmd, uint8_t opt){
+    uint8_t bit = telnet_opt_bit(opt);
+    switch(cmd){
+        case TELNET_DO:
+            if(!(bit & TELNET_LOCAL_OPTS)){
+                telnet_server_reply(client, TELNET_WONT, opt);
+                break;
+            }
+            if(!(client->local_opts & bit)){
+                client->local_opts |= bit;
+                if(!(client->local_pending & bit))
+                    telnet_server_reply(client, TELNET_WILL, opt);
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+                if(bit == TELNET_OPT_BIT_COMPRESS2)
+                    telnet_server_compress_start(client);
+#endif
+            }
+            client->local_pending &= (uint8_t)~bit;
+            break;
+        case TELNET_DONT:
+            if(client->local_opts & bit){
+                client->local_opts &= (uint8_t)~bit;
+                telnet_server_reply(client, TELNET_WONT, opt);
+            }
+            client->local_pending &= (uint8_t)~bit;
+            break;
+        case TELNET_WILL:
+            if(!(bit & TELNET_REMOTE_OPTS)){
+                telnet_server_reply(client, TELNET_DONT, opt);
+                break;
+            }
+            if(!(client->remote_opts & bit)){
+                client->remote_opts |= bit;
+                if(!(client->remote_pending & bit))
+                    telnet_server_reply(client, TELNET_DO, opt);
+            }
+            client->remote_pending &= (uint8_t)~bit;
+            break;
+        case TELNET_WONT:
+            if(client->remote_opts & bit){
+                client->remote_opts &= (uint8_t)~bit;
+                telnet_server_reply(client, TELNET_DONT, opt);
+            }
+            client->remote_pending &= (uint8_t)~bit;
+            break;
+    }
+}
+
+/**
+ * @brief                   解析一段接收数据，去掉telnet命令，其余数据成段写入输入缓冲区
+ * @param  written          累加写入输入缓冲区的字节数
+ * @return size_t           消耗的字节数，输入缓冲区满时小于len，状态机停在未消耗的字节前
+ */
+static size_t telnet_server_parse(struct telnet_server_client *client, eh_ringbuf_t *input_ringbuf,
+    const uint8_t *data, size_t len, int32_t *written){
+    static const uint8_t iac = TELNET_IAC, etx = 0x03;
+    size_t i = 0, run;
+    int32_t wl;
+    uint8_t c;
+    while(i < len){
+        c = data[i];
+        switch(client->rx_state){
+            case TELNET_RX_CR:
+                client->rx_state = TELNET_RX_DATA;
+                /* CR NUL 表示单独的回车 */
+                if(c == 0x00){
+                    i++;
+                    break;
+                }
+                _fallthrough;
+            case TELNET_RX_DATA:
+                if(c == TELNET_IAC){
+                    client->rx_state = TELNET_RX_IAC;
+                    i++;
+                    break;
+                }
+                for(run = i; run < len && data[run] != TELNET_IAC && data[run] != '\r'; run++){}
+                if(run < len && data[run] == '\r')
+                    run++;
+                wl = eh_ringbuf_write(input_ringbuf, data + i, (int32_t)(run - i));
+                if(wl <= 0)
+                    return i;
+                *written += wl;
+                i += (size_t)wl;
+                if(data[i - 1] == '\r')
+                    client->rx_state = TELNET_RX_CR;
+                if(i < run)
+                    return i;
+                break;
+            case TELNET_RX_IAC:
+                if(c == TELNET_IAC || c == TELNET_IP){
+                    /* IAC IAC 是数据0xFF，中断进程转换为 Ctrl-C */
+                    if(eh_ringbuf_write(input_ringbuf, c == TELNET_IAC ? &iac : &etx, 1) != 1)
+                        return i;
+                    *written += 1;
+                    client->rx_state = TELNET_RX_DATA;
+                }else if(c == TELNET_SB){
+                    client->rx_state = TELNET_RX_SB;
+                }else if(c >= TELNET_WILL && c <= TELNET_DONT){
+                    client->rx_cmd = c;
+                    client->rx_state = TELNET_RX_OPT;
+                }else{
+                    client->rx_state = TELNET_RX_DATA;
+                }
+                i++;
+                break;
+            case TELNET_RX_OPT:
+                telnet_server_option(client, client->rx_cmd, c);
+                client->rx_state = TELNET_RX_DATA;
+                i++;
+                break;
+            case TELNET_RX_SB:
+                /* 没有请求任何子协商，内容直接跳过 */
+                if(c == TELNET_IAC)
+                    client->rx_state = TELNET_RX_SB_IAC;
+                i++;
+                break;
+            case TELNET_RX_SB_IAC:
+                client->rx_state = c == TELNET_SE ? TELNET_RX_DATA : TELNET_RX_SB;
+                i++;
+                break;
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief                   解析接收缓冲区中的数据
+ * @param  input_len        返回写入shell输入缓冲区的字节数
+ * @return int32_t          从接收缓冲区消耗的字节数
+ */
+static int32_t telnet_server_ehshell_auto_recv(struct telnet_server_client *client, int32_t *input_len){
+    eh_ringbuf_t *input_ringbuf = ehshell_input_ringbuf(client->shell);
     eh_ringbuf_t *rx_ringbuf = ehip_tcp_client_get_recv_ringbuf(client->pcb);
-    int32_t wl = 0;
-    int32_t len;
-    uint8_t *data_ptr;
-    if((free_size = eh_ringbuf_free_size(input_ringbuf)) == 0)
-        return 0;
-    len = 0;
-    data_ptr = (uint8_t *)eh_ringbuf_peek(rx_ringbuf, 0, NULL, &len);
-    eh_debugfl("recv:|%.*hhq|", len, data_ptr);
-    wl += eh_ringbuf_write(input_ringbuf, data_ptr, len);
-    if(wl >= free_size)
-        goto finish;
-    len = 0;
-    data_ptr = (uint8_t *)eh_ringbuf_peek(rx_ringbuf, wl, NULL, &len);
-    eh_debugfl("recv:|%.*hhq|", len, data_ptr);
-    wl += eh_ringbuf_write(input_ringbuf, data_ptr, len);
-finish:
-    eh_ringbuf_read_skip(rx_ringbuf, wl);
-    return wl;
+    const uint8_t *data_ptr;
+    int32_t len, consumed = 0;
+    size_t n;
+    *input_len = 0;
+    for(int seg = 0; seg < 2; seg++){
+        len = 0;
+        data_ptr = eh_ringbuf_peek(rx_ringbuf, consumed, NULL, &len);
+        if(data_ptr == NULL || len <= 0)
+            break;
+        eh_debugfl("recv:|%.*hhq|", len, data_ptr);
+        n = telnet_server_parse(client, input_ringbuf, data_ptr, (size_t)len, input_len);
+        consumed += (int32_t)n;
+        if(n < (size_t)len){
+            /* shell输入缓冲区已满，剩余数据留在接收缓冲区中 */
+            ehshell_input_overflow(client->shell, (uint32_t)(eh_ringbuf_size(rx_ringbuf) - consumed));
+            break;
+        }
+    }
+    eh_ringbuf_read_skip(rx_ringbuf, consumed);
+    if(client->reply_pending){
+        client->reply_pending = false;
+        telnet_server_client_flush(client);
+    }
+    return consumed;
 }
 
 static void telnet_server_ehshell_ringbuf_process_finish(ehshell_t *shell){
     struct telnet_server_client *client = ehshell_get_user_data(shell);
-    int ret;
-    ret = telnet_server_ehshell_auto_recv(client);
-    if(ret <= 0) return ;
+    int32_t input_len;
+    if(telnet_server_ehshell_auto_recv(client, &input_len) <= 0)
+        return ;
     ehip_tcp_client_request_update(client->pcb, TCP_RECV);
-    ehshell_notify_processor(shell);
+    if(input_len > 0)
+        ehshell_notify_processor(shell);
 }
 
 static void telnet_server_ehshell_stream_finish(ehshell_t *shell){
     struct telnet_server_client *client = ehshell_get_user_data(shell);
-    ehip_tcp_client_request_update(client->pcb, TCP_SNED);
+    telnet_server_client_flush(client);
 }
 static void telnet_server_ehshell_stream_write(ehshell_t* ehshell, const char *buf, size_t len){
     struct telnet_server_client *client = ehshell_get_user_data(ehshell);
     eh_ringbuf_t *tx_ringbuf = ehip_tcp_client_get_send_ringbuf(client->pcb);
-    int32_t wl = 0;
-    wl += eh_ringbuf_write(tx_ringbuf, (uint8_t *)buf, (int32_t)len);
-    if(wl != (int32_t)len)
-        eh_mwarnfl(TELNET_SERVER, "telnet server write ringbuf overflow, wl: %d, len: %d", wl, len);
+    telnet_server_client_send(client, (const uint8_t *)buf, len);
     if(eh_ringbuf_free_size(tx_ringbuf) <= (CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_TCP_TX_BUFFER_SIZE/2))
         ehip_tcp_client_request_update(client->pcb, TCP_SNED);
 }
 
+static size_t telnet_server_ehshell_stream_write_space(ehshell_t* ehshell){
+    struct telnet_server_client *client = ehshell_get_user_data(ehshell);
+    eh_ringbuf_t *tx_ringbuf = ehip_tcp_client_get_send_ringbuf(client->pcb);
+    size_t free_size = (size_t)eh_ringbuf_free_size(tx_ringbuf);
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+    /* 固定哈夫曼编码最坏每字节9位，另留刷新的开销 */
+    if(client->deflate)
+        return free_size > 16 ? (free_size - 16) * 8 / 9 : 0;
+#endif
+    return free_size;
+}
+
 static enum ehshell_quit_result telnet_server_ehshell_quit(ehshell_t *ehshell){
     struct telnet_server_client *client = ehshell_get_user_data(ehshell);
     int client_index = telent_server_get_index(client);
     static const uint8_t telnet_exit_cmds[] = {
-        0xFF, 0xFD, 0x12,
+        TELNET_IAC, TELNET_DO, TELNET_OPT_LOGOUT,
     };
-    eh_ringbuf_t *tx_ringbuf = ehip_tcp_client_get_send_ringbuf(client->pcb);
-    eh_ringbuf_write(tx_ringbuf, telnet_exit_cmds, sizeof(telnet_exit_cmds));
-    ehip_tcp_client_request_update(client->pcb, TCP_SNED);
+    telnet_server_client_output(client, telnet_exit_cmds, sizeof(telnet_exit_cmds));
+    telnet_server_client_flush(client);
     if(client_index >= 0)
         telent_server_ehshell_clean_client(client_index);
     return EHSHELL_QUIT_SUCCESS;
@@ -133,33 +445,31 @@ static const struct ehshell_config ehshell_config_default = {
     .host = "eventos-telnet-server",
     .input_linebuf_size = CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_LINE_BUFFER_SIZE,
     .input_ringbuf_size = CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_INPUT_BUFFER_SIZE,
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_INPUT_BUFFER_MAX
+    .input_ringbuf_max = CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_INPUT_BUFFER_MAX,
+#endif
     .input_ringbuf_process_finish = telnet_server_ehshell_ringbuf_process_finish,
     .stream_finish = telnet_server_ehshell_stream_finish,
     .quit_shell = telnet_server_ehshell_quit,
     .stream_write = telnet_server_ehshell_stream_write,
+    .stream_write_space = telnet_server_ehshell_stream_write_space,
 };
 
-static void telnet_server_timerout(eh_event_t *e, void *slot_param){
-    (void)e;
-    struct telnet_server_client *client = slot_param;
+#if defined(CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT) && CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT > 0
+static void telnet_server_idle_timeout(ehshell_timer_t *timer, void *arg){
+    (void)timer;
+    struct telnet_server_client *client = arg;
     int client_index = telent_server_get_index(client);
+    static const char idle_msg[] = "\r\nIdle timeout, connection closed.\r\n";
     if(client_index < 0){
         eh_mwarnfl(TELNET_SERVER, "telnet server get client index failed");
         return ;
     }
-    if(client->timer_downcnt > 0)
-        client->timer_downcnt--;
-    if(client->timer_downcnt == 0){
-        /* 没有等到协商数据，超时开启shell */
-        client->shell = ehshell_create(&ehshell_config_default);
-        if(client->shell == NULL){
-            telent_server_ehshell_clean_client(client_index);
-            return ;
-        }
-        ehshell_set_userdata(client->shell, client);
-        eh_signal_slot_disconnect(&signal_eh_comp_timer_100ms, &client->slot_timerout);
-    }
+    telnet_server_client_send(client, (const uint8_t *)idle_msg, sizeof(idle_msg) - 1);
+    telnet_server_client_flush(client);
+    telent_server_ehshell_clean_client(client_index);
 }
+#endif
 
 static void telnet_server_tcp_event_callback(tcp_pcb_t pcb, enum tcp_event state){
     (void)pcb;
@@ -181,31 +491,31 @@ static void telnet_server_tcp_event_callback(tcp_pcb_t pcb, enum tcp_event state
         telent_server_ehshell_clean_client(client_index);
         break;
     case TCP_RECV_DATA:{
-        int ret;
-        if(eh_signal_slot_is_connected(&client->slot_timerout)){
-            /* 处理协商数据 */
-            eh_ringbuf_t *rx_ringbuf = ehip_tcp_client_get_recv_ringbuf(client->pcb);
-            if(eh_ringbuf_free_size(rx_ringbuf) == 0)
-                break;
-            /* 协商数据存在，我们不进行任何处理，直接清除掉，设置200ms超时，等待开启shell */
-            eh_ringbuf_clear(rx_ringbuf);
-            client->timer_downcnt = 2; /* 200ms */
-            break;
-        }
-        ret = telnet_server_ehshell_auto_recv(client);
-        if(ret > 0)
+        int32_t input_len;
+#if defined(CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT) && CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT > 0
+        ehshell_timer_start(&client->idle_timer, CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT * 1000U);
+#endif
+        /* 协商命令在数据流中就地处理，不需要等待协商结束 */
+        telnet_server_ehshell_auto_recv(client, &input_len);
+        if(input_len > 0)
             ehshell_notify_processor(client->shell);
         break;
     }
-    case TCP_CONNECTED:
     case TCP_RECV_ACK:
+        /* 发送缓冲区释放，唤醒等待输出空间的命令和旁观输出 */
+        if(client->shell)
+            ehshell_notify_processor(client->shell);
+        if(client->mirror_sink.shell)
+            ehshell_sink_ready(&client->mirror_sink);
+        break;
+    case TCP_CONNECTED:
         break;
     }
 }
 
 static void telnet_server_tcp_new_connect(tcp_server_pcb_t server_pcb, tcp_pcb_t new_client){
     struct telnet_server_client *client = NULL;
-    int ret;
+    ehshell_t *shell;
     (void)server_pcb;
     int client_index = telent_server_get_free_client_index();
     if(client_index < 0){
@@ -219,36 +529,226 @@ static void telnet_server_tcp_new_connect(tcp_server_pcb_t server_pcb, tcp_pcb_t
     }
     memset(client, 0, sizeof(struct telnet_server_client));
     client->pcb = new_client;
-    ehip_tcp_client_set_userdata(new_client, client);
-    ehip_tcp_set_events_callback(new_client, telnet_server_tcp_event_callback);
+    client->rx_state = TELNET_RX_DATA;
+    client->local_pending = TELNET_LOCAL_OPTS;
+    client->remote_pending = TELNET_REMOTE_OPTS;
     {
         static const uint8_t telnet_init_cmds[] = {
-            0xFF, 0xFB, 0x01,  // IAC WILL ECHO
-            0xFF, 0xFB, 0x03,  // IAC WILL SUPPRESS-GO-AHEAD
-            // 0xFF, 0xFD, 0x01,  // IAC DO ECHO
-            0xFF, 0xFD, 0x03,  // IAC DO SUPPRESS-GO-AHEAD
+            TELNET_IAC, TELNET_WILL, TELNET_OPT_ECHO,
+            TELNET_IAC, TELNET_WILL, TELNET_OPT_SGA,
+            TELNET_IAC, TELNET_DO, TELNET_OPT_SGA,
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+            TELNET_IAC, TELNET_WILL, TELNET_OPT_COMPRESS2,
+#endif
         };
         eh_ringbuf_t *tx_ringbuf = ehip_tcp_client_get_send_ringbuf(new_client);
         eh_ringbuf_write(tx_ringbuf, telnet_init_cmds, sizeof(telnet_init_cmds));
-        ehip_tcp_client_request_update(new_client, TCP_SNED);
     }
-    eh_signal_slot_init(&client->slot_timerout, telnet_server_timerout, client);
-    ret = eh_signal_slot_connect(&signal_eh_comp_timer_100ms, &client->slot_timerout);
-    if(ret < 0){
-        eh_merrfl(TELNET_SERVER, "eh_signal_slot_connect failed");
-        goto eh_signal_slot_connect_error;
+    /* 协商命令和欢迎信息在同一个往返中发出，协商应答到达时由解析器处理 */
+    shell = ehshell_create(&ehshell_config_default);
+    if(eh_ptr_to_error(shell) < 0){
+        eh_merrfl(TELNET_SERVER, "ehshell_create failed %d", eh_ptr_to_error(shell));
+        eh_free(client);
+        goto error;
     }
-    client->timer_downcnt = 5; /* 500ms */
+    client->shell = shell;
+    ehshell_set_userdata(shell, client);
+    ehip_tcp_client_set_userdata(new_client, client);
+    ehip_tcp_set_events_callback(new_client, telnet_server_tcp_event_callback);
+    ehip_tcp_client_request_update(new_client, TCP_SNED);
+#if defined(CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT) && CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT > 0
+    ehshell_timer_init(&client->idle_timer, telnet_server_idle_timeout, client);
+    ehshell_timer_start(&client->idle_timer, CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_IDLE_TIMEOUT * 1000U);
+#endif
     telnet_client_pcbs[client_index] = client;
     return ;
-eh_signal_slot_connect_error:
-    eh_free(client);
 error:
     ehip_tcp_client_delete(new_client);
 }
 
+/* 旁观的输出直接写入本连接，只写发送缓冲区放得下的部分，其余留在镜像队列中 */
+static int telnet_server_mirror_write(struct ehshell_sink *sink, const char *buf, size_t len){
+    struct telnet_server_client *viewer = sink->user_data;
+    size_t space = telnet_server_ehshell_stream_write_space(viewer->shell);
+    if(len > space)
+        len = space;
+    if(len == 0)
+        return 0;
+    telnet_server_client_send(viewer, (const uint8_t *)buf, len);
+    telnet_server_client_flush(viewer);
+    return (int)len;
+}
+
+static void telnet_server_mirror_stop(struct telnet_server_client *viewer){
+    ehshell_sink_detach(&viewer->mirror_sink);
+    viewer->mirror_ctx = NULL;
+}
+
+static void do_telnet_mirror(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    struct telnet_server_client *viewer = ehshell_get_user_data(ehshell_command_get_shell(cmd_context));
+    struct telnet_server_client *target;
+    uint32_t flags = 0;
+    int index, ret, i = 1;
+    char *end;
+    if(telent_server_get_index(viewer) < 0){
+        eh_stream_printf(stream, "tmirror: only available in telnet sessions\r\n");
+        goto quit;
+    }
+    if(argc == 1){
+        eh_stream_printf(stream, "%-8s %s\r\n", "client", "state");
+        for(int j = 0; j < CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_MAX_CLIENTS; j++){
+            if(telnet_client_pcbs[j] == NULL)
+                continue;
+            eh_stream_printf(stream, "%-8d %s\r\n", j, telnet_client_pcbs[j] == viewer ? "self" :
+                telnet_client_pcbs[j]->mirror_ctx ? "mirroring" : "-");
+        }
+        goto quit;
+    }
+    if(strcmp(argv[i], "-w") == 0){
+        flags |= EHSHELL_SINK_FLAG_INPUT;
+        i++;
+    }
+    if(i != argc - 1)
+        goto usage;
+    index = (int)strtol(argv[i], &end, 10);
+    if(*argv[i] == '\0' || *end != '\0' || index < 0 || index >= CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_MAX_CLIENTS ||
+        (target = telnet_client_pcbs[index]) == NULL || target->shell == NULL){
+        eh_stream_printf(stream, "tmirror: no client %s\r\n", argv[i]);
+        goto quit;
+    }
+    if(target == viewer){
+        eh_stream_printf(stream, "tmirror: cannot mirror own session\r\n");
+        goto quit;
+    }
+    viewer->mirror_sink.name = "telnet";
+    viewer->mirror_sink.write = telnet_server_mirror_write;
+    viewer->mirror_sink.user_data = viewer;
+    viewer->mirror_sink.flags = flags;
+    ret = ehshell_sink_attach(target->shell, &viewer->mirror_sink);
+    if(ret < 0){
+        eh_stream_printf(stream, "tmirror: attach failed %d\r\n", ret);
+        goto quit;
+    }
+    viewer->mirror_ctx = cmd_context;
+    eh_stream_printf(stream, "mirroring client %d (%s), Ctrl+C to stop\r\n", index, flags ? "rw" : "ro");
+    eh_stream_finish(stream);
+    return ;
+usage:
+    eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_telnet_mirror_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    struct telnet_server_client *viewer = ehshell_get_user_data(ehshell_command_get_shell(cmd_context));
+    struct ehshell_sink *sink = &viewer->mirror_sink;
+    eh_ringbuf_t *ringbuf;
+    int32_t readable = 0, offset = 0, rl;
+    const uint8_t *span;
+    /* 连接已经删除，不能再输出 */
+    if(ehshell_event & EHSHELL_EVENT_SHELL_EXIT){
+        telnet_server_mirror_stop(viewer);
+        ehshell_command_finish(cmd_context);
+        return ;
+    }
+    if(ehshell_event & EHSHELL_EVENT_RECEIVE_INPUT_DATA){
+        ringbuf = ehshell_command_input_ringbuf(cmd_context, &readable);
+        /* 只读旁观丢弃输入，含有Ctrl+C的一批输入也不转发 */
+        while(ringbuf && sink->shell && (sink->flags & EHSHELL_SINK_FLAG_INPUT) &&
+            !(ehshell_event & EHSHELL_EVENT_SIGINT_REQUEST_QUIT) && offset < readable){
+            rl = 0;
+            span = eh_ringbuf_peek(ringbuf, offset, NULL, &rl);
+            if(span == NULL || rl <= 0)
+                break;
+            if(rl > readable - offset)
+                rl = readable - offset;
+            ehshell_sink_input(sink, span, (size_t)rl);
+            offset += rl;
+        }
+        if(ringbuf && readable > 0)
+            eh_ringbuf_read_skip(ringbuf, readable);
+    }
+    if(!(ehshell_event & EHSHELL_EVENT_SIGINT_REQUEST_QUIT) && sink->shell)
+        return ;
+    eh_stream_printf(stream, sink->shell ? "\r\nmirror stopped, %llu bytes, %llu dropped\r\n" :
+        "\r\nmirrored session closed, %llu bytes, %llu dropped\r\n",
+        (unsigned long long)sink->delivered, (unsigned long long)sink->dropped);
+    telnet_server_mirror_stop(viewer);
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static struct ehshell_command_info telnet_mirror_command_info_tbl[] = {
+    {
+        .command = "tmirror",
+        .description = "Watch another telnet client's session, -w also forwards keystrokes.",
+        .usage = "tmirror [[-w] <client>]",
+        .flags = EHSHELL_COMMAND_REDIRECT_INPUT,
+        .do_function = do_telnet_mirror,
+        .do_event_function = do_telnet_mirror_event,
+    },
+};
+
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+static void telnet_compress_print(struct stream_base *stream, const char *name,
+    uint64_t raw, uint64_t compressed, uint64_t cpu_us){
+    uint64_t permille = raw ? compressed * 1000 / raw : 1000;
+    eh_stream_printf(stream, "%-8s %10llu %10llu %4u.%u%% %10llu\r\n", name,
+        (unsigned long long)raw, (unsigned long long)compressed,
+        (unsigned)(permille / 10), (unsigned)(permille % 10), (unsigned long long)cpu_us);
+}
+
+static void do_telnet_compress_stat(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    (void)argc;
+    (void)argv;
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    uint64_t total_raw = telnet_compress_total_raw;
+    uint64_t total_compressed = telnet_compress_total_compressed;
+    uint64_t total_cpu_us = telnet_compress_total_cpu_us;
+    uint32_t raw, compressed;
+    char name[8];
+    eh_stream_printf(stream, "%-8s %10s %10s %6s %10s\r\n", "client", "raw", "compressed", "ratio", "cpu(us)");
+    for(int i = 0; i < CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_MAX_CLIENTS; i++){
+        struct telnet_server_client *client = telnet_client_pcbs[i];
+        if(client == NULL || client->deflate == NULL)
+            continue;
+        telnet_deflate_stat(client->deflate, &raw, &compressed);
+        eh_snprintf(name, sizeof(name), "%d", i);
+        telnet_compress_print(stream, name, raw, compressed, client->compress_cpu_us);
+        total_raw += raw;
+        total_compressed += compressed;
+        total_cpu_us += client->compress_cpu_us;
+    }
+    telnet_compress_print(stream, "total", total_raw, total_compressed, total_cpu_us);
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static struct ehshell_command_info telnet_compress_command_info_tbl[] = {
+    {
+        .command = "mccp",
+        .description = "Show telnet output compression ratio and CPU cost.",
+        .usage = "mccp",
+        .flags = 0,
+        .do_function = do_telnet_compress_stat,
+        .do_event_function = NULL,
+    },
+};
+#endif
+
 static int __init telnet_server_shell_init(void){
     int ret;
+    ret = ehshell_register_commands(telnet_mirror_command_info_tbl, EH_ARRAY_SIZE(telnet_mirror_command_info_tbl));
+    if(ret < 0)
+        eh_mwarnfl(TELNET_SERVER, "register tmirror command failed %d", ret);
+#ifdef CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_COMPRESS
+    ret = ehshell_register_commands(telnet_compress_command_info_tbl, EH_ARRAY_SIZE(telnet_compress_command_info_tbl));
+    if(ret < 0)
+        eh_mwarnfl(TELNET_SERVER, "register mccp command failed %d", ret);
+#endif
     telnet_server = ehip_tcp_server_any_new(
         eh_hton16(CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_PORT),
         CONFIG_PACKAGE_EHSHELL_BUILTIN_TELNET_SERVER_SHELL_TCP_RX_WINDOW_SIZE,
@@ -0,0 +1,237 @@
+/**
+ * @file uart_sim_shell.c
+ * @brief Linux 上模拟的UART，用 ehshell_uart 适配器连接 stdin/stdout，
+ *        按波特率模拟线路时间，产生DMA半满、全满、空闲和发送完成中断，
+ *        用于在没有硬件时测试适配器和评估吞吐
+ *
+ *        EHSHELL_UART_SIM_BAUD=115200 ./app < script.txt      0 表示不限速
+ *        stdin 结束且输出发送完毕后打印统计并退出事件循环
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-27
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <eh.h>
+#include <eh_module.h>
+#include <eh_debug.h>
+#include <eh_platform.h>
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_uart.h>
+
+#include <autoconf.h>
+
+#ifndef CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_RX_DMA_SIZE
+#define CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_RX_DMA_SIZE     64
+#endif
+#ifndef CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_TX_BUFFER_SIZE
+#define CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_TX_BUFFER_SIZE  1024
+#endif
+#ifndef CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_INPUT_BUFFER_MAX
+#define CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_INPUT_BUFFER_MAX 4096
+#endif
+#ifndef CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_TX_CHUNK
+#define CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_TX_CHUNK        128
+#endif
+#define UART_SIM_EXIT_QUIET_MS      500
+
+struct uart_sim{
+    struct ehshell_uart uart;
+    uint8_t     rx_dma[CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_RX_DMA_SIZE];
+    uint32_t    dma_pos;
+    uint32_t    baud;
+    /* 线路上等待传输的数据 */
+    uint8_t     line[256];
+    size_t      line_off;
+    size_t      line_len;
+    bool        eof;
+    bool        done;
+    bool        idle_armed;
+    eh_clock_t  rx_time;        /* 线路已经用掉的时间 */
+    eh_clock_t  last_rx;
+    /* 发送中的DMA块 */
+    const uint8_t *tx_buf;
+    size_t      tx_len;
+    eh_clock_t  tx_done;
+    eh_clock_t  start;
+    eh_clock_t  last_active;
+    /* 中断计数 */
+    uint32_t    irq_half;
+    uint32_t    irq_full;
+    uint32_t    irq_idle;
+    uint32_t    irq_tx;
+};
+
+static struct uart_sim s_uart_sim;
+
+/* 传输n字节需要的时间，8N1每字节10位 */
+static eh_clock_t uart_sim_line_time(struct uart_sim *sim, size_t n){
+    if(sim->baud == 0)
+        return 0;
+    return eh_usec_to_clock((uint64_t)n * 10 * 1000000 / sim->baud);
+}
+
+static int uart_sim_tx_start(struct ehshell_uart *uart, const uint8_t *buf, size_t len){
+    struct uart_sim *sim = uart->user_data;
+    sim->tx_buf = buf;
+    sim->tx_len = len;
+    sim->tx_done = eh_get_clock_monotonic_time() + uart_sim_line_time(sim, len);
+    return 0;
+}
+
+static const struct ehshell_uart_ops uart_sim_ops = {
+    .tx_start = uart_sim_tx_start,
+    .rx_start = NULL,
+    .stop = NULL,
+};
+
+/* DMA写入数据，到达半满和全满位置时产生中断 */
+static void uart_sim_dma_receive(struct uart_sim *sim, size_t n){
+    const uint32_t size = CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_RX_DMA_SIZE;
+    uint32_t boundary, len;
+    while(n){
+        boundary = sim->dma_pos < size / 2 ? size / 2 : size;
+        len = boundary - sim->dma_pos;
+        if(len > n)
+            len = (uint32_t)n;
+        memcpy(sim->rx_dma + sim->dma_pos, sim->line + sim->line_off, len);
+        sim->dma_pos += len;
+        sim->line_off += len;
+        n -= len;
+        if(sim->dma_pos == size / 2){
+            sim->irq_half++;
+            ehshell_uart_rx_half_complete(&sim->uart);
+        }else if(sim->dma_pos == size){
+            sim->dma_pos = 0;
+            sim->irq_full++;
+            ehshell_uart_rx_full_complete(&sim->uart);
+        }
+    }
+}
+
+static void uart_sim_report(struct uart_sim *sim){
+    struct ehshell_uart *uart = &sim->uart;
+    struct ehshell_input_stat input;
+    uint64_t elapsed_us = (uint64_t)eh_clock_to_usec(eh_get_clock_monotonic_time() - sim->start);
+    if(elapsed_us == 0)
+        elapsed_us = 1;
+    fprintf(stderr, "uart-sim: baud %u, %llu.%03llu s\n", (unsigned)sim->baud,
+        (unsigned long long)(elapsed_us / 1000000), (unsigned long long)(elapsed_us % 1000000 / 1000));
+    fprintf(stderr, "uart-sim: rx %u bytes (%u dropped), tx %u bytes (%u dropped) in %u chunks, %llu B/s\n",
+        (unsigned)uart->rx_bytes, (unsigned)uart->rx_dropped, (unsigned)uart->tx_bytes, (unsigned)uart->tx_dropped,
+        (unsigned)uart->tx_chunks, (unsigned long long)((uint64_t)uart->tx_bytes * 1000000 / elapsed_us));
+    fprintf(stderr, "uart-sim: irq half %u, full %u, idle %u, tx %u\n",
+        (unsigned)sim->irq_half, (unsigned)sim->irq_full, (unsigned)sim->irq_idle, (unsigned)sim->irq_tx);
+    if(ehshell_input_get_stat(uart->shell, &input) == 0){
+        fprintf(stderr, "uart-sim: input ringbuf %u/%u bytes, high water %u, saturated %u, "
+            "overflow %u (%u bytes), grow %u (failed %u), shrink %u\n",
+            (unsigned)input.size, (unsigned)input.max, (unsigned)input.high_water, (unsigned)input.saturations,
+            (unsigned)input.overflows, (unsigned)input.overflow_bytes,
+            (unsigned)input.grows, (unsigned)input.grow_failures, (unsigned)input.shrinks);
+    }
+}
+
+static void uart_sim_poll_task(void *arg){
+    struct uart_sim *sim = arg;
+    eh_clock_t now = eh_get_clock_monotonic_time();
+    eh_clock_t byte_time = uart_sim_line_time(sim, 1);
+    size_t n;
+    ssize_t rl;
+    if(sim->uart.shell == NULL || sim->done)
+        return ;
+    /* 发送完成中断 */
+    if(sim->tx_len && now >= sim->tx_done){
+        if(write(STDOUT_FILENO, sim->tx_buf, sim->tx_len) < 0)
+            eh_mwarnfl(UART_SIM, "write stdout failed %d", errno);
+        sim->tx_len = 0;
+        sim->irq_tx++;
+        sim->last_active = now;
+        ehshell_uart_tx_complete(&sim->uart);
+    }
+    if(sim->line_off == sim->line_len && !sim->eof){
+        rl = read(STDIN_FILENO, sim->line, sizeof(sim->line));
+        if(rl > 0){
+            sim->line_off = 0;
+            sim->line_len = (size_t)rl;
+        }else if(rl == 0){
+            sim->eof = true;
+        }
+    }
+    if(sim->line_off == sim->line_len){
+        /* 线路空闲一个字节时间后产生空闲中断 */
+        sim->rx_time = now;
+        if(sim->idle_armed && now - sim->last_rx >= byte_time){
+            sim->idle_armed = false;
+            sim->irq_idle++;
+            ehshell_uart_rx_idle(&sim->uart, CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_RX_DMA_SIZE - sim->dma_pos);
+        }
+        if(sim->eof && sim->tx_len == 0 && !sim->idle_armed &&
+            eh_clock_to_msec(now - sim->last_active) >= UART_SIM_EXIT_QUIET_MS){
+            uart_sim_report(sim);
+            sim->done = true;
+            eh_signal_dispatch_loop_request_quit_from_task(eh_task_main());
+        }
+        return ;
+    }
+    /* 按波特率计算这段时间线路上能传输的字节数 */
+    n = sim->line_len - sim->line_off;
+    if(byte_time && (size_t)((now - sim->rx_time) / byte_time) < n)
+        n = (size_t)((now - sim->rx_time) / byte_time);
+    if(n == 0)
+        return ;
+    sim->rx_time += uart_sim_line_time(sim, n);
+    sim->last_rx = now;
+    sim->last_active = now;
+    sim->idle_armed = true;
+    uart_sim_dma_receive(sim, n);
+}
+
+static eh_loop_poll_task_t s_uart_sim_poll_task = {
+    .poll_task = uart_sim_poll_task,
+    .arg = &s_uart_sim,
+    .list_node = EH_LIST_HEAD_INIT(s_uart_sim_poll_task.list_node)
+};
+
+int __init uart_sim_shell_init(void){
+    const char *baud = getenv("EHSHELL_UART_SIM_BAUD");
+    struct ehshell_uart_param param = {
+        .ops = &uart_sim_ops,
+        .user_data = &s_uart_sim,
+        .host = "eventos-uart-sim",
+        .input_ringbuf_size = 256,
+        .input_ringbuf_max = CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_INPUT_BUFFER_MAX,
+        .input_linebuf_size = 256,
+        .rx_dma_buf = s_uart_sim.rx_dma,
+        .rx_dma_size = CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_RX_DMA_SIZE,
+        .tx_buf_size = CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_TX_BUFFER_SIZE,
+        .tx_chunk_max = CONFIG_PACKAGE_EHSHELL_BUILTIN_UART_SIM_TX_CHUNK,
+    };
+    int ret;
+    s_uart_sim.baud = baud ? (uint32_t)strtoul(baud, NULL, 10) : 115200;
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+    ret = ehshell_uart_init(&s_uart_sim.uart, &param);
+    if(ret < 0){
+        eh_merrfl(UART_SIM, "ehshell_uart_init failed %d", ret);
+        return ret;
+    }
+    s_uart_sim.start = s_uart_sim.rx_time = s_uart_sim.last_active = eh_get_clock_monotonic_time();
+    eh_loop_poll_task_add(&s_uart_sim_poll_task);
+    return 0;
+}
+
+void __exit uart_sim_shell_exit(void){
+    eh_loop_poll_task_del(&s_uart_sim_poll_task);
+    ehshell_uart_deinit(&s_uart_sim.uart);
+}
+
+ehshell_module_shell_export(uart_sim_shell_init, uart_sim_shell_exit);
@@ -0,0 +1,152 @@
+/**
+ * @file ymodem_file.c
+ * @brief Linux 主机上的 rz/sz 文件后端 "file"，在一个目录中读写普通文件
+ *
+ *        rz -g file                   接收的文件保存到目录中，先写入 <name>.part，成功后改名
+ *        sz file <name>               发送目录中的文件
+ *
+ *        目录为 EHSHELL_YMODEM_FILE_DIR 环境变量，未设置时为 CONFIG_PACKAGE_EHSHELL_BUILTIN_YMODEM_FILE_DIR，
+ *        发送端给出的文件名只取最后一段，不能离开该目录
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-08
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_error.h>
+#include <eh_module.h>
+#include <eh_debug.h>
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_ymodem.h>
+
+#include <autoconf.h>
+
+#ifndef CONFIG_PACKAGE_EHSHELL_BUILTIN_YMODEM_FILE_DIR
+#define CONFIG_PACKAGE_EHSHELL_BUILTIN_YMODEM_FILE_DIR      "."
+#endif
+#define YMODEM_FILE_PATH_MAX        256
+
+struct ymodem_file{
+    FILE       *fp;
+    bool        is_write;
+    char        path[YMODEM_FILE_PATH_MAX];
+    char        part[YMODEM_FILE_PATH_MAX];
+};
+
+static const char *s_ymodem_file_dir;
+
+/* 只保留最后一段路径，拒绝空名字和 . .. */
+static const char *ymodem_file_basename(const char *name){
+    const char *base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+    if(*base == '\0' || strcmp(base, ".") == 0 || strcmp(base, "..") == 0)
+        return NULL;
+    return base;
+}
+
+static void *ymodem_file_open(const char *path, bool is_write, uint32_t *size){
+    struct ymodem_file *file;
+    const char *name = ymodem_file_basename(path);
+    struct stat st;
+    int n, err;
+    if(name == NULL)
+        return eh_error_to_ptr(EH_RET_INVALID_PARAM);
+    file = eh_malloc(sizeof(struct ymodem_file));
+    if(file == NULL)
+        return eh_error_to_ptr(EH_RET_MALLOC_ERROR);
+    file->is_write = is_write;
+    n = snprintf(file->path, sizeof(file->path), "%s/%s", s_ymodem_file_dir, name);
+    if(n < 0 || (size_t)n >= sizeof(file->path))
+        goto too_long;
+    if(is_write){
+        n = snprintf(file->part, sizeof(file->part), "%s.part", file->path);
+        if(n < 0 || (size_t)n >= sizeof(file->part))
+            goto too_long;
+        file->fp = fopen(file->part, "wb");
+    }else{
+        file->fp = fopen(file->path, "rb");
+        if(file->fp && (fstat(fileno(file->fp), &st) < 0 || !S_ISREG(st.st_mode) || (uint64_t)st.st_size > UINT32_MAX)){
+            fclose(file->fp);
+            eh_free(file);
+            return eh_error_to_ptr(EH_RET_NOT_SUPPORTED);
+        }
+        if(file->fp)
+            *size = (uint32_t)st.st_size;
+    }
+    if(file->fp == NULL){
+        err = errno;
+        eh_mwarnfl(YMODEM_FILE, "open %s failed %d", is_write ? file->part : file->path, err);
+        eh_free(file);
+        return eh_error_to_ptr(err == ENOENT ? EH_RET_NOT_EXISTS : EH_RET_INVALID_STATE);
+    }
+    return file;
+too_long:
+    eh_free(file);
+    return eh_error_to_ptr(EH_RET_INVALID_PARAM);
+}
+
+static int ymodem_file_write(void *handle, uint32_t offset, const uint8_t *buf, size_t len){
+    struct ymodem_file *file = handle;
+    if(fseek(file->fp, (long)offset, SEEK_SET) != 0 || fwrite(buf, 1, len, file->fp) != len)
+        return EH_RET_INVALID_STATE;
+    return EH_RET_OK;
+}
+
+static int ymodem_file_read(void *handle, uint32_t offset, uint8_t *buf, size_t len){
+    struct ymodem_file *file = handle;
+    size_t rl;
+    if(fseek(file->fp, (long)offset, SEEK_SET) != 0)
+        return EH_RET_INVALID_STATE;
+    rl = fread(buf, 1, len, file->fp);
+    if(rl == 0 && ferror(file->fp))
+        return EH_RET_INVALID_STATE;
+    return (int)rl;
+}
+
+static void ymodem_file_close(void *handle, int status){
+    struct ymodem_file *file = handle;
+    /* 写入的数据到达磁盘才算接收成功 */
+    if(fclose(file->fp) != 0 && status == 0)
+        status = EH_RET_INVALID_STATE;
+    if(file->is_write){
+        if(status == 0 && rename(file->part, file->path) != 0){
+            eh_mwarnfl(YMODEM_FILE, "rename %s failed %d", file->part, errno);
+            status = EH_RET_INVALID_STATE;
+        }
+        if(status < 0)
+            remove(file->part);
+    }
+    eh_free(file);
+}
+
+static struct ehshell_ymodem_backend ymodem_file_backend = {
+    .name = "file",
+    .open = ymodem_file_open,
+    .write = ymodem_file_write,
+    .read = ymodem_file_read,
+    .close = ymodem_file_close,
+};
+
+int __init ymodem_file_init(void){
+    s_ymodem_file_dir = getenv("EHSHELL_YMODEM_FILE_DIR");
+    if(s_ymodem_file_dir == NULL || *s_ymodem_file_dir == '\0')
+        s_ymodem_file_dir = CONFIG_PACKAGE_EHSHELL_BUILTIN_YMODEM_FILE_DIR;
+    return ehshell_ymodem_backend_register(&ymodem_file_backend);
+}
+
+void __exit ymodem_file_exit(void){
+    ehshell_ymodem_backend_unregister(&ymodem_file_backend);
+}
+
+ehshell_module_shell_export(ymodem_file_init, ymodem_file_exit);
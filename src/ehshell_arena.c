@@ -0,0 +1,170 @@
+/**
+ * @file ehshell_arena.c
+ * @brief 命令上下文的bump指针分配器，页来自shell的空闲页池，
+ *        命令结束时整条页链一次归还，避免长期运行后堆碎片化
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-20
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_list.h>
+
+#include <ehshell.h>
+#include <ehshell_internal.h>
+
+#define EHSHELL_ARENA_ALIGN         8
+#define EHSHELL_ARENA_PAGE_DATA     (EHSHELL_CONFIG_ARENA_PAGE_SIZE - sizeof(struct ehshell_arena_page))
+
+struct ehshell_arena_page{
+    struct eh_list_head node;
+    uint32_t            size;       /* 数据区大小，不等于 EHSHELL_ARENA_PAGE_DATA 的为独占大页 */
+    uint32_t            used;
+};
+
+#define ehshell_arena_page_data(page) ((uint8_t *)((page) + 1))
+
+/* 把list中的节点整体接到head尾部，list重新初始化 */
+static void ehshell_arena_list_splice_tail(struct eh_list_head *list, struct eh_list_head *head){
+    if(eh_list_empty(list))
+        return ;
+    list->next->prev = head->prev;
+    head->prev->next = list->next;
+    list->prev->next = head;
+    head->prev = list->prev;
+    eh_list_head_init(list);
+}
+
+struct ehshell_arena_page *ehshell_arena_page_get(ehshell_t *shell, size_t size){
+    struct ehshell_arena_page *page;
+    if(size <= EHSHELL_ARENA_PAGE_DATA && shell && !eh_list_empty(&shell->arena_free)){
+        page = eh_list_entry(shell->arena_free.next, struct ehshell_arena_page, node);
+        eh_list_del(&page->node);
+        shell->arena_free_count--;
+    }else{
+        if(size < EHSHELL_ARENA_PAGE_DATA)
+            size = EHSHELL_ARENA_PAGE_DATA;
+        page = eh_malloc(sizeof(struct ehshell_arena_page) + size);
+        if(page == NULL)
+            return NULL;
+        page->size = (uint32_t)size;
+    }
+    page->used = 0;
+    eh_list_head_init(&page->node);
+    return page;
+}
+
+void ehshell_arena_page_put(ehshell_t *shell, struct ehshell_arena_page *page){
+    if(shell && page->size == EHSHELL_ARENA_PAGE_DATA && shell->arena_free_count < EHSHELL_CONFIG_ARENA_POOL_PAGES){
+        eh_list_add(&page->node, &shell->arena_free);
+        shell->arena_free_count++;
+        return ;
+    }
+    eh_free(page);
+}
+
+void *ehshell_arena_page_buf(struct ehshell_arena_page *page){
+    return ehshell_arena_page_data(page);
+}
+
+void ehshell_command_arena_init(ehshell_cmd_context_t *cmd_context){
+    eh_list_head_init(&cmd_context->arena_pages);
+    cmd_context->arena_page_count = 0;
+    cmd_context->arena_used = 0;
+    cmd_context->flags &= ~(uint32_t)EHSHELL_CMD_CONTEXT_FLAG_ARENA_LARGE;
+}
+
+void ehshell_command_arena_release(ehshell_cmd_context_t *cmd_context){
+    ehshell_t *shell = cmd_context->ehshell;
+    struct ehshell_arena_page *page, *n;
+    if(eh_list_empty(&cmd_context->arena_pages))
+        return ;
+    if(shell && cmd_context->arena_used > shell->arena_high_water)
+        shell->arena_high_water = cmd_context->arena_used;
+    if(shell && !(cmd_context->flags & EHSHELL_CMD_CONTEXT_FLAG_ARENA_LARGE) &&
+        shell->arena_free_count + cmd_context->arena_page_count <= EHSHELL_CONFIG_ARENA_POOL_PAGES){
+        /* 常见情况：整条页链直接接回空闲页池 */
+        ehshell_arena_list_splice_tail(&cmd_context->arena_pages, &shell->arena_free);
+        shell->arena_free_count = (uint16_t)(shell->arena_free_count + cmd_context->arena_page_count);
+    }else{
+        eh_list_for_each_entry_safe(page, n, &cmd_context->arena_pages, node){
+            eh_list_del(&page->node);
+            ehshell_arena_page_put(shell, page);
+        }
+    }
+    ehshell_command_arena_init(cmd_context);
+}
+
+void ehshell_command_arena_transfer(ehshell_cmd_context_t *dst, ehshell_cmd_context_t *src){
+    ehshell_arena_list_splice_tail(&src->arena_pages, &dst->arena_pages);
+    dst->arena_page_count = (uint16_t)(dst->arena_page_count + src->arena_page_count);
+    dst->arena_used += src->arena_used;
+    dst->flags |= src->flags & EHSHELL_CMD_CONTEXT_FLAG_ARENA_LARGE;
+    ehshell_command_arena_init(src);
+}
+
+void ehshell_command_arena_free(ehshell_cmd_context_t *cmd_context){
+    struct ehshell_arena_page *page, *n;
+    eh_list_for_each_entry_safe(page, n, &cmd_context->arena_pages, node){
+        eh_list_del(&page->node);
+        eh_free(page);
+    }
+    ehshell_command_arena_init(cmd_context);
+}
+
+void ehshell_arena_destroy(ehshell_t *shell){
+    struct ehshell_arena_page *page, *n;
+    eh_list_for_each_entry_safe(page, n, &shell->arena_free, node){
+        eh_list_del(&page->node);
+        eh_free(page);
+    }
+    shell->arena_free_count = 0;
+}
+
+void *ehshell_command_arena_alloc(ehshell_cmd_context_t *cmd_context, size_t size){
+    struct ehshell_arena_page *page;
+    void *p;
+    if(cmd_context == NULL || size == 0)
+        return NULL;
+    size = (size + EHSHELL_ARENA_ALIGN - 1) & ~(size_t)(EHSHELL_ARENA_ALIGN - 1);
+    if(!eh_list_empty(&cmd_context->arena_pages)){
+        page = eh_list_entry(cmd_context->arena_pages.prev, struct ehshell_arena_page, node);
+        if(page->size - page->used >= size)
+            goto alloc;
+    }
+    /* 工作线程不访问shell的页池，直接向堆申请 */
+    page = ehshell_arena_page_get((cmd_context->flags & EHSHELL_CMD_CONTEXT_FLAG_WORKER) ? NULL : cmd_context->ehshell, size);
+    if(page == NULL)
+        return NULL;
+    cmd_context->arena_page_count++;
+    if(page->size != EHSHELL_ARENA_PAGE_DATA){
+        /* 大页独占，放在链表头部，尾部的页继续用于小块分配 */
+        cmd_context->flags |= EHSHELL_CMD_CONTEXT_FLAG_ARENA_LARGE;
+        eh_list_add(&page->node, &cmd_context->arena_pages);
+    }else{
+        eh_list_add_tail(&page->node, &cmd_context->arena_pages);
+    }
+alloc:
+    p = ehshell_arena_page_data(page) + page->used;
+    page->used += (uint32_t)size;
+    cmd_context->arena_used += (uint32_t)size;
+    return p;
+}
+
+void *ehshell_command_arena_zalloc(ehshell_cmd_context_t *cmd_context, size_t size){
+    void *p = ehshell_command_arena_alloc(cmd_context, size);
+    if(p)
+        memset(p, 0, size);
+    return p;
+}
+
+size_t ehshell_arena_high_water(ehshell_t *ehshell){
+    if(!ehshell)
+        return 0;
+    return ehshell->arena_high_water;
+}
@@ -9,36 +9,73 @@
  */
 
 
+#include <stdlib.h>
 #include <string.h>
 #include <eh_error.h>
 #include <eh_formatio.h>
 #include <ehshell.h>
 #include <ehshell_module.h>
 #include <ehshell_internal.h>
+#include <ehshell_coroutine.h>
 #include <eh_ringbuf.h>
 
+#define HELP_CHUNK_SIZE     128
+
+struct help_frame{
+    const struct ehshell_command_info *parent;     /* 列出其子命令，NULL表示列出全部命令 */
+    size_t      index;
+};
+
+static int help_next_chunk(ehshell_cmd_context_t *cmd_context, struct stream_base *stream){
+    struct help_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct help_frame));
+    const struct ehshell_command_table *table;
+    const struct ehshell_command_info *command_info;
+    size_t count;
+    if(f == NULL)
+        return EH_RET_MALLOC_ERROR;
+    if(f->parent){
+        count = f->parent->subcommand_count;
+        if(f->index >= count)
+            return 0;
+        command_info = &f->parent->subcommands[f->index];
+    }else{
+        /* 每次重新取快照，输出期间注册的命令最多造成重复或遗漏一行 */
+        table = ehshell_command_snapshot();
+        count = table->count;
+        if(f->index >= count)
+            return 0;
+        command_info = table->commands[f->index];
+    }
+    eh_stream_printf(stream, "%16s:\t\t\t%s\r\n", command_info->command, command_info->description);
+    return ++f->index < count;
+}
+
 static void do_help(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
-    size_t command_count;
-    if(argc > 2){
-        /* 参数太多 */
-        eh_stream_printf(ehshell_command_stream(cmd_context), "Parameter too many.\r\n");
+    struct help_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct help_frame));
+    const struct ehshell_command_info* command_info = NULL;
+    if(f == NULL){
+        eh_stream_printf(ehshell_command_stream(cmd_context), "help: out of memory\r\n");
         goto quit;
     }
-    if(argc == 2){
-        const struct ehshell_command_info* command_info = ehshell_command_find(ehshell_command_get_shell(cmd_context), argv[1]);
+    if(argc >= 2){
+        /* help 命令 [子命令...]，沿子命令表逐级查找 */
+        command_info = ehshell_command_find(ehshell_command_get_shell(cmd_context), argv[1]);
+        for(int i = 2; command_info && i < argc; i++)
+            command_info = ehshell_subcommand_lookup(command_info, argv[i]);
         if(command_info == NULL){
-            eh_stream_printf(ehshell_command_stream(cmd_context), "Command %s not found.\r\n", argv[1]);
+            eh_stream_printf(ehshell_command_stream(cmd_context), "Command %s not found.\r\n", argv[argc - 1]);
             goto quit;
         }
         eh_stream_printf(ehshell_command_stream(cmd_context), "%s:\t%s\r\n", command_info->command, command_info->description);
         eh_stream_printf(ehshell_command_stream(cmd_context), "\t%s\r\n", command_info->usage);
-        goto quit;
-    }
-    /* 打印所有命令 */
-    command_count = ehshell_commands_count();
-    for(size_t i = 0; i < command_count; i++){
-        eh_stream_printf(ehshell_command_stream(cmd_context), "%16s:\t\t\t%s\r\n", ehshell_command_get(i)->command, ehshell_command_get(i)->description);
+        if(command_info->subcommands == NULL)
+            goto quit;
+        eh_stream_printf(ehshell_command_stream(cmd_context), "Subcommands:\r\n");
     }
+    /* 命令表可能很大，按输出空间逐行输出 */
+    f->parent = command_info;
+    if(ehshell_command_generate(cmd_context, help_next_chunk, HELP_CHUNK_SIZE) == 0)
+        return ;
 quit:
     eh_stream_finish(ehshell_command_stream(cmd_context));
     ehshell_command_finish(cmd_context);
@@ -58,7 +95,8 @@ static void do_quit(ehshell_cmd_context_t *cmd_context, int argc, const char *ar
     eh_stream_printf(ehshell_command_stream(cmd_context), "Quit the current terminal session.\r\n");
     eh_stream_finish(ehshell_command_stream(cmd_context));
     ehshell_command_finish(cmd_context);
-    ehshell->state = EHSHELL_STATE_QUIT;
+    if(ehshell)
+        ehshell->state = EHSHELL_STATE_QUIT;
 }
 
 
@@ -177,11 +215,430 @@ int ehshell_set_password(const char *password){
 }
 #endif
 
+/* 内存查看/修改命令 */
+#define EHSHELL_MEM_ROW_BYTES       16
+#define EHSHELL_MEM_ROW_MAX         (sizeof(uintptr_t) * 2 + 2 + EHSHELL_MEM_ROW_BYTES * 3 + 1 + EHSHELL_MEM_ROW_BYTES + 2)
+#define EHSHELL_MEM_PATTERN_MAX     16
+
+#define EHSHELL_HEX_PAIR_ROW(h)                                                     \
+    {h,'0'},{h,'1'},{h,'2'},{h,'3'},{h,'4'},{h,'5'},{h,'6'},{h,'7'},                \
+    {h,'8'},{h,'9'},{h,'a'},{h,'b'},{h,'c'},{h,'d'},{h,'e'},{h,'f'}
+
+/* 每个字节对应的两个十六进制字符，按行渲染时查表，不经过格式化函数 */
+static const char ehshell_hex_pair[256][2] = {
+    EHSHELL_HEX_PAIR_ROW('0'), EHSHELL_HEX_PAIR_ROW('1'), EHSHELL_HEX_PAIR_ROW('2'), EHSHELL_HEX_PAIR_ROW('3'),
+    EHSHELL_HEX_PAIR_ROW('4'), EHSHELL_HEX_PAIR_ROW('5'), EHSHELL_HEX_PAIR_ROW('6'), EHSHELL_HEX_PAIR_ROW('7'),
+    EHSHELL_HEX_PAIR_ROW('8'), EHSHELL_HEX_PAIR_ROW('9'), EHSHELL_HEX_PAIR_ROW('a'), EHSHELL_HEX_PAIR_ROW('b'),
+    EHSHELL_HEX_PAIR_ROW('c'), EHSHELL_HEX_PAIR_ROW('d'), EHSHELL_HEX_PAIR_ROW('e'), EHSHELL_HEX_PAIR_ROW('f'),
+};
+
+struct mem_frame{
+    uintptr_t   addr;
+    uintptr_t   addr2;
+    size_t      len;
+    size_t      total;
+    uint32_t    found;
+    uint32_t    value;
+    uint8_t     width;
+    uint8_t     pattern_len;
+    uint8_t     pattern[EHSHELL_MEM_PATTERN_MAX];
+    char        buf[EHSHELL_CONFIG_MEMORY_CHUNK_ROWS * EHSHELL_MEM_ROW_MAX];
+};
+
+#if EHSHELL_CONFIG_MEMORY_TEST_BUFFER_SIZE > 0
+/* 主机端调试用的测试缓冲区，地址参数写 test 即可访问 */
+static uint32_t mem_test_buffer[(EHSHELL_CONFIG_MEMORY_TEST_BUFFER_SIZE + 3) / 4];
+#endif
+
+static int mem_parse_num(const char *str, uintptr_t *val){
+    char *end;
+    unsigned long long v;
+#if EHSHELL_CONFIG_MEMORY_TEST_BUFFER_SIZE > 0
+    if(strcmp(str, "test") == 0){
+        *val = (uintptr_t)mem_test_buffer;
+        return EH_RET_OK;
+    }
+#endif
+    v = strtoull(str, &end, 0);
+    if(end == str || *end != '\0')
+        return EH_RET_INVALID_PARAM;
+    *val = (uintptr_t)v;
+    return EH_RET_OK;
+}
+
+/* 解析可选的 -w 1|2|4 参数，返回第一个位置参数的下标 */
+static int mem_parse_width(int argc, const char *argv[], uint8_t *width){
+    *width = 1;
+    if(argc > 2 && strcmp(argv[1], "-w") == 0){
+        if(strcmp(argv[2], "1") != 0 && strcmp(argv[2], "2") != 0 && strcmp(argv[2], "4") != 0)
+            return EH_RET_INVALID_PARAM;
+        *width = (uint8_t)(argv[2][0] - '0');
+        return 3;
+    }
+    return 1;
+}
+
+static uint32_t mem_read(uintptr_t addr, uint8_t width, uint8_t *bytes){
+    switch(width){
+        case 4:{
+            uint32_t v = *(volatile uint32_t *)addr;
+            memcpy(bytes, &v, 4);
+            return v;
+        }
+        case 2:{
+            uint16_t v = *(volatile uint16_t *)addr;
+            memcpy(bytes, &v, 2);
+            return v;
+        }
+        default:
+            bytes[0] = *(volatile uint8_t *)addr;
+            return bytes[0];
+    }
+}
+
+static void mem_write(uintptr_t addr, uint8_t width, uint32_t value){
+    switch(width){
+        case 4:
+            *(volatile uint32_t *)addr = value;
+            break;
+        case 2:
+            *(volatile uint16_t *)addr = (uint16_t)value;
+            break;
+        default:
+            *(volatile uint8_t *)addr = (uint8_t)value;
+            break;
+    }
+}
+
+static char *mem_put_hex(char *p, uintptr_t value, size_t bytes){
+    while(bytes--){
+        memcpy(p, ehshell_hex_pair[(value >> (bytes * 8)) & 0xFF], 2);
+        p += 2;
+    }
+    return p;
+}
+
+/* 渲染一行：地址、按宽度分组的十六进制、ASCII列 */
+static size_t mem_render_row(char *row, uintptr_t addr, size_t len, uint8_t width){
+    uint8_t bytes[EHSHELL_MEM_ROW_BYTES];
+    char *p = row;
+    size_t i;
+    p = mem_put_hex(p, addr, sizeof(uintptr_t));
+    *p++ = ':';
+    *p++ = ' ';
+    for(i = 0; i < EHSHELL_MEM_ROW_BYTES; i += width){
+        if(i < len){
+            p = mem_put_hex(p, mem_read(addr + i, width, bytes + i), width);
+        }else{
+            memset(p, ' ', (size_t)width * 2);
+            p += width * 2;
+        }
+        *p++ = ' ';
+    }
+    *p++ = ' ';
+    for(i = 0; i < len; i++)
+        *p++ = (bytes[i] >= 0x20 && bytes[i] < 0x7F) ? (char)bytes[i] : '.';
+    *p++ = '\r';
+    *p++ = '\n';
+    return (size_t)(p - row);
+}
+
+static size_t mem_write_space(ehshell_cmd_context_t *cmd_context){
+    ehshell_t *shell = cmd_context->ehshell;
+    if(shell == NULL || shell->config->stream_write_space == NULL || cmd_context->stream != (struct stream_base *)&shell->stream)
+        return SIZE_MAX;
+    return shell->config->stream_write_space(shell);
+}
+
+static bool mem_interrupted(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    if(!EHSHELL_CO_CANCELLED(ehshell_event))
+        return false;
+    if(ehshell_event & EHSHELL_EVENT_SIGINT_REQUEST_QUIT){
+        eh_stream_printf(ehshell_command_stream(cmd_context), "^C\r\n");
+        eh_stream_finish(ehshell_command_stream(cmd_context));
+    }
+    return true;
+}
+
+static struct mem_frame *mem_frame_start(ehshell_cmd_context_t *cmd_context){
+    struct mem_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct mem_frame));
+    if(f == NULL){
+        eh_stream_printf(ehshell_command_stream(cmd_context), "%s: out of memory\r\n",
+            ehshell_command_getcommand_info(cmd_context)->command);
+        return NULL;
+    }
+    ehshell_command_resume_later(cmd_context);
+    return f;
+}
+
+static void do_md(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    struct mem_frame *f;
+    uintptr_t addr, len = 64;
+    uint8_t width;
+    int i = mem_parse_width(argc, argv, &width);
+    if(i < 0 || (argc - i != 1 && argc - i != 2) || mem_parse_num(argv[i], &addr) < 0 ||
+        (argc - i == 2 && mem_parse_num(argv[i + 1], &len) < 0)){
+        eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+        goto quit;
+    }
+    if(addr % width){
+        eh_stream_printf(stream, "md: address 0x%lx not aligned to %d\r\n", (unsigned long)addr, width);
+        goto quit;
+    }
+    if((f = mem_frame_start(cmd_context)) == NULL)
+        goto quit;
+    f->addr = addr;
+    f->len = (len + width - 1) / width * width;
+    f->width = width;
+    return ;
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_md_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    struct mem_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct mem_frame));
+    size_t rows, n, pos;
+    EHSHELL_CO_BEGIN(cmd_context);
+    while(f->len){
+        EHSHELL_CO_AWAIT_WRITABLE(cmd_context, ehshell_event, EHSHELL_MEM_ROW_MAX);
+        if(mem_interrupted(cmd_context, ehshell_event))
+            break;
+        /* 按输出空间决定本次渲染的行数，整块渲染后一次写出 */
+        rows = mem_write_space(cmd_context) / EHSHELL_MEM_ROW_MAX;
+        if(rows > EHSHELL_CONFIG_MEMORY_CHUNK_ROWS)
+            rows = EHSHELL_CONFIG_MEMORY_CHUNK_ROWS;
+        for(pos = 0; rows-- && f->len; ){
+            n = f->len < EHSHELL_MEM_ROW_BYTES ? f->len : EHSHELL_MEM_ROW_BYTES;
+            pos += mem_render_row(f->buf + pos, f->addr, n, f->width);
+            f->addr += n;
+            f->len -= n;
+        }
+        ehshell_command_write(cmd_context, f->buf, pos);
+        eh_stream_finish(ehshell_command_stream(cmd_context));
+        if(f->len)
+            EHSHELL_CO_YIELD(cmd_context);
+    }
+    EHSHELL_CO_END(cmd_context);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_mw(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    uintptr_t addr, value;
+    uint8_t width;
+    int i = mem_parse_width(argc, argv, &width);
+    if(i < 0 || argc - i < 2 || mem_parse_num(argv[i], &addr) < 0){
+        eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+        goto quit;
+    }
+    if(addr % width){
+        eh_stream_printf(stream, "mw: address 0x%lx not aligned to %d\r\n", (unsigned long)addr, width);
+        goto quit;
+    }
+    for(i++; i < argc; i++, addr += width){
+        if(mem_parse_num(argv[i], &value) < 0){
+            eh_stream_printf(stream, "mw: invalid value %s\r\n", argv[i]);
+            goto quit;
+        }
+        mem_write(addr, width, (uint32_t)value);
+    }
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_mfill(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    struct mem_frame *f;
+    uintptr_t addr, len, value;
+    uint8_t width;
+    int i = mem_parse_width(argc, argv, &width);
+    if(i < 0 || argc - i != 3 || mem_parse_num(argv[i], &addr) < 0 ||
+        mem_parse_num(argv[i + 1], &len) < 0 || mem_parse_num(argv[i + 2], &value) < 0){
+        eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+        goto quit;
+    }
+    if(addr % width || len % width){
+        eh_stream_printf(stream, "mfill: address and length must be aligned to %d\r\n", width);
+        goto quit;
+    }
+    if((f = mem_frame_start(cmd_context)) == NULL)
+        goto quit;
+    f->addr = addr;
+    f->len = len;
+    f->value = (uint32_t)value;
+    f->width = width;
+    return ;
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_mfill_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    struct mem_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct mem_frame));
+    size_t n;
+    EHSHELL_CO_BEGIN(cmd_context);
+    while(f->len){
+        if(mem_interrupted(cmd_context, ehshell_event))
+            goto quit;
+        /* 块大小是宽度的整数倍，剩余长度保持对齐 */
+        n = f->len < EHSHELL_CONFIG_MEMORY_CHUNK_BYTES ? f->len : EHSHELL_CONFIG_MEMORY_CHUNK_BYTES / 4 * 4;
+        if(f->width == 1){
+            memset((void *)f->addr, (int)f->value, n);
+        }else{
+            for(size_t i = 0; i < n; i += f->width)
+                mem_write(f->addr + i, f->width, f->value);
+        }
+        f->addr += n;
+        f->len -= n;
+        if(f->len)
+            EHSHELL_CO_YIELD(cmd_context);
+    }
+    eh_stream_finish(ehshell_command_stream(cmd_context));
+quit:
+    EHSHELL_CO_END(cmd_context);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_mcmp(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    struct mem_frame *f;
+    uintptr_t addr, addr2, len;
+    if(argc != 4 || mem_parse_num(argv[1], &addr) < 0 || mem_parse_num(argv[2], &addr2) < 0 ||
+        mem_parse_num(argv[3], &len) < 0){
+        eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+        goto quit;
+    }
+    if((f = mem_frame_start(cmd_context)) == NULL)
+        goto quit;
+    f->addr = addr;
+    f->addr2 = addr2;
+    f->len = len;
+    f->total = len;
+    return ;
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_mcmp_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    struct mem_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct mem_frame));
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    const uint8_t *a, *b;
+    size_t n;
+    EHSHELL_CO_BEGIN(cmd_context);
+    while(f->len){
+        if(mem_interrupted(cmd_context, ehshell_event))
+            goto quit;
+        n = f->len < EHSHELL_CONFIG_MEMORY_CHUNK_BYTES ? f->len : EHSHELL_CONFIG_MEMORY_CHUNK_BYTES;
+        a = (const uint8_t *)f->addr;
+        b = (const uint8_t *)f->addr2;
+        if(memcmp(a, b, n) != 0){
+            for(size_t i = 0; i < n; i++){
+                if(a[i] == b[i])
+                    continue;
+                if(f->found++ < EHSHELL_CONFIG_MEMORY_REPORT_MAX)
+                    eh_stream_printf(stream, "0x%lx: %02x != 0x%lx: %02x\r\n",
+                        (unsigned long)(f->addr + i), a[i], (unsigned long)(f->addr2 + i), b[i]);
+            }
+            eh_stream_finish(stream);
+        }
+        f->addr += n;
+        f->addr2 += n;
+        f->len -= n;
+        if(f->len)
+            EHSHELL_CO_YIELD(cmd_context);
+    }
+    eh_stream_printf(stream, "mcmp: %u difference(s) in %lu bytes\r\n", (unsigned)f->found, (unsigned long)f->total);
+    eh_stream_finish(stream);
+quit:
+    EHSHELL_CO_END(cmd_context);
+    ehshell_command_finish(cmd_context);
+}
+
+static int mem_parse_pattern(const char *str, uint8_t *pattern, uint8_t *pattern_len){
+    size_t len = strlen(str);
+    if(len >= 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')){
+        str += 2;
+        len -= 2;
+    }
+    if(len == 0 || len % 2 || len / 2 > EHSHELL_MEM_PATTERN_MAX)
+        return EH_RET_INVALID_PARAM;
+    for(size_t i = 0; i < len / 2; i++){
+        char hex[3] = {str[i * 2], str[i * 2 + 1], '\0'};
+        char *end;
+        pattern[i] = (uint8_t)strtoul(hex, &end, 16);
+        if(*end != '\0')
+            return EH_RET_INVALID_PARAM;
+    }
+    *pattern_len = (uint8_t)(len / 2);
+    return EH_RET_OK;
+}
+
+static void do_msearch(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    struct mem_frame *f;
+    uint8_t pattern[EHSHELL_MEM_PATTERN_MAX];
+    uint8_t pattern_len;
+    uintptr_t addr, len;
+    if(argc != 4 || mem_parse_num(argv[1], &addr) < 0 || mem_parse_num(argv[2], &len) < 0 ||
+        mem_parse_pattern(argv[3], pattern, &pattern_len) < 0){
+        eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+        goto quit;
+    }
+    if((f = mem_frame_start(cmd_context)) == NULL)
+        goto quit;
+    f->addr = addr;
+    f->len = len;
+    f->total = len;
+    memcpy(f->pattern, pattern, pattern_len);
+    f->pattern_len = pattern_len;
+    return ;
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_msearch_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    struct mem_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct mem_frame));
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    const uint8_t *p, *end;
+    size_t n;
+    EHSHELL_CO_BEGIN(cmd_context);
+    while(f->len >= f->pattern_len){
+        if(mem_interrupted(cmd_context, ehshell_event))
+            goto quit;
+        /* 每段多扫描 pattern_len - 1 字节，跨段的匹配不会遗漏 */
+        n = f->len - f->pattern_len + 1;
+        if(n > EHSHELL_CONFIG_MEMORY_CHUNK_BYTES)
+            n = EHSHELL_CONFIG_MEMORY_CHUNK_BYTES;
+        p = (const uint8_t *)f->addr;
+        end = p + n;
+        while(p < end && (p = memchr(p, f->pattern[0], (size_t)(end - p))) != NULL){
+            if(memcmp(p, f->pattern, f->pattern_len) == 0 && f->found++ < EHSHELL_CONFIG_MEMORY_REPORT_MAX)
+                eh_stream_printf(stream, "0x%lx\r\n", (unsigned long)p);
+            p++;
+        }
+        eh_stream_finish(stream);
+        f->addr += n;
+        f->len -= n;
+        if(f->len >= f->pattern_len)
+            EHSHELL_CO_YIELD(cmd_context);
+    }
+    eh_stream_printf(stream, "msearch: %u match(es) in %lu bytes\r\n", (unsigned)f->found, (unsigned long)f->total);
+    eh_stream_finish(stream);
+quit:
+    EHSHELL_CO_END(cmd_context);
+    ehshell_command_finish(cmd_context);
+}
+
 static struct ehshell_command_info ehshell_command_info_tbl[] = {
     {
         .command = "help",
         .description = "Show help information.",
-        .usage = "help [command]",
+        .usage = "help [command [subcommand...]]",
         .flags = 0,
         .do_function = do_help,
         .do_event_function = NULL
@@ -199,6 +656,41 @@ static struct ehshell_command_info ehshell_command_info_tbl[] = {
         .flags = 0,
         .do_function = do_quit,
         .do_event_function = NULL
+    },{
+        .command = "md",
+        .description = "Display memory.",
+        .usage = "md [-w 1|2|4] <addr> [len]",
+        .flags = 0,
+        .do_function = do_md,
+        .do_event_function = do_md_event,
+    },{
+        .command = "mw",
+        .description = "Write memory.",
+        .usage = "mw [-w 1|2|4] <addr> <value> [value...]",
+        .flags = 0,
+        .do_function = do_mw,
+        .do_event_function = NULL,
+    },{
+        .command = "mfill",
+        .description = "Fill memory with a value.",
+        .usage = "mfill [-w 1|2|4] <addr> <len> <value>",
+        .flags = 0,
+        .do_function = do_mfill,
+        .do_event_function = do_mfill_event,
+    },{
+        .command = "mcmp",
+        .description = "Compare two memory regions.",
+        .usage = "mcmp <addr1> <addr2> <len>",
+        .flags = 0,
+        .do_function = do_mcmp,
+        .do_event_function = do_mcmp_event,
+    },{
+        .command = "msearch",
+        .description = "Search memory for a byte pattern.",
+        .usage = "msearch <addr> <len> <hex bytes>",
+        .flags = 0,
+        .do_function = do_msearch,
+        .do_event_function = do_msearch_event,
     },
     
 #ifdef CONFIG_PACKAGE_EHSHELL_USE_PASSWORD
@@ -18,47 +18,95 @@
 #include <eh_error.h>
 #include <eh_ringbuf.h>
 #include <eh_debug.h>
+#include <eh_platform.h>
 
 #include <eh_formatio.h>
 #include <eh_signal.h>
-#include <eh_comp_timer.h>
 
 #include <ehshell.h>
 #include <ehshell_module.h>
 #include <ehshell_internal.h>
 #include <ehshell_escape_char.h>
+#include <ehshell_coroutine.h>
 
 
 #ifndef EH_DBG_MODULE_LEVEL_EHSHELL
 #define EH_DBG_MODULE_LEVEL_EHSHELL EH_DBG_INFO
 #endif
 
-static const struct ehshell_command_info  * ehshell_commands[CONFIG_PACKAGE_EHSHELL_MAX_COMMAND_SIZE];
-static size_t ehshell_command_count = 0;
+/*
+ * 命令注册表是只读快照，注册时复制出新的有序表再整体发布，
+ * 查找只读取一次快照指针，其他分片线程可以同时查找
+ */
+static struct ehshell_command_table ehshell_command_table_empty;
+static struct ehshell_command_table *ehshell_command_table = &ehshell_command_table_empty;
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+static struct ehshell_command_table *ehshell_command_table_retired;
+#endif
+
+/* 
+ * 所有shell共用一个就绪队列和一个调度信号，
+ * 只有队列从空变为非空时才发出通知，调度器按轮转方式服务各个shell
+ */
+static struct eh_list_head ehshell_ready_list;
+static size_t ehshell_ready_count;
+static eh_signal_base_t ehshell_sig_dispatch;
+static eh_signal_slot_t ehshell_slot_dispatch;
+
+const struct ehshell_command_table *ehshell_command_snapshot(void){
+    return __atomic_load_n(&ehshell_command_table, __ATOMIC_ACQUIRE);
+}
 
 size_t ehshell_commands_count(void){
-    return ehshell_command_count;
+    return ehshell_command_snapshot()->count;
 }
 
 const struct ehshell_command_info  * ehshell_command_get(size_t index){
-    return ehshell_commands[index];
+    return ehshell_command_snapshot()->commands[index];
+}
+
+void ehshell_port_write(ehshell_t *shell, const char *buf, size_t len){
+    /* 输出与输入共用本次调度的预算，用完后命令的恢复推迟到下一轮 */
+    if(shell->dispatch_budget > 0)
+        shell->dispatch_budget = len >= (size_t)shell->dispatch_budget ? 0 : shell->dispatch_budget - (int32_t)len;
+    if(shell->recorder)
+        ehshell_recorder_output(shell, buf, len);
+    shell->config->stream_write(shell, buf, len);
+    /* 主会话先输出，镜像只复制一次 */
+    if(!eh_list_empty(&shell->sinks))
+        ehshell_mirror_output(shell, buf, len);
+}
+
+void ehshell_output_write(ehshell_t *shell, const char *buf, size_t len){
+    if(shell->machine){
+        ehshell_machine_output(shell, buf, len);
+        return ;
+    }
+    ehshell_port_write(shell, buf, len);
+}
+
+void ehshell_output_finish(ehshell_t *shell){
+    if(shell->machine)
+        ehshell_machine_flush(shell);
+    if(shell->config->stream_finish)
+        shell->config->stream_finish(shell);
+    ehshell_mirror_flush(shell);
 }
 
 static void ehshell_stream_write(void *ctx, const uint8_t *buf, size_t len){
     struct stream_function_no_cache *stream = (struct stream_function_no_cache *)ctx;
     ehshell_t *shell = eh_container_of(stream, ehshell_t, stream);
-    shell->config->stream_write(shell, (const char *)buf, len);
+    ehshell_output_write(shell, (const char *)buf, len);
 }
 
 static void ehshell_stream_finish(void *ctx){
     struct stream_function_no_cache *stream = (struct stream_function_no_cache *)ctx;
     ehshell_t *shell = eh_container_of(stream, ehshell_t, stream);
-    if(shell->config->stream_finish)
-        shell->config->stream_finish(shell);
+    ehshell_output_finish(shell);
 }   
 
 static void ehshell_print_welcome(ehshell_t *shell){
-    shell->config->stream_write(shell, EHSHELL_CONFIG_WELCOME, sizeof(EHSHELL_CONFIG_WELCOME) - 1);
+    ehshell_port_write(shell, EHSHELL_CONFIG_WELCOME, sizeof(EHSHELL_CONFIG_WELCOME) - 1);
 }
 static void ehshell_print_prompt(ehshell_t *shell){
     if(shell->linebuf_data_len){
@@ -79,6 +127,37 @@ static void ehshell_input_reset(ehshell_t *shell){
     shell->escape_char_match_state = 0;
 }
 
+static void ehshell_command_call_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    const char *name = cmd_context->command_info->command;
+    eh_clock_t start;
+    if(!cmd_context->gen_next && !cmd_context->command_info->do_event_function)
+        return ;
+    start = ehshell_stall_start();
+    if(cmd_context->gen_next)
+        ehshell_command_generate_step(cmd_context, (uint32_t)ehshell_event);
+    else
+        cmd_context->command_info->do_event_function(cmd_context, ehshell_event);
+    ehshell_stall_account(EHSHELL_STALL_EVENT, name, (uint32_t)ehshell_event, start);
+}
+
+void ehshell_command_call(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    const char *name = cmd_context->command_info->command;
+    eh_clock_t start = ehshell_stall_start();
+    cmd_context->command_info->do_function(cmd_context, argc, argv);
+    ehshell_stall_account(EHSHELL_STALL_FUNCTION, name, 0, start);
+}
+
+void ehshell_command_post_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+#if CONFIG_PACKAGE_EHSHELL_WORKER_NUM > 0
+    if(cmd_context->worker_job){
+        /* 工作线程中的命令自行查询事件 */
+        ehshell_worker_post_event(cmd_context, ehshell_event);
+        return ;
+    }
+#endif
+    ehshell_command_call_event(cmd_context, ehshell_event);
+}
+
 #ifdef CONFIG_PACKAGE_EHSHELL_USE_PASSWORD
 static void ehshell_run_login(ehshell_t *shell){
     const char *argv[1] = {"login"};
@@ -103,9 +182,13 @@ static int ehshell_linebuf_pos_left_char_bytes(ehshell_t *shell) {
     return bytes;
 }
 
-static int _ehshell_command_run_form_string(ehshell_t *ehshell, char *cmd_str)
+/**
+ * @brief                   就地切分命令行，处理引号和转义
+ * @param  err              出错时返回错误描述
+ * @return int              返回参数个数，出错返回负数
+ */
+int ehshell_command_split(char *cmd_str, const char *argv[], const char **err)
 {
-    const char *argv[EHSHELL_CONFIG_ARGC_MAX] = {0};
     int argc = 0;
 
     char *p = cmd_str;
@@ -122,8 +205,7 @@ static int _ehshell_command_run_form_string(ehshell_t *ehshell, char *cmd_str)
             break;
 
         if (argc >= EHSHELL_CONFIG_ARGC_MAX){
-            eh_stream_printf((struct stream_base *)&ehshell->stream, "command \"%s\" argc overflow %d\r\n", cmd_str, argc);
-            eh_stream_finish((struct stream_base *)&ehshell->stream);
+            *err = "argc overflow";
             return EH_RET_INVALID_PARAM;
         }
 
@@ -176,10 +258,22 @@ static int _ehshell_command_run_form_string(ehshell_t *ehshell, char *cmd_str)
 
     /* 检查引号是否闭合 */
     if (in_quote) {
-        eh_stream_printf((struct stream_base *)&ehshell->stream, "command %s quote not close\r\n", cmd_str);
-        eh_stream_finish((struct stream_base *)&ehshell->stream);
+        *err = "quote not close";
         return EH_RET_INVALID_PARAM;  /* 引号未闭合 */
     }
+    return argc;
+}
+
+int _ehshell_command_run_form_string(ehshell_t *ehshell, char *cmd_str)
+{
+    const char *argv[EHSHELL_CONFIG_ARGC_MAX] = {0};
+    const char *err = NULL;
+    int argc = ehshell_command_split(cmd_str, argv, &err);
+    if(argc < 0){
+        eh_stream_printf((struct stream_base *)&ehshell->stream, "command \"%s\" %s\r\n", cmd_str, err);
+        eh_stream_finish((struct stream_base *)&ehshell->stream);
+        return argc;
+    }
     if(argc == 0)
         return EH_RET_INVALID_PARAM;
     /* 调用执行函数 */
@@ -192,26 +286,77 @@ static size_t ehshell_command_common_prefix_len(const char *s1, size_t s1_len, c
     }
     return prefix_len;
 }
+/* 补全时的一级命令表，顶层为有序的指针数组，子命令为有序的结构体数组 */
+struct ehshell_command_level{
+    const struct ehshell_command_info * const *ptrs;
+    const struct ehshell_command_info *infos;
+    size_t count;
+};
+
+static const struct ehshell_command_info *ehshell_command_level_get(const struct ehshell_command_level *level, size_t i){
+    return level->ptrs ? level->ptrs[i] : &level->infos[i];
+}
+
+/* 在一级命令表中查找长度为len的单词 */
+static const struct ehshell_command_info *ehshell_command_level_find(const struct ehshell_command_level *level, 
+    const char *word, size_t len){
+    const struct ehshell_command_info *command_info;
+    size_t start_pos = 0, end_pos = level->count, pos;
+    int cmp;
+    while(start_pos < end_pos){
+        pos = (start_pos + end_pos) / 2;
+        command_info = ehshell_command_level_get(level, pos);
+        cmp = strncmp(word, command_info->command, len);
+        if(cmp == 0 && command_info->command[len] != '\0')
+            cmp = -1;
+        if(cmp == 0)
+            return command_info;
+        if(cmp < 0)
+            end_pos = pos;
+        else
+            start_pos = pos + 1;
+    }
+    return NULL;
+}
+
 static void ehshell_command_auto_complete(ehshell_t *shell){
     char *linebuf = ehshell_linebuf(shell);
     size_t linebuf_pos = shell->linebuf_pos;
-    char *cmd = linebuf;
+    const struct ehshell_command_table *table = ehshell_command_snapshot();
+    struct ehshell_command_level level = { table->commands, NULL, table->count };
+    const struct ehshell_command_info *command_info;
     const char *first_completion = NULL;
     bool is_multi_match = false;
     size_t completion_len = 0;
+    size_t word_start = 0, word_end, prefix_len;
     size_t diff;
     if(linebuf_pos == 0){
         return;
     }
-    /* 如果中间有空格，就返回 */
-    for(size_t i=0; i < linebuf_pos; i++){
-        if(isspace((unsigned char)cmd[i])){
+    /* 光标之前已经输入完整的单词逐级匹配子命令，补全光标所在的单词 */
+    for(;;){
+        while(word_start < linebuf_pos && isspace((unsigned char)linebuf[word_start]))
+            word_start++;
+        word_end = word_start;
+        while(word_end < linebuf_pos && !isspace((unsigned char)linebuf[word_end]))
+            word_end++;
+        if(word_end == linebuf_pos)
+            break;
+        command_info = ehshell_command_level_find(&level, linebuf + word_start, word_end - word_start);
+        if(command_info == NULL || command_info->subcommands == NULL)
             return;
-        }
+        level.ptrs = NULL;
+        level.infos = command_info->subcommands;
+        level.count = command_info->subcommand_count;
+        word_start = word_end;
     }
-    for(size_t i=0; i < ehshell_command_count; i++){
-        const struct ehshell_command_info *command_info = ehshell_commands[i];
-        if(strncmp(cmd, command_info->command, linebuf_pos) == 0){
+    prefix_len = linebuf_pos - word_start;
+    /* 顶层命令至少输入一个字符，子命令可以直接列出全部 */
+    if(prefix_len == 0 && level.ptrs)
+        return;
+    for(size_t i=0; i < level.count; i++){
+        command_info = ehshell_command_level_get(&level, i);
+        if(strncmp(linebuf + word_start, command_info->command, prefix_len) == 0){
             if(first_completion == NULL){
                 first_completion = command_info->command;
                 completion_len = strlen(first_completion);
@@ -228,27 +373,27 @@ static void ehshell_command_auto_complete(ehshell_t *shell){
             eh_stream_puts((struct stream_base *)&shell->stream, "\t\t");
         }
     }
-        if(is_multi_match){
+    if(is_multi_match){
         eh_stream_puts((struct stream_base *)&shell->stream, "\r\n");
         ehshell_print_prompt(shell);
     }
     
     if(first_completion == NULL)
         return ;
-    diff = completion_len - linebuf_pos;
+    diff = completion_len - prefix_len;
     if(diff == 0 || (shell->linebuf_data_len + diff) >= shell->config->input_linebuf_size)
         return;
     if(linebuf_pos < shell->linebuf_data_len){
         int n = (int)(shell->linebuf_data_len - linebuf_pos);
-        memmove(linebuf + completion_len, linebuf + linebuf_pos, (size_t)n);
+        memmove(linebuf + linebuf_pos + diff, linebuf + linebuf_pos, (size_t)n);
         eh_stream_printf((struct stream_base *)&shell->stream, "%.*s%.*s\x1B[%dD", 
-            (int)diff, first_completion + linebuf_pos, n, linebuf + completion_len, n);
+            (int)diff, first_completion + prefix_len, n, linebuf + linebuf_pos + diff, n);
     }else{
-        eh_stream_printf((struct stream_base *)&shell->stream, "%.*s", diff, first_completion + linebuf_pos);
+        eh_stream_printf((struct stream_base *)&shell->stream, "%.*s", (int)diff, first_completion + prefix_len);
     }
+    memcpy(linebuf + linebuf_pos, first_completion + prefix_len, diff);
     shell->linebuf_pos += (uint16_t)diff;
     shell->linebuf_data_len += (uint16_t)diff;
-        strncpy(linebuf + linebuf_pos, first_completion + linebuf_pos, diff);
 }
 
 static void ehshell_processor_input_ringbuf_redirect_init(ehshell_t *shell){
@@ -279,11 +424,17 @@ static void ehshell_processor_input_ringbuf_redirect(ehshell_t *shell){
     int32_t rl = 0, pl = 0, chars_count;
     eh_ringbuf_t peek_ringbuf;
     bool is_request_quit = false;
+    bool is_budget_exhausted = false;
     peek_ringbuf = *shell->input_ringbuf;
     peek_ringbuf.r = shell->redirect_input_escape_parse_pos;
     chars_count = eh_ringbuf_size(&peek_ringbuf);
     if(chars_count == 0)
         return;
+    if(shell->cmd_current.command_info->flags & EHSHELL_COMMAND_REDIRECT_RAW){
+        /* 原始模式不做转义解析，全部数据直接交给命令，由命令控制每次处理的数据量 */
+        pl = chars_count;
+        goto next;
+    }
     rl = 0;
     input_buf[0] = (const char *)eh_ringbuf_peek(&peek_ringbuf, 0, NULL, &rl);
     input_buf_len[0] = (size_t)rl;
@@ -294,6 +445,11 @@ static void ehshell_processor_input_ringbuf_redirect(ehshell_t *shell){
         for(size_t j = 0; j < input_buf_len[i]; j++){
             char input = input_buf[i][j];
             enum ehshell_escape_char escape_char;
+            /* 预算可能已被输出用完，每轮至少处理一个字节，保证Ctrl+C能被看到 */
+            if(pl >= shell->dispatch_budget && pl > 0){
+                is_budget_exhausted = true;
+                goto next;
+            }
             pl++;
             escape_char = ehshell_escape_char_parse(shell, input);
             if(escape_char == ESCAPE_CHAR_CTRL_C_SIGINT){
@@ -305,11 +461,9 @@ static void ehshell_processor_input_ringbuf_redirect(ehshell_t *shell){
 next:
     eh_ringbuf_read_skip(&peek_ringbuf, (int32_t)pl);
     shell->redirect_input_escape_parse_pos = peek_ringbuf.r;
-    if(shell->cmd_current.command_info->do_event_function){
-        shell->cmd_current.command_info->do_event_function(
-            &shell->cmd_current, EHSHELL_EVENT_RECEIVE_INPUT_DATA | (is_request_quit ? EHSHELL_EVENT_SIGINT_REQUEST_QUIT : 0));
-    }
-    if(is_request_quit){
+    ehshell_command_call_event(&shell->cmd_current,
+        EHSHELL_EVENT_RECEIVE_INPUT_DATA | (is_request_quit ? EHSHELL_EVENT_SIGINT_REQUEST_QUIT : 0));
+    if(is_request_quit || is_budget_exhausted){
         ehshell_notify_processor(shell);
     }
 }
@@ -343,7 +497,7 @@ static void ehshell_processor_input_ringbuf(ehshell_t *shell){
     }
     
 #if CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT > 0
-    shell->login_downcounter = CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT;
+    ehshell_timer_start(&shell->login_timer, CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT * 1000U);
 #endif
     /* 
      *  因为我们是环形缓冲区，所以读两次，必然可以零拷贝并取出所需数据
@@ -358,6 +512,10 @@ static void ehshell_processor_input_ringbuf(ehshell_t *shell){
         for(size_t j = 0; j < input_buf_len[i]; j++){
             char input = input_buf[i][j];
             enum ehshell_escape_char escape_char;
+            if(pl >= shell->dispatch_budget && pl > 0){
+                /* 本轮预算用完(包括输出)，剩余数据排队等待下一轮调度，每轮至少处理一个字节 */
+                goto status_refresh;
+            }
             escape_char = ehshell_escape_char_parse(shell, input);
             pl++;
             if(escape_char <= ESCAPE_CHAR_CTRL_NOSTD_START && 
@@ -437,9 +595,7 @@ static void ehshell_processor_input_ringbuf(ehshell_t *shell){
                     eh_stream_putc((struct stream_base *)&shell->stream, (char)(escape_char - ESCAPE_CHAR_CTRL_A + 'A'));
                     if(escape_char == ESCAPE_CHAR_CTRL_C_SIGINT && pl == chars_count){
                         /* 发送SIGINT信号 */
-                        if(cmd_current->command_info->do_event_function){
-                            cmd_current->command_info->do_event_function(cmd_current, EHSHELL_EVENT_SIGINT_REQUEST_QUIT);
-                        }
+                        ehshell_command_post_event(cmd_current, EHSHELL_EVENT_SIGINT_REQUEST_QUIT);
                         goto status_refresh;
                     }
                     continue;
@@ -476,7 +632,9 @@ static void ehshell_processor_input_ringbuf(ehshell_t *shell){
                     }
                     case ESCAPE_CHAR_CTRL_TAB:{
                         /* tab建自动补全 */
+                        eh_clock_t start = ehshell_stall_start();
                         ehshell_command_auto_complete(shell);
+                        ehshell_stall_account(EHSHELL_STALL_COMPLETE, shell->config->host, 0, start);
                         continue;
                     }
                     case ESCAPE_CHAR_CTRL_J_LF:
@@ -568,11 +726,32 @@ status_refresh:
     return ;
 }
 
-static void ehshell_processor(eh_event_t *e, void *slot_param){
-    (void)e;
-    ehshell_t *shell = (ehshell_t *)slot_param;
+static void ehshell_processor(ehshell_t *shell){
+    bool input_blocked = false;
+#if EHSHELL_CONFIG_INPUT_QUEUE_SIZE > 0
+    /* 多生产者队列中已提交的输入先搬进输入缓冲区 */
+    input_blocked = ehshell_input_queue_drain(shell);
+#endif
+    /* 输入缓冲区接近写满时按需扩大，扩大后继续搬运队列中剩余的输入 */
+    if(ehshell_input_adapt(shell, input_blocked) && input_blocked){
+#if EHSHELL_CONFIG_INPUT_QUEUE_SIZE > 0
+        input_blocked = ehshell_input_queue_drain(shell);
+#endif
+    }
+    /* 先录制新到达的输入，之后的处理才会消费它们 */
+    if(shell->recorder)
+        ehshell_recorder_input(shell);
+#if CONFIG_PACKAGE_EHSHELL_WORKER_NUM > 0
+    ehshell_worker_process(shell);
+#endif
+    ehshell_command_co_process(shell);
     switch (shell->state) {
         case EHSHELL_INIT:
+#if CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT > 0 && CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+            /* 分片的shell在自己的线程中启动定时器 */
+            if(shell->shard)
+                ehshell_timer_start(&shell->login_timer, CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT * 1000U);
+#endif
             ehshell_print_welcome(shell);            
 #ifdef CONFIG_PACKAGE_EHSHELL_USE_PASSWORD
             ehshell_run_login(shell);
@@ -582,12 +761,19 @@ static void ehshell_processor(eh_event_t *e, void *slot_param){
 #endif
         case EHSHELL_STATE_RESET:
             ehshell_input_reset(shell);
-            ehshell_print_prompt(shell);
+            if(shell->machine_pending)
+                ehshell_machine_start(shell);
+            /* 机器模式下没有提示符 */
+            if(!shell->machine)
+                ehshell_print_prompt(shell);
             eh_stream_finish((struct stream_base *)&shell->stream);
             shell->state = EHSHELL_STATE_WAIT_INPUT;
             _fallthrough;
         case EHSHELL_STATE_WAIT_INPUT:
-            ehshell_processor_input_ringbuf(shell);
+            if(shell->machine)
+                ehshell_machine_process(shell);
+            else
+                ehshell_processor_input_ringbuf(shell);
             break;
         case EHSHELL_STATE_REDIRECT_INPUT_INIT:
             ehshell_processor_input_ringbuf_redirect_init(shell);
@@ -603,25 +789,87 @@ static void ehshell_processor(eh_event_t *e, void *slot_param){
             ehshell_notify_processor(shell);
             break;
     }
+    /* 输入缓冲区满时队列停止搬运，腾出空间后再调度一次 */
+    if(input_blocked && eh_ringbuf_free_size(shell->input_ringbuf) > 0)
+        ehshell_notify_processor(shell);
 }
 
-#if CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT > 0
-static void ehshell_password_timer_1s_processor(eh_event_t *e, void *slot_param){
-    (void)e;
-    ehshell_t *shell = (ehshell_t *)slot_param;
-    if(ehshell_current_command_context(shell))
-        return ;
+static ehshell_t *ehshell_ready_list_pop(void){
+    ehshell_t *shell = NULL;
+    eh_save_state_t state = eh_enter_critical();
+    if(!eh_list_empty(&ehshell_ready_list)){
+        shell = eh_list_entry(ehshell_ready_list.next, ehshell_t, ready_node);
+        eh_list_del_init(&shell->ready_node);
+        ehshell_ready_count--;
+    }
+    eh_exit_critical(state);
+    return shell;
+}
 
-    if(shell->login_downcounter){
-        shell->login_downcounter--;
-    }else{
-        /* 超时未输入密码，运行登录命令 */
-        ehshell_run_login(shell);
+static void ehshell_dispatcher(eh_event_t *e, void *slot_param){
+    (void)e;
+    (void)slot_param;
+    eh_clock_t start = eh_get_clock_monotonic_time();
+    size_t round;
+    ehshell_t *shell;
+    eh_save_state_t state;
+    bool is_pending;
+
+    /* 每次最多服务一轮(本次调度开始时就绪的shell数)，处理中重新就绪的shell排在队尾，留给下一轮 */
+    state = eh_enter_critical();
+    round = ehshell_ready_count;
+    eh_exit_critical(state);
+    while(round-- && (shell = ehshell_ready_list_pop())){
+        ehshell_dispatch(shell);
+        if(eh_clock_to_usec(eh_get_clock_monotonic_time() - start) >= EHSHELL_CONFIG_DISPATCH_TIME_BUDGET_US)
+            break;
     }
+    /* 仍有shell就绪，让出事件循环后继续调度 */
+    state = eh_enter_critical();
+    is_pending = !eh_list_empty(&ehshell_ready_list);
+    eh_exit_critical(state);
+    if(is_pending)
+        eh_signal_notify(&ehshell_sig_dispatch);
+}
+
+void ehshell_dispatch(ehshell_t *shell){
+    /* 处理中shell可能被销毁，先取出名字 */
+    const char *host = shell->config->host;
+    eh_clock_t start = ehshell_stall_start();
+    shell->dispatch_budget = EHSHELL_CONFIG_DISPATCH_BYTE_BUDGET;
+    ehshell_processor(shell);
+    ehshell_stall_account(EHSHELL_STALL_PROCESSOR, host, 0, start);
+}
 
+#if CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT > 0
+static void ehshell_login_timeout_processor(ehshell_timer_t *timer, void *arg){
+    (void)timer;
+    ehshell_t *shell = (ehshell_t *)arg;
+    /* 有前台命令运行时不计时，命令结束时会重新启动定时器 */
+    if(ehshell_current_command_context(shell))
+        return ;
+    /* 超时未操作，退出机器模式并运行登录命令 */
+    ehshell_machine_stop(shell);
+    ehshell_run_login(shell);
 }
 #endif
 
+void ehshell_cmd_context_init(ehshell_cmd_context_t *ctx, ehshell_t *ehshell, 
+    const struct ehshell_command_info *command_info, struct stream_base *stream, uint32_t flags){
+    ctx->ehshell = ehshell;
+    ctx->command_info = command_info;
+    ctx->user_data = NULL;
+    ctx->stream = stream;
+    ctx->worker_job = NULL;
+    ctx->exit_status = 0;
+    ctx->flags = flags;
+    ctx->capture_child = NULL;
+    ctx->capture_owner = NULL;
+    ctx->capture_finish_time = 0;
+    ehshell_command_co_init(ctx);
+    ehshell_command_arena_init(ctx);
+}
+
 static ehshell_cmd_context_t *ehshell_cmd_context_create(ehshell_t *ehshell, const struct ehshell_command_info *command_info, bool is_background){
     ehshell_cmd_context_t *ctx, *cmd_current;
     int idx = -1;
@@ -650,33 +898,28 @@ static ehshell_cmd_context_t *ehshell_cmd_context_create(ehshell_t *ehshell, con
     }
     if(!ctx)
         return eh_error_to_ptr(EH_RET_MALLOC_ERROR);
-    ctx->ehshell = ehshell;
-    ctx->command_info = command_info;
-    ctx->user_data = NULL;
+    ehshell_cmd_context_init(ctx, ehshell, command_info, (struct stream_base *)&ehshell->stream,
+        is_background ? EHSHELL_CMD_CONTEXT_FLAG_BACKGROUND : 0);
     if(is_background){
         ehshell->cmd_background[idx] = ctx;
         ehshell->state = EHSHELL_STATE_RESET;
-        ctx->flags = EHSHELL_CMD_CONTEXT_FLAG_BACKGROUND;
     }else{
-        ctx->flags = 0;
         if(command_info->flags & EHSHELL_COMMAND_REDIRECT_INPUT)
             ehshell->state = EHSHELL_STATE_REDIRECT_INPUT_INIT;
     }
     return ctx;
 }
 
-const struct ehshell_command_info* ehshell_command_find(ehshell_t *ehshell, const char *command){
+const struct ehshell_command_info* ehshell_command_lookup(const char *command){
+    const struct ehshell_command_table *table = ehshell_command_snapshot();
     size_t start_pos = 0;
     size_t end_pos;
     size_t pos;
     int cmp = -1;
-    if( ehshell == NULL || command == NULL ){
-        return NULL;
-    }
-    end_pos = ehshell_command_count;
+    end_pos = table->count;
     pos = (start_pos + end_pos) / 2;
     while(start_pos < end_pos){
-        cmp = strcmp(command, ehshell_commands[pos]->command);
+        cmp = strcmp(command, table->commands[pos]->command);
         if(cmp == 0){
             /* 找到命令 */
             break;
@@ -690,7 +933,94 @@ const struct ehshell_command_info* ehshell_command_find(ehshell_t *ehshell, cons
     if(cmp != 0){
         return NULL;
     }
-    return ehshell_commands[pos];
+    return table->commands[pos];
+}
+
+const struct ehshell_command_info* ehshell_subcommand_lookup(const struct ehshell_command_info *parent, const char *command){
+    size_t start_pos = 0;
+    size_t end_pos = parent->subcommand_count;
+    size_t pos;
+    int cmp;
+    while(start_pos < end_pos){
+        pos = (start_pos + end_pos) / 2;
+        cmp = strcmp(command, parent->subcommands[pos].command);
+        if(cmp == 0)
+            return &parent->subcommands[pos];
+        if(cmp < 0)
+            end_pos = pos;
+        else
+            start_pos = pos + 1;
+    }
+    return NULL;
+}
+
+const struct ehshell_command_info* ehshell_command_descend(const struct ehshell_command_info *command_info,
+    int *argc, const char ***argv){
+    const struct ehshell_command_info *child;
+    while(command_info->subcommands && *argc > 1){
+        child = ehshell_subcommand_lookup(command_info, (*argv)[1]);
+        if(child == NULL)
+            break;
+        command_info = child;
+        (*argv)++;
+        (*argc)--;
+    }
+    return command_info;
+}
+
+void ehshell_command_print_subcommands(struct stream_base *stream, const struct ehshell_command_info *command_info){
+    for(size_t i = 0; i < command_info->subcommand_count; i++){
+        eh_stream_printf(stream, "%16s:\t\t\t%s\r\n", 
+            command_info->subcommands[i].command, command_info->subcommands[i].description);
+    }
+}
+
+const struct ehshell_command_info* ehshell_command_find(ehshell_t *ehshell, const char *command){
+    /* 命令表是全局的，无终端执行的命令没有ehshell实例 */
+    (void)ehshell;
+    if( command == NULL ){
+        return NULL;
+    }
+    return ehshell_command_lookup(command);
+}
+
+static int ehshell_command_exec(ehshell_t *ehshell, const struct ehshell_command_info* command_info, 
+    int argc, const char *argv[], bool is_background){
+    if(eh_unlikely(ehshell->machine && (command_info->flags & EHSHELL_COMMAND_REDIRECT_INPUT))){
+        eh_stream_printf((struct stream_base *)&ehshell->stream, "ehshell: command %s redirect input in machine mode not supported\r\n", argv[0]);
+        eh_stream_finish((struct stream_base *)&ehshell->stream);
+        return EH_RET_NOT_SUPPORTED;
+    }
+
+#if CONFIG_PACKAGE_EHSHELL_WORKER_NUM > 0
+    if(eh_unlikely((command_info->flags & (EHSHELL_COMMAND_RUN_ON_WORKER | EHSHELL_COMMAND_REDIRECT_INPUT)) == 
+        (EHSHELL_COMMAND_RUN_ON_WORKER | EHSHELL_COMMAND_REDIRECT_INPUT))){
+        eh_stream_printf((struct stream_base *)&ehshell->stream, "ehshell: command %s redirect input on worker not supported\r\n", argv[0]);
+        eh_stream_finish((struct stream_base *)&ehshell->stream);
+        return EH_RET_NOT_SUPPORTED;
+    }
+#endif
+
+    ehshell_cmd_context_t *ctx = ehshell_cmd_context_create(ehshell, command_info, is_background);
+    if(eh_ptr_to_error(ctx) < 0){
+        eh_stream_printf((struct stream_base *)&ehshell->stream, "ehshell: command context create failed %d, command %s\r\n", eh_ptr_to_error(ctx), argv[0]);
+        eh_stream_finish((struct stream_base *)&ehshell->stream);
+        return eh_ptr_to_error(ctx);
+    }
+#if CONFIG_PACKAGE_EHSHELL_WORKER_NUM > 0
+    if(command_info->flags & EHSHELL_COMMAND_RUN_ON_WORKER){
+        int ret = ehshell_worker_submit(ctx, argc, argv);
+        if(ret < 0){
+            eh_stream_printf((struct stream_base *)&ehshell->stream, "ehshell: worker submit failed %d, command %s\r\n", ret, argv[0]);
+            eh_stream_finish((struct stream_base *)&ehshell->stream);
+            ehshell_command_finish(ctx);
+            return ret;
+        }
+        return 0;
+    }
+#endif
+    ehshell_command_call(ctx, argc, argv);
+    return 0;
 }
 
 int ehshell_command_run(ehshell_t *ehshell, int argc, const char *argv[]){
@@ -719,17 +1049,57 @@ int ehshell_command_run(ehshell_t *ehshell, int argc, const char *argv[]){
         is_background = true;
         argc--;
     }
-
-    ehshell_cmd_context_t *ctx = ehshell_cmd_context_create(ehshell, command_info, is_background);
-    if(eh_ptr_to_error(ctx) < 0){
-        eh_stream_printf((struct stream_base *)&ehshell->stream, "ehshell: command context create failed %d, command %s\r\n", eh_ptr_to_error(ctx), argv[0]);
+    command_info = ehshell_command_descend(command_info, &argc, &argv);
+    if(!command_info->do_function){
+        eh_stream_printf((struct stream_base *)&ehshell->stream, "%s: missing or unknown subcommand, available:\r\n", argv[0]);
+        ehshell_command_print_subcommands((struct stream_base *)&ehshell->stream, command_info);
         eh_stream_finish((struct stream_base *)&ehshell->stream);
-        return eh_ptr_to_error(ctx);
+        return EH_RET_INVALID_PARAM;
     }
-    ctx->command_info->do_function(ctx, argc, argv);
+    return ehshell_command_exec(ehshell, command_info, argc, argv, is_background);
+}
+
+int ehshell_command_capture_start(ehshell_cmd_context_t *owner, ehshell_cmd_context_t *child,
+    struct stream_base *stream, int argc, const char *argv[]){
+    const struct ehshell_command_info* command_info;
+    if(argc < 1 || !argv[0] || owner->capture_child)
+        return EH_RET_INVALID_PARAM;
+    command_info = ehshell_command_lookup(argv[0]);
+    if(command_info)
+        command_info = ehshell_command_descend(command_info, &argc, &argv);
+    if(!command_info || !command_info->do_function)
+        return EH_RET_NOT_EXISTS;
+    /* 子命令没有自己的输入，也不能离开shell所在的线程 */
+    if(command_info->flags & (EHSHELL_COMMAND_REDIRECT_INPUT | EHSHELL_COMMAND_RUN_ON_WORKER))
+        return EH_RET_NOT_SUPPORTED;
+    ehshell_cmd_context_init(child, owner->ehshell, command_info, stream, EHSHELL_CMD_CONTEXT_FLAG_CAPTURE);
+    child->capture_owner = owner;
+    owner->capture_child = child;
+    ehshell_command_call(child, argc, argv);
     return 0;
 }
 
+void ehshell_command_capture_stop(ehshell_cmd_context_t *child){
+    if(child->command_info)
+        ehshell_command_post_event(child, EHSHELL_EVENT_SIGINT_REQUEST_QUIT);
+    if(child->command_info)
+        ehshell_command_post_event(child, EHSHELL_EVENT_SHELL_EXIT);
+    if(child->command_info == NULL)
+        return ;
+    eh_mwarnfl(EHSHELL, "capture command %s not finished on exit", child->command_info->command);
+    ehshell_command_co_release(child);
+    ehshell_command_arena_release(child);
+    child->command_info = NULL;
+    if(child->capture_owner)
+        child->capture_owner->capture_child = NULL;
+}
+
+
+void ehshell_command_set_exit_status(ehshell_cmd_context_t *cmd_context, int status){
+    if(!cmd_context)
+        return;
+    cmd_context->exit_status = status;
+}
 
 void ehshell_command_set_userdata(ehshell_cmd_context_t *cmd_context, void *user_data){
     cmd_context->user_data = user_data;
@@ -744,8 +1114,41 @@ const struct ehshell_command_info * ehshell_command_getcommand_info(ehshell_cmd_
     return cmd_context->command_info;
 }
 
+uint32_t ehshell_command_pending_events(ehshell_cmd_context_t *cmd_context){
+#if CONFIG_PACKAGE_EHSHELL_WORKER_NUM > 0
+    if(cmd_context && (cmd_context->flags & EHSHELL_CMD_CONTEXT_FLAG_WORKER))
+        return ehshell_worker_take_events(cmd_context);
+#else
+    (void)cmd_context;
+#endif
+    return 0;
+}
+
 void ehshell_command_finish(ehshell_cmd_context_t *cmd_context){
     ehshell_t *ehshell = cmd_context->ehshell;
+#if CONFIG_PACKAGE_EHSHELL_WORKER_NUM > 0
+    if(cmd_context->flags & EHSHELL_CMD_CONTEXT_FLAG_WORKER){
+        /* 工作线程中结束命令，交给所属shell的调度器完成 */
+        ehshell_worker_finish(cmd_context);
+        return ;
+    }
+#endif
+    ehshell_command_co_release(cmd_context);
+    ehshell_command_arena_release(cmd_context);
+    if(cmd_context->flags & EHSHELL_CMD_CONTEXT_FLAG_CAPTURE){
+        /* 子命令的存储属于owner，只需要唤醒owner */
+        cmd_context->capture_finish_time = eh_get_clock_monotonic_time();
+        cmd_context->command_info = NULL;
+        if(cmd_context->capture_owner){
+            cmd_context->capture_owner->capture_child = NULL;
+            ehshell_command_resume_later(cmd_context->capture_owner);
+        }
+        return ;
+    }
+    if(cmd_context->flags & EHSHELL_CMD_CONTEXT_FLAG_HEADLESS){
+        ehshell_exec_finish(cmd_context);
+        return ;
+    }
     if(ehshell){
         if(cmd_context->flags & EHSHELL_CMD_CONTEXT_FLAG_BACKGROUND){
             for(int i = 0; i < CONFIG_PACKAGE_EHSHELL_MAX_BACKGROUND_COMMAND_SIZE; i++){
@@ -758,8 +1161,10 @@ void ehshell_command_finish(ehshell_cmd_context_t *cmd_context){
         }else{
             if(&ehshell->cmd_current == cmd_context){
 #if CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT > 0
-                ehshell->login_downcounter = CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT;
+                ehshell_timer_start(&ehshell->login_timer, CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT * 1000U);
 #endif
+                if(ehshell->machine)
+                    ehshell_machine_command_end(ehshell, cmd_context->exit_status);
                 ehshell->cmd_current.command_info = NULL;
                 ehshell->state = EHSHELL_STATE_RESET;
                 ehshell_notify_processor(ehshell);
@@ -772,23 +1177,88 @@ void ehshell_command_finish(ehshell_cmd_context_t *cmd_context){
 
 
 int ehshell_command_run_form_string(ehshell_t *ehshell, const char *cmd_str){
-    char *linebuf = eh_malloc(strlen(cmd_str) + 1);
+    /* 命令行的副本借用arena空闲页，不在堆上反复申请释放 */
+    size_t len = strlen(cmd_str) + 1;
+    struct ehshell_arena_page *page = ehshell_arena_page_get(ehshell, len);
+    char *linebuf;
     int ret;
-    if(!linebuf)
+    if(!page)
         return EH_RET_MALLOC_ERROR;
-    strcpy(linebuf, cmd_str);
+    linebuf = ehshell_arena_page_buf(page);
+    memcpy(linebuf, cmd_str, len);
     ret = _ehshell_command_run_form_string(ehshell, linebuf);
-    eh_free(linebuf);
+    ehshell_arena_page_put(ehshell, page);
     return ret;
 }
 
+ehshell_prepared_t *ehshell_command_prepare(const char *cmd_str){
+    ehshell_prepared_t *prepared;
+    const char **argv;
+    const char *err = NULL;
+    size_t len;
+    int argc;
+    if(!cmd_str)
+        return eh_error_to_ptr(EH_RET_INVALID_PARAM);
+    len = strlen(cmd_str) + 1;
+    prepared = eh_malloc(sizeof(ehshell_prepared_t) + len);
+    if(!prepared)
+        return eh_error_to_ptr(EH_RET_MALLOC_ERROR);
+    memcpy(prepared->cmd_str, cmd_str, len);
+    argc = ehshell_command_split(prepared->cmd_str, prepared->argv, &err);
+    if(argc <= 0){
+        eh_mwarnfl(EHSHELL, "prepare command \"%s\" failed: %s", cmd_str, err ? err : "empty command");
+        goto err;
+    }
+    prepared->command_info = ehshell_command_lookup(prepared->argv[0]);
+    if(!prepared->command_info){
+        eh_mwarnfl(EHSHELL, "prepare command \"%s\" failed: command not found", cmd_str);
+        argc = EH_RET_NOT_EXISTS;
+        goto err;
+    }
+    prepared->is_background = false;
+    if(argc > 1 && strcmp(prepared->argv[argc - 1], "&") == 0){
+        prepared->is_background = true;
+        argc--;
+    }
+    argv = prepared->argv;
+    prepared->command_info = ehshell_command_descend(prepared->command_info, &argc, &argv);
+    if(!prepared->command_info->do_function){
+        eh_mwarnfl(EHSHELL, "prepare command \"%s\" failed: missing subcommand", cmd_str);
+        argc = EH_RET_NOT_EXISTS;
+        goto err;
+    }
+    memmove(prepared->argv, argv, (size_t)argc * sizeof(const char *));
+    prepared->argc = argc;
+    return prepared;
+err:
+    eh_free(prepared);
+    return eh_error_to_ptr(argc < 0 ? argc : EH_RET_INVALID_PARAM);
+}
+
+int ehshell_command_run_prepared(ehshell_t *ehshell, const ehshell_prepared_t *prepared){
+    if(!ehshell || !prepared)
+        return EH_RET_INVALID_PARAM;
+    if(ehshell_current_command_context(ehshell)){
+        eh_stream_printf((struct stream_base *)&ehshell->stream, "The foreground command is running, command %s exec failure\r\n", prepared->argv[0]);
+        eh_stream_finish((struct stream_base *)&ehshell->stream);
+        return EH_RET_INVALID_STATE;
+    }
+    /* 命令不会修改argv数组，句柄本身保持不变 */
+    return ehshell_command_exec(ehshell, prepared->command_info, prepared->argc, 
+        (const char **)prepared->argv, prepared->is_background);
+}
+
+void ehshell_command_prepared_free(ehshell_prepared_t *prepared){
+    eh_free(prepared);
+}
+
 ehshell_t *ehshell_create(const struct ehshell_config *static_config){
     int ret;
     ehshell_t *shell;
     if(!static_config || !static_config->input_linebuf_size  || !static_config->stream_write)
         return eh_error_to_ptr(EH_RET_INVALID_PARAM);
-    if(static_config->input_ringbuf_size < sizeof(uint32_t) * 2){
-        eh_merrfl( EHSHELL,"input_ringbuf_size %d is too small, sizeof(uint32_t) * 2 %d", static_config->input_ringbuf_size, sizeof(uint32_t) * 2);
+    if(static_config->input_ringbuf_size < sizeof(uint32_t) * 2 || static_config->input_ringbuf_size > INT32_MAX){
+        eh_merrfl( EHSHELL,"input_ringbuf_size %u is out of range, min %d", (unsigned)static_config->input_ringbuf_size, (int)(sizeof(uint32_t) * 2));
         return eh_error_to_ptr(EH_RET_INVALID_PARAM);
     }
 
@@ -797,67 +1267,123 @@ ehshell_t *ehshell_create(const struct ehshell_config *static_config){
         return eh_error_to_ptr(EH_RET_MALLOC_ERROR);
     bzero(shell, sizeof(ehshell_t));
     shell->config = static_config;
-    shell->input_ringbuf = eh_ringbuf_create(static_config->input_ringbuf_size, NULL);
+    shell->input_ringbuf = eh_ringbuf_create((int32_t)static_config->input_ringbuf_size, NULL);
     ret = eh_ptr_to_error(shell->input_ringbuf);
     if(ret < 0){
         goto err_input_ringbuf_create;
     }
+    ehshell_input_adapt_init(shell);
+#if EHSHELL_CONFIG_INPUT_QUEUE_SIZE > 0
+    shell->input_queue = ehshell_input_queue_create();
+    if(shell->input_queue == NULL){
+        ret = EH_RET_MALLOC_ERROR;
+        goto err_input_queue_create;
+    }
+#endif
     shell->linebuf_pos = 0;
     shell->linebuf_data_len = 0;
     shell->state = EHSHELL_INIT;
 
     eh_stream_function_no_cache_init(&shell->stream, ehshell_stream_write, ehshell_stream_finish);
 
-    eh_signal_init(&shell->sig_notify_process);
-    eh_signal_slot_init(&shell->slot_notify_process, ehshell_processor, shell);
-
-    ret = eh_signal_slot_connect(&shell->sig_notify_process, &shell->slot_notify_process);
-    if(ret < 0){
-        goto err_eh_signal_slot_connect;
-    }
+    eh_list_head_init(&shell->ready_node);
+    shell->dispatch_budget = EHSHELL_CONFIG_DISPATCH_BYTE_BUDGET;
+    shell->machine = NULL;
+    shell->machine_pending = (static_config->flags & EHSHELL_CONFIG_FLAG_MACHINE_MODE) != 0;
+    eh_list_head_init(&shell->arena_free);
+    shell->arena_free_count = 0;
+    shell->arena_high_water = 0;
+    shell->recorder = NULL;
+    shell->record_input_pos = 0;
+    eh_list_head_init(&shell->sinks);
+    shell->mirror_seg = NULL;
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+    shell->shard = (static_config->flags & EHSHELL_CONFIG_FLAG_SHARDED) ? ehshell_shard_assign() : NULL;
+#endif
 #if CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT > 0
-    eh_signal_slot_init(&shell->slot_1s_timer_process, ehshell_password_timer_1s_processor, shell);
-    ret = eh_signal_slot_connect(&signal_eh_comp_timer_1s, &shell->slot_1s_timer_process);
-    if(ret < 0){
-        goto err_eh_signal_eh_comp_timer_1s_connect;
-    }
-    shell->login_downcounter = CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT;
+    ehshell_timer_init(&shell->login_timer, ehshell_login_timeout_processor, shell);
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+    if(shell->shard == NULL)
+#endif
+    ehshell_timer_start(&shell->login_timer, CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT * 1000U);
 #endif
 
 
 
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+    /* 分片的shell由端口设置好用户数据后再通知开始处理 */
+    if(shell->shard == NULL)
+#endif
     ehshell_notify_processor(shell);
     return shell;
-#if CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT > 0
-err_eh_signal_eh_comp_timer_1s_connect:
-    eh_signal_slot_disconnect(&shell->sig_notify_process, &shell->slot_notify_process);
-#endif
-err_eh_signal_slot_connect:
+#if EHSHELL_CONFIG_INPUT_QUEUE_SIZE > 0
+err_input_queue_create:
     eh_ringbuf_destroy(shell->input_ringbuf);
+#endif
 err_input_ringbuf_create:
     eh_free(shell);
     return (ehshell_t *)eh_error_to_ptr(ret);
 }
 
 void ehshell_destroy(ehshell_t *ehshell){
+    eh_save_state_t state;
     if(!ehshell)
         return;
     for(size_t i = 0; i < CONFIG_PACKAGE_EHSHELL_MAX_BACKGROUND_COMMAND_SIZE; i++){
         if(ehshell->cmd_background[i]){
-            if(ehshell->cmd_background[i]->command_info->do_event_function){
-                ehshell->cmd_background[i]->command_info->do_event_function(ehshell->cmd_background[i], EHSHELL_EVENT_SHELL_EXIT);
+#if CONFIG_PACKAGE_EHSHELL_WORKER_NUM > 0
+            if(ehshell->cmd_background[i]->worker_job){
+                /* 工作线程中的命令与shell脱离，命令结束后自行释放 */
+                ehshell_worker_detach(ehshell->cmd_background[i]);
+                eh_free(ehshell->cmd_background[i]);
+                ehshell->cmd_background[i] = NULL;
+                continue;
+            }
+#endif
+            ehshell_command_call_event(ehshell->cmd_background[i], EHSHELL_EVENT_SHELL_EXIT);
+            /* 命令未在退出事件中结束时，停止其协程定时器，避免shell释放后被唤醒 */
+            if(ehshell->cmd_background[i]){
+                ehshell_command_co_release(ehshell->cmd_background[i]);
+                ehshell_command_arena_release(ehshell->cmd_background[i]);
             }
         }
     }
     if(ehshell_current_command_context(ehshell)){
-        if(ehshell->cmd_current.command_info->do_event_function){
-            ehshell->cmd_current.command_info->do_event_function(&ehshell->cmd_current, EHSHELL_EVENT_SHELL_EXIT);
+#if CONFIG_PACKAGE_EHSHELL_WORKER_NUM > 0
+        if(ehshell->cmd_current.worker_job){
+            ehshell_worker_detach(&ehshell->cmd_current);
+        }else
+#endif
+        ehshell_command_call_event(&ehshell->cmd_current, EHSHELL_EVENT_SHELL_EXIT);
+        if(ehshell_current_command_context(ehshell)){
+            ehshell_command_co_release(&ehshell->cmd_current);
+            ehshell_command_arena_release(&ehshell->cmd_current);
         }
     }
 #if CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT > 0
-    eh_signal_slot_disconnect(&signal_eh_comp_timer_1s, &ehshell->slot_1s_timer_process);
+    ehshell_timer_stop(&ehshell->login_timer);
+#endif
+    ehshell_input_adapt_stop(ehshell);
+    ehshell_mirror_destroy(ehshell);
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+    if(ehshell->shard){
+        ehshell_shard_release(ehshell);
+    }else
+#endif
+    {
+        state = eh_enter_critical();
+        if(!eh_list_empty(&ehshell->ready_node)){
+            eh_list_del_init(&ehshell->ready_node);
+            ehshell_ready_count--;
+        }
+        eh_exit_critical(state);
+    }
+    if(ehshell->machine)
+        eh_free(ehshell->machine);
+    ehshell_arena_destroy(ehshell);
+#if EHSHELL_CONFIG_INPUT_QUEUE_SIZE > 0
+    ehshell_input_queue_destroy(ehshell->input_queue);
 #endif
-    eh_signal_slot_disconnect(&ehshell->sig_notify_process, &ehshell->slot_notify_process);
     eh_ringbuf_destroy(ehshell->input_ringbuf);
     eh_free(ehshell);
 }
@@ -884,13 +1410,41 @@ eh_ringbuf_t* ehshell_input_ringbuf(ehshell_t *ehshell){
 
 
 void ehshell_notify_processor(ehshell_t *ehshell){
-    eh_signal_notify(&ehshell->sig_notify_process);
+    bool is_first_ready = false;
+    eh_save_state_t state;
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+    if(ehshell->shard){
+        ehshell_shard_notify(ehshell);
+        return ;
+    }
+#endif
+    state = eh_enter_critical();
+    if(eh_list_empty(&ehshell->ready_node)){
+        is_first_ready = eh_list_empty(&ehshell_ready_list);
+        eh_list_add_tail(&ehshell->ready_node, &ehshell_ready_list);
+        ehshell_ready_count++;
+    }
+    eh_exit_critical(state);
+    if(is_first_ready)
+        eh_signal_notify(&ehshell_sig_dispatch);
 }
 
 struct stream_base *ehshell_command_stream(ehshell_cmd_context_t *cmd_context){
-    if(cmd_context == NULL || cmd_context->ehshell == NULL)
+    if(cmd_context == NULL)
         return NULL;
-    return (struct stream_base *)&cmd_context->ehshell->stream;
+    return cmd_context->stream;
+}
+
+void ehshell_command_write(ehshell_cmd_context_t *cmd_context, const char *buf, size_t len){
+    ehshell_t *shell;
+    if(cmd_context == NULL || len == 0)
+        return ;
+    shell = cmd_context->ehshell;
+    if(shell && cmd_context->stream == (struct stream_base *)&shell->stream){
+        ehshell_output_write(shell, buf, len);
+        return ;
+    }
+    eh_stream_printf(cmd_context->stream, "%.*s", (int)len, buf);
 }
 
 
@@ -923,30 +1477,100 @@ ehshell_t* ehshell_command_get_shell(ehshell_cmd_context_t *cmd_context){
     return cmd_context->ehshell;
 }
 
+/* 子命令表使用二分查找，注册时检查每一级是否有序 */
+static bool ehshell_command_tree_check(const struct ehshell_command_info *command_info){
+    for(size_t i = 0; i < command_info->subcommand_count; i++){
+        const struct ehshell_command_info *child = &command_info->subcommands[i];
+        if(i > 0 && strcmp(command_info->subcommands[i - 1].command, child->command) >= 0){
+            eh_merrfl( EHSHELL,"command %s subcommands not sorted at %s", command_info->command, child->command);
+            return false;
+        }
+        if(!child->do_function && !child->subcommands){
+            eh_merrfl( EHSHELL,"command %s subcommand %s has no handler", command_info->command, child->command);
+            return false;
+        }
+        if(!ehshell_command_tree_check(child))
+            return false;
+    }
+    return true;
+}
+
+static void ehshell_command_table_retire(struct ehshell_command_table *table){
+    if(table == &ehshell_command_table_empty)
+        return ;
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+    /* 分片线程可能还在读取旧快照，退出时统一释放 */
+    if(ehshell_shard_running()){
+        table->retired = ehshell_command_table_retired;
+        ehshell_command_table_retired = table;
+        return ;
+    }
+#endif
+    eh_free(table);
+}
+
 int ehshell_register_commands(const struct ehshell_command_info *command_info, size_t command_info_num){
+    struct ehshell_command_table *old = ehshell_command_table;
+    struct ehshell_command_table *table;
     if(!command_info || command_info_num == 0)
         return EH_RET_INVALID_PARAM;
-    if(ehshell_command_count + command_info_num > CONFIG_PACKAGE_EHSHELL_MAX_COMMAND_SIZE){
+    for(size_t i = 0; i < command_info_num; i++){
+        if(!ehshell_command_tree_check(&command_info[i]))
+            return EH_RET_INVALID_PARAM;
+    }
+    if(old->count + command_info_num > CONFIG_PACKAGE_EHSHELL_MAX_COMMAND_SIZE){
         eh_merrfl( EHSHELL,"command_info_num %d is too large, max_command_size %d", command_info_num, CONFIG_PACKAGE_EHSHELL_MAX_COMMAND_SIZE);
         return EH_RET_INVALID_PARAM;
     }
+    table = eh_malloc(sizeof(struct ehshell_command_table) + (old->count + command_info_num) * sizeof(struct ehshell_command_info*));
+    if(table == NULL)
+        return EH_RET_MALLOC_ERROR;
+    table->retired = NULL;
+    table->count = old->count;
+    memcpy(table->commands, old->commands, old->count * sizeof(struct ehshell_command_info*));
     /* 循环插入有序数组中 */
     for(size_t i = 0; i < command_info_num; i++){
         size_t j;
-        for(j = 0; j < ehshell_command_count; j++){
-            if(strcmp(command_info[i].command, ehshell_commands[j]->command) < 0){
+        for(j = 0; j < table->count; j++){
+            if(strcmp(command_info[i].command, table->commands[j]->command) < 0){
                 break;
             }
         }
-        memmove(ehshell_commands + j + 1, ehshell_commands + j, (ehshell_command_count - j) * sizeof(struct ehshell_command_info*));
-        ehshell_commands[j] = &command_info[i];
-        ehshell_command_count++;
+        memmove(table->commands + j + 1, table->commands + j, (table->count - j) * sizeof(struct ehshell_command_info*));
+        table->commands[j] = &command_info[i];
+        table->count++;
     }
+    /* 新表填充完成后才发布，读者看到的总是完整的表 */
+    __atomic_store_n(&ehshell_command_table, table, __ATOMIC_RELEASE);
+    ehshell_command_table_retire(old);
     return EH_RET_OK;
 }
 
 static int __init  ehshell_core_init(void){
-    ehshell_command_count = 0;
+    int ret;
+    ehshell_command_table = &ehshell_command_table_empty;
+    eh_list_head_init(&ehshell_ready_list);
+    ehshell_ready_count = 0;
+    eh_signal_init(&ehshell_sig_dispatch);
+    eh_signal_slot_init(&ehshell_slot_dispatch, ehshell_dispatcher, NULL);
+    ret = eh_signal_slot_connect(&ehshell_sig_dispatch, &ehshell_slot_dispatch);
+    if(ret < 0){
+        eh_merrfl( EHSHELL,"dispatcher signal connect failed %d", ret);
+        return ret;
+    }
     return 0;
 }
-ehshell_module_core_export(ehshell_core_init, NULL);
\ No newline at end of file
+
+static void __exit ehshell_core_exit(void){
+    eh_signal_slot_disconnect(&ehshell_sig_dispatch, &ehshell_slot_dispatch);
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+    while(ehshell_command_table_retired){
+        struct ehshell_command_table *table = ehshell_command_table_retired;
+        ehshell_command_table_retired = table->retired;
+        eh_free(table);
+    }
+#endif
+    ehshell_command_table_retire(ehshell_command_table);
+    ehshell_command_table = &ehshell_command_table_empty;
+}
+ehshell_module_core_export(ehshell_core_init, ehshell_core_exit);
\ No newline at end of file
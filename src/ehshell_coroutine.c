@@ -0,0 +1,178 @@
+/**
+ * @file ehshell_coroutine.c
+ * @brief ehshell 无栈协程支持，恢复点、协程帧以及让出/定时/输出空间等待的唤醒
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-09
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_error.h>
+
+#include <ehshell.h>
+#include <ehshell_internal.h>
+#include <ehshell_coroutine.h>
+
+static void ehshell_command_co_timeout(ehshell_timer_t *timer, void *arg){
+    (void)timer;
+    ehshell_cmd_context_t *cmd_context = arg;
+    cmd_context->flags |= EHSHELL_CMD_CONTEXT_FLAG_SLEEP_DONE | EHSHELL_CMD_CONTEXT_FLAG_RESUME_PENDING;
+    ehshell_command_notify(cmd_context);
+}
+
+void ehshell_command_notify(ehshell_cmd_context_t *cmd_context){
+    if(cmd_context->ehshell){
+        ehshell_notify_processor(cmd_context->ehshell);
+        return ;
+    }
+    /* 无终端执行的子命令由最外层命令统一恢复 */
+    while(cmd_context->capture_owner)
+        cmd_context = cmd_context->capture_owner;
+    if(cmd_context->flags & EHSHELL_CMD_CONTEXT_FLAG_HEADLESS)
+        ehshell_exec_notify(cmd_context);
+}
+
+void ehshell_command_co_init(ehshell_cmd_context_t *cmd_context){
+    cmd_context->co_line = 0;
+    cmd_context->co_wait_writable = 0;
+    cmd_context->co_frame = NULL;
+    cmd_context->gen_next = NULL;
+    cmd_context->gen_chunk = 0;
+    ehshell_timer_init(&cmd_context->co_timer, ehshell_command_co_timeout, cmd_context);
+}
+
+void ehshell_command_co_release(ehshell_cmd_context_t *cmd_context){
+    ehshell_timer_stop(&cmd_context->co_timer);
+    /* 协程帧在命令的arena中，随arena一起回收 */
+    cmd_context->co_frame = NULL;
+    cmd_context->co_line = 0;
+    cmd_context->co_wait_writable = 0;
+    cmd_context->gen_next = NULL;
+    cmd_context->flags &= ~(uint32_t)(EHSHELL_CMD_CONTEXT_FLAG_RESUME_PENDING | EHSHELL_CMD_CONTEXT_FLAG_SLEEP_DONE);
+}
+
+void ehshell_command_co_resume(ehshell_t *shell, ehshell_cmd_context_t *cmd_context){
+    if(cmd_context->capture_child)
+        ehshell_command_co_resume(shell, cmd_context->capture_child);
+    if(cmd_context->worker_job)
+        return ;
+    if(cmd_context->co_wait_writable && shell &&
+        shell->config->stream_write_space(shell) >= cmd_context->co_wait_writable){
+        cmd_context->co_wait_writable = 0;
+        cmd_context->flags |= EHSHELL_CMD_CONTEXT_FLAG_RESUME_PENDING;
+    }
+    if(!(cmd_context->flags & EHSHELL_CMD_CONTEXT_FLAG_RESUME_PENDING))
+        return ;
+    /* 本次调度的输出预算已用完，排到就绪队列尾部，下一轮再恢复 */
+    if(shell && shell->dispatch_budget <= 0){
+        ehshell_notify_processor(shell);
+        return ;
+    }
+    cmd_context->flags &= ~(uint32_t)EHSHELL_CMD_CONTEXT_FLAG_RESUME_PENDING;
+    ehshell_command_post_event(cmd_context, EHSHELL_EVENT_RESUME);
+}
+
+void ehshell_command_co_process(ehshell_t *shell){
+    /* 每轮调度每个命令最多恢复一次，让出的命令排到就绪队列尾部，
+     * 起点轮转，输出多的命令用完预算时不会一直挡住排在后面的命令 */
+    const int n = CONFIG_PACKAGE_EHSHELL_MAX_BACKGROUND_COMMAND_SIZE + 1;
+    int start = shell->co_rotor % n, i;
+    shell->co_rotor = (uint8_t)((start + 1) % n);
+    for(int k = 0; k < n; k++){
+        i = (start + k) % n;
+        if(i < CONFIG_PACKAGE_EHSHELL_MAX_BACKGROUND_COMMAND_SIZE){
+            if(shell->cmd_background[i])
+                ehshell_command_co_resume(shell, shell->cmd_background[i]);
+        }else if(ehshell_current_command_context(shell)){
+            ehshell_command_co_resume(shell, &shell->cmd_current);
+        }
+    }
+}
+
+uint16_t *ehshell_command_co_line(ehshell_cmd_context_t *cmd_context){
+    return &cmd_context->co_line;
+}
+
+void *ehshell_command_co_frame(ehshell_cmd_context_t *cmd_context, size_t size){
+    if(cmd_context->co_frame == NULL)
+        cmd_context->co_frame = ehshell_command_arena_zalloc(cmd_context, size);
+    return cmd_context->co_frame;
+}
+
+void ehshell_command_resume_later(ehshell_cmd_context_t *cmd_context){
+    cmd_context->flags |= EHSHELL_CMD_CONTEXT_FLAG_RESUME_PENDING;
+    ehshell_command_notify(cmd_context);
+}
+
+bool ehshell_command_wait_writable(ehshell_cmd_context_t *cmd_context, size_t size){
+    ehshell_t *shell = cmd_context->ehshell;
+    /* 被捕获的子命令输出到内存中，不受端口空间限制 */
+    if(shell == NULL || shell->config->stream_write_space == NULL ||
+        cmd_context->stream != (struct stream_base *)&shell->stream)
+        return true;
+    if(shell->config->stream_write_space(shell) >= size){
+        cmd_context->co_wait_writable = 0;
+        return true;
+    }
+    cmd_context->co_wait_writable = (uint32_t)size;
+    return false;
+}
+
+int ehshell_command_sleep(ehshell_cmd_context_t *cmd_context, uint32_t timeout_ms){
+    cmd_context->flags &= ~(uint32_t)EHSHELL_CMD_CONTEXT_FLAG_SLEEP_DONE;
+    return ehshell_timer_start(&cmd_context->co_timer, timeout_ms);
+}
+
+bool ehshell_command_sleep_done(ehshell_cmd_context_t *cmd_context){
+    if(!(cmd_context->flags & EHSHELL_CMD_CONTEXT_FLAG_SLEEP_DONE))
+        return false;
+    cmd_context->flags &= ~(uint32_t)EHSHELL_CMD_CONTEXT_FLAG_SLEEP_DONE;
+    return true;
+}
+
+void ehshell_command_generate_step(ehshell_cmd_context_t *cmd_context, uint32_t ehshell_event){
+    struct stream_base *stream = cmd_context->stream;
+    int ret = 0;
+    if(EHSHELL_CO_CANCELLED(ehshell_event)){
+        if(ehshell_event & EHSHELL_EVENT_SIGINT_REQUEST_QUIT)
+            eh_stream_puts(stream, "^C\r\n");
+        goto finish;
+    }
+    for(int i = 0; i < EHSHELL_CONFIG_GENERATE_PASS_CHUNKS; i++){
+        /* 空间不足时登记等待，有空间后以 EHSHELL_EVENT_RESUME 回到这里 */
+        if(!ehshell_command_wait_writable(cmd_context, cmd_context->gen_chunk)){
+            eh_stream_finish(stream);
+            return ;
+        }
+        ret = cmd_context->gen_next(cmd_context, stream);
+        if(ret <= 0)
+            goto finish;
+        if(cmd_context->ehshell && cmd_context->ehshell->dispatch_budget <= 0)
+            break;
+    }
+    /* 本轮用完，让其他会话和事件先得到处理 */
+    eh_stream_finish(stream);
+    ehshell_command_resume_later(cmd_context);
+    return ;
+finish:
+    if(ret < 0)
+        ehshell_command_set_exit_status(cmd_context, ret);
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+int ehshell_command_generate(ehshell_cmd_context_t *cmd_context, ehshell_next_chunk_t next_chunk, size_t chunk_size){
+    if(next_chunk == NULL)
+        return EH_RET_INVALID_PARAM;
+    if(cmd_context->flags & EHSHELL_CMD_CONTEXT_FLAG_WORKER)
+        return EH_RET_NOT_SUPPORTED;
+    cmd_context->gen_next = next_chunk;
+    cmd_context->gen_chunk = (uint32_t)chunk_size;
+    ehshell_command_generate_step(cmd_context, 0);
+    return 0;
+}
@@ -0,0 +1,218 @@
+/**
+ * @file ehshell_exec.c
+ * @brief ehshell 无终端命令执行，每个请求只有一个命令上下文和一个输出流，
+ *        协程命令的恢复由独立的信号在事件循环中调度
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-22
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_list.h>
+#include <eh_error.h>
+#include <eh_debug.h>
+#include <eh_signal.h>
+#include <eh_formatio.h>
+
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+#include <ehshell_exec.h>
+
+/* 字符串命令的执行上下文，参数就地切分在cmd_str中 */
+struct ehshell_exec_string{
+    struct ehshell_exec                 exec;
+    const char                         *argv[EHSHELL_CONFIG_ARGC_MAX];
+    char                                cmd_str[];
+};
+
+static struct eh_list_head ehshell_exec_ready_list;
+static eh_signal_base_t ehshell_exec_sig_dispatch;
+static eh_signal_slot_t ehshell_exec_slot_dispatch;
+
+static void ehshell_exec_stream_write(void *ctx, const uint8_t *buf, size_t len){
+    struct ehshell_exec *exec = eh_container_of((struct stream_function_no_cache *)ctx, struct ehshell_exec, stream);
+    struct ehshell_exec_request *request = exec->request;
+    size_t n;
+    /* 直接写入请求方的缓冲区段 */
+    while(len && exec->seg){
+        n = exec->seg->size - exec->seg->len;
+        if(n == 0){
+            exec->seg = exec->seg->next;
+            continue;
+        }
+        if(n > len)
+            n = len;
+        memcpy(exec->seg->buf + exec->seg->len, buf, n);
+        exec->seg->len += n;
+        request->output_len += n;
+        buf += n;
+        len -= n;
+    }
+    request->dropped += len;
+}
+
+static void ehshell_exec_stream_finish(void *ctx){
+    (void)ctx;
+}
+
+void ehshell_exec_notify(ehshell_cmd_context_t *cmd_context){
+    struct ehshell_exec *exec = eh_container_of(cmd_context, struct ehshell_exec, ctx);
+    bool is_first_ready = false;
+    eh_save_state_t state = eh_enter_critical();
+    if(eh_list_empty(&exec->ready_node)){
+        is_first_ready = eh_list_empty(&ehshell_exec_ready_list);
+        eh_list_add_tail(&exec->ready_node, &ehshell_exec_ready_list);
+    }
+    eh_exit_critical(state);
+    if(is_first_ready)
+        eh_signal_notify(&ehshell_exec_sig_dispatch);
+}
+
+void ehshell_exec_finish(ehshell_cmd_context_t *cmd_context){
+    struct ehshell_exec *exec = eh_container_of(cmd_context, struct ehshell_exec, ctx);
+    struct ehshell_exec_request *request = exec->request;
+    int status = cmd_context->exit_status;
+    eh_save_state_t state = eh_enter_critical();
+    eh_list_del_init(&exec->ready_node);
+    eh_exit_critical(state);
+    request->exec = NULL;
+    if(!exec->is_static)
+        eh_free(exec);
+    if(request->done)
+        request->done(request, status);
+}
+
+static void ehshell_exec_dispatcher(eh_event_t *e, void *slot_param){
+    (void)e;
+    (void)slot_param;
+    struct eh_list_head list;
+    struct ehshell_exec *exec;
+    eh_save_state_t state;
+    /* 只处理本次调度开始时就绪的请求，处理中重新就绪的留给下一次调度 */
+    eh_list_head_init(&list);
+    state = eh_enter_critical();
+    if(!eh_list_empty(&ehshell_exec_ready_list)){
+        list.next = ehshell_exec_ready_list.next;
+        list.prev = ehshell_exec_ready_list.prev;
+        list.next->prev = &list;
+        list.prev->next = &list;
+        eh_list_head_init(&ehshell_exec_ready_list);
+    }
+    eh_exit_critical(state);
+    while(!eh_list_empty(&list)){
+        exec = eh_list_entry(list.next, struct ehshell_exec, ready_node);
+        state = eh_enter_critical();
+        eh_list_del_init(&exec->ready_node);
+        eh_exit_critical(state);
+        ehshell_command_co_resume(NULL, &exec->ctx);
+    }
+}
+
+static int ehshell_exec_launch(struct ehshell_exec_request *request, struct ehshell_exec *exec,
+    const struct ehshell_command_info *command_info, int argc, const char *argv[]){
+    /* 就绪表和信号只属于主循环，分片线程中不能启动 */
+    if(ehshell_shard_self() ||
+        (command_info->flags & (EHSHELL_COMMAND_REDIRECT_INPUT | EHSHELL_COMMAND_RUN_ON_WORKER))){
+        if(!exec->is_static)
+            eh_free(exec);
+        return EH_RET_NOT_SUPPORTED;
+    }
+    eh_stream_function_no_cache_init(&exec->stream, ehshell_exec_stream_write, ehshell_exec_stream_finish);
+    ehshell_cmd_context_init(&exec->ctx, NULL, command_info, (struct stream_base *)&exec->stream,
+        EHSHELL_CMD_CONTEXT_FLAG_HEADLESS);
+    eh_list_head_init(&exec->ready_node);
+    exec->request = request;
+    exec->seg = request->output;
+    request->exec = exec;
+    /* 命令可能同步结束，之后不能再访问exec */
+    ehshell_command_call(&exec->ctx, argc, argv);
+    return 0;
+}
+
+static int ehshell_exec_start(struct ehshell_exec_request *request, struct ehshell_exec *exec,
+    const struct ehshell_command_info *command_info, int argc, const char *argv[]){
+    exec->is_static = false;
+    for(struct ehshell_exec_segment *seg = request->output; seg; seg = seg->next)
+        seg->len = 0;
+    request->output_len = 0;
+    request->dropped = 0;
+    return ehshell_exec_launch(request, exec, command_info, argc, argv);
+}
+
+int ehshell_exec_start_static(struct ehshell_exec_request *request, struct ehshell_exec *exec,
+    const struct ehshell_command_info *command_info, int argc, const char *argv[]){
+    /* 已写满的段被跳过，输出接在之前的命令之后 */
+    exec->is_static = true;
+    return ehshell_exec_launch(request, exec, command_info, argc, argv);
+}
+
+int ehshell_exec(struct ehshell_exec_request *request, const char *cmd_str){
+    const struct ehshell_command_info *command_info;
+    struct ehshell_exec_string *exec;
+    const char **argv;
+    const char *err = NULL;
+    size_t len;
+    int argc;
+    if(!request || !cmd_str)
+        return EH_RET_INVALID_PARAM;
+    len = strlen(cmd_str) + 1;
+    exec = eh_malloc(sizeof(struct ehshell_exec_string) + len);
+    if(!exec)
+        return EH_RET_MALLOC_ERROR;
+    memcpy(exec->cmd_str, cmd_str, len);
+    argc = ehshell_command_split(exec->cmd_str, exec->argv, &err);
+    if(argc > 1 && strcmp(exec->argv[argc - 1], "&") == 0)
+        argc--;
+    if(argc <= 0 || (command_info = ehshell_command_lookup(exec->argv[0])) == NULL){
+        eh_free(exec);
+        return argc <= 0 ? EH_RET_INVALID_PARAM : EH_RET_NOT_EXISTS;
+    }
+    argv = exec->argv;
+    command_info = ehshell_command_descend(command_info, &argc, &argv);
+    if(!command_info->do_function){
+        eh_free(exec);
+        return EH_RET_NOT_EXISTS;
+    }
+    return ehshell_exec_start(request, &exec->exec, command_info, argc, argv);
+}
+
+int ehshell_exec_prepared(struct ehshell_exec_request *request, const ehshell_prepared_t *prepared){
+    struct ehshell_exec *exec;
+    if(!request || !prepared)
+        return EH_RET_INVALID_PARAM;
+    exec = eh_malloc(sizeof(struct ehshell_exec));
+    if(!exec)
+        return EH_RET_MALLOC_ERROR;
+    /* 命令不会修改argv数组，句柄本身保持不变 */
+    return ehshell_exec_start(request, exec, prepared->command_info, prepared->argc, (const char **)prepared->argv);
+}
+
+void ehshell_exec_cancel(struct ehshell_exec_request *request){
+    if(!request || !request->exec)
+        return ;
+    ehshell_command_post_event(&request->exec->ctx, EHSHELL_EVENT_SIGINT_REQUEST_QUIT);
+}
+
+static int __init ehshell_exec_init(void){
+    int ret;
+    eh_list_head_init(&ehshell_exec_ready_list);
+    eh_signal_init(&ehshell_exec_sig_dispatch);
+    eh_signal_slot_init(&ehshell_exec_slot_dispatch, ehshell_exec_dispatcher, NULL);
+    ret = eh_signal_slot_connect(&ehshell_exec_sig_dispatch, &ehshell_exec_slot_dispatch);
+    if(ret < 0){
+        eh_merrfl( EHSHELL,"exec dispatcher signal connect failed %d", ret);
+        return ret;
+    }
+    return 0;
+}
+
+static void __exit ehshell_exec_exit(void){
+    eh_signal_slot_disconnect(&ehshell_exec_sig_dispatch, &ehshell_exec_slot_dispatch);
+}
+ehshell_module_core_export(ehshell_exec_init, ehshell_exec_exit);
@@ -0,0 +1,127 @@
+/**
+ * @file ehshell_heap_trace.c
+ * @brief 堆分配跟踪，链接时用 -Wl,--wrap=eh_malloc,--wrap=eh_free 替换分配函数，
+ *        跟踪期间记录每次分配的地址和大小，释放时按地址找回大小，得到分配次数和峰值占用，
+ *        不在分配块前增加头部，跟踪开始前分配的内存在跟踪期间释放时被忽略
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-05
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_error.h>
+
+#include <ehshell.h>
+#include <ehshell_internal.h>
+
+#ifdef CONFIG_PACKAGE_EHSHELL_HEAP_HOOK
+
+struct ehshell_heap_trace_slot{
+    void                       *ptr;
+    size_t                      size;
+};
+
+static struct{
+    bool                            active;
+    struct ehshell_heap_stat        stat;
+    struct ehshell_heap_trace_slot  slots[EHSHELL_CONFIG_HEAP_TRACE_SLOTS];
+}s_heap_trace;
+/* 分片线程和工作线程的分配也经过这里 */
+static ehshell_lock_t s_heap_trace_lock = EHSHELL_LOCK_INIT;
+
+extern void *__real_eh_malloc(size_t size);
+extern void __real_eh_free(void *ptr);
+
+static void ehshell_heap_trace_alloc(void *ptr, size_t size){
+    struct ehshell_heap_trace_slot *slot = NULL;
+    ehshell_lock(&s_heap_trace_lock);
+    if(!s_heap_trace.active)
+        goto out;
+    s_heap_trace.stat.allocs++;
+    s_heap_trace.stat.bytes += size;
+    for(size_t i = 0; i < EHSHELL_CONFIG_HEAP_TRACE_SLOTS; i++){
+        if(s_heap_trace.slots[i].ptr == NULL){
+            slot = &s_heap_trace.slots[i];
+            break;
+        }
+    }
+    if(slot == NULL){
+        s_heap_trace.stat.untracked++;
+        goto out;
+    }
+    slot->ptr = ptr;
+    slot->size = size;
+    s_heap_trace.stat.live += size;
+    if(s_heap_trace.stat.live > s_heap_trace.stat.peak)
+        s_heap_trace.stat.peak = s_heap_trace.stat.live;
+out:
+    ehshell_unlock(&s_heap_trace_lock);
+}
+
+static void ehshell_heap_trace_free(void *ptr){
+    ehshell_lock(&s_heap_trace_lock);
+    if(!s_heap_trace.active)
+        goto out;
+    s_heap_trace.stat.frees++;
+    for(size_t i = 0; i < EHSHELL_CONFIG_HEAP_TRACE_SLOTS; i++){
+        if(s_heap_trace.slots[i].ptr == ptr){
+            s_heap_trace.stat.live -= s_heap_trace.slots[i].size;
+            s_heap_trace.slots[i].ptr = NULL;
+            break;
+        }
+    }
+out:
+    ehshell_unlock(&s_heap_trace_lock);
+}
+
+void *__wrap_eh_malloc(size_t size){
+    void *ptr = __real_eh_malloc(size);
+    if(ptr && __atomic_load_n(&s_heap_trace.active, __ATOMIC_RELAXED))
+        ehshell_heap_trace_alloc(ptr, size);
+    return ptr;
+}
+
+void __wrap_eh_free(void *ptr){
+    if(ptr && __atomic_load_n(&s_heap_trace.active, __ATOMIC_RELAXED))
+        ehshell_heap_trace_free(ptr);
+    __real_eh_free(ptr);
+}
+
+int ehshell_heap_trace_start(void){
+    ehshell_lock(&s_heap_trace_lock);
+    if(s_heap_trace.active){
+        ehshell_unlock(&s_heap_trace_lock);
+        return EH_RET_BUSY;
+    }
+    memset(&s_heap_trace.stat, 0, sizeof(s_heap_trace.stat));
+    memset(s_heap_trace.slots, 0, sizeof(s_heap_trace.slots));
+    __atomic_store_n(&s_heap_trace.active, true, __ATOMIC_RELAXED);
+    ehshell_unlock(&s_heap_trace_lock);
+    return 0;
+}
+
+void ehshell_heap_trace_stop(struct ehshell_heap_stat *stat){
+    ehshell_lock(&s_heap_trace_lock);
+    __atomic_store_n(&s_heap_trace.active, false, __ATOMIC_RELAXED);
+    if(stat)
+        *stat = s_heap_trace.stat;
+    ehshell_unlock(&s_heap_trace_lock);
+}
+
+#else
+
+int ehshell_heap_trace_start(void){
+    return EH_RET_NOT_SUPPORTED;
+}
+
+void ehshell_heap_trace_stop(struct ehshell_heap_stat *stat){
+    if(stat)
+        memset(stat, 0, sizeof(struct ehshell_heap_stat));
+}
+
+#endif /* CONFIG_PACKAGE_EHSHELL_HEAP_HOOK */
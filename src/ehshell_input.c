@@ -0,0 +1,187 @@
+/**
+ * @file ehshell_input.c
+ * @brief 多生产者单消费者的无锁输入队列，
+ *        生产者用CAS预留空间，拷贝数据后用release写入记录头提交，
+ *        消费者(shell调度器)用acquire读取记录头，按顺序把已提交的记录搬进输入缓冲区，
+ *        被抢占的生产者只会让消费者停在它的记录前，不会让其他生产者等待
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-28
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_error.h>
+#include <eh_ringbuf.h>
+
+#include <ehshell.h>
+#include <ehshell_internal.h>
+
+#if EHSHELL_CONFIG_INPUT_QUEUE_SIZE > 0
+
+#if (EHSHELL_CONFIG_INPUT_QUEUE_SIZE & (EHSHELL_CONFIG_INPUT_QUEUE_SIZE - 1)) != 0 || EHSHELL_CONFIG_INPUT_QUEUE_SIZE < 16
+#error "EHSHELL_CONFIG_INPUT_QUEUE_SIZE must be a power of 2 and at least 16"
+#endif
+
+/*
+ * 记录: | head(4) (len << 1) | 1，0表示未提交 | data(len) | 填充到4字节对齐 |
+ * 位置都是4的倍数，记录头不会跨越缓冲区结尾，数据可能回绕
+ */
+#define EHSHELL_INPUT_HEAD_SIZE     4
+#define EHSHELL_INPUT_MASK          (EHSHELL_CONFIG_INPUT_QUEUE_SIZE - 1)
+#define EHSHELL_INPUT_RECORD_MAX    (EHSHELL_CONFIG_INPUT_QUEUE_SIZE / 2 - EHSHELL_INPUT_HEAD_SIZE)
+#define ehshell_input_align(n)      (((n) + 3U) & ~3U)
+
+struct ehshell_input_queue{
+    uint32_t    reserve;        /* 生产者预留到的位置 */
+    uint32_t    read;           /* 消费者读取到的位置 */
+    uint32_t    idle;           /* 消费者已经空闲，下一个提交的生产者负责通知 */
+    uint32_t    offset;         /* 当前记录中已经搬走的字节数，只有消费者访问 */
+    uint32_t    dropped;
+    uint32_t    data[EHSHELL_CONFIG_INPUT_QUEUE_SIZE / 4];
+};
+
+#define ehshell_input_head(q, pos)  (&(q)->data[((pos) & EHSHELL_INPUT_MASK) / 4])
+
+static void ehshell_input_copy_in(struct ehshell_input_queue *q, uint32_t pos, const uint8_t *src, size_t len){
+    uint8_t *buf = (uint8_t *)q->data;
+    size_t idx = pos & EHSHELL_INPUT_MASK;
+    size_t first = EHSHELL_CONFIG_INPUT_QUEUE_SIZE - idx;
+    if(first > len)
+        first = len;
+    memcpy(buf + idx, src, first);
+    memcpy(buf, src + first, len - first);
+}
+
+static void ehshell_input_zero(struct ehshell_input_queue *q, uint32_t pos, size_t len){
+    uint8_t *buf = (uint8_t *)q->data;
+    size_t idx = pos & EHSHELL_INPUT_MASK;
+    size_t first = EHSHELL_CONFIG_INPUT_QUEUE_SIZE - idx;
+    if(first > len)
+        first = len;
+    memset(buf + idx, 0, first);
+    memset(buf, 0, len - first);
+}
+
+struct ehshell_input_queue *ehshell_input_queue_create(void){
+    struct ehshell_input_queue *q = eh_malloc(sizeof(struct ehshell_input_queue));
+    if(q == NULL)
+        return NULL;
+    memset(q, 0, sizeof(struct ehshell_input_queue));
+    q->idle = 1;
+    return q;
+}
+
+void ehshell_input_queue_destroy(struct ehshell_input_queue *q){
+    eh_free(q);
+}
+
+int ehshell_input_write(ehshell_t *ehshell, const void *buf, size_t len){
+    struct ehshell_input_queue *q;
+    const uint8_t *src = buf;
+    uint32_t pos, rd, need, avail, n;
+    size_t written = 0;
+    if(!ehshell || (!buf && len))
+        return EH_RET_INVALID_PARAM;
+    q = ehshell->input_queue;
+    while(written < len){
+        n = (uint32_t)(len - written > EHSHELL_INPUT_RECORD_MAX ? EHSHELL_INPUT_RECORD_MAX : len - written);
+        pos = __atomic_load_n(&q->reserve, __ATOMIC_RELAXED);
+        do{
+            /* read的acquire保证看到消费者对已释放区域的清零 */
+            rd = __atomic_load_n(&q->read, __ATOMIC_ACQUIRE);
+            avail = EHSHELL_CONFIG_INPUT_QUEUE_SIZE - (pos - rd);
+            if(avail <= EHSHELL_INPUT_HEAD_SIZE)
+                goto full;
+            need = EHSHELL_INPUT_HEAD_SIZE + ehshell_input_align(n);
+            if(need > avail){
+                n = avail - EHSHELL_INPUT_HEAD_SIZE;
+                need = avail;
+            }
+        }while(!__atomic_compare_exchange_n(&q->reserve, &pos, pos + need, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+        ehshell_input_copy_in(q, pos + EHSHELL_INPUT_HEAD_SIZE, src + written, n);
+        __atomic_store_n(ehshell_input_head(q, pos), (n << 1) | 1, __ATOMIC_RELEASE);
+        written += n;
+        /* 只有消费者空闲时才通知，突发写入不会重复触发信号 */
+        if(__atomic_exchange_n(&q->idle, 0, __ATOMIC_ACQ_REL))
+            ehshell_notify_processor(ehshell);
+    }
+    return (int)written;
+full:
+    __atomic_fetch_add(&q->dropped, (uint32_t)(len - written), __ATOMIC_RELAXED);
+    return (int)written;
+}
+
+/**
+ * @brief                   搬运队首记录
+ * @return int              搬完一条记录返回1，队首未提交返回0，输入缓冲区满返回负数
+ */
+static int ehshell_input_queue_pop(struct ehshell_input_queue *q, eh_ringbuf_t *ringbuf){
+    const uint8_t *buf = (const uint8_t *)q->data;
+    uint32_t rd = q->read;
+    uint32_t head = __atomic_load_n(ehshell_input_head(q, rd), __ATOMIC_ACQUIRE);
+    uint32_t len, idx, n;
+    int32_t wl;
+    if(!(head & 1))
+        return 0;
+    len = head >> 1;
+    while(q->offset < len){
+        idx = (rd + EHSHELL_INPUT_HEAD_SIZE + q->offset) & EHSHELL_INPUT_MASK;
+        n = EHSHELL_CONFIG_INPUT_QUEUE_SIZE - idx;
+        if(n > len - q->offset)
+            n = len - q->offset;
+        wl = eh_ringbuf_write(ringbuf, buf + idx, (int32_t)n);
+        if(wl > 0)
+            q->offset += (uint32_t)wl;
+        if(wl < (int32_t)n)
+            return -1;
+    }
+    len = EHSHELL_INPUT_HEAD_SIZE + ehshell_input_align(len);
+    /* 先清零再释放，之后的记录头总是从0开始 */
+    ehshell_input_zero(q, rd, len);
+    q->offset = 0;
+    __atomic_store_n(&q->read, rd + len, __ATOMIC_RELEASE);
+    return 1;
+}
+
+bool ehshell_input_queue_drain(ehshell_t *shell){
+    struct ehshell_input_queue *q = shell->input_queue;
+    int ret;
+    for(;;){
+        while((ret = ehshell_input_queue_pop(q, shell->input_ringbuf)) > 0){}
+        /* 输入缓冲区满，不登记空闲，由调用者在腾出空间后再次调度 */
+        if(ret < 0)
+            return true;
+        /* 先登记空闲再检查队首，避免错过在两者之间提交的记录 */
+        __atomic_store_n(&q->idle, 1, __ATOMIC_SEQ_CST);
+        if(!(__atomic_load_n(ehshell_input_head(q, q->read), __ATOMIC_SEQ_CST) & 1))
+            return false;
+        __atomic_store_n(&q->idle, 0, __ATOMIC_SEQ_CST);
+    }
+}
+
+uint32_t ehshell_input_dropped(ehshell_t *ehshell){
+    if(!ehshell)
+        return 0;
+    return __atomic_load_n(&ehshell->input_queue->dropped, __ATOMIC_RELAXED);
+}
+
+#else
+
+int ehshell_input_write(ehshell_t *ehshell, const void *buf, size_t len){
+    (void)ehshell;
+    (void)buf;
+    (void)len;
+    return EH_RET_NOT_SUPPORTED;
+}
+
+uint32_t ehshell_input_dropped(ehshell_t *ehshell){
+    (void)ehshell;
+    return 0;
+}
+
+#endif /* EHSHELL_CONFIG_INPUT_QUEUE_SIZE > 0 */
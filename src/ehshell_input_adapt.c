@@ -0,0 +1,202 @@
+/**
+ * @file ehshell_input_adapt.c
+ * @brief 输入缓冲区的占用统计和自适应大小，
+ *        处理开始时缓冲区接近写满，或者端口报告了写满溢出，说明输入突发超过了处理速度，立即加倍，
+ *        之后每个统计窗口检查最高占用，持续低占用时逐步减半，回到初始大小后停止计时
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-03
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_error.h>
+#include <eh_debug.h>
+#include <eh_ringbuf.h>
+
+#include <ehshell.h>
+#include <ehshell_internal.h>
+
+static bool ehshell_input_adaptive(ehshell_t *shell){
+    return shell->config->input_ringbuf_max > shell->config->input_ringbuf_size;
+}
+
+static uint32_t ehshell_input_max(ehshell_t *shell){
+    uint32_t max = shell->config->input_ringbuf_max;
+    if(!ehshell_input_adaptive(shell))
+        return shell->config->input_ringbuf_size;
+    return max > INT32_MAX ? INT32_MAX : max;
+}
+
+/*
+ * 前台命令的回显位置指向缓冲区内部，此时不能更换缓冲区，
+ * 重定向输入的解析位置和录制位置可以换算到新缓冲区，机器模式只使用相对读指针的偏移
+ */
+static bool ehshell_input_resizable(ehshell_t *shell){
+    return shell->cmd_current.command_info == NULL || shell->machine ||
+        shell->state == EHSHELL_STATE_REDIRECT_INPUT;
+}
+
+/* 旧缓冲区中pos相对读指针的偏移，换算成新缓冲区中的位置 */
+static uint32_t ehshell_input_rebase(const eh_ringbuf_t *old, const eh_ringbuf_t *ring, uint32_t pos){
+    eh_ringbuf_t tmp = *old;
+    int32_t off;
+    tmp.w = pos;
+    off = eh_ringbuf_size(&tmp);
+    tmp = *ring;
+    eh_ringbuf_read_skip(&tmp, off);
+    return tmp.r;
+}
+
+static int ehshell_input_resize(ehshell_t *shell, uint32_t size){
+    eh_ringbuf_t *old = shell->input_ringbuf;
+    eh_ringbuf_t *ring;
+    const uint8_t *buf;
+    int32_t len, off = 0, rl;
+    eh_save_state_t state;
+    int ret;
+    ring = eh_ringbuf_create((int32_t)size, NULL);
+    ret = eh_ptr_to_error(ring);
+    if(ret < 0)
+        return ret;
+    /* 端口可能在中断中写入，搬运和替换都在临界区中完成 */
+    state = eh_enter_critical();
+    len = eh_ringbuf_size(old);
+    if(len > (int32_t)size){
+        eh_exit_critical(state);
+        eh_ringbuf_destroy(ring);
+        return EH_RET_BUSY;
+    }
+    while(off < len){
+        rl = 0;
+        buf = eh_ringbuf_peek(old, off, NULL, &rl);
+        if(buf == NULL || rl <= 0)
+            break;
+        eh_ringbuf_write(ring, buf, rl);
+        off += rl;
+    }
+    if(shell->state == EHSHELL_STATE_REDIRECT_INPUT && shell->cmd_current.command_info)
+        shell->redirect_input_escape_parse_pos = ehshell_input_rebase(old, ring, shell->redirect_input_escape_parse_pos);
+    if(shell->recorder)
+        shell->record_input_pos = ehshell_input_rebase(old, ring, shell->record_input_pos);
+    shell->input_ringbuf = ring;
+    shell->input_size = size;
+    eh_exit_critical(state);
+    eh_ringbuf_destroy(old);
+    return 0;
+}
+
+static void ehshell_input_adapt_timeout(ehshell_timer_t *timer, void *arg){
+    ehshell_t *shell = arg;
+    uint32_t size = shell->input_size;
+    uint32_t fill = (uint32_t)eh_ringbuf_size(shell->input_ringbuf);
+    uint32_t target;
+    if(shell->input_window_high < size / 4){
+        if(shell->input_low_windows < UINT8_MAX)
+            shell->input_low_windows++;
+    }else{
+        shell->input_low_windows = 0;
+    }
+    shell->input_window_high = fill;
+    if(shell->input_low_windows >= EHSHELL_CONFIG_INPUT_ADAPT_SHRINK_WINDOWS && ehshell_input_resizable(shell)){
+        target = size / 2;
+        if(target < shell->config->input_ringbuf_size)
+            target = shell->config->input_ringbuf_size;
+        if(fill <= target && ehshell_input_resize(shell, target) == 0){
+            shell->input_shrinks++;
+            shell->input_low_windows = 0;
+            eh_mdebugfl(EHSHELL, "%s input ringbuf shrink %u -> %u", shell->config->host,
+                (unsigned)size, (unsigned)target);
+        }
+    }
+    if(shell->input_size > shell->config->input_ringbuf_size)
+        ehshell_timer_start(timer, EHSHELL_CONFIG_INPUT_ADAPT_WINDOW_MS);
+}
+
+void ehshell_input_adapt_init(ehshell_t *shell){
+    shell->input_size = shell->config->input_ringbuf_size;
+    shell->input_high_water = 0;
+    shell->input_window_high = 0;
+    shell->input_saturations = 0;
+    shell->input_overflows = 0;
+    shell->input_overflow_bytes = 0;
+    shell->input_overflows_seen = 0;
+    shell->input_grows = 0;
+    shell->input_shrinks = 0;
+    shell->input_grow_failures = 0;
+    shell->input_low_windows = 0;
+    ehshell_timer_init(&shell->input_adapt_timer, ehshell_input_adapt_timeout, shell);
+}
+
+void ehshell_input_adapt_stop(ehshell_t *shell){
+    ehshell_timer_stop(&shell->input_adapt_timer);
+}
+
+bool ehshell_input_adapt(ehshell_t *shell, bool input_blocked){
+    uint32_t size = shell->input_size;
+    uint32_t fill = (uint32_t)eh_ringbuf_size(shell->input_ringbuf);
+    uint32_t overflows = __atomic_load_n(&shell->input_overflows, __ATOMIC_RELAXED);
+    uint32_t target, max;
+    bool overflowed = overflows != shell->input_overflows_seen;
+    int ret;
+    shell->input_overflows_seen = overflows;
+    if(fill > shell->input_high_water)
+        shell->input_high_water = fill;
+    if(fill > shell->input_window_high)
+        shell->input_window_high = fill;
+    /* 两次处理之间的溢出此时可能已经看不到占用，按写满计入本窗口 */
+    if(overflowed){
+        shell->input_high_water = size;
+        shell->input_window_high = size;
+    }
+    /* 剩余不到八分之一，端口报告过溢出，或者多生产者队列因缓冲区满停止搬运 */
+    if(!input_blocked && !overflowed && fill < size - size / 8)
+        return false;
+    shell->input_saturations++;
+    if(!ehshell_input_adaptive(shell))
+        return false;
+    max = ehshell_input_max(shell);
+    if(size >= max || !ehshell_input_resizable(shell)){
+        shell->input_grow_failures++;
+        return false;
+    }
+    target = size > max / 2 ? max : size * 2;
+    ret = ehshell_input_resize(shell, target);
+    if(ret < 0){
+        shell->input_grow_failures++;
+        eh_mwarnfl(EHSHELL, "%s input ringbuf grow %u -> %u failed %d", shell->config->host,
+            (unsigned)size, (unsigned)target, ret);
+        return false;
+    }
+    shell->input_grows++;
+    shell->input_low_windows = 0;
+    eh_mdebugfl(EHSHELL, "%s input ringbuf grow %u -> %u", shell->config->host, (unsigned)size, (unsigned)target);
+    if(!ehshell_timer_is_active(&shell->input_adapt_timer))
+        ehshell_timer_start(&shell->input_adapt_timer, EHSHELL_CONFIG_INPUT_ADAPT_WINDOW_MS);
+    return true;
+}
+
+void ehshell_input_overflow(ehshell_t *ehshell, uint32_t bytes){
+    if(!ehshell || bytes == 0)
+        return ;
+    __atomic_fetch_add(&ehshell->input_overflow_bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&ehshell->input_overflows, 1, __ATOMIC_RELAXED);
+}
+
+int ehshell_input_get_stat(ehshell_t *ehshell, struct ehshell_input_stat *stat){
+    if(!ehshell || !stat)
+        return EH_RET_INVALID_PARAM;
+    stat->size = ehshell->input_size;
+    stat->max = ehshell_input_max(ehshell);
+    stat->high_water = ehshell->input_high_water;
+    stat->saturations = ehshell->input_saturations;
+    stat->overflows = __atomic_load_n(&ehshell->input_overflows, __ATOMIC_RELAXED);
+    stat->overflow_bytes = __atomic_load_n(&ehshell->input_overflow_bytes, __ATOMIC_RELAXED);
+    stat->grows = ehshell->input_grows;
+    stat->shrinks = ehshell->input_shrinks;
+    stat->grow_failures = ehshell->input_grow_failures;
+    return 0;
+}
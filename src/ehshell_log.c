@@ -0,0 +1,397 @@
+/**
+ * @file ehshell_log.c
+ * @brief 共享日志环形缓冲区和 logtail 命令，
+ *        缓冲区用绝对位置和记录序号描述，订阅者的序号落后于最旧记录时即发生了覆盖，
+ *        订阅者只在主事件循环中恢复，有其他线程时写日志只置位，由轮询任务在主事件循环中唤醒，
+ *        订阅者直接从缓冲区输出文本，不逐个复制，输出前后检查序号，
+ *        输出途中被覆盖的记录可能夹杂新日志的内容，随后停止输出该记录并计入丢弃数
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-25
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_list.h>
+#include <eh_error.h>
+#include <eh_debug.h>
+#include <eh_signal.h>
+#include <eh_formatio.h>
+
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+#include <ehshell_coroutine.h>
+#include <ehshell_log.h>
+
+#if (EHSHELL_CONFIG_LOG_RING_SIZE & (EHSHELL_CONFIG_LOG_RING_SIZE - 1)) != 0
+#error "EHSHELL_CONFIG_LOG_RING_SIZE must be a power of 2"
+#endif
+
+/* 记录头: | len(2) 含头的记录长度 | level(1) | module_len(1) |，之后是模块名和文本 */
+#define EHSHELL_LOG_HEAD_SIZE       4
+#define EHSHELL_LOG_TEXT_MAX        (EHSHELL_CONFIG_LOG_RING_SIZE / 2 - EHSHELL_LOG_HEAD_SIZE - EHSHELL_CONFIG_LOG_MODULE_MAX)
+#define EHSHELL_LOG_MASK            (EHSHELL_CONFIG_LOG_RING_SIZE - 1)
+#define LOGTAIL_BATCH               32
+#define LOGTAIL_WRITABLE_MAX        128
+
+struct ehshell_log_ring{
+    uint8_t     buf[EHSHELL_CONFIG_LOG_RING_SIZE];
+    uint32_t    head;           /* 下一条记录的写入位置 */
+    uint32_t    tail;           /* 最旧记录的位置 */
+    uint32_t    head_seq;
+    uint32_t    tail_seq;
+    bool        waiters;        /* 有订阅者读完了全部记录，等待新日志 */
+};
+
+struct logtail_frame{
+    struct eh_list_head     node;
+    ehshell_cmd_context_t  *cmd_context;
+    uint32_t    pos;
+    uint32_t    seq;
+    uint32_t    dropped;
+    uint32_t    reported;
+    uint32_t    count;
+    /* 当前记录 */
+    uint16_t    rec_len;
+    uint8_t     level;
+    uint8_t     module_len;
+    /* 过滤条件 */
+    uint8_t     max_level;
+    uint8_t     filter_len;
+    char        filter[EHSHELL_CONFIG_LOG_MODULE_MAX];
+};
+
+static struct ehshell_log_ring ehshell_log;
+static ehshell_lock_t ehshell_log_lock = EHSHELL_LOCK_INIT;
+static struct eh_list_head ehshell_log_subscribers;
+static eh_signal_base_t ehshell_log_sig_wake;
+static eh_signal_slot_t ehshell_log_slot_wake;
+#if EHSHELL_THREADED
+static bool ehshell_log_wake_pending;
+static eh_loop_poll_task_t ehshell_log_wake_poll_task;
+#endif
+
+static void ehshell_log_copy_in(uint32_t pos, const void *src, size_t len){
+    size_t idx = pos & EHSHELL_LOG_MASK;
+    size_t first = EHSHELL_CONFIG_LOG_RING_SIZE - idx;
+    if(first > len)
+        first = len;
+    memcpy(ehshell_log.buf + idx, src, first);
+    memcpy(ehshell_log.buf, (const uint8_t *)src + first, len - first);
+}
+
+static void ehshell_log_copy_out(uint32_t pos, void *dst, size_t len){
+    size_t idx = pos & EHSHELL_LOG_MASK;
+    size_t first = EHSHELL_CONFIG_LOG_RING_SIZE - idx;
+    if(first > len)
+        first = len;
+    memcpy(dst, ehshell_log.buf + idx, first);
+    memcpy((uint8_t *)dst + first, ehshell_log.buf, len - first);
+}
+
+void ehshell_log_write(enum ehshell_log_level level, const char *module, const char *text, size_t len){
+    uint8_t head[EHSHELL_LOG_HEAD_SIZE];
+    size_t module_len = module ? strlen(module) : 0;
+    uint32_t rec_len;
+    bool wake;
+    if(module_len > EHSHELL_CONFIG_LOG_MODULE_MAX)
+        module_len = EHSHELL_CONFIG_LOG_MODULE_MAX;
+    if(len > EHSHELL_LOG_TEXT_MAX)
+        len = EHSHELL_LOG_TEXT_MAX;
+    rec_len = (uint32_t)(EHSHELL_LOG_HEAD_SIZE + module_len + len);
+    head[0] = (uint8_t)rec_len;
+    head[1] = (uint8_t)(rec_len >> 8);
+    head[2] = (uint8_t)level;
+    head[3] = (uint8_t)module_len;
+    ehshell_lock(&ehshell_log_lock);
+    /* 空间不足时丢弃最旧的记录，落后的订阅者通过序号发现丢弃 */
+    while(ehshell_log.head + rec_len - ehshell_log.tail > EHSHELL_CONFIG_LOG_RING_SIZE){
+        uint8_t old[2];
+        ehshell_log_copy_out(ehshell_log.tail, old, sizeof(old));
+        ehshell_log.tail += (uint32_t)old[0] | ((uint32_t)old[1] << 8);
+        ehshell_log.tail_seq++;
+    }
+    ehshell_log_copy_in(ehshell_log.head, head, sizeof(head));
+    ehshell_log_copy_in(ehshell_log.head + EHSHELL_LOG_HEAD_SIZE, module, module_len);
+    ehshell_log_copy_in(ehshell_log.head + EHSHELL_LOG_HEAD_SIZE + (uint32_t)module_len, text, len);
+    ehshell_log.head += rec_len;
+    ehshell_log.head_seq++;
+    wake = ehshell_log.waiters;
+    ehshell_log.waiters = false;
+    ehshell_unlock(&ehshell_log_lock);
+    if(!wake)
+        return ;
+#if EHSHELL_THREADED
+    /* 可能在分片或工作线程中，信号只能在主事件循环中发出 */
+    __atomic_store_n(&ehshell_log_wake_pending, true, __ATOMIC_RELEASE);
+#else
+    eh_signal_notify(&ehshell_log_sig_wake);
+#endif
+}
+
+/* 订阅者链表与缓冲区使用同一个锁 */
+static void ehshell_log_wake(eh_event_t *e, void *slot_param){
+    (void)e;
+    (void)slot_param;
+    struct logtail_frame *f;
+    ehshell_lock(&ehshell_log_lock);
+    eh_list_for_each_entry(f, &ehshell_log_subscribers, node)
+        ehshell_command_resume_later(f->cmd_context);
+    ehshell_unlock(&ehshell_log_lock);
+}
+
+#if EHSHELL_THREADED
+static void ehshell_log_wake_poll(void *arg){
+    (void)arg;
+    if(__atomic_exchange_n(&ehshell_log_wake_pending, false, __ATOMIC_ACQ_REL))
+        eh_signal_notify(&ehshell_log_sig_wake);
+}
+#endif
+
+/* 定位到下一条记录，被覆盖的记录计入丢弃数，没有新记录时登记等待 */
+static bool logtail_next(struct logtail_frame *f){
+    uint8_t head[EHSHELL_LOG_HEAD_SIZE];
+    bool has_record;
+    ehshell_lock(&ehshell_log_lock);
+    if((int32_t)(ehshell_log.tail_seq - f->seq) > 0){
+        f->dropped += ehshell_log.tail_seq - f->seq;
+        f->seq = ehshell_log.tail_seq;
+        f->pos = ehshell_log.tail;
+    }
+    has_record = f->pos != ehshell_log.head;
+    if(has_record){
+        ehshell_log_copy_out(f->pos, head, sizeof(head));
+        f->rec_len = (uint16_t)(head[0] | (head[1] << 8));
+        f->level = head[2];
+        f->module_len = head[3];
+    }else{
+        ehshell_log.waiters = true;
+    }
+    ehshell_unlock(&ehshell_log_lock);
+    return has_record;
+}
+
+/* 当前记录是否仍然有效，调用时已持有锁 */
+static bool logtail_valid(struct logtail_frame *f){
+    return (int32_t)(ehshell_log.tail_seq - f->seq) <= 0;
+}
+
+static bool logtail_match(struct logtail_frame *f){
+    char module[EHSHELL_CONFIG_LOG_MODULE_MAX];
+    bool valid;
+    if(f->level > f->max_level)
+        return false;
+    if(f->filter_len == 0)
+        return true;
+    if(f->module_len != f->filter_len)
+        return false;
+    ehshell_lock(&ehshell_log_lock);
+    valid = logtail_valid(f);
+    if(valid)
+        ehshell_log_copy_out(f->pos + EHSHELL_LOG_HEAD_SIZE, module, f->module_len);
+    ehshell_unlock(&ehshell_log_lock);
+    return valid && memcmp(module, f->filter, f->filter_len) == 0;
+}
+
+/* 当前记录是否仍然有效，不持有锁时调用 */
+static bool logtail_check(struct logtail_frame *f){
+    bool valid;
+    ehshell_lock(&ehshell_log_lock);
+    valid = logtail_valid(f);
+    ehshell_unlock(&ehshell_log_lock);
+    return valid;
+}
+
+/**
+ * @brief                   直接从缓冲区按行输出，不为订阅者复制，每行输出前后确认记录没有被覆盖，
+ *                          覆盖发生在一行输出途中时该行可能夹杂新写入的内容，这一行之后停止输出
+ * @return bool             记录在输出途中被覆盖时返回false，已输出的部分以换行结束
+ */
+static bool logtail_write_text(struct logtail_frame *f, uint32_t pos, size_t len){
+    ehshell_cmd_context_t *cmd_context = f->cmd_context;
+    const char *p, *nl;
+    size_t idx, span, n, skip;
+    bool newline_end = true, pending_cr = false, valid = true;
+    while(len){
+        if(!logtail_check(f)){
+            valid = false;
+            break;
+        }
+        idx = pos & EHSHELL_LOG_MASK;
+        span = EHSHELL_CONFIG_LOG_RING_SIZE - idx;
+        if(span > len)
+            span = len;
+        p = (const char *)ehshell_log.buf + idx;
+        /* 上一段末尾的'\r'后面不是'\n'时原样输出 */
+        if(pending_cr && p[0] != '\n')
+            ehshell_command_write(cmd_context, "\r", 1);
+        pending_cr = false;
+        nl = memchr(p, '\n', span);
+        n = nl ? (size_t)(nl - p) : span;
+        skip = n;
+        if(nl && n && p[n - 1] == '\r'){
+            n--;
+        }else if(nl == NULL && n < len && p[n - 1] == '\r'){
+            /* 回绕处的'\r'留给下一段，与后面的'\n'一起转换 */
+            n--;
+            pending_cr = true;
+        }
+        ehshell_command_write(cmd_context, p, n);
+        newline_end = nl != NULL;
+        if(nl){
+            ehshell_command_write(cmd_context, "\r\n", 2);
+            skip++;
+        }
+        pos += (uint32_t)skip;
+        len -= skip;
+    }
+    if(valid && !logtail_check(f))
+        valid = false;
+    if(!newline_end)
+        ehshell_command_write(cmd_context, "\r\n", 2);
+    return valid;
+}
+
+static int logtail_parse_level(const char *str, uint8_t *level){
+    static const char *const names[] = { "err", "warn", "info", "debug" };
+    if(str[0] >= '0' && str[0] <= '3' && str[1] == '\0'){
+        *level = (uint8_t)(str[0] - '0');
+        return EH_RET_OK;
+    }
+    for(size_t i = 0; i < EH_ARRAY_SIZE(names); i++){
+        if(str[0] && strncmp(str, names[i], strlen(str)) == 0){
+            *level = (uint8_t)i;
+            return EH_RET_OK;
+        }
+    }
+    return EH_RET_INVALID_PARAM;
+}
+
+static void do_logtail(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    struct logtail_frame *f;
+    uint8_t max_level = EHSHELL_LOG_LEVEL_DEBUG;
+    const char *module = NULL;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-l") == 0 && i + 1 < argc){
+            if(logtail_parse_level(argv[++i], &max_level) < 0)
+                goto usage;
+        }else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc){
+            module = argv[++i];
+            if(strlen(module) > EHSHELL_CONFIG_LOG_MODULE_MAX)
+                goto usage;
+        }else{
+            goto usage;
+        }
+    }
+    /* 订阅者由主事件循环唤醒，不能跨线程恢复分片中的命令 */
+    if(ehshell_shard_self()){
+        eh_stream_printf(stream, "logtail: not supported in sharded sessions\r\n");
+        goto quit;
+    }
+    f = ehshell_command_co_frame(cmd_context, sizeof(struct logtail_frame));
+    if(f == NULL){
+        eh_stream_printf(stream, "logtail: out of memory\r\n");
+        goto quit;
+    }
+    f->cmd_context = cmd_context;
+    f->max_level = max_level;
+    if(module){
+        f->filter_len = (uint8_t)strlen(module);
+        memcpy(f->filter, module, f->filter_len);
+    }
+    /* 从最旧的记录开始，先输出缓冲区中已有的日志 */
+    ehshell_lock(&ehshell_log_lock);
+    f->pos = ehshell_log.tail;
+    f->seq = ehshell_log.tail_seq;
+    eh_list_add_tail(&f->node, &ehshell_log_subscribers);
+    ehshell_unlock(&ehshell_log_lock);
+    ehshell_command_resume_later(cmd_context);
+    return ;
+usage:
+    eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_logtail_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    struct logtail_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct logtail_frame));
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    size_t text_len;
+    EHSHELL_CO_BEGIN(cmd_context);
+    while(!EHSHELL_CO_CANCELLED(ehshell_event)){
+        EHSHELL_CO_AWAIT(cmd_context, logtail_next(f) || EHSHELL_CO_CANCELLED(ehshell_event));
+        if(EHSHELL_CO_CANCELLED(ehshell_event))
+            break;
+        if(f->dropped != f->reported){
+            eh_stream_printf(stream, "[logtail: %u dropped]\r\n", (unsigned)(f->dropped - f->reported));
+            f->reported = f->dropped;
+        }
+        if(logtail_match(f)){
+            text_len = (size_t)f->rec_len - EHSHELL_LOG_HEAD_SIZE - f->module_len;
+            EHSHELL_CO_AWAIT_WRITABLE(cmd_context, ehshell_event,
+                text_len + 2 > LOGTAIL_WRITABLE_MAX ? LOGTAIL_WRITABLE_MAX : text_len + 2);
+            if(EHSHELL_CO_CANCELLED(ehshell_event))
+                break;
+            /* 等待或输出期间被覆盖的记录由下一次 logtail_next 计入丢弃数 */
+            text_len = (size_t)f->rec_len - EHSHELL_LOG_HEAD_SIZE - f->module_len;
+            if(!logtail_write_text(f, f->pos + EHSHELL_LOG_HEAD_SIZE + f->module_len, text_len))
+                continue;
+        }
+        f->pos += f->rec_len;
+        f->seq++;
+        if((f->count++ + 1) % LOGTAIL_BATCH == 0){
+            eh_stream_finish(stream);
+            EHSHELL_CO_YIELD(cmd_context);
+        }
+    }
+    EHSHELL_CO_END(cmd_context);
+    ehshell_lock(&ehshell_log_lock);
+    eh_list_del_init(&f->node);
+    ehshell_unlock(&ehshell_log_lock);
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static struct ehshell_command_info log_command_info_tbl[] = {
+    {
+        .command = "logtail",
+        .description = "Follow the system log, filtered by level and module.",
+        .usage = "logtail [-l err|warn|info|debug] [-m module]",
+        .flags = 0,
+        .do_function = do_logtail,
+        .do_event_function = do_logtail_event,
+    },
+};
+
+static int __init log_commands_register_init(void){
+    int ret;
+    eh_list_head_init(&ehshell_log_subscribers);
+    eh_signal_init(&ehshell_log_sig_wake);
+    eh_signal_slot_init(&ehshell_log_slot_wake, ehshell_log_wake, NULL);
+    ret = eh_signal_slot_connect(&ehshell_log_sig_wake, &ehshell_log_slot_wake);
+    if(ret < 0){
+        eh_merrfl( EHSHELL,"log wake signal connect failed %d", ret);
+        return ret;
+    }
+#if EHSHELL_THREADED
+    ehshell_log_wake_poll_task.poll_task = ehshell_log_wake_poll;
+    ehshell_log_wake_poll_task.arg = NULL;
+    eh_list_head_init(&ehshell_log_wake_poll_task.list_node);
+    eh_loop_poll_task_add(&ehshell_log_wake_poll_task);
+#endif
+    return ehshell_register_commands(log_command_info_tbl, EH_ARRAY_SIZE(log_command_info_tbl));
+}
+
+static void __exit log_commands_register_exit(void){
+#if EHSHELL_THREADED
+    eh_loop_poll_task_del(&ehshell_log_wake_poll_task);
+#endif
+    eh_signal_slot_disconnect(&ehshell_log_sig_wake, &ehshell_log_slot_wake);
+}
+ehshell_module_command_export(log_commands_register_init, log_commands_register_exit);
@@ -0,0 +1,255 @@
+/**
+ * @file ehshell_machine.c
+ * @brief ehshell 机器模式，帧化的请求/响应协议，帧格式见 ehshell_machine.h
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-16
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_error.h>
+#include <eh_ringbuf.h>
+#include <eh_formatio.h>
+
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+#include <ehshell_machine.h>
+
+struct ehshell_machine{
+    uint16_t    id;                 /* 当前请求ID */
+    uint16_t    out_len;
+    uint16_t    discard;            /* 超长请求剩余待丢弃的字节数 */
+    bool        busy;               /* 当前请求还未发送结束帧 */
+    bool        cancel_sent;
+    char        out[EHSHELL_CONFIG_MACHINE_OUTPUT_CHUNK];
+};
+
+static void ehshell_machine_send_frame(ehshell_t *shell, uint8_t type, uint16_t id, const void *payload, uint16_t len){
+    uint8_t head[EHSHELL_MACHINE_HEADER_SIZE] = {
+        EHSHELL_MACHINE_SYNC, type,
+        (uint8_t)id, (uint8_t)(id >> 8),
+        (uint8_t)len, (uint8_t)(len >> 8),
+    };
+    ehshell_port_write(shell, (const char *)head, sizeof(head));
+    if(len)
+        ehshell_port_write(shell, (const char *)payload, len);
+}
+
+void ehshell_machine_enter(ehshell_t *ehshell){
+    if(!ehshell || ehshell->machine)
+        return ;
+    ehshell->machine_pending = true;
+    if(ehshell_current_command_context(ehshell) == NULL && ehshell->state == EHSHELL_STATE_WAIT_INPUT)
+        ehshell->state = EHSHELL_STATE_RESET;
+    ehshell_notify_processor(ehshell);
+}
+
+int ehshell_machine_start(ehshell_t *shell){
+    struct ehshell_machine *m;
+    shell->machine_pending = false;
+    if(shell->machine)
+        return EH_RET_OK;
+    m = eh_malloc(sizeof(struct ehshell_machine));
+    if(m == NULL)
+        return EH_RET_MALLOC_ERROR;
+    memset(m, 0, sizeof(struct ehshell_machine));
+    shell->machine = m;
+    ehshell_machine_send_frame(shell, EHSHELL_MACHINE_RSP_HELLO, 0,
+        EHSHELL_MACHINE_VERSION, sizeof(EHSHELL_MACHINE_VERSION) - 1);
+    if(shell->config->stream_finish)
+        shell->config->stream_finish(shell);
+    return EH_RET_OK;
+}
+
+void ehshell_machine_stop(ehshell_t *shell){
+    if(shell->machine == NULL)
+        return ;
+    ehshell_machine_flush(shell);
+    eh_free(shell->machine);
+    shell->machine = NULL;
+}
+
+void ehshell_machine_flush(ehshell_t *shell){
+    struct ehshell_machine *m = shell->machine;
+    if(m->out_len == 0)
+        return ;
+    /* 没有请求在执行时(例如后台命令)的输出使用ID 0 */
+    ehshell_machine_send_frame(shell, EHSHELL_MACHINE_RSP_OUTPUT, m->busy ? m->id : 0, m->out, m->out_len);
+    m->out_len = 0;
+}
+
+void ehshell_machine_output(ehshell_t *shell, const char *buf, size_t len){
+    struct ehshell_machine *m = shell->machine;
+    size_t n;
+    while(len){
+        n = sizeof(m->out) - m->out_len;
+        if(n > len)
+            n = len;
+        memcpy(m->out + m->out_len, buf, n);
+        m->out_len = (uint16_t)(m->out_len + n);
+        buf += n;
+        len -= n;
+        if(m->out_len == sizeof(m->out))
+            ehshell_machine_flush(shell);
+    }
+}
+
+void ehshell_machine_command_end(ehshell_t *shell, int status){
+    struct ehshell_machine *m = shell->machine;
+    uint8_t payload[4] = {
+        (uint8_t)status, (uint8_t)((uint32_t)status >> 8),
+        (uint8_t)((uint32_t)status >> 16), (uint8_t)((uint32_t)status >> 24),
+    };
+    if(!m->busy)
+        return ;
+    ehshell_machine_flush(shell);
+    ehshell_machine_send_frame(shell, EHSHELL_MACHINE_RSP_END, m->id, payload, sizeof(payload));
+    if(shell->config->stream_finish)
+        shell->config->stream_finish(shell);
+    m->busy = false;
+    m->cancel_sent = false;
+}
+
+/* 命令执行期间，后续请求留在输入缓冲区中，只向前查找针对当前请求的取消帧 */
+static void ehshell_machine_scan_cancel(ehshell_t *shell){
+    struct ehshell_machine *m = shell->machine;
+    eh_ringbuf_t *ringbuf = shell->input_ringbuf;
+    int32_t size = eh_ringbuf_size(ringbuf);
+    int32_t off = m->discard;
+    uint8_t head[EHSHELL_MACHINE_HEADER_SIZE];
+    if(!m->busy || m->cancel_sent)
+        return ;
+    while(off + EHSHELL_MACHINE_HEADER_SIZE <= size){
+        eh_ringbuf_peek_copy(ringbuf, off, head, EHSHELL_MACHINE_HEADER_SIZE);
+        if(head[0] != EHSHELL_MACHINE_SYNC){
+            off++;
+            continue;
+        }
+        if(head[1] == EHSHELL_MACHINE_REQ_CANCEL && (uint16_t)(head[2] | (head[3] << 8)) == m->id){
+            m->cancel_sent = true;
+            ehshell_command_post_event(&shell->cmd_current, EHSHELL_EVENT_SIGINT_REQUEST_QUIT);
+            return ;
+        }
+        off += EHSHELL_MACHINE_HEADER_SIZE + (head[4] | (head[5] << 8));
+    }
+}
+
+void ehshell_machine_process(ehshell_t *shell){
+    struct ehshell_machine *m = shell->machine;
+    eh_ringbuf_t *ringbuf = shell->input_ringbuf;
+    char *linebuf = ehshell_linebuf(shell);
+    uint8_t head[EHSHELL_MACHINE_HEADER_SIZE];
+    /* 预算可能已被本轮的输出用完，仍至少处理一个请求 */
+    int32_t budget = shell->dispatch_budget > 0 ? shell->dispatch_budget : 1;
+    int32_t size;
+    uint16_t id, len;
+    int ret;
+    for(;;){
+        if(ehshell_current_command_context(shell)){
+            ehshell_machine_scan_cancel(shell);
+            return ;
+        }
+        if(shell->state != EHSHELL_STATE_WAIT_INPUT || shell->machine != m)
+            return ;
+        size = eh_ringbuf_size(ringbuf);
+        if(m->discard){
+            if(size == 0)
+                break;
+            size = size < m->discard ? size : m->discard;
+            eh_ringbuf_read_skip(ringbuf, size);
+            m->discard = (uint16_t)(m->discard - size);
+            continue;
+        }
+        if(budget <= 0){
+            /* 本轮预算用完，剩余请求排队等待下一轮调度 */
+            ehshell_notify_processor(shell);
+            return ;
+        }
+        if(size < EHSHELL_MACHINE_HEADER_SIZE)
+            break;
+        eh_ringbuf_peek_copy(ringbuf, 0, head, EHSHELL_MACHINE_HEADER_SIZE);
+        if(head[0] != EHSHELL_MACHINE_SYNC){
+            /* 重新同步 */
+            eh_ringbuf_read_skip(ringbuf, 1);
+            budget--;
+            continue;
+        }
+        id = (uint16_t)(head[2] | (head[3] << 8));
+        len = (uint16_t)(head[4] | (head[5] << 8));
+        if(len >= shell->config->input_linebuf_size){
+            eh_ringbuf_read_skip(ringbuf, EHSHELL_MACHINE_HEADER_SIZE);
+            m->discard = len;
+            m->id = id;
+            m->busy = true;
+            ehshell_machine_command_end(shell, EH_RET_INVALID_PARAM);
+            continue;
+        }
+        if(size < EHSHELL_MACHINE_HEADER_SIZE + len)
+            break;
+        eh_ringbuf_peek_copy(ringbuf, EHSHELL_MACHINE_HEADER_SIZE, (uint8_t *)linebuf, len);
+        eh_ringbuf_read_skip(ringbuf, EHSHELL_MACHINE_HEADER_SIZE + len);
+        linebuf[len] = '\0';
+        budget -= EHSHELL_MACHINE_HEADER_SIZE + len;
+        switch(head[1]){
+            case EHSHELL_MACHINE_REQ_EXEC:
+                m->id = id;
+                m->busy = true;
+                m->cancel_sent = false;
+                ret = _ehshell_command_run_form_string(shell, linebuf);
+                /* 执行失败、后台命令或者命令已经同步结束 */
+                if(ehshell_current_command_context(shell) == NULL){
+                    ehshell_machine_command_end(shell, ret < 0 ? ret : 0);
+                    /* 机器模式的复位没有提示符要打印，直接继续处理后续请求 */
+                    if(shell->state == EHSHELL_STATE_RESET)
+                        shell->state = EHSHELL_STATE_WAIT_INPUT;
+                }
+                break;
+            case EHSHELL_MACHINE_REQ_EXIT:
+                m->id = id;
+                m->busy = true;
+                ehshell_machine_command_end(shell, 0);
+                ehshell_machine_stop(shell);
+                shell->state = EHSHELL_STATE_RESET;
+                ehshell_notify_processor(shell);
+                return ;
+            default:
+                /* 没有命令在执行时的取消请求，以及未知请求，直接丢弃 */
+                break;
+        }
+        /* 命令的输出同样计入预算 */
+        if(shell->dispatch_budget < budget)
+            budget = shell->dispatch_budget;
+    }
+    /* 输入不足一帧，让端口继续填充输入缓冲区 */
+    if(shell->config->input_ringbuf_process_finish)
+        shell->config->input_ringbuf_process_finish(shell);
+}
+
+static void do_machine(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    (void)argc;
+    (void)argv;
+    ehshell_machine_enter(ehshell_command_get_shell(cmd_context));
+    ehshell_command_finish(cmd_context);
+}
+
+static struct ehshell_command_info machine_command_info_tbl[] = {
+    {
+        .command = "machine",
+        .description = "Switch the session to framed machine mode.",
+        .usage = "machine",
+        .flags = 0,
+        .do_function = do_machine,
+        .do_event_function = NULL,
+    },
+};
+
+static int __init machine_commands_register_init(void){
+    return ehshell_register_commands(machine_command_info_tbl, EH_ARRAY_SIZE(machine_command_info_tbl));
+}
+ehshell_module_command_export(machine_commands_register_init, NULL);
@@ -0,0 +1,296 @@
+/**
+ * @file ehshell_mirror.c
+ * @brief 会话镜像，端口输出追加到正在填充的共享段，输出结束时段以引用的方式放入每个输出端的队列，
+ *        之后的输出继续追加到同一段直到写满，逐字符回显不会每次占用一段和一个队列位置，
+ *        最后一个引用释放时回收
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-06
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_list.h>
+#include <eh_error.h>
+#include <eh_debug.h>
+#include <eh_formatio.h>
+
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+#include <ehshell_mirror.h>
+
+/* 引用计数只在shell所在任务中修改，
+ * 输出结束时填充中的段就放入输出端队列，之后的输出继续追加到同一段，写满后才换新段 */
+struct ehshell_mirror_seg{
+    uint16_t                ref;
+    uint16_t                len;
+    bool                    is_queued;
+    char                    buf[EHSHELL_CONFIG_MIRROR_SEG_SIZE];
+};
+
+static void ehshell_mirror_seg_put(struct ehshell_mirror_seg *seg){
+    if(--seg->ref == 0)
+        eh_free(seg);
+}
+
+static void ehshell_sink_drop_all(struct ehshell_sink *sink){
+    while(sink->count){
+        ehshell_mirror_seg_put(sink->queue[sink->head]);
+        sink->head = (uint16_t)((sink->head + 1) % EHSHELL_CONFIG_MIRROR_SINK_QUEUE);
+        sink->count--;
+    }
+    sink->offset = 0;
+}
+
+static void ehshell_sink_remove(struct ehshell_sink *sink){
+    ehshell_sink_drop_all(sink);
+    eh_list_del_init(&sink->node);
+    __atomic_store_n(&sink->shell, NULL, __ATOMIC_RELEASE);
+}
+
+/* 段是否排在该输出端队尾，即追加的数据该输出端也能收到 */
+static bool ehshell_sink_has_tail(struct ehshell_sink *sink, struct ehshell_mirror_seg *seg){
+    uint16_t tail;
+    if(sink->count == 0)
+        return false;
+    tail = (uint16_t)((sink->head + sink->count - 1) % EHSHELL_CONFIG_MIRROR_SINK_QUEUE);
+    return sink->queue[tail] == seg;
+}
+
+/**
+ * @brief                   尽可能多地写出队列中的数据
+ * @return int              输出端出错被移除时返回负数
+ */
+static int ehshell_sink_pump(struct ehshell_sink *sink){
+    struct ehshell_mirror_seg *seg;
+    int ret;
+    while(sink->count){
+        seg = sink->queue[sink->head];
+        if(sink->offset < seg->len){
+            ret = sink->write(sink, seg->buf + sink->offset, (size_t)(seg->len - sink->offset));
+            if(ret < 0){
+                eh_mwarnfl(EHSHELL, "%s mirror sink %s write failed %d, detached", sink->shell->config->host,
+                    sink->name ? sink->name : "?", ret);
+                ehshell_sink_remove(sink);
+                return ret;
+            }
+            if(ret > seg->len - sink->offset)
+                ret = seg->len - sink->offset;
+            sink->offset = (uint16_t)(sink->offset + ret);
+            sink->delivered += (uint64_t)ret;
+            /* 传输层暂时写不下，等待 ehshell_sink_ready */
+            if(sink->offset < seg->len)
+                return 0;
+        }
+        /* 仍在填充的段留在队首，追加的数据从当前位置继续发送 */
+        if(seg == sink->shell->mirror_seg)
+            return 0;
+        sink->head = (uint16_t)((sink->head + 1) % EHSHELL_CONFIG_MIRROR_SINK_QUEUE);
+        sink->count--;
+        sink->offset = 0;
+        ehshell_mirror_seg_put(seg);
+    }
+    return 0;
+}
+
+/* 填充中的段第一次分发时放入所有输出端的队列，队列已满的输出端丢弃整段 */
+static void ehshell_mirror_enqueue(ehshell_t *shell, struct ehshell_mirror_seg *seg){
+    struct ehshell_sink *sink;
+    uint16_t tail;
+    if(seg->is_queued)
+        return ;
+    seg->is_queued = true;
+    eh_list_for_each_entry(sink, &shell->sinks, node){
+        if(sink->count >= EHSHELL_CONFIG_MIRROR_SINK_QUEUE){
+            sink->dropped += seg->len;
+            continue;
+        }
+        tail = (uint16_t)((sink->head + sink->count) % EHSHELL_CONFIG_MIRROR_SINK_QUEUE);
+        sink->queue[tail] = seg;
+        sink->count++;
+        seg->ref++;
+    }
+}
+
+static void ehshell_mirror_pump_all(ehshell_t *shell){
+    struct ehshell_sink *sink, *n;
+    eh_list_for_each_entry_safe(sink, n, &shell->sinks, node)
+        ehshell_sink_pump(sink);
+}
+
+/* 封口当前段，不再追加，输出端写完后即可释放 */
+static void ehshell_mirror_seal(ehshell_t *shell){
+    struct ehshell_mirror_seg *seg = shell->mirror_seg;
+    if(seg == NULL)
+        return ;
+    ehshell_mirror_enqueue(shell, seg);
+    shell->mirror_seg = NULL;
+    ehshell_mirror_pump_all(shell);
+    /* 释放填充时持有的引用 */
+    ehshell_mirror_seg_put(seg);
+}
+
+void ehshell_mirror_output(ehshell_t *shell, const char *buf, size_t len){
+    struct ehshell_mirror_seg *seg;
+    struct ehshell_sink *sink;
+    size_t n;
+    while(len){
+        seg = shell->mirror_seg;
+        if(seg == NULL){
+            seg = eh_malloc(sizeof(struct ehshell_mirror_seg));
+            if(seg == NULL){
+                eh_list_for_each_entry(sink, &shell->sinks, node)
+                    sink->dropped += len;
+                return ;
+            }
+            seg->ref = 1;
+            seg->len = 0;
+            seg->is_queued = false;
+            shell->mirror_seg = seg;
+        }
+        n = EHSHELL_CONFIG_MIRROR_SEG_SIZE - seg->len;
+        if(n > len)
+            n = len;
+        memcpy(seg->buf + seg->len, buf, n);
+        seg->len = (uint16_t)(seg->len + n);
+        /* 已分发的段继续追加，当时队列已满的输出端同样丢弃追加部分 */
+        if(seg->is_queued){
+            eh_list_for_each_entry(sink, &shell->sinks, node){
+                if(!ehshell_sink_has_tail(sink, seg))
+                    sink->dropped += n;
+            }
+        }
+        buf += n;
+        len -= n;
+        if(seg->len == EHSHELL_CONFIG_MIRROR_SEG_SIZE)
+            ehshell_mirror_seal(shell);
+    }
+}
+
+void ehshell_mirror_flush(ehshell_t *shell){
+    if(shell->mirror_seg == NULL || shell->mirror_seg->len == 0)
+        return ;
+    ehshell_mirror_enqueue(shell, shell->mirror_seg);
+    ehshell_mirror_pump_all(shell);
+}
+
+void ehshell_mirror_destroy(ehshell_t *shell){
+    struct ehshell_sink *sink, *n;
+    eh_list_for_each_entry_safe(sink, n, &shell->sinks, node)
+        ehshell_sink_remove(sink);
+    if(shell->mirror_seg){
+        ehshell_mirror_seg_put(shell->mirror_seg);
+        shell->mirror_seg = NULL;
+    }
+}
+
+int ehshell_sink_attach(ehshell_t *ehshell, struct ehshell_sink *sink){
+    if(!ehshell || !sink || !sink->write)
+        return EH_RET_INVALID_PARAM;
+    if(sink->shell)
+        return EH_RET_EXISTS;
+    /* 已填充的部分属于附加之前的输出，封口后新的输出端从新段开始 */
+    if(ehshell->mirror_seg && ehshell->mirror_seg->len)
+        ehshell_mirror_seal(ehshell);
+    sink->head = 0;
+    sink->count = 0;
+    sink->offset = 0;
+    sink->delivered = 0;
+    sink->dropped = 0;
+    eh_list_add_tail(&sink->node, &ehshell->sinks);
+    __atomic_store_n(&sink->shell, ehshell, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void ehshell_sink_detach(struct ehshell_sink *sink){
+    if(!sink || !sink->shell)
+        return ;
+    ehshell_sink_remove(sink);
+}
+
+void ehshell_sink_ready(struct ehshell_sink *sink){
+    if(!sink || !sink->shell)
+        return ;
+    ehshell_sink_pump(sink);
+}
+
+int ehshell_sink_input(struct ehshell_sink *sink, const void *buf, size_t len){
+    ehshell_t *shell;
+    if(!sink)
+        return EH_RET_INVALID_PARAM;
+    if(!(sink->flags & EHSHELL_SINK_FLAG_INPUT))
+        return EH_RET_NOT_SUPPORTED;
+    shell = __atomic_load_n(&sink->shell, __ATOMIC_ACQUIRE);
+    if(!shell)
+        return EH_RET_INVALID_STATE;
+    return ehshell_input_write(shell, buf, len);
+}
+
+/* 每次输出都可能移除出错的输出端，先复制统计再打印 */
+#define EHSHELL_MIRROR_LIST_MAX         16
+
+struct mirror_row{
+    const char *name;
+    uint32_t    flags;
+    uint16_t    count;
+    uint64_t    delivered;
+    uint64_t    dropped;
+};
+
+static void do_mirror(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    ehshell_t *shell = ehshell_command_get_shell(cmd_context);
+    struct mirror_row rows[EHSHELL_MIRROR_LIST_MAX];
+    struct ehshell_sink *sink;
+    size_t n = 0, more = 0;
+    (void)argc;
+    (void)argv;
+    if(shell == NULL){
+        eh_stream_printf(stream, "mirror: no session\r\n");
+        goto quit;
+    }
+    eh_list_for_each_entry(sink, &shell->sinks, node){
+        if(n >= EHSHELL_MIRROR_LIST_MAX){
+            more++;
+            continue;
+        }
+        rows[n].name = sink->name ? sink->name : "?";
+        rows[n].flags = sink->flags;
+        rows[n].count = sink->count;
+        rows[n].delivered = sink->delivered;
+        rows[n].dropped = sink->dropped;
+        n++;
+    }
+    eh_stream_printf(stream, "%-16s %5s %6s %12s %12s\r\n", "sink", "mode", "queued", "delivered", "dropped");
+    for(size_t i = 0; i < n; i++){
+        eh_stream_printf(stream, "%-16s %5s %6u %12llu %12llu\r\n", rows[i].name,
+            (rows[i].flags & EHSHELL_SINK_FLAG_INPUT) ? "rw" : "ro", (unsigned)rows[i].count,
+            (unsigned long long)rows[i].delivered, (unsigned long long)rows[i].dropped);
+    }
+    if(more)
+        eh_stream_printf(stream, "... %u more\r\n", (unsigned)more);
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static struct ehshell_command_info mirror_command_info_tbl[] = {
+    {
+        .command = "mirror",
+        .description = "Show output sinks attached to this session.",
+        .usage = "mirror",
+        .flags = 0,
+        .do_function = do_mirror,
+        .do_event_function = NULL,
+    },
+};
+
+static int __init mirror_commands_register_init(void){
+    return ehshell_register_commands(mirror_command_info_tbl, EH_ARRAY_SIZE(mirror_command_info_tbl));
+}
+ehshell_module_command_export(mirror_commands_register_init, NULL);
@@ -0,0 +1,87 @@
+/**
+ * @file ehshell_recorder.c
+ * @brief ehshell 会话录制，输入在调度器处理前从输入缓冲区中取出新到达的数据，
+ *        输出在写入端口前记录，格式见 ehshell_recorder.h
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-24
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_error.h>
+#include <eh_ringbuf.h>
+
+#include <ehshell.h>
+#include <ehshell_internal.h>
+#include <ehshell_recorder.h>
+
+#define EHSHELL_RECORDER_HEAD_MAX   (1 + 10 + 10)
+
+static uint8_t *ehshell_recorder_put_varint(uint8_t *p, uint64_t v){
+    while(v >= 0x80){
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static void ehshell_recorder_record(struct ehshell_recorder *recorder, uint8_t type, const void *buf, size_t len){
+    uint8_t head[EHSHELL_RECORDER_HEAD_MAX];
+    uint8_t *p = head;
+    eh_clock_t now = eh_get_clock_monotonic_time();
+    *p++ = type;
+    p = ehshell_recorder_put_varint(p, (uint64_t)eh_clock_to_usec(now - recorder->last_time));
+    p = ehshell_recorder_put_varint(p, len);
+    recorder->last_time = now;
+    recorder->write(recorder, head, (size_t)(p - head));
+    recorder->write(recorder, buf, len);
+}
+
+void ehshell_recorder_output(ehshell_t *shell, const char *buf, size_t len){
+    if(len)
+        ehshell_recorder_record(shell->recorder, EHSHELL_RECORDER_TYPE_OUTPUT, buf, len);
+}
+
+void ehshell_recorder_input(ehshell_t *shell){
+    eh_ringbuf_t peek_ringbuf = *shell->input_ringbuf;
+    const uint8_t *buf;
+    int32_t size, rl;
+    /* 记录位置之后、写指针之前的数据是上次调度以来新到达的输入 */
+    peek_ringbuf.r = shell->record_input_pos;
+    size = eh_ringbuf_size(&peek_ringbuf);
+    while(size > 0){
+        rl = 0;
+        buf = eh_ringbuf_peek(&peek_ringbuf, 0, NULL, &rl);
+        if(buf == NULL || rl <= 0)
+            break;
+        ehshell_recorder_record(shell->recorder, EHSHELL_RECORDER_TYPE_INPUT, buf, (size_t)rl);
+        eh_ringbuf_read_skip(&peek_ringbuf, rl);
+        size -= rl;
+    }
+    shell->record_input_pos = peek_ringbuf.r;
+}
+
+int ehshell_recorder_attach(ehshell_t *ehshell, struct ehshell_recorder *recorder){
+    static const uint8_t head[] = {
+        EHSHELL_RECORDER_MAGIC[0], EHSHELL_RECORDER_MAGIC[1], EHSHELL_RECORDER_MAGIC[2], EHSHELL_RECORDER_MAGIC[3],
+        EHSHELL_RECORDER_VERSION,
+    };
+    if(!ehshell || !recorder || !recorder->write)
+        return EH_RET_INVALID_PARAM;
+    recorder->last_time = eh_get_clock_monotonic_time();
+    recorder->write(recorder, head, sizeof(head));
+    ehshell->record_input_pos = ehshell->input_ringbuf->w;
+    ehshell->recorder = recorder;
+    return EH_RET_OK;
+}
+
+void ehshell_recorder_detach(ehshell_t *ehshell){
+    if(!ehshell)
+        return ;
+    ehshell->recorder = NULL;
+}
@@ -0,0 +1,319 @@
+/**
+ * @file ehshell_script.c
+ * @brief 预编译脚本解释器，解释器从静态池中分配，命令的执行上下文嵌在解释器中，
+ *        参数直接指向字节码中的字符串池，执行过程中不分配内存，
+ *        命令同步结束时在同一个循环中继续取指，异步命令结束后从done回调恢复，
+ *        每轮最多执行 EHSHELL_CONFIG_SCRIPT_STEP_BUDGET 条指令，之后通过信号在下一轮继续
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-04
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_error.h>
+#include <eh_debug.h>
+#include <eh_signal.h>
+
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+#include <ehshell_exec.h>
+#include <ehshell_script.h>
+
+struct ehshell_script_runner{
+    struct ehshell_exec                 exec;
+    struct ehshell_exec_request         request;
+    struct ehshell_script              *script;     /* 为NULL时空闲 */
+    const uint8_t                      *refs;
+    const uint8_t                      *code;
+    const char                         *strs;
+    uint16_t                            ref_count;
+    uint16_t                            code_len;
+    uint16_t                            str_len;
+    uint16_t                            pc;
+    int                                 status;
+    bool                                is_stepping;
+    bool                                is_waiting;     /* 命令异步执行中 */
+    bool                                is_cancelled;
+    bool                                is_yielded;     /* 预算用完，等待下一轮调度 */
+    /* 命令解析缓存，命令表快照变化后重新解析 */
+    const struct ehshell_command_table *table;
+    const struct ehshell_command_info  *resolved[EHSHELL_CONFIG_SCRIPT_REFS_MAX];
+    uint16_t                            counters[EHSHELL_CONFIG_SCRIPT_LOOP_DEPTH];
+    const char                         *argv[EHSHELL_CONFIG_ARGC_MAX];
+};
+
+static struct ehshell_script_runner s_script_runners[EHSHELL_CONFIG_SCRIPT_RUNNERS];
+static eh_signal_base_t ehshell_script_sig_resume;
+static eh_signal_slot_t ehshell_script_slot_resume;
+
+static void ehshell_script_step(struct ehshell_script_runner *runner);
+
+static inline uint16_t ehshell_script_u16(const uint8_t *p){
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static const char *ehshell_script_ref_name(struct ehshell_script_runner *runner, uint16_t ref){
+    return runner->strs + ehshell_script_u16(runner->refs + ref * 2);
+}
+
+/* 命令名和命令表都按字典序排列，一次归并完成全部解析 */
+static void ehshell_script_resolve(struct ehshell_script_runner *runner){
+    const struct ehshell_command_table *table = ehshell_command_snapshot();
+    size_t n = runner->ref_count < EHSHELL_CONFIG_SCRIPT_REFS_MAX ? runner->ref_count : EHSHELL_CONFIG_SCRIPT_REFS_MAX;
+    size_t pos = 0;
+    const char *name;
+    int cmp = -1;
+    runner->table = table;
+    for(size_t i = 0; i < n; i++){
+        name = ehshell_script_ref_name(runner, (uint16_t)i);
+        runner->resolved[i] = NULL;
+        while(pos < table->count && (cmp = strcmp(table->commands[pos]->command, name)) < 0)
+            pos++;
+        if(pos < table->count && cmp == 0)
+            runner->resolved[i] = table->commands[pos];
+    }
+}
+
+static const struct ehshell_command_info *ehshell_script_command(struct ehshell_script_runner *runner, uint16_t ref){
+    const struct ehshell_command_info *command_info;
+    if(runner->table != ehshell_command_snapshot())
+        ehshell_script_resolve(runner);
+    if(ref < EHSHELL_CONFIG_SCRIPT_REFS_MAX && runner->resolved[ref])
+        return runner->resolved[ref];
+    /* 超出缓存或者启动时还没有注册的命令按名称查找 */
+    runner->script->lookups++;
+    command_info = ehshell_command_lookup(ehshell_script_ref_name(runner, ref));
+    if(command_info && ref < EHSHELL_CONFIG_SCRIPT_REFS_MAX)
+        runner->resolved[ref] = command_info;
+    return command_info;
+}
+
+static void ehshell_script_finish(struct ehshell_script_runner *runner, int status){
+    struct ehshell_script *script = runner->script;
+    script->output_len = runner->request.output_len;
+    script->dropped = runner->request.dropped;
+    script->runner = NULL;
+    runner->script = NULL;
+    runner->is_stepping = false;
+    if(script->done)
+        script->done(script, status);
+}
+
+static void ehshell_script_exec_done(struct ehshell_exec_request *request, int status){
+    struct ehshell_script_runner *runner = request->user_data;
+    runner->status = status;
+    runner->is_waiting = false;
+    if(!runner->is_stepping)
+        ehshell_script_step(runner);
+}
+
+/**
+ * @brief                   执行RUN指令，命令启动后pc已经指向下一条指令
+ * @return int              指令越界返回负数
+ */
+static int ehshell_script_op_run(struct ehshell_script_runner *runner, const uint8_t *ins, uint16_t avail){
+    const struct ehshell_command_info *command_info;
+    const char **argv = runner->argv;
+    uint16_t ref, off;
+    int argc, ret;
+    if(avail < 4)
+        return EH_RET_INVALID_PARAM;
+    ref = ehshell_script_u16(ins + 1);
+    argc = ins[3];
+    if(ref >= runner->ref_count || argc == 0 || argc > EHSHELL_CONFIG_ARGC_MAX || avail < 4 + argc * 2)
+        return EH_RET_INVALID_PARAM;
+    for(int i = 0; i < argc; i++){
+        off = ehshell_script_u16(ins + 4 + i * 2);
+        if(off >= runner->str_len)
+            return EH_RET_INVALID_PARAM;
+        argv[i] = runner->strs + off;
+    }
+    runner->pc = (uint16_t)(runner->pc + 4 + argc * 2);
+    command_info = ehshell_script_command(runner, ref);
+    if(command_info)
+        command_info = ehshell_command_descend(command_info, &argc, &argv);
+    if(!command_info || !command_info->do_function){
+        eh_mwarnfl(EHSHELL, "script: %s: command not found", runner->argv[0]);
+        runner->status = EH_RET_NOT_EXISTS;
+        return 0;
+    }
+    runner->script->commands++;
+    /* 命令可能在启动过程中同步结束 */
+    runner->is_waiting = true;
+    ret = ehshell_exec_start_static(&runner->request, &runner->exec, command_info, argc, argv);
+    if(ret < 0){
+        eh_mwarnfl(EHSHELL, "script: %s: start failed %d", runner->argv[0], ret);
+        runner->is_waiting = false;
+        runner->status = ret;
+    }
+    return 0;
+}
+
+static void ehshell_script_step(struct ehshell_script_runner *runner){
+    const uint8_t *ins;
+    uint16_t avail, target;
+    uint32_t budget = EHSHELL_CONFIG_SCRIPT_STEP_BUDGET;
+    int ret;
+    runner->is_stepping = true;
+    while(!runner->is_waiting){
+        if(runner->is_cancelled || runner->pc >= runner->code_len){
+            ehshell_script_finish(runner, runner->status);
+            return ;
+        }
+        /* 同步命令组成的循环不能一直占用事件循环 */
+        if(budget-- == 0){
+            runner->is_yielded = true;
+            eh_signal_notify(&ehshell_script_sig_resume);
+            break;
+        }
+        ins = runner->code + runner->pc;
+        avail = (uint16_t)(runner->code_len - runner->pc);
+        ret = 0;
+        switch(ins[0]){
+            case EHSHELL_SCRIPT_OP_END:
+                ehshell_script_finish(runner, runner->status);
+                return ;
+            case EHSHELL_SCRIPT_OP_RUN:
+                ret = ehshell_script_op_run(runner, ins, avail);
+                break;
+            case EHSHELL_SCRIPT_OP_JMP:
+            case EHSHELL_SCRIPT_OP_JZ:
+            case EHSHELL_SCRIPT_OP_JNZ:
+                if(avail < 3){
+                    ret = EH_RET_INVALID_PARAM;
+                    break;
+                }
+                target = ehshell_script_u16(ins + 1);
+                if(ins[0] == EHSHELL_SCRIPT_OP_JMP ||
+                    (ins[0] == EHSHELL_SCRIPT_OP_JZ) == (runner->status == 0))
+                    runner->pc = target;
+                else
+                    runner->pc = (uint16_t)(runner->pc + 3);
+                break;
+            case EHSHELL_SCRIPT_OP_SETCNT:
+            case EHSHELL_SCRIPT_OP_LOOP:
+                if(avail < 4 || ins[1] >= EHSHELL_CONFIG_SCRIPT_LOOP_DEPTH){
+                    ret = EH_RET_INVALID_PARAM;
+                    break;
+                }
+                if(ins[0] == EHSHELL_SCRIPT_OP_SETCNT){
+                    runner->counters[ins[1]] = ehshell_script_u16(ins + 2);
+                    runner->pc = (uint16_t)(runner->pc + 4);
+                }else if(runner->counters[ins[1]] == 0){
+                    runner->pc = ehshell_script_u16(ins + 2);
+                }else{
+                    runner->counters[ins[1]]--;
+                    runner->pc = (uint16_t)(runner->pc + 4);
+                }
+                break;
+            default:
+                ret = EH_RET_INVALID_PARAM;
+                break;
+        }
+        if(ret < 0){
+            eh_merrfl(EHSHELL, "script: bad instruction 0x%02x at %u", ins[0], (unsigned)runner->pc);
+            ehshell_script_finish(runner, ret);
+            return ;
+        }
+    }
+    runner->is_stepping = false;
+}
+
+static void ehshell_script_resume(eh_event_t *e, void *slot_param){
+    (void)e;
+    (void)slot_param;
+    for(size_t i = 0; i < EHSHELL_CONFIG_SCRIPT_RUNNERS; i++){
+        if(s_script_runners[i].script == NULL || !s_script_runners[i].is_yielded)
+            continue;
+        s_script_runners[i].is_yielded = false;
+        ehshell_script_step(&s_script_runners[i]);
+    }
+}
+
+int ehshell_script_run(struct ehshell_script *script){
+    struct ehshell_script_runner *runner = NULL;
+    const uint8_t *blob;
+    uint16_t ref_count, code_len, str_len;
+    if(!script || !script->blob || script->size < EHSHELL_SCRIPT_HEADER_SIZE)
+        return EH_RET_INVALID_PARAM;
+    /* 运行槽和续跑信号只属于主循环 */
+    if(ehshell_shard_self())
+        return EH_RET_NOT_SUPPORTED;
+    blob = script->blob;
+    if(memcmp(blob, EHSHELL_SCRIPT_MAGIC, 4) != 0 || blob[4] != EHSHELL_SCRIPT_VERSION ||
+        blob[5] > EHSHELL_CONFIG_SCRIPT_LOOP_DEPTH)
+        return EH_RET_NOT_SUPPORTED;
+    ref_count = ehshell_script_u16(blob + 6);
+    code_len = ehshell_script_u16(blob + 8);
+    str_len = ehshell_script_u16(blob + 10);
+    if((size_t)EHSHELL_SCRIPT_HEADER_SIZE + ref_count * 2U + code_len + str_len > script->size)
+        return EH_RET_INVALID_PARAM;
+    /* 字符串池以'\0'结尾，池内任意偏移都是有效的字符串 */
+    if(str_len == 0 || blob[EHSHELL_SCRIPT_HEADER_SIZE + ref_count * 2U + code_len + str_len - 1] != '\0')
+        return EH_RET_INVALID_PARAM;
+    for(uint16_t i = 0; i < ref_count; i++){
+        if(ehshell_script_u16(blob + EHSHELL_SCRIPT_HEADER_SIZE + i * 2) >= str_len)
+            return EH_RET_INVALID_PARAM;
+    }
+    for(size_t i = 0; i < EHSHELL_CONFIG_SCRIPT_RUNNERS; i++){
+        if(s_script_runners[i].script == NULL){
+            runner = &s_script_runners[i];
+            break;
+        }
+    }
+    if(runner == NULL)
+        return EH_RET_BUSY;
+    memset(runner, 0, sizeof(struct ehshell_script_runner));
+    runner->script = script;
+    runner->refs = blob + EHSHELL_SCRIPT_HEADER_SIZE;
+    runner->code = runner->refs + ref_count * 2;
+    runner->strs = (const char *)runner->code + code_len;
+    runner->ref_count = ref_count;
+    runner->code_len = code_len;
+    runner->str_len = str_len;
+    runner->request.output = script->output;
+    runner->request.done = ehshell_script_exec_done;
+    runner->request.user_data = runner;
+    for(struct ehshell_exec_segment *seg = script->output; seg; seg = seg->next)
+        seg->len = 0;
+    script->output_len = 0;
+    script->dropped = 0;
+    script->commands = 0;
+    script->lookups = 0;
+    script->runner = runner;
+    ehshell_script_resolve(runner);
+    ehshell_script_step(runner);
+    return 0;
+}
+
+void ehshell_script_cancel(struct ehshell_script *script){
+    struct ehshell_script_runner *runner;
+    if(!script || !script->runner)
+        return ;
+    runner = script->runner;
+    runner->is_cancelled = true;
+    if(runner->is_waiting)
+        ehshell_exec_cancel(&runner->request);
+}
+
+static int __init ehshell_script_init(void){
+    int ret;
+    eh_signal_init(&ehshell_script_sig_resume);
+    eh_signal_slot_init(&ehshell_script_slot_resume, ehshell_script_resume, NULL);
+    ret = eh_signal_slot_connect(&ehshell_script_sig_resume, &ehshell_script_slot_resume);
+    if(ret < 0){
+        eh_merrfl(EHSHELL, "script resume signal connect failed %d", ret);
+        return ret;
+    }
+    return 0;
+}
+
+static void __exit ehshell_script_exit(void){
+    eh_signal_slot_disconnect(&ehshell_script_sig_resume, &ehshell_script_slot_resume);
+}
+ehshell_module_core_export(ehshell_script_init, ehshell_script_exit);
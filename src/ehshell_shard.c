@@ -0,0 +1,294 @@
+/**
+ * @file ehshell_shard.c
+ * @brief shell会话分片，每个分片是一个独立线程，有自己的就绪队列和时间轮，
+ *        分片之间只共享只读的命令注册表快照，会话状态不跨线程访问，
+ *        日志环、卡顿记录和堆跟踪表由 ehshell_lock_t 互斥，
+ *        无终端执行和logtail的恢复只在主事件循环中调度，分片线程中拒绝使用
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-01
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <eh.h>
+#include <eh_error.h>
+#include <eh_debug.h>
+#include <eh_list.h>
+#include <eh_formatio.h>
+
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+#include <ehshell_coroutine.h>
+#include <ehshell_shard.h>
+
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+
+#include <pthread.h>
+
+struct ehshell_shard{
+    pthread_t                   thread;
+    pthread_mutex_t             lock;
+    pthread_cond_t              cond;
+    struct eh_list_head         ready_list;
+    struct ehshell_timer_wheel *wheel;
+    uint32_t                    sessions;
+    bool                        is_exit;
+    /* 统计，其他线程可以随时读取 */
+    uint64_t                    dispatches;
+    uint64_t                    busy_us;
+};
+
+static struct ehshell_shard s_shards[CONFIG_PACKAGE_EHSHELL_SHARD_NUM];
+static size_t s_shard_started;
+static size_t s_shard_limit;
+static pthread_mutex_t s_shard_assign_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct ehshell_shard *s_shard_self;
+
+static uint64_t ehshell_shard_now_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+}
+
+/* 没有就绪的shell时睡眠到下一个定时器到期点 */
+static void ehshell_shard_wait(struct ehshell_shard *shard, uint32_t timeout_ms){
+    struct timespec ts;
+    if(timeout_ms == UINT32_MAX){
+        pthread_cond_wait(&shard->cond, &shard->lock);
+        return ;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if(ts.tv_nsec >= 1000000000L){
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&shard->cond, &shard->lock, &ts);
+}
+
+static void *ehshell_shard_thread(void *arg){
+    struct ehshell_shard *shard = arg;
+    ehshell_t *shell;
+    uint32_t timeout_ms;
+    uint64_t start;
+    s_shard_self = shard;
+    ehshell_timer_wheel_bind(shard->wheel);
+    for(;;){
+        /* 定时器回调可能通知shell就绪，要在检查就绪队列之前处理 */
+        timeout_ms = ehshell_timer_wheel_poll(shard->wheel);
+        pthread_mutex_lock(&shard->lock);
+        if(shard->is_exit){
+            pthread_mutex_unlock(&shard->lock);
+            break;
+        }
+        if(eh_list_empty(&shard->ready_list)){
+            ehshell_shard_wait(shard, timeout_ms);
+            pthread_mutex_unlock(&shard->lock);
+            continue;
+        }
+        /* 一次只取一个，重新就绪的shell排到队尾，分片内按轮转方式服务 */
+        shell = eh_list_entry(shard->ready_list.next, ehshell_t, ready_node);
+        eh_list_del_init(&shell->ready_node);
+        pthread_mutex_unlock(&shard->lock);
+        start = ehshell_shard_now_us();
+        ehshell_dispatch(shell);
+        __atomic_fetch_add(&shard->busy_us, ehshell_shard_now_us() - start, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&shard->dispatches, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+bool ehshell_shard_self(void){
+    return s_shard_self != NULL;
+}
+
+bool ehshell_shard_running(void){
+    return s_shard_started > 0;
+}
+
+struct ehshell_shard *ehshell_shard_assign(void){
+    struct ehshell_shard *best = NULL;
+    size_t limit;
+    pthread_mutex_lock(&s_shard_assign_lock);
+    limit = s_shard_limit && s_shard_limit < s_shard_started ? s_shard_limit : s_shard_started;
+    for(size_t i = 0; i < limit; i++){
+        if(best == NULL || s_shards[i].sessions < best->sessions)
+            best = &s_shards[i];
+    }
+    if(best)
+        __atomic_fetch_add(&best->sessions, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&s_shard_assign_lock);
+    return best;
+}
+
+void ehshell_shard_release(ehshell_t *shell){
+    struct ehshell_shard *shard = shell->shard;
+    pthread_mutex_lock(&shard->lock);
+    if(!eh_list_empty(&shell->ready_node))
+        eh_list_del_init(&shell->ready_node);
+    pthread_mutex_unlock(&shard->lock);
+    pthread_mutex_lock(&s_shard_assign_lock);
+    __atomic_fetch_sub(&shard->sessions, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&s_shard_assign_lock);
+    shell->shard = NULL;
+}
+
+void ehshell_shard_notify(ehshell_t *shell){
+    struct ehshell_shard *shard = shell->shard;
+    bool is_first_ready = false;
+    pthread_mutex_lock(&shard->lock);
+    if(eh_list_empty(&shell->ready_node)){
+        is_first_ready = eh_list_empty(&shard->ready_list);
+        eh_list_add_tail(&shell->ready_node, &shard->ready_list);
+    }
+    /* 分片线程只在就绪队列为空时等待 */
+    if(is_first_ready)
+        pthread_cond_signal(&shard->cond);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+size_t ehshell_shard_count(void){
+    return s_shard_started;
+}
+
+void ehshell_shard_set_limit(size_t n){
+    pthread_mutex_lock(&s_shard_assign_lock);
+    s_shard_limit = n;
+    pthread_mutex_unlock(&s_shard_assign_lock);
+}
+
+int ehshell_shard_get_stat(size_t index, struct ehshell_shard_stat *stat){
+    if(index >= s_shard_started || stat == NULL)
+        return EH_RET_INVALID_PARAM;
+    stat->sessions = __atomic_load_n(&s_shards[index].sessions, __ATOMIC_RELAXED);
+    stat->dispatches = __atomic_load_n(&s_shards[index].dispatches, __ATOMIC_RELAXED);
+    stat->busy_us = __atomic_load_n(&s_shards[index].busy_us, __ATOMIC_RELAXED);
+    return 0;
+}
+
+#define SHARDS_CHUNK_SIZE   64
+
+/* 第0块输出表头，之后每块输出一个分片 */
+static int shards_next_chunk(ehshell_cmd_context_t *cmd_context, struct stream_base *stream){
+    size_t *row = ehshell_command_co_frame(cmd_context, sizeof(size_t));
+    struct ehshell_shard_stat stat;
+    if(row == NULL)
+        return EH_RET_MALLOC_ERROR;
+    if(*row == 0){
+        eh_stream_printf(stream, "%-6s %8s %12s %12s\r\n", "shard", "sessions", "dispatches", "busy(ms)");
+    }else{
+        if(ehshell_shard_get_stat(*row - 1, &stat) < 0)
+            return 0;
+        eh_stream_printf(stream, "%-6u %8u %12llu %12llu\r\n", (unsigned)(*row - 1), (unsigned)stat.sessions,
+            (unsigned long long)stat.dispatches, (unsigned long long)(stat.busy_us / 1000));
+    }
+    return ++*row <= s_shard_started;
+}
+
+static void do_shards(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    (void)argc;
+    (void)argv;
+    if(ehshell_command_generate(cmd_context, shards_next_chunk, SHARDS_CHUNK_SIZE) == 0)
+        return ;
+    eh_stream_finish(ehshell_command_stream(cmd_context));
+    ehshell_command_finish(cmd_context);
+}
+
+static struct ehshell_command_info shard_command_info_tbl[] = {
+    {
+        .command = "shards",
+        .description = "Show per-shard session count and dispatch load.",
+        .usage = "shards",
+        .flags = 0,
+        .do_function = do_shards,
+        .do_event_function = NULL,
+    },
+};
+
+static void ehshell_shard_stop(size_t count){
+    for(size_t i = 0; i < count; i++){
+        pthread_mutex_lock(&s_shards[i].lock);
+        s_shards[i].is_exit = true;
+        pthread_cond_signal(&s_shards[i].cond);
+        pthread_mutex_unlock(&s_shards[i].lock);
+    }
+    for(size_t i = 0; i < count; i++){
+        pthread_join(s_shards[i].thread, NULL);
+        pthread_cond_destroy(&s_shards[i].cond);
+        pthread_mutex_destroy(&s_shards[i].lock);
+        ehshell_timer_wheel_destroy(s_shards[i].wheel);
+    }
+}
+
+static int __init ehshell_shard_pool_init(void){
+    pthread_condattr_t attr;
+    struct ehshell_shard *shard;
+    int ret = 0;
+    s_shard_started = 0;
+    s_shard_limit = 0;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    for(size_t i = 0; i < CONFIG_PACKAGE_EHSHELL_SHARD_NUM; i++){
+        shard = &s_shards[i];
+        memset(shard, 0, sizeof(struct ehshell_shard));
+        eh_list_head_init(&shard->ready_list);
+        shard->wheel = ehshell_timer_wheel_create();
+        if(shard->wheel == NULL){
+            ret = EH_RET_MALLOC_ERROR;
+            break;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+        pthread_cond_init(&shard->cond, &attr);
+        if(pthread_create(&shard->thread, NULL, ehshell_shard_thread, shard) != 0){
+            eh_merrfl(EHSHELL, "shard thread %d create failed", (int)i);
+            pthread_cond_destroy(&shard->cond);
+            pthread_mutex_destroy(&shard->lock);
+            ehshell_timer_wheel_destroy(shard->wheel);
+            ret = EH_RET_MALLOC_ERROR;
+            break;
+        }
+        s_shard_started++;
+    }
+    pthread_condattr_destroy(&attr);
+    if(ret < 0){
+        ehshell_shard_stop(s_shard_started);
+        s_shard_started = 0;
+        return ret;
+    }
+    ret = ehshell_register_commands(shard_command_info_tbl, EH_ARRAY_SIZE(shard_command_info_tbl));
+    if(ret < 0)
+        eh_mwarnfl(EHSHELL, "register shards command failed %d", ret);
+    return 0;
+}
+
+static void __exit ehshell_shard_pool_exit(void){
+    size_t count = s_shard_started;
+    s_shard_started = 0;
+    ehshell_shard_stop(count);
+}
+
+ehshell_module_core_export(ehshell_shard_pool_init, ehshell_shard_pool_exit);
+
+#else
+
+size_t ehshell_shard_count(void){
+    return 0;
+}
+
+void ehshell_shard_set_limit(size_t n){
+    (void)n;
+}
+
+int ehshell_shard_get_stat(size_t index, struct ehshell_shard_stat *stat){
+    (void)index;
+    (void)stat;
+    return EH_RET_NOT_SUPPORTED;
+}
+
+#endif /* CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0 */
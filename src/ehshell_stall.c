@@ -0,0 +1,347 @@
+/**
+ * @file ehshell_stall.c
+ * @brief 事件循环卡顿检测，对 do_function、do_event_function、tab 补全和shell处理逐次计时，
+ *        所有调用计入耗时直方图，超过预算的调用记入最近卡顿环和按命令统计的排行表，
+ *        stalls 命令输出排行、最近记录和直方图
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-02
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <eh.h>
+#include <eh_error.h>
+#include <eh_debug.h>
+#include <eh_formatio.h>
+
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+#include <ehshell_coroutine.h>
+
+#if EHSHELL_CONFIG_STALL_BUDGET_US > 0
+
+/* 直方图按2的幂分桶，第0桶 <16us，第b桶 <(16<<b)us，最后一桶不设上限 */
+#define EHSHELL_STALL_HIST_BUCKETS  16
+#define EHSHELL_STALL_HIST_SHIFT    4
+
+struct ehshell_stall_record{
+    char        name[EHSHELL_CONFIG_STALL_NAME_MAX];
+    uint8_t     kind;
+    uint32_t    event;
+    uint32_t    duration_us;
+    eh_clock_t  when;
+};
+
+struct ehshell_stall_offender{
+    char        name[EHSHELL_CONFIG_STALL_NAME_MAX];
+    uint8_t     kind;
+    uint32_t    count;
+    uint32_t    max_us;
+    uint64_t    total_us;
+};
+
+struct ehshell_stall_state{
+    uint32_t    budget_us;
+    uint32_t    overruns;       /* 超过预算的总次数，也是下一条记录的序号 */
+    uint32_t    hist[EHSHELL_STALL_KIND_MAX][EHSHELL_STALL_HIST_BUCKETS];
+    struct ehshell_stall_record   ring[EHSHELL_CONFIG_STALL_RING_SIZE];
+    struct ehshell_stall_offender offenders[EHSHELL_CONFIG_STALL_OFFENDERS];
+};
+
+static struct ehshell_stall_state s_stall = {
+    .budget_us = EHSHELL_CONFIG_STALL_BUDGET_US,
+};
+/* 卡顿环和排行表由主循环和各分片线程共同写入 */
+static ehshell_lock_t s_stall_lock = EHSHELL_LOCK_INIT;
+
+static const char * const ehshell_stall_kind_name[EHSHELL_STALL_KIND_MAX] = {
+    [EHSHELL_STALL_FUNCTION] = "function",
+    [EHSHELL_STALL_EVENT] = "event",
+    [EHSHELL_STALL_COMPLETE] = "complete",
+    [EHSHELL_STALL_PROCESSOR] = "processor",
+};
+
+static unsigned ehshell_stall_bucket(uint64_t us){
+    unsigned b = 0;
+    us >>= EHSHELL_STALL_HIST_SHIFT;
+    while(us && b < EHSHELL_STALL_HIST_BUCKETS - 1){
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void ehshell_stall_copy_name(char *dst, const char *name){
+    size_t len = name ? strlen(name) : 0;
+    if(len == 0){
+        name = "-";
+        len = 1;
+    }
+    if(len > EHSHELL_CONFIG_STALL_NAME_MAX - 1)
+        len = EHSHELL_CONFIG_STALL_NAME_MAX - 1;
+    memcpy(dst, name, len);
+    dst[len] = '\0';
+}
+
+/* 持有 s_stall_lock 时调用，找不到也没有空位时替换最大耗时最小的一项，本次更小时放弃 */
+static void ehshell_stall_offender_update(struct ehshell_stall_record *rec){
+    struct ehshell_stall_offender *o, *victim = NULL;
+    for(size_t i = 0; i < EHSHELL_CONFIG_STALL_OFFENDERS; i++){
+        o = &s_stall.offenders[i];
+        if(o->count == 0 || (o->kind == rec->kind && strcmp(o->name, rec->name) == 0)){
+            victim = o;
+            break;
+        }
+        if(victim == NULL || o->max_us < victim->max_us)
+            victim = o;
+    }
+    o = victim;
+    if(o->count && (o->kind != rec->kind || strcmp(o->name, rec->name) != 0)){
+        if(o->max_us >= rec->duration_us)
+            return ;
+        o->count = 0;
+    }
+    if(o->count == 0){
+        memcpy(o->name, rec->name, sizeof(o->name));
+        o->kind = rec->kind;
+        o->max_us = 0;
+        o->total_us = 0;
+    }
+    o->count++;
+    o->total_us += rec->duration_us;
+    if(rec->duration_us > o->max_us)
+        o->max_us = rec->duration_us;
+}
+
+void ehshell_stall_account(enum ehshell_stall_kind kind, const char *name, uint32_t event, eh_clock_t start){
+    uint64_t us = (uint64_t)eh_clock_to_usec(eh_get_clock_monotonic_time() - start);
+    uint32_t budget_us = __atomic_load_n(&s_stall.budget_us, __ATOMIC_RELAXED);
+    struct ehshell_stall_record rec;
+    /* 分片线程同时计时，直方图用原子加，超过预算的少数调用再加锁 */
+    __atomic_fetch_add(&s_stall.hist[kind][ehshell_stall_bucket(us)], 1, __ATOMIC_RELAXED);
+    if(budget_us == 0 || us < budget_us)
+        return ;
+    ehshell_stall_copy_name(rec.name, name);
+    rec.kind = (uint8_t)kind;
+    rec.event = event;
+    rec.duration_us = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    rec.when = eh_get_clock_monotonic_time();
+    ehshell_lock(&s_stall_lock);
+    s_stall.ring[s_stall.overruns % EHSHELL_CONFIG_STALL_RING_SIZE] = rec;
+    s_stall.overruns++;
+    ehshell_stall_offender_update(&rec);
+    ehshell_unlock(&s_stall_lock);
+}
+
+static void ehshell_stall_clear(void){
+    uint32_t budget_us;
+    ehshell_lock(&s_stall_lock);
+    budget_us = s_stall.budget_us;
+    memset(&s_stall, 0, sizeof(struct ehshell_stall_state));
+    s_stall.budget_us = budget_us;
+    ehshell_unlock(&s_stall_lock);
+}
+
+static void ehshell_stall_print_event(struct stream_base *stream, uint32_t event){
+    static const char * const names[] = {"exit", "sigint", "input", "resume"};
+    bool is_first = true;
+    if(event == 0){
+        eh_stream_puts(stream, "-");
+        return ;
+    }
+    for(size_t i = 0; i < EH_ARRAY_SIZE(names); i++){
+        if(!(event & (1U << i)))
+            continue;
+        eh_stream_printf(stream, "%s%s", is_first ? "" : "|", names[i]);
+        is_first = false;
+    }
+}
+
+static int ehshell_stall_offender_cmp(const void *a, const void *b){
+    const struct ehshell_stall_offender *oa = a, *ob = b;
+    if(oa->max_us != ob->max_us)
+        return oa->max_us < ob->max_us ? 1 : -1;
+    return 0;
+}
+
+#define STALLS_CHUNK_SIZE   96
+
+enum stalls_section{
+    STALLS_SECTION_SUMMARY = 0,
+    STALLS_SECTION_OFFENDERS,
+    STALLS_SECTION_RECENT,
+    STALLS_SECTION_HIST,
+    STALLS_SECTION_DONE,
+};
+
+/* 报告开始时拷贝的快照，输出期间计时点可以继续记录 */
+struct stalls_frame{
+    uint8_t     section;
+    uint32_t    row;            /* 当前段内的行，0为段标题 */
+    uint32_t    budget_us;
+    uint32_t    overruns;
+    uint32_t    offender_count;
+    uint32_t    recent;
+    eh_clock_t  now;
+    struct ehshell_stall_offender offenders[EHSHELL_CONFIG_STALL_OFFENDERS];
+    struct ehshell_stall_record   ring[EHSHELL_CONFIG_STALL_RING_SIZE];
+    uint32_t    hist[EHSHELL_STALL_KIND_MAX][EHSHELL_STALL_HIST_BUCKETS];
+};
+
+static void stalls_snapshot(struct stalls_frame *f){
+    ehshell_lock(&s_stall_lock);
+    f->budget_us = s_stall.budget_us;
+    f->overruns = s_stall.overruns;
+    memcpy(f->offenders, s_stall.offenders, sizeof(f->offenders));
+    memcpy(f->ring, s_stall.ring, sizeof(f->ring));
+    ehshell_unlock(&s_stall_lock);
+    for(size_t k = 0; k < EHSHELL_STALL_KIND_MAX; k++){
+        for(size_t b = 0; b < EHSHELL_STALL_HIST_BUCKETS; b++)
+            f->hist[k][b] = __atomic_load_n(&s_stall.hist[k][b], __ATOMIC_RELAXED);
+    }
+    f->now = eh_get_clock_monotonic_time();
+    for(size_t i = 0; i < EHSHELL_CONFIG_STALL_OFFENDERS; i++){
+        if(f->offenders[i].count)
+            f->offenders[f->offender_count++] = f->offenders[i];
+    }
+    qsort(f->offenders, f->offender_count, sizeof(struct ehshell_stall_offender), ehshell_stall_offender_cmp);
+    f->recent = f->overruns < EHSHELL_CONFIG_STALL_RING_SIZE ? f->overruns : EHSHELL_CONFIG_STALL_RING_SIZE;
+}
+
+static void stalls_next_section(struct stalls_frame *f){
+    f->section++;
+    f->row = 0;
+    if(f->section == STALLS_SECTION_OFFENDERS && f->offender_count == 0)
+        f->section++;
+    if(f->section == STALLS_SECTION_RECENT && f->recent == 0)
+        f->section++;
+}
+
+/* 每块输出一行 */
+static int stalls_next_chunk(ehshell_cmd_context_t *cmd_context, struct stream_base *stream){
+    struct stalls_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct stalls_frame));
+    struct ehshell_stall_offender *o;
+    struct ehshell_stall_record *rec;
+    uint32_t b, row;
+    switch(f->section){
+        case STALLS_SECTION_SUMMARY:
+            eh_stream_printf(stream, "budget %u us, %u overruns\r\n", (unsigned)f->budget_us, (unsigned)f->overruns);
+            stalls_next_section(f);
+            break;
+        case STALLS_SECTION_OFFENDERS:
+            if(f->row == 0){
+                eh_stream_printf(stream, "\r\nworst offenders:\r\n%-10s %-16s %8s %10s %10s\r\n",
+                    "kind", "command", "count", "max(us)", "avg(us)");
+            }else{
+                o = &f->offenders[f->row - 1];
+                eh_stream_printf(stream, "%-10s %-16s %8u %10u %10u\r\n", ehshell_stall_kind_name[o->kind],
+                    o->name, (unsigned)o->count, (unsigned)o->max_us, (unsigned)(o->total_us / o->count));
+            }
+            if(f->row++ == f->offender_count)
+                stalls_next_section(f);
+            break;
+        case STALLS_SECTION_RECENT:
+            if(f->row == 0){
+                eh_stream_printf(stream, "\r\nrecent (newest first):\r\n%10s %-10s %-16s %10s  %s\r\n",
+                    "age(ms)", "kind", "command", "us", "event");
+            }else{
+                rec = &f->ring[(f->overruns - f->row) % EHSHELL_CONFIG_STALL_RING_SIZE];
+                eh_stream_printf(stream, "%10u %-10s %-16s %10u  ", (unsigned)eh_clock_to_msec(f->now - rec->when),
+                    ehshell_stall_kind_name[rec->kind], rec->name, (unsigned)rec->duration_us);
+                ehshell_stall_print_event(stream, rec->event);
+                eh_stream_puts(stream, "\r\n");
+            }
+            if(f->row++ == f->recent)
+                stalls_next_section(f);
+            break;
+        case STALLS_SECTION_HIST:
+            if(f->row == 0){
+                eh_stream_printf(stream, "\r\nhistogram:\r\n%-10s", "us");
+                for(size_t k = 0; k < EHSHELL_STALL_KIND_MAX; k++)
+                    eh_stream_printf(stream, " %10s", ehshell_stall_kind_name[k]);
+                eh_stream_puts(stream, "\r\n");
+                f->row++;
+                break;
+            }
+            /* 跳过全为0的桶 */
+            for(b = f->row - 1; b < EHSHELL_STALL_HIST_BUCKETS; b++){
+                row = 0;
+                for(size_t k = 0; k < EHSHELL_STALL_KIND_MAX; k++)
+                    row |= f->hist[k][b];
+                if(row)
+                    break;
+            }
+            if(b == EHSHELL_STALL_HIST_BUCKETS){
+                stalls_next_section(f);
+                break;
+            }
+            if(b == EHSHELL_STALL_HIST_BUCKETS - 1)
+                eh_stream_printf(stream, ">=%-8u", (unsigned)(1U << (EHSHELL_STALL_HIST_SHIFT + b - 1)));
+            else
+                eh_stream_printf(stream, "<%-9u", (unsigned)(1U << (EHSHELL_STALL_HIST_SHIFT + b)));
+            for(size_t k = 0; k < EHSHELL_STALL_KIND_MAX; k++)
+                eh_stream_printf(stream, " %10u", (unsigned)f->hist[k][b]);
+            eh_stream_puts(stream, "\r\n");
+            f->row = b + 2;
+            break;
+        default:
+            break;
+    }
+    return f->section != STALLS_SECTION_DONE;
+}
+
+static void do_stalls(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    struct stalls_frame *f;
+    char *end;
+    unsigned long budget_us;
+    if(argc == 1){
+        f = ehshell_command_co_frame(cmd_context, sizeof(struct stalls_frame));
+        if(f == NULL){
+            eh_stream_printf(stream, "stalls: out of memory\r\n");
+            goto quit;
+        }
+        stalls_snapshot(f);
+        if(ehshell_command_generate(cmd_context, stalls_next_chunk, STALLS_CHUNK_SIZE) == 0)
+            return ;
+    }else if(argc == 2 && strcmp(argv[1], "-c") == 0){
+        ehshell_stall_clear();
+    }else if(argc == 3 && strcmp(argv[1], "-b") == 0){
+        budget_us = strtoul(argv[2], &end, 0);
+        if(end == argv[2] || *end || budget_us > UINT32_MAX)
+            goto usage;
+        __atomic_store_n(&s_stall.budget_us, (uint32_t)budget_us, __ATOMIC_RELAXED);
+    }else{
+        goto usage;
+    }
+    goto quit;
+usage:
+    eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static struct ehshell_command_info stall_command_info_tbl[] = {
+    {
+        .command = "stalls",
+        .description = "Show handlers that blocked the event loop longer than the budget.",
+        .usage = "stalls [-c] [-b budget_us]",
+        .flags = 0,
+        .do_function = do_stalls,
+        .do_event_function = NULL,
+    },
+};
+
+static int __init stall_commands_register_init(void){
+    return ehshell_register_commands(stall_command_info_tbl, EH_ARRAY_SIZE(stall_command_info_tbl));
+}
+
+ehshell_module_command_export(stall_commands_register_init, NULL);
+
+#endif /* EHSHELL_CONFIG_STALL_BUDGET_US > 0 */
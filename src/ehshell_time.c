@@ -0,0 +1,232 @@
+/**
+ * @file ehshell_time.c
+ * @brief time 命令，以捕获方式执行子命令并原样转发输出，
+ *        统计从 do_function 到 ehshell_command_finish 的耗时、输出字节数和写入次数，
+ *        启用 CONFIG_PACKAGE_EHSHELL_HEAP_HOOK 时同时统计堆分配，
+ *        堆跟踪是全局的，异步命令等待期间其他会话和事件的分配也会计入，
+ *        同一时间只有一个 time 能跟踪，其余的报告 heap busy
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-05
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_error.h>
+#include <eh_formatio.h>
+
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+#include <ehshell_coroutine.h>
+
+#define EHSHELL_TIME_ARGS_MAX           128
+
+struct time_frame{
+    ehshell_cmd_context_t           child;
+    struct stream_function_no_cache capture;
+    ehshell_cmd_context_t          *owner;
+    int         argc;
+    const char *argv[EHSHELL_CONFIG_ARGC_MAX];
+    char        args[EHSHELL_TIME_ARGS_MAX];
+    uint32_t    repeat;
+    uint32_t    runs;           /* 已完成的次数 */
+    eh_clock_t  start;
+    int         status;
+    int         heap_state;     /* 第一次无法跟踪的原因，0为全部跟踪 */
+    bool        heap_tracing;
+    /* 全部运行的累计值 */
+    uint64_t    bytes;
+    uint64_t    writes;
+    struct ehshell_heap_stat heap;
+    uint32_t    samples_us[EHSHELL_CONFIG_TIME_REPEAT_MAX];
+};
+
+static void time_capture_write(void *ctx, const uint8_t *buf, size_t len){
+    struct time_frame *f = eh_container_of((struct stream_function_no_cache *)ctx, struct time_frame, capture);
+    f->bytes += len;
+    f->writes++;
+    ehshell_command_write(f->owner, (const char *)buf, len);
+}
+
+static void time_capture_finish(void *ctx){
+    struct time_frame *f = eh_container_of((struct stream_function_no_cache *)ctx, struct time_frame, capture);
+    eh_stream_finish(ehshell_command_stream(f->owner));
+}
+
+static void time_heap_stop(struct time_frame *f){
+    struct ehshell_heap_stat stat;
+    if(!f->heap_tracing)
+        return ;
+    f->heap_tracing = false;
+    ehshell_heap_trace_stop(&stat);
+    f->heap.allocs += stat.allocs;
+    f->heap.frees += stat.frees;
+    f->heap.bytes += stat.bytes;
+    f->heap.untracked += stat.untracked;
+    if(stat.peak > f->heap.peak)
+        f->heap.peak = stat.peak;
+}
+
+static void time_print_ms(struct stream_base *stream, const char *label, uint32_t us){
+    eh_stream_printf(stream, "%s%u.%03u ms", label, (unsigned)(us / 1000), (unsigned)(us % 1000));
+}
+
+static void time_report(ehshell_cmd_context_t *cmd_context, struct time_frame *f){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    uint32_t *s = f->samples_us, v, median, j;
+    uint32_t n = f->runs;
+    const char *per = n > 1 ? "per run " : "";
+    if(n == 0)
+        return ;
+    /* 插入排序，次数不多 */
+    for(uint32_t i = 1; i < n; i++){
+        v = s[i];
+        for(j = i; j > 0 && s[j - 1] > v; j--)
+            s[j] = s[j - 1];
+        s[j] = v;
+    }
+    eh_stream_printf(stream, "\r\n");
+    if(n > 1){
+        median = n % 2 ? s[n / 2] : (uint32_t)(((uint64_t)s[n / 2 - 1] + s[n / 2]) / 2);
+        eh_stream_printf(stream, "runs     %u\r\n", (unsigned)n);
+        time_print_ms(stream, "real     min ", s[0]);
+        time_print_ms(stream, ", median ", median);
+        time_print_ms(stream, ", max ", s[n - 1]);
+    }else{
+        time_print_ms(stream, "real     ", s[0]);
+    }
+    eh_stream_printf(stream, "\r\nstatus   %d\r\n", f->status);
+    eh_stream_printf(stream, "output   %s%llu bytes, %llu writes\r\n", per,
+        (unsigned long long)(f->bytes / n), (unsigned long long)(f->writes / n));
+    if(f->heap_state == EH_RET_NOT_SUPPORTED){
+        eh_stream_printf(stream, "heap     n/a, build with CONFIG_PACKAGE_EHSHELL_HEAP_HOOK\r\n");
+        return ;
+    }
+    if(f->heap_state < 0){
+        eh_stream_printf(stream, "heap     busy, traced by another time command\r\n");
+        return ;
+    }
+    eh_stream_printf(stream, "heap     %s%u allocs (%llu bytes), %u frees, peak %llu bytes%s, all tasks\r\n", per,
+        (unsigned)(f->heap.allocs / n), (unsigned long long)(f->heap.bytes / n), (unsigned)(f->heap.frees / n),
+        (unsigned long long)f->heap.peak, f->heap.untracked ? " or more" : "");
+}
+
+/* 解析 1 到 EHSHELL_CONFIG_TIME_REPEAT_MAX 的重复次数 */
+static int time_parse_repeat(const char *str, uint32_t *repeat){
+    uint32_t n = 0;
+    const char *p = str;
+    if(*p == '\0')
+        return EH_RET_INVALID_PARAM;
+    for(; *p >= '0' && *p <= '9'; p++){
+        n = n * 10 + (uint32_t)(*p - '0');
+        if(n > EHSHELL_CONFIG_TIME_REPEAT_MAX)
+            return EH_RET_INVALID_PARAM;
+    }
+    if(*p != '\0' || n == 0)
+        return EH_RET_INVALID_PARAM;
+    *repeat = n;
+    return EH_RET_OK;
+}
+
+static void do_time(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    struct time_frame *f;
+    uint32_t repeat = 1;
+    size_t n, pos = 0;
+    int i = 1;
+    if(argc > 2 && strcmp(argv[1], "-r") == 0){
+        if(time_parse_repeat(argv[2], &repeat) < 0){
+            eh_stream_printf(stream, "time: repeat count must be 1-%u\r\n", (unsigned)EHSHELL_CONFIG_TIME_REPEAT_MAX);
+            goto quit;
+        }
+        i = 3;
+    }
+    if(i >= argc)
+        goto usage;
+    f = ehshell_command_co_frame(cmd_context, sizeof(struct time_frame));
+    if(f == NULL){
+        eh_stream_printf(stream, "time: out of memory\r\n");
+        goto quit;
+    }
+    /* 参数保存在帧中，每次重复都使用同一份参数 */
+    for(f->argc = 0; i < argc; i++){
+        n = strlen(argv[i]) + 1;
+        if(pos + n > sizeof(f->args)){
+            eh_stream_printf(stream, "time: command too long\r\n");
+            goto quit;
+        }
+        memcpy(f->args + pos, argv[i], n);
+        f->argv[f->argc++] = f->args + pos;
+        pos += n;
+    }
+    f->owner = cmd_context;
+    f->repeat = repeat;
+    eh_stream_function_no_cache_init(&f->capture, time_capture_write, time_capture_finish);
+    ehshell_command_resume_later(cmd_context);
+    return ;
+usage:
+    eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_time_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    struct time_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct time_frame));
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    int ret;
+    EHSHELL_CO_BEGIN(cmd_context);
+    while(f->runs < f->repeat && !EHSHELL_CO_CANCELLED(ehshell_event)){
+        ret = ehshell_heap_trace_start();
+        f->heap_tracing = ret == 0;
+        if(ret < 0 && f->heap_state == 0)
+            f->heap_state = ret;
+        f->start = eh_get_clock_monotonic_time();
+        ret = ehshell_command_capture_start(cmd_context, &f->child, (struct stream_base *)&f->capture, f->argc, f->argv);
+        if(ret < 0){
+            time_heap_stop(f);
+            f->status = ret;
+            eh_stream_printf(stream, "time: %s: %s\r\n", f->argv[0],
+                ret == EH_RET_NOT_EXISTS ? "command not found" : "command not supported");
+            break;
+        }
+        EHSHELL_CO_AWAIT(cmd_context, f->child.command_info == NULL || EHSHELL_CO_CANCELLED(ehshell_event));
+        if(EHSHELL_CO_CANCELLED(ehshell_event))
+            break;
+        time_heap_stop(f);
+        f->samples_us[f->runs++] = (uint32_t)eh_clock_to_usec(f->child.capture_finish_time - f->start);
+        f->status = f->child.exit_status;
+    }
+    EHSHELL_CO_END(cmd_context);
+    /* 被中断的一次不计入统计 */
+    if(f->child.command_info)
+        ehshell_command_capture_stop(&f->child);
+    if(f->heap_tracing){
+        f->heap_tracing = false;
+        ehshell_heap_trace_stop(NULL);
+    }
+    time_report(cmd_context, f);
+    ehshell_command_set_exit_status(cmd_context, f->status);
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static struct ehshell_command_info time_command_info_tbl[] = {
+    {
+        .command = "time",
+        .description = "Run a command and report latency, output and heap usage.",
+        .usage = "time [-r count] <command> [args...]",
+        .flags = 0,
+        .do_function = do_time,
+        .do_event_function = do_time_event,
+    },
+};
+
+static int __init time_commands_register_init(void){
+    return ehshell_register_commands(time_command_info_tbl, EH_ARRAY_SIZE(time_command_info_tbl));
+}
+ehshell_module_command_export(time_commands_register_init, NULL);
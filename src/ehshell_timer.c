@@ -0,0 +1,322 @@
+/**
+ * @file ehshell_timer.c
+ * @brief ehshell 共享分层时间轮
+ *        所有会话的定时需求共用一个eventhub定时器，定时器只在最近的到期点(或高层级的级联点)唤醒，
+ *        没有到期事件时不会产生任何周期性回调
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-03
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <eh.h>
+#include <eh_error.h>
+#include <eh_mem.h>
+#include <eh_debug.h>
+#include <eh_list.h>
+#include <eh_signal.h>
+#include <eh_timer.h>
+
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+#include <ehshell_timer.h>
+
+#define EHSHELL_TIMER_WHEEL_BITS        5U
+#define EHSHELL_TIMER_WHEEL_SLOTS       (1U << EHSHELL_TIMER_WHEEL_BITS)
+#define EHSHELL_TIMER_WHEEL_MASK        (EHSHELL_TIMER_WHEEL_SLOTS - 1U)
+#define EHSHELL_TIMER_WHEEL_LEVELS      4U
+#define EHSHELL_TIMER_WHEEL_MAX_DELTA   ((1UL << (EHSHELL_TIMER_WHEEL_BITS * EHSHELL_TIMER_WHEEL_LEVELS)) - 1U)
+
+#define ehshell_timer_level_shift(level)    ((level) * EHSHELL_TIMER_WHEEL_BITS)
+#define ehshell_timer_level_mask(level)     ((1UL << ehshell_timer_level_shift(level)) - 1U)
+
+struct ehshell_timer_wheel{
+    struct eh_list_head     slots[EHSHELL_TIMER_WHEEL_LEVELS][EHSHELL_TIMER_WHEEL_SLOTS];
+    uint32_t                bitmap[EHSHELL_TIMER_WHEEL_LEVELS];
+    uint32_t                clk;            /* 下一个待处理的tick，小于clk的tick都已经处理完成 */
+    uint32_t                wakeup_tick;    /* eventhub定时器当前设置的唤醒tick */
+    uint32_t                active_count;
+    bool                    wakeup_armed;
+};
+
+static struct ehshell_timer_wheel s_wheel;
+static eh_signal_slot_t s_slot_wheel_timer;
+
+EH_DEFINE_STATIC_CUSTOM_SIGNAL(signal_ehshell_timer_wheel, eh_timer_event_t, EH_TIMER_INIT(signal_ehshell_timer_wheel.custom_event));
+
+static uint32_t ehshell_timer_now_tick(void){
+    return (uint32_t)(eh_clock_to_msec(eh_get_clock_monotonic_time()) / EHSHELL_CONFIG_TIMER_TICK_MS);
+}
+
+static inline uint32_t ehshell_timer_rotr(uint32_t bitmap, uint32_t n){
+    n &= EHSHELL_TIMER_WHEEL_MASK;
+    return n ? ((bitmap >> n) | (bitmap << (EHSHELL_TIMER_WHEEL_SLOTS - n))) : bitmap;
+}
+
+static bool ehshell_timer_wheel_next_tick(struct ehshell_timer_wheel *w, uint32_t *next_tick);
+
+/* 在clk与now之间没有待处理的tick时，clk可以直接追上当前时间，避免新定时器被放入过高的层级 */
+static void ehshell_timer_wheel_catch_up(struct ehshell_timer_wheel *w, uint32_t now){
+    uint32_t next_tick;
+    if((int32_t)(now - w->clk) <= 0)
+        return ;
+    if(!ehshell_timer_wheel_next_tick(w, &next_tick) || (int32_t)(next_tick - now) > 0)
+        w->clk = now;
+}
+
+static void ehshell_timer_wheel_insert(struct ehshell_timer_wheel *w, ehshell_timer_t *timer){
+    uint32_t delta, level, idx;
+    if((int32_t)(timer->expires - w->clk) < 0)
+        timer->expires = w->clk;
+    delta = timer->expires - w->clk;
+    if(delta > EHSHELL_TIMER_WHEEL_MAX_DELTA){
+        timer->expires = w->clk + (uint32_t)EHSHELL_TIMER_WHEEL_MAX_DELTA;
+        delta = (uint32_t)EHSHELL_TIMER_WHEEL_MAX_DELTA;
+    }
+    for(level = 0; level < EHSHELL_TIMER_WHEEL_LEVELS - 1; level++){
+        if(delta <= ehshell_timer_level_mask(level + 1))
+            break;
+    }
+    idx = (timer->expires >> ehshell_timer_level_shift(level)) & EHSHELL_TIMER_WHEEL_MASK;
+    timer->slot = (uint16_t)(level * EHSHELL_TIMER_WHEEL_SLOTS + idx);
+    eh_list_add_tail(&timer->node, &w->slots[level][idx]);
+    w->bitmap[level] |= (1U << idx);
+}
+
+static void ehshell_timer_wheel_remove(struct ehshell_timer_wheel *w, ehshell_timer_t *timer){
+    uint32_t level = timer->slot / EHSHELL_TIMER_WHEEL_SLOTS;
+    uint32_t idx = timer->slot % EHSHELL_TIMER_WHEEL_SLOTS;
+    eh_list_del_init(&timer->node);
+    if(eh_list_empty(&w->slots[level][idx]))
+        w->bitmap[level] &= ~(1U << idx);
+}
+
+/* 把槽中的定时器整体移到临时链表，处理过程中新插入的定时器不会再落入本次处理的链表 */
+static void ehshell_timer_wheel_detach_slot(struct ehshell_timer_wheel *w, uint32_t level, uint32_t idx, struct eh_list_head *list){
+    struct eh_list_head *slot = &w->slots[level][idx];
+    eh_list_head_init(list);
+    while(!eh_list_empty(slot)){
+        struct eh_list_head *node = slot->next;
+        eh_list_del(node);
+        eh_list_add_tail(node, list);
+    }
+    w->bitmap[level] &= ~(1U << idx);
+}
+
+/**
+ * @brief                   计算下一次需要处理的tick，可能是0层的到期点，也可能是高层级的级联点
+ *                          每层只需一次循环移位和ctz，与定时器数量无关
+ * @param  next_tick        输出下一次处理的tick
+ * @return bool             时间轮为空返回false
+ */
+static bool ehshell_timer_wheel_next_tick(struct ehshell_timer_wheel *w, uint32_t *next_tick){
+    bool found = false;
+    uint32_t best = 0;
+    for(uint32_t level = 0; level < EHSHELL_TIMER_WHEEL_LEVELS; level++){
+        uint32_t shift = ehshell_timer_level_shift(level);
+        uint32_t period = w->clk >> shift;
+        uint32_t start, dist, tick;
+        if(w->bitmap[level] == 0)
+            continue;
+        /* 0层槽在clk处即到期，高层级的当前槽若已经过了级联点，要等下一轮 */
+        start = (level == 0 || (w->clk & ehshell_timer_level_mask(level)) == 0) ? 0 : 1;
+        dist = (uint32_t)__builtin_ctz(ehshell_timer_rotr(w->bitmap[level], period + start)) + start;
+        tick = (period + dist) << shift;
+        if(!found || (int32_t)(tick - best) < 0){
+            best = tick;
+            found = true;
+        }
+    }
+    *next_tick = best;
+    return found;
+}
+
+static void ehshell_timer_wheel_reprogram(struct ehshell_timer_wheel *w){
+    uint32_t next_tick, now;
+    eh_timer_event_t *timer = eh_signal_to_custom_event(&signal_ehshell_timer_wheel);
+    /* 分片的时间轮由分片线程在等待前自行计算超时 */
+    if(w != &s_wheel)
+        return ;
+    if(!ehshell_timer_wheel_next_tick(w, &next_tick)){
+        if(w->wakeup_armed){
+            eh_timer_stop(timer);
+            w->wakeup_armed = false;
+        }
+        return ;
+    }
+    if(w->wakeup_armed && (int32_t)(w->wakeup_tick - next_tick) <= 0)
+        return ;
+    now = ehshell_timer_now_tick();
+    w->wakeup_tick = next_tick;
+    w->wakeup_armed = true;
+    eh_timer_config_interval(timer, eh_msec_to_clock(
+        (int32_t)(next_tick - now) > 0 ? (next_tick - now) * EHSHELL_CONFIG_TIMER_TICK_MS : 0));
+    eh_timer_restart(timer);
+}
+
+static void ehshell_timer_wheel_cascade(struct ehshell_timer_wheel *w, uint32_t level, uint32_t tick){
+    struct eh_list_head list;
+    uint32_t idx = (tick >> ehshell_timer_level_shift(level)) & EHSHELL_TIMER_WHEEL_MASK;
+    if(!(w->bitmap[level] & (1U << idx)))
+        return ;
+    ehshell_timer_wheel_detach_slot(w, level, idx, &list);
+    while(!eh_list_empty(&list)){
+        ehshell_timer_t *timer = eh_list_entry(list.next, ehshell_timer_t, node);
+        eh_list_del(&timer->node);
+        ehshell_timer_wheel_insert(w, timer);
+    }
+}
+
+static void ehshell_timer_wheel_expire(struct ehshell_timer_wheel *w, uint32_t tick){
+    struct eh_list_head list;
+    uint32_t idx = tick & EHSHELL_TIMER_WHEEL_MASK;
+    if(!(w->bitmap[0] & (1U << idx)))
+        return ;
+    ehshell_timer_wheel_detach_slot(w, 0, idx, &list);
+    /* 回调中可能会启动或停止任意定时器，每次只取链表头部 */
+    while(!eh_list_empty(&list)){
+        ehshell_timer_t *timer = eh_list_entry(list.next, ehshell_timer_t, node);
+        eh_list_del_init(&timer->node);
+        w->active_count--;
+        timer->callback(timer, timer->arg);
+    }
+}
+
+/* 处理到当前时刻为止的全部到期点和级联点 */
+static void ehshell_timer_wheel_run(struct ehshell_timer_wheel *w){
+    uint32_t now = ehshell_timer_now_tick();
+    uint32_t tick;
+    while(ehshell_timer_wheel_next_tick(w, &tick) && (int32_t)(tick - now) <= 0){
+        /* tick之前没有任何到期点和级联点，直接跳过 */
+        w->clk = tick;
+        for(uint32_t level = EHSHELL_TIMER_WHEEL_LEVELS - 1; level > 0; level--){
+            if((tick & ehshell_timer_level_mask(level)) == 0)
+                ehshell_timer_wheel_cascade(w, level, tick);
+        }
+        /* 先推进clk，回调中重新启动的定时器最早也只能在下一个tick到期 */
+        w->clk = tick + 1;
+        ehshell_timer_wheel_expire(w, tick);
+    }
+    ehshell_timer_wheel_catch_up(w, now);
+}
+
+static void ehshell_timer_wheel_process(eh_event_t *e, void *slot_param){
+    (void)e;
+    (void)slot_param;
+    s_wheel.wakeup_armed = false;
+    ehshell_timer_wheel_run(&s_wheel);
+    ehshell_timer_wheel_reprogram(&s_wheel);
+}
+
+static void ehshell_timer_wheel_reset(struct ehshell_timer_wheel *w){
+    for(uint32_t level = 0; level < EHSHELL_TIMER_WHEEL_LEVELS; level++){
+        for(uint32_t i = 0; i < EHSHELL_TIMER_WHEEL_SLOTS; i++)
+            eh_list_head_init(&w->slots[level][i]);
+        w->bitmap[level] = 0;
+    }
+    w->active_count = 0;
+    w->wakeup_armed = false;
+    w->clk = ehshell_timer_now_tick();
+}
+
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+/* 分片线程绑定自己的时间轮，其他线程使用主时间轮 */
+static __thread struct ehshell_timer_wheel *s_current_wheel;
+
+static struct ehshell_timer_wheel *ehshell_timer_wheel_current(void){
+    return s_current_wheel ? s_current_wheel : &s_wheel;
+}
+
+struct ehshell_timer_wheel *ehshell_timer_wheel_create(void){
+    struct ehshell_timer_wheel *w = eh_malloc(sizeof(struct ehshell_timer_wheel));
+    if(w == NULL)
+        return NULL;
+    ehshell_timer_wheel_reset(w);
+    return w;
+}
+
+void ehshell_timer_wheel_destroy(struct ehshell_timer_wheel *w){
+    eh_free(w);
+}
+
+void ehshell_timer_wheel_bind(struct ehshell_timer_wheel *w){
+    s_current_wheel = w;
+}
+
+uint32_t ehshell_timer_wheel_poll(struct ehshell_timer_wheel *w){
+    uint32_t next_tick, now;
+    ehshell_timer_wheel_run(w);
+    if(!ehshell_timer_wheel_next_tick(w, &next_tick))
+        return UINT32_MAX;
+    now = ehshell_timer_now_tick();
+    return (int32_t)(next_tick - now) > 0 ? (next_tick - now) * EHSHELL_CONFIG_TIMER_TICK_MS : 0;
+}
+#else
+#define ehshell_timer_wheel_current()   (&s_wheel)
+#endif
+
+void ehshell_timer_init(ehshell_timer_t *timer, void (*callback)(ehshell_timer_t *timer, void *arg), void *arg){
+    eh_list_head_init(&timer->node);
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->expires = 0;
+    timer->slot = 0;
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+    timer->wheel = NULL;
+#endif
+}
+
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+#define ehshell_timer_owner(timer)      ((timer)->wheel)
+#else
+#define ehshell_timer_owner(timer)      (&s_wheel)
+#endif
+
+int ehshell_timer_start(ehshell_timer_t *timer, uint32_t timeout_ms){
+    struct ehshell_timer_wheel *w = ehshell_timer_wheel_current();
+    uint32_t now;
+    if(!timer || !timer->callback)
+        return EH_RET_INVALID_PARAM;
+    if(ehshell_timer_is_active(timer)){
+        ehshell_timer_wheel_remove(ehshell_timer_owner(timer), timer);
+        ehshell_timer_owner(timer)->active_count--;
+    }
+    now = ehshell_timer_now_tick();
+    ehshell_timer_wheel_catch_up(w, now);
+    timer->expires = now + (timeout_ms + EHSHELL_CONFIG_TIMER_TICK_MS - 1) / EHSHELL_CONFIG_TIMER_TICK_MS;
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+    timer->wheel = w;
+#endif
+    ehshell_timer_wheel_insert(w, timer);
+    w->active_count++;
+    ehshell_timer_wheel_reprogram(w);
+    return 0;
+}
+
+void ehshell_timer_stop(ehshell_timer_t *timer){
+    if(!timer || !ehshell_timer_is_active(timer))
+        return ;
+    ehshell_timer_wheel_remove(ehshell_timer_owner(timer), timer);
+    ehshell_timer_owner(timer)->active_count--;
+    /* 不重新设置唤醒点，多余的一次唤醒没有到期事件，处理后自动停止 */
+}
+
+static int __init ehshell_timer_wheel_init(void){
+    int ret;
+    ehshell_timer_wheel_reset(&s_wheel);
+    eh_signal_slot_init(&s_slot_wheel_timer, ehshell_timer_wheel_process, NULL);
+    ret = eh_signal_slot_connect(&signal_ehshell_timer_wheel, &s_slot_wheel_timer);
+    if(ret < 0){
+        eh_merrfl(EHSHELL, "timer wheel signal connect failed %d", ret);
+        return ret;
+    }
+    return 0;
+}
+
+static void __exit ehshell_timer_wheel_exit(void){
+    eh_timer_stop(eh_signal_to_custom_event(&signal_ehshell_timer_wheel));
+    eh_signal_slot_disconnect(&signal_ehshell_timer_wheel, &s_slot_wheel_timer);
+}
+
+ehshell_module_core_export(ehshell_timer_wheel_init, ehshell_timer_wheel_exit);
@@ -0,0 +1,212 @@
+/**
+ * @file ehshell_uart.c
+ * @brief UART类设备的端口适配器，接收和发送都按段处理，不逐字节搬运，
+ *        接收段在中断中直接写入shell的输入缓冲区，写不下的部分留在DMA缓冲区中，
+ *        shell处理完输入后再次拉取
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-27
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_error.h>
+#include <eh_debug.h>
+#include <eh_ringbuf.h>
+
+#include <ehshell.h>
+#include <ehshell_uart.h>
+
+/* 把DMA缓冲区中待拷贝的数据写入输入缓冲区，返回写入的字节数 */
+static int32_t ehshell_uart_rx_pull(struct ehshell_uart *uart){
+    eh_ringbuf_t *input_ringbuf = ehshell_input_ringbuf(uart->shell);
+    uint32_t start, n;
+    int32_t wl, total = 0;
+    bool full = false;
+    eh_save_state_t state = eh_enter_critical();
+    while(uart->rx_pending){
+        start = (uart->rx_dma_pos + uart->rx_dma_size - uart->rx_pending) % uart->rx_dma_size;
+        n = uart->rx_dma_size - start;
+        if(n > uart->rx_pending)
+            n = uart->rx_pending;
+        wl = eh_ringbuf_write(input_ringbuf, uart->rx_dma_buf + start, (int32_t)n);
+        if(wl < 0)
+            wl = 0;
+        uart->rx_pending -= (uint32_t)wl;
+        total += wl;
+        if((uint32_t)wl < n){
+            full = true;
+            break;
+        }
+    }
+    uart->rx_bytes += (uint32_t)total;
+    /* 未拷贝的数据留在DMA缓冲区中，等待下一次更新 */
+    if(full)
+        ehshell_input_overflow(uart->shell, uart->rx_pending);
+    eh_exit_critical(state);
+    return total;
+}
+
+void ehshell_uart_rx_dma_update(struct ehshell_uart *uart, uint32_t dma_pos){
+    uint32_t delta;
+    eh_save_state_t state;
+    if(uart->shell == NULL || uart->rx_dma_buf == NULL || dma_pos > uart->rx_dma_size)
+        return ;
+    state = eh_enter_critical();
+    /* dma_pos 等于缓冲区大小时，上次位置为0说明正好收满一圈 */
+    delta = dma_pos >= uart->rx_dma_pos ? dma_pos - uart->rx_dma_pos : uart->rx_dma_size - uart->rx_dma_pos + dma_pos;
+    uart->rx_dma_pos = dma_pos % uart->rx_dma_size;
+    uart->rx_pending += delta;
+    if(uart->rx_pending > uart->rx_dma_size){
+        /* DMA已经覆盖了还没拷贝的数据 */
+        uart->rx_dropped += uart->rx_pending - uart->rx_dma_size;
+        uart->rx_pending = uart->rx_dma_size;
+    }
+    eh_exit_critical(state);
+    if(ehshell_uart_rx_pull(uart) > 0)
+        ehshell_notify_processor(uart->shell);
+}
+
+void ehshell_uart_rx_bytes(struct ehshell_uart *uart, const uint8_t *buf, size_t len){
+    eh_save_state_t state;
+    int32_t wl;
+    if(uart->shell == NULL || len == 0)
+        return ;
+    /* 自适应输入缓冲区在临界区中更换 */
+    state = eh_enter_critical();
+    wl = eh_ringbuf_write(ehshell_input_ringbuf(uart->shell), buf, (int32_t)len);
+    eh_exit_critical(state);
+    if(wl < 0)
+        wl = 0;
+    uart->rx_bytes += (uint32_t)wl;
+    uart->rx_dropped += (uint32_t)len - (uint32_t)wl;
+    ehshell_input_overflow(uart->shell, (uint32_t)len - (uint32_t)wl);
+    if(wl > 0)
+        ehshell_notify_processor(uart->shell);
+}
+
+/* 空闲时从发送缓冲区取出一段连续数据启动发送 */
+static void ehshell_uart_tx_kick(struct ehshell_uart *uart){
+    const uint8_t *buf = NULL;
+    int32_t len = 0;
+    eh_save_state_t state = eh_enter_critical();
+    if(uart->tx_inflight == 0){
+        buf = eh_ringbuf_peek(uart->tx_ringbuf, 0, NULL, &len);
+        if(buf && len > 0){
+            if(uart->tx_chunk_max && (uint32_t)len > uart->tx_chunk_max)
+                len = (int32_t)uart->tx_chunk_max;
+            uart->tx_inflight = (uint32_t)len;
+        }else{
+            buf = NULL;
+        }
+    }
+    eh_exit_critical(state);
+    if(buf == NULL)
+        return ;
+    if(uart->ops->tx_start(uart, buf, (size_t)len) < 0){
+        state = eh_enter_critical();
+        uart->tx_inflight = 0;
+        eh_exit_critical(state);
+        return ;
+    }
+    uart->tx_chunks++;
+}
+
+void ehshell_uart_tx_complete(struct ehshell_uart *uart){
+    eh_save_state_t state = eh_enter_critical();
+    eh_ringbuf_read_skip(uart->tx_ringbuf, (int32_t)uart->tx_inflight);
+    uart->tx_bytes += uart->tx_inflight;
+    uart->tx_inflight = 0;
+    eh_exit_critical(state);
+    ehshell_uart_tx_kick(uart);
+    /* 发送缓冲区释放，唤醒等待输出空间的命令 */
+    if(uart->shell)
+        ehshell_notify_processor(uart->shell);
+}
+
+static void ehshell_uart_stream_write(ehshell_t *ehshell, const char *buf, size_t len){
+    struct ehshell_uart *uart = ehshell_get_user_data(ehshell);
+    int32_t wl = eh_ringbuf_write(uart->tx_ringbuf, (const uint8_t *)buf, (int32_t)len);
+    if(wl < 0)
+        wl = 0;
+    uart->tx_dropped += (uint32_t)len - (uint32_t)wl;
+    /* 攒够一个DMA块就先发出去，其余等到流结束 */
+    if(uart->tx_chunk_max == 0 || (uint32_t)eh_ringbuf_size(uart->tx_ringbuf) >= uart->tx_chunk_max)
+        ehshell_uart_tx_kick(uart);
+}
+
+static void ehshell_uart_stream_finish(ehshell_t *ehshell){
+    ehshell_uart_tx_kick(ehshell_get_user_data(ehshell));
+}
+
+static size_t ehshell_uart_stream_write_space(ehshell_t *ehshell){
+    struct ehshell_uart *uart = ehshell_get_user_data(ehshell);
+    return (size_t)eh_ringbuf_free_size(uart->tx_ringbuf);
+}
+
+static void ehshell_uart_input_ringbuf_process_finish(ehshell_t *ehshell){
+    struct ehshell_uart *uart = ehshell_get_user_data(ehshell);
+    if(uart->rx_dma_buf && ehshell_uart_rx_pull(uart) > 0)
+        ehshell_notify_processor(ehshell);
+}
+
+static enum ehshell_quit_result ehshell_uart_quit(ehshell_t *ehshell){
+    (void)ehshell;
+    return EHSHELL_QUIT_REJECTED;
+}
+
+int ehshell_uart_init(struct ehshell_uart *uart, const struct ehshell_uart_param *param){
+    ehshell_t *shell;
+    int ret;
+    if(!uart || !param || !param->ops || !param->ops->tx_start || param->tx_buf_size == 0 ||
+        (param->rx_dma_buf && param->rx_dma_size < 2))
+        return EH_RET_INVALID_PARAM;
+    memset(uart, 0, sizeof(struct ehshell_uart));
+    uart->ops = param->ops;
+    uart->user_data = param->user_data;
+    uart->rx_dma_buf = param->rx_dma_buf;
+    uart->rx_dma_size = param->rx_dma_size;
+    uart->tx_chunk_max = param->tx_chunk_max;
+    uart->config.host = param->host;
+    uart->config.input_ringbuf_size = param->input_ringbuf_size;
+    uart->config.input_ringbuf_max = param->input_ringbuf_max;
+    uart->config.input_linebuf_size = param->input_linebuf_size;
+    uart->config.stream_write = ehshell_uart_stream_write;
+    uart->config.stream_finish = ehshell_uart_stream_finish;
+    uart->config.stream_write_space = ehshell_uart_stream_write_space;
+    uart->config.input_ringbuf_process_finish = ehshell_uart_input_ringbuf_process_finish;
+    uart->config.quit_shell = ehshell_uart_quit;
+    uart->tx_ringbuf = eh_ringbuf_create((int32_t)param->tx_buf_size, NULL);
+    ret = eh_ptr_to_error(uart->tx_ringbuf);
+    if(ret < 0)
+        return ret;
+    shell = ehshell_create(&uart->config);
+    ret = eh_ptr_to_error(shell);
+    if(ret < 0){
+        eh_merrfl(EHSHELL_UART, "ehshell_create failed %d", ret);
+        eh_ringbuf_destroy(uart->tx_ringbuf);
+        uart->tx_ringbuf = NULL;
+        return ret;
+    }
+    ehshell_set_userdata(shell, uart);
+    uart->shell = shell;
+    if(uart->rx_dma_buf && uart->ops->rx_start)
+        uart->ops->rx_start(uart, uart->rx_dma_buf, uart->rx_dma_size);
+    return 0;
+}
+
+void ehshell_uart_deinit(struct ehshell_uart *uart){
+    ehshell_t *shell;
+    if(!uart || !uart->shell)
+        return ;
+    if(uart->ops->stop)
+        uart->ops->stop(uart);
+    shell = uart->shell;
+    uart->shell = NULL;
+    ehshell_destroy(shell);
+    eh_ringbuf_destroy(uart->tx_ringbuf);
+    uart->tx_ringbuf = NULL;
+}
@@ -0,0 +1,280 @@
+/**
+ * @file ehshell_watch.c
+ * @brief watch 命令，周期执行命令并捕获输出到虚拟屏幕，
+ *        与上一帧比较后只用光标定位序列发送变化的部分
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-18
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_error.h>
+#include <eh_formatio.h>
+
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+#include <ehshell_coroutine.h>
+
+#define EHSHELL_WATCH_ARGS_MAX          128
+#define EHSHELL_WATCH_OUTPUT_ROW        2           /* 第0行为标题，第1行空行 */
+#define EHSHELL_WATCH_MIN_INTERVAL_MS   100
+
+enum watch_esc_state{
+    WATCH_ESC_NONE = 0,
+    WATCH_ESC_START,
+    WATCH_ESC_CSI,
+};
+
+struct watch_frame{
+    ehshell_cmd_context_t           child;
+    struct stream_function_no_cache capture;
+    uint32_t    interval_ms;
+    int         argc;
+    const char *argv[EHSHELL_CONFIG_ARGC_MAX];
+    char        args[EHSHELL_WATCH_ARGS_MAX];
+    /* 捕获时的虚拟光标 */
+    uint16_t    row;
+    uint16_t    col;
+    uint8_t     esc_state;
+    uint16_t    rows_used;
+    char        screen[EHSHELL_CONFIG_WATCH_ROWS][EHSHELL_CONFIG_WATCH_COLS];  /* 本次捕获的画面 */
+    char        shown[EHSHELL_CONFIG_WATCH_ROWS][EHSHELL_CONFIG_WATCH_COLS];   /* 终端上的画面 */
+    char        out[EHSHELL_CONFIG_WATCH_COLS + 24];
+};
+
+static void watch_screen_putc(struct watch_frame *f, char c){
+    uint8_t ch = (uint8_t)c;
+    switch(f->esc_state){
+        case WATCH_ESC_START:
+            f->esc_state = ch == '[' ? WATCH_ESC_CSI : WATCH_ESC_NONE;
+            return ;
+        case WATCH_ESC_CSI:
+            /* 丢弃命令自己的控制序列，直到结束字节 */
+            if(ch >= 0x40 && ch <= 0x7E)
+                f->esc_state = WATCH_ESC_NONE;
+            return ;
+        default:
+            break;
+    }
+    switch(ch){
+        case 0x1B:
+            f->esc_state = WATCH_ESC_START;
+            return ;
+        case '\r':
+            f->col = 0;
+            return ;
+        case '\n':
+            f->row++;
+            f->col = 0;
+            return ;
+        case '\t':
+            f->col = (uint16_t)((f->col + 8) & ~7U);
+            return ;
+        case '\b':
+            if(f->col)
+                f->col--;
+            return ;
+        default:
+            break;
+    }
+    if(ch < 0x20 || ch == 0x7F)
+        return ;
+    if(f->row < EHSHELL_CONFIG_WATCH_ROWS && f->col < EHSHELL_CONFIG_WATCH_COLS)
+        f->screen[f->row][f->col] = c;
+    f->col++;
+}
+
+static void watch_capture_write(void *ctx, const uint8_t *buf, size_t len){
+    struct watch_frame *f = eh_container_of((struct stream_function_no_cache *)ctx, struct watch_frame, capture);
+    while(len--)
+        watch_screen_putc(f, (char)*buf++);
+}
+
+static void watch_capture_finish(void *ctx){
+    (void)ctx;
+}
+
+static bool watch_row_is_ascii(const char *row){
+    for(size_t i = 0; i < EHSHELL_CONFIG_WATCH_COLS; i++){
+        if((uint8_t)row[i] >= 0x80)
+            return false;
+    }
+    return true;
+}
+
+/* 输出一行中 [start, end) 的变化，end之后全为空白时用擦除到行尾代替空格 */
+static void watch_render_row(ehshell_cmd_context_t *cmd_context, struct watch_frame *f, size_t r){
+    const char *now = f->screen[r];
+    const char *old = f->shown[r];
+    size_t start = 0, end = EHSHELL_CONFIG_WATCH_COLS, last = EHSHELL_CONFIG_WATCH_COLS;
+    bool erase = false;
+    int pos;
+    if(memcmp(now, old, EHSHELL_CONFIG_WATCH_COLS) == 0)
+        return ;
+    while(last && now[last - 1] == ' ')
+        last--;
+    if(watch_row_is_ascii(now) && watch_row_is_ascii(old)){
+        while(now[start] == old[start])
+            start++;
+        while(now[end - 1] == old[end - 1])
+            end--;
+    }
+    /* 非ASCII字符的显示宽度未知，整行重画 */
+    if(end >= last){
+        erase = end > last;
+        end = last;
+    }
+    pos = eh_snprintf(f->out, sizeof(f->out), "\x1B[%u;%uH", (unsigned)(r + 1), (unsigned)(start + 1));
+    if(end > start){
+        memcpy(f->out + pos, now + start, end - start);
+        pos += (int)(end - start);
+    }
+    if(erase){
+        memcpy(f->out + pos, "\x1B[K", 3);
+        pos += 3;
+    }
+    ehshell_command_write(cmd_context, f->out, (size_t)pos);
+    memcpy(f->shown[r], now, EHSHELL_CONFIG_WATCH_COLS);
+}
+
+static void watch_render(ehshell_cmd_context_t *cmd_context, struct watch_frame *f){
+    for(size_t r = 0; r < EHSHELL_CONFIG_WATCH_ROWS; r++){
+        watch_render_row(cmd_context, f, r);
+        if(f->screen[r][0] != ' ' || memcmp(f->screen[r], f->screen[r] + 1, EHSHELL_CONFIG_WATCH_COLS - 1))
+            f->rows_used = f->rows_used > r + 1 ? f->rows_used : (uint16_t)(r + 1);
+    }
+    eh_stream_finish(ehshell_command_stream(cmd_context));
+}
+
+static int watch_capture(ehshell_cmd_context_t *cmd_context, struct watch_frame *f){
+    int n;
+    memset(f->screen, ' ', sizeof(f->screen));
+    f->row = 0;
+    f->col = 0;
+    f->esc_state = WATCH_ESC_NONE;
+    n = eh_snprintf(f->out, sizeof(f->out), "Every %u.%us:",
+        (unsigned)(f->interval_ms / 1000), (unsigned)(f->interval_ms % 1000 / 100));
+    watch_capture_write(&f->capture, (const uint8_t *)f->out, (size_t)n);
+    for(int i = 0; i < f->argc; i++){
+        watch_screen_putc(f, ' ');
+        watch_capture_write(&f->capture, (const uint8_t *)f->argv[i], strlen(f->argv[i]));
+    }
+    f->row = EHSHELL_WATCH_OUTPUT_ROW;
+    f->col = 0;
+    return ehshell_command_capture_start(cmd_context, &f->child, (struct stream_base *)&f->capture, f->argc, f->argv);
+}
+
+/* 解析 "秒[.小数]" 形式的间隔 */
+static int watch_parse_interval(const char *str, uint32_t *interval_ms){
+    uint32_t sec = 0, ms = 0, scale = 100;
+    const char *p = str;
+    if(*p < '0' || *p > '9')
+        return EH_RET_INVALID_PARAM;
+    for(; *p >= '0' && *p <= '9'; p++){
+        sec = sec * 10 + (uint32_t)(*p - '0');
+        if(sec > 86400)
+            return EH_RET_INVALID_PARAM;
+    }
+    if(*p == '.'){
+        for(p++; *p >= '0' && *p <= '9'; p++){
+            ms += (uint32_t)(*p - '0') * scale;
+            scale /= 10;
+        }
+    }
+    if(*p != '\0')
+        return EH_RET_INVALID_PARAM;
+    ms += sec * 1000;
+    *interval_ms = ms < EHSHELL_WATCH_MIN_INTERVAL_MS ? EHSHELL_WATCH_MIN_INTERVAL_MS : ms;
+    return EH_RET_OK;
+}
+
+static void do_watch(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    struct watch_frame *f;
+    uint32_t interval_ms = EHSHELL_CONFIG_WATCH_INTERVAL_MS;
+    size_t n, pos = 0;
+    int i = 1;
+    if(argc > 2 && strcmp(argv[1], "-n") == 0){
+        if(watch_parse_interval(argv[2], &interval_ms) < 0)
+            goto usage;
+        i = 3;
+    }
+    if(i >= argc)
+        goto usage;
+    f = ehshell_command_co_frame(cmd_context, sizeof(struct watch_frame));
+    if(f == NULL){
+        eh_stream_printf(stream, "watch: out of memory\r\n");
+        goto quit;
+    }
+    /* 参数保存在帧中，子命令每次执行都使用同一份参数 */
+    for(f->argc = 0; i < argc; i++){
+        n = strlen(argv[i]) + 1;
+        if(pos + n > sizeof(f->args)){
+            eh_stream_printf(stream, "watch: command too long\r\n");
+            goto quit;
+        }
+        memcpy(f->args + pos, argv[i], n);
+        f->argv[f->argc++] = f->args + pos;
+        pos += n;
+    }
+    f->interval_ms = interval_ms;
+    eh_stream_function_no_cache_init(&f->capture, watch_capture_write, watch_capture_finish);
+    memset(f->shown, ' ', sizeof(f->shown));
+    ehshell_command_write(cmd_context, "\x1B[?25l\x1B[H\x1B[2J", 13);
+    ehshell_command_resume_later(cmd_context);
+    return ;
+usage:
+    eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_watch_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    struct watch_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct watch_frame));
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    int ret;
+    EHSHELL_CO_BEGIN(cmd_context);
+    while(!EHSHELL_CO_CANCELLED(ehshell_event)){
+        ret = watch_capture(cmd_context, f);
+        if(ret < 0){
+            eh_stream_printf(stream, "\x1B[H\x1B[2Jwatch: %s: %s\r\n", f->argv[0],
+                ret == EH_RET_NOT_EXISTS ? "command not found" : "command not supported");
+            f->rows_used = 0;
+            break;
+        }
+        EHSHELL_CO_AWAIT(cmd_context, f->child.command_info == NULL || EHSHELL_CO_CANCELLED(ehshell_event));
+        if(EHSHELL_CO_CANCELLED(ehshell_event))
+            break;
+        watch_render(cmd_context, f);
+        EHSHELL_CO_SLEEP(cmd_context, ehshell_event, f->interval_ms);
+    }
+    EHSHELL_CO_END(cmd_context);
+    if(f->child.command_info)
+        ehshell_command_capture_stop(&f->child);
+    /* 光标移到画面下方并恢复显示 */
+    eh_stream_printf(stream, "\x1B[%u;1H\x1B[?25h", (unsigned)(f->rows_used + 1));
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static struct ehshell_command_info watch_command_info_tbl[] = {
+    {
+        .command = "watch",
+        .description = "Execute a command periodically, showing only what changed.",
+        .usage = "watch [-n seconds] <command> [args...]",
+        .flags = 0,
+        .do_function = do_watch,
+        .do_event_function = do_watch_event,
+    },
+};
+
+static int __init watch_commands_register_init(void){
+    return ehshell_register_commands(watch_command_info_tbl, EH_ARRAY_SIZE(watch_command_info_tbl));
+}
+ehshell_module_command_export(watch_commands_register_init, NULL);
@@ -0,0 +1,410 @@
+/**
+ * @file ehshell_worker.c
+ * @brief 命令工作线程池，带有 EHSHELL_COMMAND_RUN_ON_WORKER 标志的命令在工作任务(Linux上为pthread)中执行，
+ *        输出经由每条命令独立的通道送回所属shell，命令结束同样由所属shell的调度器完成，
+ *        pthread模式下工作线程不直接通知shell，待唤醒的任务放入加锁的交接队列，
+ *        由事件循环的轮询任务在主线程中取出并通知
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-06
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <string.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_error.h>
+#include <eh_debug.h>
+#include <eh_list.h>
+#include <eh_ringbuf.h>
+#include <eh_platform.h>
+#include <eh_formatio.h>
+
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+
+#if CONFIG_PACKAGE_EHSHELL_WORKER_NUM > 0
+
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+#include <pthread.h>
+#include <semaphore.h>
+
+typedef pthread_mutex_t         ehshell_worker_lock_t;
+typedef sem_t                   ehshell_worker_sem_t;
+#define ehshell_worker_lock_init(lock)      pthread_mutex_init(lock, NULL)
+#define ehshell_worker_lock_deinit(lock)    pthread_mutex_destroy(lock)
+#define ehshell_worker_lock(lock)           pthread_mutex_lock(lock)
+#define ehshell_worker_unlock(lock)         pthread_mutex_unlock(lock)
+#define ehshell_worker_sem_init(sem)        sem_init(sem, 0, 0)
+#define ehshell_worker_sem_deinit(sem)      sem_destroy(sem)
+#define ehshell_worker_sem_wait(sem)        while(sem_wait(sem) != 0)
+#define ehshell_worker_sem_post(sem)        sem_post(sem)
+
+#else
+#include <eh_sem.h>
+
+/* eventhub 任务之间是协作式调度，临界区即可保护共享数据 */
+typedef eh_save_state_t         ehshell_worker_lock_t;
+typedef eh_sem_t                ehshell_worker_sem_t;
+#define ehshell_worker_lock_init(lock)      ((void)(lock))
+#define ehshell_worker_lock_deinit(lock)    ((void)(lock))
+#define ehshell_worker_lock(lock)           (*(lock) = eh_enter_critical())
+#define ehshell_worker_unlock(lock)         eh_exit_critical(*(lock))
+#define ehshell_worker_sem_init(sem)        (*(sem) = eh_sem_create(0))
+#define ehshell_worker_sem_deinit(sem)      eh_sem_destroy(*(sem))
+#define ehshell_worker_sem_wait(sem)        eh_sem_wait(*(sem), EH_TIME_FOREVER)
+#define ehshell_worker_sem_post(sem)        eh_sem_post(*(sem))
+#endif
+
+struct ehshell_worker_job{
+    struct eh_list_head                 node;
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+    struct eh_list_head                 wake_node;  /* 挂入交接队列，空链表表示未排队 */
+#endif
+    ehshell_cmd_context_t               ctx;        /* 工作线程中命令看到的上下文 */
+    ehshell_cmd_context_t              *owner;      /* shell中占位的命令上下文，shell销毁后为NULL */
+    ehshell_t                          *shell;
+    struct stream_function_no_cache     stream;
+    eh_ringbuf_t                       *channel;
+    ehshell_worker_lock_t               lock;
+    ehshell_worker_sem_t                sem_space;  /* 通道被读出后唤醒阻塞的写入者 */
+    uint32_t                            events;
+    bool                                is_finished;
+    bool                                is_wait_space;
+    int                                 argc;
+    const char                         *argv[EHSHELL_CONFIG_ARGC_MAX];
+    char                                argbuf[];
+};
+
+struct ehshell_worker_pool{
+    struct eh_list_head                 job_list;
+    ehshell_worker_lock_t               lock;
+    ehshell_worker_sem_t                sem_job;
+    bool                                is_exit;
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+    struct eh_list_head                 wake_list;  /* 等待在主线程中通知所属shell的任务 */
+    bool                                has_wake;   /* wake_list非空，轮询时无锁检查 */
+    eh_loop_poll_task_t                 wake_poll;
+    pthread_t                           threads[CONFIG_PACKAGE_EHSHELL_WORKER_NUM];
+#else
+    eh_task_t                          *tasks[CONFIG_PACKAGE_EHSHELL_WORKER_NUM];
+#endif
+};
+
+static struct ehshell_worker_pool s_pool;
+
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+/*
+ * ehshell_notify_processor 只能在事件循环线程中调用，
+ * 工作线程把任务放入交接队列，轮询任务取出后在事件循环中通知，
+ * owner 只在事件循环中修改，轮询时可以直接读取
+ */
+static void ehshell_worker_wake(struct ehshell_worker_job *job){
+    ehshell_worker_lock(&s_pool.lock);
+    if(eh_list_empty(&job->wake_node)){
+        eh_list_add_tail(&job->wake_node, &s_pool.wake_list);
+        __atomic_store_n(&s_pool.has_wake, true, __ATOMIC_RELEASE);
+    }
+    ehshell_worker_unlock(&s_pool.lock);
+}
+
+static void ehshell_worker_wake_poll(void *arg){
+    struct ehshell_worker_job *job;
+    (void)arg;
+    if(!__atomic_load_n(&s_pool.has_wake, __ATOMIC_ACQUIRE))
+        return ;
+    ehshell_worker_lock(&s_pool.lock);
+    while(!eh_list_empty(&s_pool.wake_list)){
+        job = eh_list_entry(s_pool.wake_list.next, struct ehshell_worker_job, wake_node);
+        eh_list_del_init(&job->wake_node);
+        if(job->owner)
+            ehshell_notify_processor(job->shell);
+    }
+    __atomic_store_n(&s_pool.has_wake, false, __ATOMIC_RELAXED);
+    ehshell_worker_unlock(&s_pool.lock);
+}
+#else
+static void ehshell_worker_wake(struct ehshell_worker_job *job){
+    ehshell_notify_processor(job->shell);
+}
+#endif
+
+static void ehshell_worker_job_free(struct ehshell_worker_job *job){
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+    ehshell_worker_lock(&s_pool.lock);
+    eh_list_del_init(&job->wake_node);
+    ehshell_worker_unlock(&s_pool.lock);
+#endif
+    ehshell_command_arena_free(&job->ctx);
+    eh_ringbuf_destroy(job->channel);
+    ehshell_worker_sem_deinit(&job->sem_space);
+    ehshell_worker_lock_deinit(&job->lock);
+    eh_free(job);
+}
+
+static void ehshell_worker_stream_write(void *ctx, const uint8_t *buf, size_t len){
+    struct stream_function_no_cache *stream = (struct stream_function_no_cache *)ctx;
+    struct ehshell_worker_job *job = eh_container_of(stream, struct ehshell_worker_job, stream);
+    int32_t wl;
+    while(len){
+        ehshell_worker_lock(&job->lock);
+        if(job->owner == NULL){
+            /* shell已经销毁，输出直接丢弃 */
+            ehshell_worker_unlock(&job->lock);
+            return ;
+        }
+        wl = eh_ringbuf_write(job->channel, buf, (int32_t)len);
+        buf += wl;
+        len -= (size_t)wl;
+        job->is_wait_space = len > 0;
+        ehshell_worker_wake(job);
+        ehshell_worker_unlock(&job->lock);
+        if(len)
+            ehshell_worker_sem_wait(&job->sem_space);
+    }
+}
+
+static void ehshell_worker_stream_finish(void *ctx){
+    struct stream_function_no_cache *stream = (struct stream_function_no_cache *)ctx;
+    struct ehshell_worker_job *job = eh_container_of(stream, struct ehshell_worker_job, stream);
+    ehshell_worker_lock(&job->lock);
+    if(job->owner)
+        ehshell_worker_wake(job);
+    ehshell_worker_unlock(&job->lock);
+}
+
+static void ehshell_worker_run_job(struct ehshell_worker_job *job){
+    job->ctx.command_info->do_function(&job->ctx, job->argc, job->argv);
+}
+
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+static void *ehshell_worker_thread(void *arg)
+#else
+static int ehshell_worker_thread(void *arg)
+#endif
+{
+    (void)arg;
+    struct ehshell_worker_job *job;
+    for(;;){
+        ehshell_worker_sem_wait(&s_pool.sem_job);
+        ehshell_worker_lock(&s_pool.lock);
+        if(s_pool.is_exit){
+            ehshell_worker_unlock(&s_pool.lock);
+            break;
+        }
+        job = NULL;
+        if(!eh_list_empty(&s_pool.job_list)){
+            job = eh_list_entry(s_pool.job_list.next, struct ehshell_worker_job, node);
+            eh_list_del_init(&job->node);
+        }
+        ehshell_worker_unlock(&s_pool.lock);
+        if(job)
+            ehshell_worker_run_job(job);
+    }
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+    return NULL;
+#else
+    return 0;
+#endif
+}
+
+int ehshell_worker_submit(ehshell_cmd_context_t *owner, int argc, const char *argv[]){
+    struct ehshell_worker_job *job;
+    size_t argbuf_size = 0;
+    char *p;
+    for(int i = 0; i < argc; i++)
+        argbuf_size += strlen(argv[i]) + 1;
+    job = eh_malloc(sizeof(struct ehshell_worker_job) + argbuf_size);
+    if(!job)
+        return EH_RET_MALLOC_ERROR;
+    memset(job, 0, sizeof(struct ehshell_worker_job));
+    job->channel = eh_ringbuf_create(EHSHELL_CONFIG_WORKER_CHANNEL_SIZE, NULL);
+    if(eh_ptr_to_error(job->channel) < 0){
+        eh_free(job);
+        return EH_RET_MALLOC_ERROR;
+    }
+    /* 命令行缓冲区在命令运行期间会被复用，参数需要拷贝一份 */
+    p = job->argbuf;
+    for(int i = 0; i < argc; i++){
+        size_t n = strlen(argv[i]) + 1;
+        memcpy(p, argv[i], n);
+        job->argv[i] = p;
+        p += n;
+    }
+    job->argc = argc;
+    job->owner = owner;
+    job->shell = owner->ehshell;
+    ehshell_worker_lock_init(&job->lock);
+    ehshell_worker_sem_init(&job->sem_space);
+    eh_stream_function_no_cache_init(&job->stream, ehshell_worker_stream_write, ehshell_worker_stream_finish);
+    /* 协程状态、定时器和arena都不能与发起者共用 */
+    ehshell_cmd_context_init(&job->ctx, owner->ehshell, owner->command_info, (struct stream_base *)&job->stream,
+        owner->flags | EHSHELL_CMD_CONTEXT_FLAG_WORKER);
+    job->ctx.worker_job = job;
+    owner->worker_job = job;
+    eh_list_head_init(&job->node);
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+    eh_list_head_init(&job->wake_node);
+#endif
+
+    ehshell_worker_lock(&s_pool.lock);
+    eh_list_add_tail(&job->node, &s_pool.job_list);
+    ehshell_worker_unlock(&s_pool.lock);
+    ehshell_worker_sem_post(&s_pool.sem_job);
+    return 0;
+}
+
+void ehshell_worker_finish(ehshell_cmd_context_t *job_ctx){
+    struct ehshell_worker_job *job = job_ctx->worker_job;
+    bool is_orphan;
+    ehshell_worker_lock(&job->lock);
+    job->is_finished = true;
+    is_orphan = job->owner == NULL;
+    if(!is_orphan)
+        ehshell_worker_wake(job);
+    ehshell_worker_unlock(&job->lock);
+    if(is_orphan)
+        ehshell_worker_job_free(job);
+}
+
+void ehshell_worker_post_event(ehshell_cmd_context_t *owner, enum ehshell_event ehshell_event){
+    struct ehshell_worker_job *job = owner->worker_job;
+    ehshell_worker_lock(&job->lock);
+    job->events |= (uint32_t)ehshell_event;
+    ehshell_worker_unlock(&job->lock);
+}
+
+uint32_t ehshell_worker_take_events(ehshell_cmd_context_t *job_ctx){
+    struct ehshell_worker_job *job = job_ctx->worker_job;
+    uint32_t events;
+    ehshell_worker_lock(&job->lock);
+    events = job->events;
+    job->events = 0;
+    ehshell_worker_unlock(&job->lock);
+    return events;
+}
+
+void ehshell_worker_detach(ehshell_cmd_context_t *owner){
+    struct ehshell_worker_job *job = owner->worker_job;
+    bool is_finished;
+    ehshell_worker_lock(&job->lock);
+    job->owner = NULL;
+    job->events |= EHSHELL_EVENT_SHELL_EXIT;
+    is_finished = job->is_finished;
+    if(job->is_wait_space){
+        job->is_wait_space = false;
+        ehshell_worker_sem_post(&job->sem_space);
+    }
+    ehshell_worker_unlock(&job->lock);
+    owner->worker_job = NULL;
+    /* 命令已经结束则由这里释放，否则等命令结束时自行释放 */
+    if(is_finished)
+        ehshell_worker_job_free(job);
+}
+
+/**
+ * @brief                   在shell所属任务中把工作线程的输出写入shell，并完成已经结束的命令
+ * @return bool             通道中仍有数据未处理返回true
+ */
+static bool ehshell_worker_process_owner(ehshell_cmd_context_t *owner){
+    struct ehshell_worker_job *job = owner->worker_job;
+    ehshell_t *shell = owner->ehshell;
+    uint8_t buf[EHSHELL_CONFIG_WORKER_DRAIN_CHUNK];
+    int32_t rl;
+    bool is_finished = false, is_pending;
+    do{
+        ehshell_worker_lock(&job->lock);
+        rl = eh_ringbuf_read(job->channel, buf, (int32_t)sizeof(buf));
+        if(rl > 0 && job->is_wait_space){
+            job->is_wait_space = false;
+            ehshell_worker_sem_post(&job->sem_space);
+        }
+        is_pending = eh_ringbuf_size(job->channel) > 0;
+        is_finished = job->is_finished && !is_pending;
+        ehshell_worker_unlock(&job->lock);
+        /* 输出计入本次调度的预算 */
+        if(rl > 0)
+            ehshell_output_write(shell, (const char *)buf, (size_t)rl);
+    }while(rl > 0 && is_pending && shell->dispatch_budget > 0);
+    if(rl > 0)
+        ehshell_output_finish(shell);
+    if(is_finished){
+        owner->exit_status = job->ctx.exit_status;
+        ehshell_command_arena_transfer(owner, &job->ctx);
+        owner->worker_job = NULL;
+        ehshell_worker_job_free(job);
+        ehshell_command_finish(owner);
+    }
+    return is_pending;
+}
+
+void ehshell_worker_process(ehshell_t *shell){
+    bool is_pending = false;
+    for(int i = 0; i < CONFIG_PACKAGE_EHSHELL_MAX_BACKGROUND_COMMAND_SIZE; i++){
+        ehshell_cmd_context_t *ctx = shell->cmd_background[i];
+        if(ctx && ctx->worker_job)
+            is_pending |= ehshell_worker_process_owner(ctx);
+    }
+    if(ehshell_current_command_context(shell) && shell->cmd_current.worker_job)
+        is_pending |= ehshell_worker_process_owner(&shell->cmd_current);
+    if(is_pending)
+        ehshell_notify_processor(shell);
+}
+
+static int __init ehshell_worker_pool_init(void){
+    eh_list_head_init(&s_pool.job_list);
+    ehshell_worker_lock_init(&s_pool.lock);
+    ehshell_worker_sem_init(&s_pool.sem_job);
+    s_pool.is_exit = false;
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+    eh_list_head_init(&s_pool.wake_list);
+    s_pool.has_wake = false;
+    s_pool.wake_poll.poll_task = ehshell_worker_wake_poll;
+    s_pool.wake_poll.arg = NULL;
+    eh_list_head_init(&s_pool.wake_poll.list_node);
+    eh_loop_poll_task_add(&s_pool.wake_poll);
+#endif
+    for(int i = 0; i < CONFIG_PACKAGE_EHSHELL_WORKER_NUM; i++){
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+        if(pthread_create(&s_pool.threads[i], NULL, ehshell_worker_thread, NULL) != 0){
+            eh_merrfl(EHSHELL, "worker thread %d create failed", i);
+            return EH_RET_MALLOC_ERROR;
+        }
+#else
+        s_pool.tasks[i] = eh_task_create("ehshell_worker", 0, EHSHELL_CONFIG_WORKER_STACK_SIZE, NULL, ehshell_worker_thread);
+        if(eh_ptr_to_error(s_pool.tasks[i]) < 0){
+            eh_merrfl(EHSHELL, "worker task %d create failed", i);
+            return eh_ptr_to_error(s_pool.tasks[i]);
+        }
+#endif
+    }
+    return 0;
+}
+
+static void __exit ehshell_worker_pool_exit(void){
+    ehshell_worker_lock(&s_pool.lock);
+    s_pool.is_exit = true;
+    ehshell_worker_unlock(&s_pool.lock);
+    for(int i = 0; i < CONFIG_PACKAGE_EHSHELL_WORKER_NUM; i++)
+        ehshell_worker_sem_post(&s_pool.sem_job);
+    for(int i = 0; i < CONFIG_PACKAGE_EHSHELL_WORKER_NUM; i++){
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+        pthread_join(s_pool.threads[i], NULL);
+#else
+        if(eh_ptr_to_error(s_pool.tasks[i]) >= 0)
+            eh_task_join(s_pool.tasks[i], NULL, EH_TIME_FOREVER);
+#endif
+    }
+#if defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+    eh_loop_poll_task_del(&s_pool.wake_poll);
+#endif
+    ehshell_worker_sem_deinit(&s_pool.sem_job);
+    ehshell_worker_lock_deinit(&s_pool.lock);
+}
+
+ehshell_module_core_export(ehshell_worker_pool_init, ehshell_worker_pool_exit);
+
+#endif /* CONFIG_PACKAGE_EHSHELL_WORKER_NUM > 0 */
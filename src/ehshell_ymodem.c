@@ -0,0 +1,880 @@
+/**
+ * @file ehshell_ymodem.c
+ * @brief rz/sz 命令，YMODEM/YMODEM-g 文件传输
+ *        会话切换到原始重定向模式，数据包直接在输入环形缓冲区中校验，
+ *        数据区按环形缓冲区的连续段直接交给后端写入，不做额外拷贝
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-12
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <eh.h>
+#include <eh_mem.h>
+#include <eh_error.h>
+#include <eh_list.h>
+#include <eh_ringbuf.h>
+#include <eh_formatio.h>
+
+#include <ehshell.h>
+#include <ehshell_module.h>
+#include <ehshell_internal.h>
+#include <ehshell_coroutine.h>
+#include <ehshell_ymodem.h>
+
+#define YMODEM_SOH                  0x01
+#define YMODEM_STX                  0x02
+#define YMODEM_EOT                  0x04
+#define YMODEM_ACK                  0x06
+#define YMODEM_NAK                  0x15
+#define YMODEM_CAN                  0x18
+#define YMODEM_CPMEOF               0x1A
+#define YMODEM_CRC                  'C'
+#define YMODEM_STREAMING            'G'
+
+#define YMODEM_SOH_DATA_SIZE        128
+#define YMODEM_STX_DATA_SIZE        1024
+#define YMODEM_PACKET_OVERHEAD      5           /* 包头3字节 + CRC16 2字节 */
+#define YMODEM_PACKET_MAX           (YMODEM_STX_DATA_SIZE + YMODEM_PACKET_OVERHEAD)
+
+enum ymodem_recv{
+    YMODEM_RECV_AGAIN = 0,
+    YMODEM_RECV_PACKET,
+    YMODEM_RECV_EOT,
+    YMODEM_RECV_CANCEL,
+    YMODEM_RECV_BAD,
+    YMODEM_RECV_TIMEOUT,
+};
+
+#define YMODEM_REPLY_NONE           (-1)
+#define YMODEM_REPLY_TIMEOUT        (-2)
+#define YMODEM_REPLY_CANCEL         (-3)
+
+enum ymodem_phase{
+    YMODEM_PHASE_HEADER = 0,
+    YMODEM_PHASE_DATA,
+    YMODEM_PHASE_EOT,
+    YMODEM_PHASE_FINAL,
+};
+
+struct ymodem_frame{
+    const struct ehshell_ymodem_backend *backend;
+    void                   *handle;
+    int                     status;
+    int                     reply;
+    uint32_t                file_size;
+    uint32_t                offset;
+    uint32_t                crc32;
+    uint32_t                files;
+    uint32_t                bytes;
+    uint16_t                pkt_len;            /* 当前数据包数据区长度 */
+    uint16_t                chunk;              /* sz当前数据包中的有效数据长度 */
+    uint8_t                 recv;
+    uint8_t                 pkt_seq;
+    uint8_t                 expect_seq;
+    uint8_t                 retry;
+    uint8_t                 mode;               /* YMODEM_CRC 或 YMODEM_STREAMING */
+    uint8_t                 phase;
+    bool                    in_file;
+    char                    file_name[EHSHELL_CONFIG_YMODEM_FILE_NAME_MAX];
+    uint8_t                 block[];            /* sz发送缓冲区 */
+};
+
+static EH_LIST_HEAD(ymodem_backend_list);
+
+static const uint16_t ymodem_crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+    0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+    0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+    0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+    0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+    0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+    0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+    0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+    0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+    0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+    0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+    0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+    0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+    0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+    0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+    0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+    0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+    0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+    0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+    0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+    0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+    0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
+
+static const uint32_t ymodem_crc32_table[256] = {
+    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
+    0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
+    0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
+    0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
+    0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9,
+    0xfa0f3d63, 0x8d080df5, 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
+    0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c,
+    0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
+    0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
+    0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
+    0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d, 0x76dc4190, 0x01db7106,
+    0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
+    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d,
+    0x91646c97, 0xe6635c01, 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
+    0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
+    0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
+    0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7,
+    0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
+    0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa,
+    0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
+    0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
+    0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
+    0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84,
+    0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
+    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb,
+    0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
+    0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
+    0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
+    0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55,
+    0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
+    0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28,
+    0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
+    0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
+    0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
+    0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242,
+    0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
+    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69,
+    0x616bffd3, 0x166ccf45, 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
+    0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
+    0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
+    0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693,
+    0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
+    0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
+};
+
+static uint16_t ymodem_crc16_update(uint16_t crc, const uint8_t *buf, size_t len){
+    while(len--)
+        crc = (uint16_t)((crc << 8) ^ ymodem_crc16_table[((crc >> 8) ^ *buf++) & 0xFF]);
+    return crc;
+}
+
+static uint32_t ymodem_crc32_update(uint32_t crc, const uint8_t *buf, size_t len){
+    while(len--)
+        crc = (crc >> 8) ^ ymodem_crc32_table[(crc ^ *buf++) & 0xFF];
+    return crc;
+}
+
+int ehshell_ymodem_backend_register(struct ehshell_ymodem_backend *backend){
+    struct ehshell_ymodem_backend *pos;
+    if(!backend || !backend->name || !backend->open)
+        return EH_RET_INVALID_PARAM;
+    eh_list_for_each_entry(pos, &ymodem_backend_list, node){
+        if(strcmp(pos->name, backend->name) == 0)
+            return EH_RET_EXISTS;
+    }
+    eh_list_add_tail(&backend->node, &ymodem_backend_list);
+    return EH_RET_OK;
+}
+
+void ehshell_ymodem_backend_unregister(struct ehshell_ymodem_backend *backend){
+    if(!backend)
+        return ;
+    eh_list_del_init(&backend->node);
+}
+
+static const struct ehshell_ymodem_backend *ymodem_backend_find(const char *name){
+    struct ehshell_ymodem_backend *pos;
+    eh_list_for_each_entry(pos, &ymodem_backend_list, node){
+        if(strcmp(pos->name, name) == 0)
+            return pos;
+    }
+    return NULL;
+}
+
+static void ymodem_write(ehshell_cmd_context_t *cmd_context, const uint8_t *buf, size_t len){
+    ehshell_t *shell = cmd_context->ehshell;
+    ehshell_port_write(shell, (const char *)buf, len);
+    if(shell->config->stream_finish)
+        shell->config->stream_finish(shell);
+}
+
+static void ymodem_putc(ehshell_cmd_context_t *cmd_context, uint8_t c){
+    ymodem_write(cmd_context, &c, 1);
+}
+
+static void ymodem_cancel(ehshell_cmd_context_t *cmd_context){
+    static const uint8_t cancel_seq[] = {YMODEM_CAN, YMODEM_CAN, YMODEM_CAN, YMODEM_CAN, YMODEM_CAN};
+    ymodem_write(cmd_context, cancel_seq, sizeof(cancel_seq));
+}
+
+static void ymodem_purge(ehshell_cmd_context_t *cmd_context){
+    int32_t readable = 0;
+    eh_ringbuf_t *ringbuf = ehshell_command_input_ringbuf(cmd_context, &readable);
+    if(ringbuf && readable > 0)
+        eh_ringbuf_read_skip(ringbuf, readable);
+}
+
+static void ymodem_arm_timeout(ehshell_cmd_context_t *cmd_context){
+    ehshell_command_sleep(cmd_context, EHSHELL_CONFIG_YMODEM_TIMEOUT_MS);
+}
+
+static uint16_t ymodem_ringbuf_crc16(eh_ringbuf_t *ringbuf, int32_t offset, int32_t len){
+    uint16_t crc = 0;
+    while(len > 0){
+        int32_t rl = 0;
+        const uint8_t *span = eh_ringbuf_peek(ringbuf, offset, NULL, &rl);
+        if(span == NULL || rl <= 0)
+            break;
+        if(rl > len)
+            rl = len;
+        crc = ymodem_crc16_update(crc, span, (size_t)rl);
+        offset += rl;
+        len -= rl;
+    }
+    return crc;
+}
+
+/* 数据区按连续段直接写入后端 */
+static int ymodem_ringbuf_sink(struct ymodem_frame *f, eh_ringbuf_t *ringbuf, int32_t offset, int32_t len){
+    int ret;
+    while(len > 0){
+        int32_t rl = 0;
+        const uint8_t *span = eh_ringbuf_peek(ringbuf, offset, NULL, &rl);
+        if(span == NULL || rl <= 0)
+            return EH_RET_FAULT;
+        if(rl > len)
+            rl = len;
+        if(f->backend->write){
+            ret = f->backend->write(f->handle, f->offset, span, (size_t)rl);
+            if(ret < 0)
+                return ret;
+        }
+        f->crc32 = ymodem_crc32_update(f->crc32, span, (size_t)rl);
+        f->offset += (uint32_t)rl;
+        offset += rl;
+        len -= rl;
+    }
+    return EH_RET_OK;
+}
+
+/**
+ * @brief                   从输入中解析一个数据包，校验通过的数据包留在环形缓冲区中，
+ *                          由调用者处理后跳过 pkt_len + YMODEM_PACKET_OVERHEAD 字节
+ */
+static enum ymodem_recv ymodem_recv_packet(ehshell_cmd_context_t *cmd_context, struct ymodem_frame *f){
+    int32_t readable = 0;
+    eh_ringbuf_t *ringbuf = ehshell_command_input_ringbuf(cmd_context, &readable);
+    uint8_t head[3];
+    uint8_t crc[2];
+    int32_t data_len;
+    while(ringbuf && readable > 0){
+        eh_ringbuf_peek_copy(ringbuf, 0, head, 1);
+        switch(head[0]){
+            case YMODEM_SOH:
+                data_len = YMODEM_SOH_DATA_SIZE;
+                break;
+            case YMODEM_STX:
+                data_len = YMODEM_STX_DATA_SIZE;
+                break;
+            case YMODEM_EOT:
+                eh_ringbuf_read_skip(ringbuf, 1);
+                return YMODEM_RECV_EOT;
+            case YMODEM_CAN:
+                if(readable < 2)
+                    goto again;
+                eh_ringbuf_peek_copy(ringbuf, 0, head, 2);
+                if(head[1] == YMODEM_CAN){
+                    eh_ringbuf_read_skip(ringbuf, 2);
+                    return YMODEM_RECV_CANCEL;
+                }
+                _fallthrough;
+            default:
+                /* 丢弃包头之前的噪声 */
+                eh_ringbuf_read_skip(ringbuf, 1);
+                readable--;
+                continue;
+        }
+        if(readable < data_len + YMODEM_PACKET_OVERHEAD)
+            break;
+        eh_ringbuf_peek_copy(ringbuf, 0, head, 3);
+        eh_ringbuf_peek_copy(ringbuf, 3 + data_len, crc, 2);
+        if((uint8_t)(head[1] ^ head[2]) != 0xFF ||
+            ymodem_ringbuf_crc16(ringbuf, 3, data_len) != (uint16_t)((crc[0] << 8) | crc[1])){
+            eh_ringbuf_read_skip(ringbuf, data_len + YMODEM_PACKET_OVERHEAD);
+            return YMODEM_RECV_BAD;
+        }
+        f->pkt_seq = head[1];
+        f->pkt_len = (uint16_t)data_len;
+        return YMODEM_RECV_PACKET;
+    }
+again:
+    if(ehshell_command_sleep_done(cmd_context))
+        return YMODEM_RECV_TIMEOUT;
+    return YMODEM_RECV_AGAIN;
+}
+
+static int ymodem_recv_reply(ehshell_cmd_context_t *cmd_context){
+    int32_t readable = 0;
+    eh_ringbuf_t *ringbuf = ehshell_command_input_ringbuf(cmd_context, &readable);
+    uint8_t c[2];
+    if(ringbuf && readable > 0){
+        eh_ringbuf_peek_copy(ringbuf, 0, c, 1);
+        if(c[0] != YMODEM_CAN){
+            eh_ringbuf_read_skip(ringbuf, 1);
+            return c[0];
+        }
+        if(readable >= 2){
+            eh_ringbuf_peek_copy(ringbuf, 0, c, 2);
+            if(c[1] == YMODEM_CAN){
+                eh_ringbuf_read_skip(ringbuf, 2);
+                return YMODEM_REPLY_CANCEL;
+            }
+            eh_ringbuf_read_skip(ringbuf, 1);
+            return c[0];
+        }
+    }
+    if(ehshell_command_sleep_done(cmd_context))
+        return YMODEM_REPLY_TIMEOUT;
+    return YMODEM_REPLY_NONE;
+}
+
+static void ymodem_close(struct ymodem_frame *f, int status){
+    if(!f->in_file)
+        return ;
+    if(f->backend->close)
+        f->backend->close(f->handle, status);
+    f->in_file = false;
+    f->handle = NULL;
+}
+
+/* rz: 处理文件头数据包，返回1表示批量传输结束 */
+static int ymodem_rz_header(ehshell_cmd_context_t *cmd_context, struct ymodem_frame *f, eh_ringbuf_t *ringbuf){
+    char head[YMODEM_SOH_DATA_SIZE + 1];
+    size_t name_len;
+    uint32_t size;
+    void *handle;
+    eh_ringbuf_peek_copy(ringbuf, 3, (uint8_t *)head, YMODEM_SOH_DATA_SIZE);
+    head[YMODEM_SOH_DATA_SIZE] = '\0';
+    if(head[0] == '\0'){
+        ymodem_putc(cmd_context, YMODEM_ACK);
+        return 1;
+    }
+    name_len = strlen(head);
+    if(name_len >= YMODEM_SOH_DATA_SIZE)
+        return EH_RET_INVALID_PARAM;
+    size = (uint32_t)strtoul(head + name_len + 1, NULL, 10);
+    handle = f->backend->open(head, true, &size);
+    if(eh_ptr_to_error(handle) < 0)
+        return eh_ptr_to_error(handle);
+    strncpy(f->file_name, head, sizeof(f->file_name) - 1);
+    f->file_name[sizeof(f->file_name) - 1] = '\0';
+    f->handle = handle;
+    f->file_size = size;
+    f->offset = 0;
+    f->crc32 = 0xFFFFFFFF;
+    f->expect_seq = 1;
+    f->in_file = true;
+    if(f->mode == YMODEM_CRC)
+        ymodem_putc(cmd_context, YMODEM_ACK);
+    ymodem_putc(cmd_context, f->mode);
+    return 0;
+}
+
+/* rz: 处理一个校验通过的数据包 */
+static int ymodem_rz_packet(ehshell_cmd_context_t *cmd_context, struct ymodem_frame *f, eh_ringbuf_t *ringbuf){
+    int32_t len;
+    int ret;
+    if(!f->in_file){
+        if(f->pkt_seq != 0){
+            /* 等待文件头时收到数据包，重新请求文件头 */
+            ymodem_putc(cmd_context, f->mode);
+            return 0;
+        }
+        return ymodem_rz_header(cmd_context, f, ringbuf);
+    }
+    if(f->pkt_seq == (uint8_t)(f->expect_seq - 1)){
+        /* 重复包，上一次的应答丢失 */
+        if(f->mode == YMODEM_CRC)
+            ymodem_putc(cmd_context, YMODEM_ACK);
+        if(f->offset == 0 && f->pkt_seq == 0)
+            ymodem_putc(cmd_context, f->mode);
+        return 0;
+    }
+    if(f->pkt_seq != f->expect_seq)
+        return EH_RET_FAULT;
+    len = f->pkt_len;
+    if(f->file_size && f->file_size - f->offset < (uint32_t)len)
+        len = (int32_t)(f->file_size - f->offset);
+    ret = ymodem_ringbuf_sink(f, ringbuf, 3, len);
+    if(ret < 0)
+        return ret;
+    f->expect_seq++;
+    if(f->mode == YMODEM_CRC)
+        ymodem_putc(cmd_context, YMODEM_ACK);
+    return 0;
+}
+
+static void ymodem_print_result(ehshell_cmd_context_t *cmd_context, struct ymodem_frame *f, const char *cmd){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    if(f->status < 0)
+        eh_stream_printf(stream, "\r\n%s: transfer failed %d\r\n", cmd, f->status);
+    else if(f->files)
+        eh_stream_printf(stream, "\r\n%s: %u file(s) %u bytes, last %s crc32 0x%08x\r\n",
+            cmd, (unsigned)f->files, (unsigned)f->bytes, f->file_name, (unsigned)f->crc32);
+    else
+        eh_stream_printf(stream, "\r\n%s: no file transferred\r\n", cmd);
+    eh_stream_finish(stream);
+}
+
+static int ymodem_check_input_size(ehshell_cmd_context_t *cmd_context, const char *cmd){
+    int32_t total = eh_ringbuf_total_size(ehshell_input_ringbuf(ehshell_command_get_shell(cmd_context)));
+    if(total < YMODEM_PACKET_MAX){
+        eh_stream_printf(ehshell_command_stream(cmd_context), "%s: input buffer %d too small, need %d\r\n",
+            cmd, (int)total, YMODEM_PACKET_MAX);
+        return EH_RET_INVALID_STATE;
+    }
+    return EH_RET_OK;
+}
+
+static void do_rz(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    const struct ehshell_ymodem_backend *backend;
+    const char *name = NULL;
+    struct ymodem_frame *f;
+    bool streaming = false;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "-g") == 0){
+            streaming = true;
+        }else if(name == NULL){
+            name = argv[i];
+        }else{
+            name = NULL;
+            break;
+        }
+    }
+    if(name == NULL){
+        eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+        goto quit;
+    }
+    backend = ymodem_backend_find(name);
+    if(backend == NULL || backend->write == NULL){
+        eh_stream_printf(stream, "rz: backend %s not found or not writable\r\n", name);
+        goto quit;
+    }
+    if(ymodem_check_input_size(cmd_context, "rz") < 0)
+        goto quit;
+    f = ehshell_command_co_frame(cmd_context, sizeof(struct ymodem_frame));
+    if(f == NULL){
+        eh_stream_printf(stream, "rz: out of memory\r\n");
+        goto quit;
+    }
+    f->backend = backend;
+    f->mode = streaming ? YMODEM_STREAMING : YMODEM_CRC;
+    eh_stream_printf(stream, "rz: waiting for YMODEM%s sender, Ctrl+X Ctrl+X to cancel\r\n", streaming ? "-g" : "");
+    eh_stream_finish(stream);
+    ehshell_command_resume_later(cmd_context);
+    return ;
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_rz_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    struct ymodem_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct ymodem_frame));
+    eh_ringbuf_t *ringbuf;
+    int32_t readable;
+    int ret;
+    if(f == NULL){
+        ehshell_command_finish(cmd_context);
+        return ;
+    }
+    EHSHELL_CO_BEGIN(cmd_context);
+next_file:
+    f->retry = 0;
+    ymodem_putc(cmd_context, f->mode);
+    for(;;){
+        ymodem_arm_timeout(cmd_context);
+        EHSHELL_CO_AWAIT(cmd_context, (f->recv = (uint8_t)ymodem_recv_packet(cmd_context, f)) != YMODEM_RECV_AGAIN ||
+            EHSHELL_CO_CANCELLED(ehshell_event));
+        if(EHSHELL_CO_CANCELLED(ehshell_event)){
+            f->status = EH_RET_INVALID_STATE;
+            goto abort;
+        }
+        switch(f->recv){
+            case YMODEM_RECV_PACKET:
+                ringbuf = ehshell_command_input_ringbuf(cmd_context, &readable);
+                ret = ymodem_rz_packet(cmd_context, f, ringbuf);
+                eh_ringbuf_read_skip(ringbuf, f->pkt_len + YMODEM_PACKET_OVERHEAD);
+                if(ret < 0){
+                    f->status = ret;
+                    goto abort;
+                }
+                if(ret > 0)
+                    goto quit;
+                f->retry = 0;
+                break;
+            case YMODEM_RECV_EOT:
+                ymodem_putc(cmd_context, YMODEM_ACK);
+                if(!f->in_file)
+                    break;
+                ymodem_close(f, 0);
+                f->crc32 = ~f->crc32;
+                f->files++;
+                f->bytes += f->offset;
+                goto next_file;
+            case YMODEM_RECV_CANCEL:
+                f->status = EH_RET_INVALID_STATE;
+                ymodem_close(f, f->status);
+                goto quit;
+            default:
+                /* 校验失败或者超时，流式模式下无法重传 */
+                f->retry++;
+                if(f->retry > (f->in_file ? EHSHELL_CONFIG_YMODEM_MAX_RETRY : EHSHELL_CONFIG_YMODEM_START_RETRY) ||
+                    (f->in_file && f->mode == YMODEM_STREAMING)){
+                    f->status = f->recv == YMODEM_RECV_BAD ? EH_RET_FAULT : EH_RET_TIMEOUT;
+                    goto abort;
+                }
+                ymodem_purge(cmd_context);
+                ymodem_putc(cmd_context, f->in_file ? YMODEM_NAK : f->mode);
+                break;
+        }
+    }
+abort:
+    ymodem_close(f, f->status);
+    ymodem_cancel(cmd_context);
+quit:
+    ymodem_purge(cmd_context);
+    ymodem_print_result(cmd_context, f, "rz");
+    EHSHELL_CO_END(cmd_context);
+    ehshell_command_finish(cmd_context);
+}
+
+/* sz: 读取下一个数据包，返回有效数据长度，0表示文件结束 */
+static int ymodem_sz_fill(struct ymodem_frame *f){
+    uint8_t *data = f->block + 3;
+    uint16_t crc;
+    size_t want = YMODEM_STX_DATA_SIZE;
+    size_t rl = 0;
+    int ret;
+    if(f->file_size && f->file_size - f->offset <= YMODEM_SOH_DATA_SIZE)
+        want = YMODEM_SOH_DATA_SIZE;
+    while(rl < want){
+        ret = f->backend->read(f->handle, f->offset + (uint32_t)rl, data + rl, want - rl);
+        if(ret < 0)
+            return ret;
+        if(ret == 0)
+            break;
+        rl += (size_t)ret;
+    }
+    if(rl == 0)
+        return 0;
+    memset(data + rl, YMODEM_CPMEOF, want - rl);
+    f->crc32 = ymodem_crc32_update(f->crc32, data, rl);
+    f->pkt_seq++;
+    f->block[0] = want == YMODEM_STX_DATA_SIZE ? YMODEM_STX : YMODEM_SOH;
+    f->block[1] = f->pkt_seq;
+    f->block[2] = (uint8_t)~f->pkt_seq;
+    crc = ymodem_crc16_update(0, data, want);
+    data[want] = (uint8_t)(crc >> 8);
+    data[want + 1] = (uint8_t)crc;
+    f->pkt_len = (uint16_t)want;
+    f->chunk = (uint16_t)rl;
+    return (int)rl;
+}
+
+/* sz: 生成文件头数据包，name为NULL时生成批量传输结束包 */
+static void ymodem_sz_header(struct ymodem_frame *f, const char *name){
+    uint8_t *data = f->block + 3;
+    uint16_t crc;
+    memset(data, 0, YMODEM_SOH_DATA_SIZE);
+    if(name){
+        size_t name_len = strlen(name);
+        memcpy(data, name, name_len);
+        eh_snprintf((char *)data + name_len + 1, YMODEM_SOH_DATA_SIZE - name_len - 1, "%u", (unsigned)f->file_size);
+    }
+    f->pkt_seq = 0;
+    f->block[0] = YMODEM_SOH;
+    f->block[1] = 0;
+    f->block[2] = 0xFF;
+    crc = ymodem_crc16_update(0, data, YMODEM_SOH_DATA_SIZE);
+    data[YMODEM_SOH_DATA_SIZE] = (uint8_t)(crc >> 8);
+    data[YMODEM_SOH_DATA_SIZE + 1] = (uint8_t)crc;
+    f->pkt_len = YMODEM_SOH_DATA_SIZE;
+    f->chunk = 0;
+}
+
+static void do_sz(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]){
+    struct stream_base *stream = ehshell_command_stream(cmd_context);
+    const struct ehshell_ymodem_backend *backend;
+    const char *base_name;
+    struct ymodem_frame *f;
+    uint32_t size = 0;
+    void *handle;
+    if(argc != 3){
+        eh_stream_printf(stream, "Usage: %s\r\n", ehshell_command_usage(cmd_context));
+        goto quit;
+    }
+    backend = ymodem_backend_find(argv[1]);
+    if(backend == NULL || backend->read == NULL){
+        eh_stream_printf(stream, "sz: backend %s not found or not readable\r\n", argv[1]);
+        goto quit;
+    }
+    base_name = strrchr(argv[2], '/');
+    base_name = base_name ? base_name + 1 : argv[2];
+    if(strlen(base_name) == 0 || strlen(base_name) >= EHSHELL_CONFIG_YMODEM_FILE_NAME_MAX){
+        eh_stream_printf(stream, "sz: invalid file name %s\r\n", argv[2]);
+        goto quit;
+    }
+    f = ehshell_command_co_frame(cmd_context, sizeof(struct ymodem_frame) + YMODEM_PACKET_MAX);
+    if(f == NULL){
+        eh_stream_printf(stream, "sz: out of memory\r\n");
+        goto quit;
+    }
+    handle = backend->open(argv[2], false, &size);
+    if(eh_ptr_to_error(handle) < 0){
+        eh_stream_printf(stream, "sz: open %s failed %d\r\n", argv[2], eh_ptr_to_error(handle));
+        goto quit;
+    }
+    f->backend = backend;
+    f->handle = handle;
+    f->in_file = true;
+    f->file_size = size;
+    f->crc32 = 0xFFFFFFFF;
+    strcpy(f->file_name, base_name);
+    eh_stream_printf(stream, "sz: waiting for YMODEM receiver, Ctrl+X Ctrl+X to cancel\r\n");
+    eh_stream_finish(stream);
+    ehshell_command_resume_later(cmd_context);
+    return ;
+quit:
+    eh_stream_finish(stream);
+    ehshell_command_finish(cmd_context);
+}
+
+static void do_sz_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+    struct ymodem_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct ymodem_frame) + YMODEM_PACKET_MAX);
+    int ret;
+    if(f == NULL){
+        ehshell_command_finish(cmd_context);
+        return ;
+    }
+    EHSHELL_CO_BEGIN(cmd_context);
+    /* 等待接收端发起传输 */
+    for(f->retry = 0; ; ){
+        ymodem_arm_timeout(cmd_context);
+        EHSHELL_CO_AWAIT(cmd_context, (f->reply = ymodem_recv_reply(cmd_context)) != YMODEM_REPLY_NONE ||
+            EHSHELL_CO_CANCELLED(ehshell_event));
+        if(EHSHELL_CO_CANCELLED(ehshell_event) || f->reply == YMODEM_REPLY_CANCEL){
+            f->status = EH_RET_INVALID_STATE;
+            goto abort;
+        }
+        if(f->reply == YMODEM_CRC || f->reply == YMODEM_STREAMING){
+            f->mode = (uint8_t)f->reply;
+            break;
+        }
+        if(f->reply == YMODEM_REPLY_TIMEOUT && ++f->retry > EHSHELL_CONFIG_YMODEM_START_RETRY){
+            f->status = EH_RET_TIMEOUT;
+            goto abort;
+        }
+    }
+    f->phase = YMODEM_PHASE_HEADER;
+    ymodem_sz_header(f, f->file_name);
+    for(f->retry = 0; ; ){
+        if(f->phase == YMODEM_PHASE_EOT){
+            ymodem_putc(cmd_context, YMODEM_EOT);
+        }else{
+            if(f->mode == YMODEM_STREAMING){
+                EHSHELL_CO_AWAIT_WRITABLE(cmd_context, ehshell_event, (size_t)f->pkt_len + YMODEM_PACKET_OVERHEAD);
+                if(EHSHELL_CO_CANCELLED(ehshell_event)){
+                    f->status = EH_RET_INVALID_STATE;
+                    goto abort;
+                }
+            }
+            ymodem_write(cmd_context, f->block, (size_t)f->pkt_len + YMODEM_PACKET_OVERHEAD);
+        }
+        if(f->mode == YMODEM_STREAMING && f->phase <= YMODEM_PHASE_DATA){
+            /* 流式模式不等待应答，只检查接收端是否取消 */
+            if(ymodem_recv_reply(cmd_context) == YMODEM_REPLY_CANCEL){
+                f->status = EH_RET_INVALID_STATE;
+                goto quit;
+            }
+            f->reply = YMODEM_ACK;
+            EHSHELL_CO_YIELD_EVERY(cmd_context, f->pkt_seq, 8);
+        }else{
+            ymodem_arm_timeout(cmd_context);
+            EHSHELL_CO_AWAIT(cmd_context, ((f->reply = ymodem_recv_reply(cmd_context)) == YMODEM_ACK ||
+                f->reply == YMODEM_NAK || f->reply == YMODEM_REPLY_TIMEOUT || f->reply == YMODEM_REPLY_CANCEL) ||
+                EHSHELL_CO_CANCELLED(ehshell_event));
+        }
+        if(EHSHELL_CO_CANCELLED(ehshell_event) || f->reply == YMODEM_REPLY_CANCEL){
+            f->status = EH_RET_INVALID_STATE;
+            goto abort;
+        }
+        if(f->reply != YMODEM_ACK){
+            if(f->phase == YMODEM_PHASE_FINAL && f->reply == YMODEM_REPLY_TIMEOUT)
+                break;
+            if(++f->retry > EHSHELL_CONFIG_YMODEM_MAX_RETRY){
+                f->status = EH_RET_TIMEOUT;
+                goto abort;
+            }
+            continue;
+        }
+        f->retry = 0;
+        switch(f->phase){
+            case YMODEM_PHASE_DATA:
+                f->offset += f->chunk;
+                break;
+            case YMODEM_PHASE_FINAL:
+                goto quit;
+            default:
+                break;
+        }
+        if(f->phase == YMODEM_PHASE_HEADER || f->phase == YMODEM_PHASE_EOT){
+            /* 文件头和结束确认之后接收端会再次发起请求 */
+            ymodem_arm_timeout(cmd_context);
+            EHSHELL_CO_AWAIT(cmd_context, ((f->reply = ymodem_recv_reply(cmd_context)) == f->mode ||
+                f->reply == YMODEM_REPLY_TIMEOUT || f->reply == YMODEM_REPLY_CANCEL) || EHSHELL_CO_CANCELLED(ehshell_event));
+            if(f->reply != f->mode){
+                f->status = f->reply == YMODEM_REPLY_TIMEOUT ? EH_RET_TIMEOUT : EH_RET_INVALID_STATE;
+                goto abort;
+            }
+        }
+        if(f->phase == YMODEM_PHASE_EOT){
+            ymodem_close(f, 0);
+            f->crc32 = ~f->crc32;
+            f->files++;
+            f->bytes += f->offset;
+            f->phase = YMODEM_PHASE_FINAL;
+            ymodem_sz_header(f, NULL);
+            continue;
+        }
+        ret = ymodem_sz_fill(f);
+        if(ret < 0){
+            f->status = ret;
+            goto abort;
+        }
+        f->phase = ret ? YMODEM_PHASE_DATA : YMODEM_PHASE_EOT;
+    }
+    goto quit;
+abort:
+    ymodem_cancel(cmd_context);
+quit:
+    ymodem_close(f, f->status);
+    ymodem_purge(cmd_context);
+    ymodem_print_result(cmd_context, f, "sz");
+    EHSHELL_CO_END(cmd_context);
+    ehshell_command_finish(cmd_context);
+}
+
+#if EHSHELL_CONFIG_YMODEM_RAM_MAX_SIZE > 0
+/* 内置RAM后端，保存最后一次接收的文件，可以再通过sz发送回去 */
+static struct{
+    uint8_t    *buf;
+    uint32_t    size;
+    bool        valid;
+    bool        busy;
+    bool        writing;
+}ymodem_ram;
+
+static void *ymodem_ram_open(const char *path, bool is_write, uint32_t *size){
+    (void)path;
+    if(ymodem_ram.busy)
+        return eh_error_to_ptr(EH_RET_BUSY);
+    if(is_write){
+        if(*size == 0 || *size > EHSHELL_CONFIG_YMODEM_RAM_MAX_SIZE)
+            return eh_error_to_ptr(EH_RET_NOT_SUPPORTED);
+        if(ymodem_ram.buf)
+            eh_free(ymodem_ram.buf);
+        ymodem_ram.valid = false;
+        ymodem_ram.buf = eh_malloc(*size);
+        if(ymodem_ram.buf == NULL)
+            return eh_error_to_ptr(EH_RET_MALLOC_ERROR);
+        ymodem_ram.size = *size;
+    }else{
+        if(!ymodem_ram.valid)
+            return eh_error_to_ptr(EH_RET_NOT_EXISTS);
+        *size = ymodem_ram.size;
+    }
+    ymodem_ram.busy = true;
+    ymodem_ram.writing = is_write;
+    return &ymodem_ram;
+}
+
+static int ymodem_ram_write(void *handle, uint32_t offset, const uint8_t *buf, size_t len){
+    (void)handle;
+    if(offset > ymodem_ram.size || len > ymodem_ram.size - offset)
+        return EH_RET_INVALID_PARAM;
+    memcpy(ymodem_ram.buf + offset, buf, len);
+    return EH_RET_OK;
+}
+
+static int ymodem_ram_read(void *handle, uint32_t offset, uint8_t *buf, size_t len){
+    (void)handle;
+    if(offset >= ymodem_ram.size)
+        return 0;
+    if(len > ymodem_ram.size - offset)
+        len = ymodem_ram.size - offset;
+    memcpy(buf, ymodem_ram.buf + offset, len);
+    return (int)len;
+}
+
+static void ymodem_ram_close(void *handle, int status){
+    (void)handle;
+    if(ymodem_ram.writing){
+        ymodem_ram.valid = status == 0;
+        if(!ymodem_ram.valid){
+            eh_free(ymodem_ram.buf);
+            ymodem_ram.buf = NULL;
+        }
+    }
+    ymodem_ram.busy = false;
+}
+
+static struct ehshell_ymodem_backend ymodem_ram_backend = {
+    .name = "ram",
+    .open = ymodem_ram_open,
+    .write = ymodem_ram_write,
+    .read = ymodem_ram_read,
+    .close = ymodem_ram_close,
+};
+#endif
+
+static struct ehshell_command_info ymodem_command_info_tbl[] = {
+    {
+        .command = "rz",
+        .description = "Receive files with YMODEM(-g).",
+        .usage = "rz [-g] <backend>",
+        .flags = EHSHELL_COMMAND_REDIRECT_INPUT | EHSHELL_COMMAND_REDIRECT_RAW,
+        .do_function = do_rz,
+        .do_event_function = do_rz_event,
+    },{
+        .command = "sz",
+        .description = "Send a file with YMODEM(-g).",
+        .usage = "sz <backend> <file>",
+        .flags = EHSHELL_COMMAND_REDIRECT_INPUT | EHSHELL_COMMAND_REDIRECT_RAW,
+        .do_function = do_sz,
+        .do_event_function = do_sz_event,
+    },
+};
+
+static int __init ymodem_commands_register_init(void){
+#if EHSHELL_CONFIG_YMODEM_RAM_MAX_SIZE > 0
+    ehshell_ymodem_backend_register(&ymodem_ram_backend);
+#endif
+    return ehshell_register_commands(ymodem_command_info_tbl, EH_ARRAY_SIZE(ymodem_command_info_tbl));
+}
+ehshell_module_command_export(ymodem_commands_register_init, NULL);
@@ -24,6 +24,7 @@ typedef struct ehshell ehshell_t;
 typedef struct ehshell_cmd_context ehshell_cmd_context_t;
 typedef struct eh_ringbuf eh_ringbuf_t;
 typedef struct eh_event_flags eh_event_flags_t;
+typedef struct ehshell_prepared ehshell_prepared_t;
 struct stream_base;
 
 enum ehshell_quit_result{
@@ -35,6 +36,11 @@ struct ehshell_config{
     void (*stream_write)(ehshell_t* ehshell, const char *buf, size_t len);
     void (*stream_finish)(ehshell_t* ehshell);
     void (*input_ringbuf_process_finish)(ehshell_t* ehshell);
+    /**
+     * @brief 可选，返回输出流当前可以无阻塞写入的字节数，提供后命令可以等待输出空间，
+     *        端口在输出空间释放时应调用 ehshell_notify_processor
+     */
+    size_t (*stream_write_space)(ehshell_t* ehshell);
     const char *host;
     /**
      * @brief 退出ehshell信号函数,请在该函数中，清理ehshell实例占用的资源，否则请返回EHSHELL_QUIT_REJECTED
@@ -42,14 +48,25 @@ struct ehshell_config{
      * @return enum ehshell_quit_result 退出结果
      */
     enum ehshell_quit_result (*quit_shell)(ehshell_t* ehshell);
-    uint16_t input_ringbuf_size;
+    uint32_t input_ringbuf_size;
+    /**
+     * @brief 可选，大于 input_ringbuf_size 时启用自适应输入缓冲区，
+     *        缓冲区从 input_ringbuf_size 开始，处理时接近写满则加倍，最大到该值，
+     *        连续 EHSHELL_CONFIG_INPUT_ADAPT_SHRINK_WINDOWS 个窗口占用低于四分之一时减半，
+     *        启用后端口每次写入前都要重新调用 ehshell_input_ringbuf 获取缓冲区
+     */
+    uint32_t input_ringbuf_max;
     uint16_t input_linebuf_size;
+#define EHSHELL_CONFIG_FLAG_MACHINE_MODE (1 << 0)      /* 登录后直接进入机器模式，见 ehshell_machine.h */
+#define EHSHELL_CONFIG_FLAG_SHARDED      (1 << 1)      /* 在分片线程中处理，见 ehshell_shard.h */
+    uint16_t flags;
 };
 
 enum ehshell_event{
     EHSHELL_EVENT_SHELL_EXIT = (1 << 0),                /* 退出ehshell */
     EHSHELL_EVENT_SIGINT_REQUEST_QUIT = (1 << 1),       /* 请求外部请求退出命令 */
     EHSHELL_EVENT_RECEIVE_INPUT_DATA = (1 << 2),        /* 接收输入数据事件 */
+    EHSHELL_EVENT_RESUME = (1 << 3),                    /* 命令请求的恢复点已经就绪(让出、定时器到期、输出空间可用) */
 };
 
 
@@ -58,6 +75,8 @@ struct ehshell_command_info{
     const char *description;
     const char *usage;
 #define EHSHELL_COMMAND_REDIRECT_INPUT (1 << 0)        /* 命令行重定向输入到本命令 */
+#define EHSHELL_COMMAND_RUN_ON_WORKER  (1 << 1)        /* 命令在工作线程池中执行，不能与 EHSHELL_COMMAND_REDIRECT_INPUT 同时使用 */
+#define EHSHELL_COMMAND_REDIRECT_RAW   (1 << 2)        /* 与 EHSHELL_COMMAND_REDIRECT_INPUT 一起使用，8位透明输入，不解析转义字符，不响应Ctrl+C */
     uint32_t   flags;
 
     /**
@@ -73,12 +92,22 @@ struct ehshell_command_info{
      * @param  event_flags      事件标志位指针
      */
     void (*do_event_function)(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event);
+
+    /**
+     * @brief                   子命令表，必须按命令名升序排列，可以继续嵌套，
+     *                          执行时按参数逐级查找，命中的子命令以子命令名为argv[0]执行，
+     *                          没有命中时执行本命令的do_function，此时do_function可以为NULL(只作为分组)
+     */
+    const struct ehshell_command_info *subcommands;
+    size_t     subcommand_count;
 };
 
 #define EHSHELL_EVENT_FLAGS_SIGINT (1 << 0)
 
 /**
- * @brief                   创建ehshell实例,ehshell对象具有任务亲和性，只能在创建它的任务中进行destroy
+ * @brief                   创建ehshell实例,ehshell对象具有任务亲和性，只能在创建它的任务中进行destroy，
+ *                          带有 EHSHELL_CONFIG_FLAG_SHARDED 的实例创建后不会自动开始处理，
+ *                          设置好用户数据后调用 ehshell_notify_processor 开始
  * @param  static_config    配置参数,注意static_config的生命周期必须大于等于ehshell实例的生命周期
  *                          建议直接使用 static 关键字定义
  * @return ehshell_t*       返回ehshell实例指针,错误值由 eh_ptr_to_error() 获取
@@ -115,12 +144,60 @@ extern int ehshell_set_password(const char *password);
 
 /**
  * @brief                   获取ehshell输入环形缓冲区,可用于在中断或者任务中写入数据，
- *                          数据写入完成后应该调用ehshell_notify_process通知ehshell处理数据
+ *                          数据写入完成后应该调用ehshell_notify_process通知ehshell处理数据，
+ *                          环形缓冲区只允许一个写入者，多个输入源应使用 ehshell_input_write，
+ *                          自适应输入缓冲区会在处理时更换，不要保存返回的指针，
+ *                          中断中写入时需要在 eh_enter_critical 保护下获取并写入
  * @param  ehshell          ehshell实例指针
  * @return eh_ringbuf_t*    返回ehshell输入环形缓冲区指针
  */
 extern eh_ringbuf_t* ehshell_input_ringbuf(ehshell_t *ehshell);
 
+/**
+ * @brief                   端口写入 ehshell_input_ringbuf 时缓冲区已满，报告未能写入的字节数，
+ *                          无论这些数据被丢弃还是留在端口中稍后重试，
+ *                          下一次处理时计为一次溢出并按需扩大自适应输入缓冲区，
+ *                          可以在中断中调用，缓冲区满说明已有待处理的输入，不会再通知ehshell
+ * @param  ehshell          ehshell实例指针
+ * @param  bytes            未能写入的字节数
+ */
+extern void ehshell_input_overflow(ehshell_t *ehshell, uint32_t bytes);
+
+/**
+ * @brief                   写入输入数据，无锁，可以在多个任务和中断中同时调用，
+ *                          同一次调用的数据保持连续，队列由空变为非空时自动通知ehshell
+ * @param  ehshell          ehshell实例指针
+ * @param  buf              数据
+ * @param  len              长度
+ * @return int              返回写入的字节数，队列满时小于len，未启用返回 EH_RET_NOT_SUPPORTED
+ */
+extern int ehshell_input_write(ehshell_t *ehshell, const void *buf, size_t len);
+
+/**
+ * @brief                   获取 ehshell_input_write 因队列满未能写入的字节数的累计值
+ */
+extern uint32_t ehshell_input_dropped(ehshell_t *ehshell);
+
+struct ehshell_input_stat{
+    uint32_t        size;           /* 当前输入缓冲区大小 */
+    uint32_t        max;            /* 自适应上限，等于size表示固定大小 */
+    uint32_t        high_water;     /* 处理时观察到的最高占用 */
+    uint32_t        saturations;    /* 处理时缓冲区接近写满或发现端口报告溢出的次数 */
+    uint32_t        overflows;      /* 端口通过 ehshell_input_overflow 报告的溢出次数 */
+    uint32_t        overflow_bytes; /* 溢出时未能写入的字节数 */
+    uint32_t        grows;
+    uint32_t        shrinks;
+    uint32_t        grow_failures;  /* 达到上限、内存不足或有前台命令占用位置而无法扩大的次数 */
+};
+
+/**
+ * @brief                   获取输入缓冲区的占用统计和自适应调整记录
+ * @param  ehshell          ehshell实例指针
+ * @param  stat             输出统计
+ * @return int              成功返回0, 失败返回负数
+ */
+extern int ehshell_input_get_stat(ehshell_t *ehshell, struct ehshell_input_stat *stat);
+
 /**
  * @brief                   通知ehshell处理输入环形缓冲区,或者通知处理其他任务
  * @param  ehshell          ehshell实例指针
@@ -145,6 +222,29 @@ extern int ehshell_command_run(ehshell_t *ehshell, int argc, const char *argv[])
  */
 extern int ehshell_command_run_form_string(ehshell_t *ehshell, const char *cmd_str);
 
+/**
+ * @brief                   预先解析命令字符串，查找命令并切分参数，
+ *                          适合周期性重复执行同一条命令，句柄不绑定ehshell实例，可以在多个实例中使用，
+ *                          必须在命令注册完成后调用
+ * @param  cmd_str          命令字符串，末尾为 & 时在后台执行
+ * @return ehshell_prepared_t* 返回命令句柄,错误值由 eh_ptr_to_error() 获取
+ */
+extern ehshell_prepared_t *ehshell_command_prepare(const char *cmd_str);
+
+/**
+ * @brief                   执行预先解析的命令，不申请内存(后台命令和工作线程命令除外)也不再解析字符串
+ * @param  ehshell          ehshell实例指针
+ * @param  prepared         命令句柄，命令运行期间不能释放
+ * @return int              成功返回0, 失败返回负数
+ */
+extern int ehshell_command_run_prepared(ehshell_t *ehshell, const ehshell_prepared_t *prepared);
+
+/**
+ * @brief                   释放命令句柄
+ * @param  prepared         命令句柄
+ */
+extern void ehshell_command_prepared_free(ehshell_prepared_t *prepared);
+
 /**
  * @brief                   获取ehshell命令处理流
  * @param  cmd_context      命令上下文指针
@@ -152,6 +252,15 @@ extern int ehshell_command_run_form_string(ehshell_t *ehshell, const char *cmd_s
  */
 extern struct stream_base *ehshell_command_stream(ehshell_cmd_context_t *cmd_context);
 
+/**
+ * @brief                   向命令输出流写入一段已经格式化好的数据，
+ *                          适合整块渲染后一次输出，避免逐字节调用 eh_stream_printf
+ * @param  cmd_context      命令上下文指针
+ * @param  buf              数据指针
+ * @param  len              数据长度
+ */
+extern void ehshell_command_write(ehshell_cmd_context_t *cmd_context, const char *buf, size_t len);
+
 /**
  * @brief                   获取ehshell命令使用说明字符串
  * @param  cmd_context      命令上下文指针
@@ -181,6 +290,43 @@ extern ehshell_t* ehshell_command_get_shell(ehshell_cmd_context_t *cmd_context);
  */
 extern void ehshell_command_finish(ehshell_cmd_context_t *cmd_context);
 
+/**
+ * @brief                   取出并清除命令的待处理事件，用于 EHSHELL_COMMAND_RUN_ON_WORKER 命令，
+ *                          这类命令不会收到 do_event_function 回调，需要在处理循环中自行查询
+ *                          SIGINT 及 shell 退出事件，其他命令始终返回0
+ * @param  cmd_context      命令上下文指针
+ * @return uint32_t         enum ehshell_event 事件位的组合
+ */
+extern uint32_t ehshell_command_pending_events(ehshell_cmd_context_t *cmd_context);
+
+/**
+ * @brief                   从命令的arena中申请内存，按8字节对齐，不需要也不能单独释放，
+ *                          命令结束(ehshell_command_finish)时一次性全部回收
+ * @param  cmd_context      命令上下文指针
+ * @param  size             申请大小
+ * @return void*            成功返回内存指针，失败返回NULL
+ */
+extern void *ehshell_command_arena_alloc(ehshell_cmd_context_t *cmd_context, size_t size);
+
+/**
+ * @brief                   同 ehshell_command_arena_alloc，返回的内存已经清零
+ */
+extern void *ehshell_command_arena_zalloc(ehshell_cmd_context_t *cmd_context, size_t size);
+
+/**
+ * @brief                   获取ehshell实例上单次命令arena用量的最大值，用于调整页大小
+ * @param  ehshell          ehshell实例指针
+ * @return size_t           字节数
+ */
+extern size_t ehshell_arena_high_water(ehshell_t *ehshell);
+
+/**
+ * @brief                   设置命令退出状态，默认为0，机器模式下随结束帧返回给客户端
+ * @param  cmd_context      命令上下文指针
+ * @param  status           退出状态
+ */
+extern void ehshell_command_set_exit_status(ehshell_cmd_context_t *cmd_context, int status);
+
 /**
  * @brief                   设置ehshell命令上下文用户数据
  * @param  cmd_context      命令上下文指针
@@ -37,6 +37,198 @@ extern "C"{
 #define EHSHELL_CONFIG_ARGC_MAX                    (8)
 #endif
 
+#ifndef EHSHELL_CONFIG_TIMER_TICK_MS
+#define EHSHELL_CONFIG_TIMER_TICK_MS               (100)
+#endif
+
+/* 每个shell单次调度最多处理的字节数，输入和端口输出都计入，超出后排到就绪队列尾部等待下一轮，
+ * 输出超出后本轮不再恢复该shell的命令 */
+#ifndef EHSHELL_CONFIG_DISPATCH_BYTE_BUDGET
+#define EHSHELL_CONFIG_DISPATCH_BYTE_BUDGET        (64)
+#endif
+
+/* 调度器单次运行的时间预算(us)，超出后让出事件循环 */
+#ifndef EHSHELL_CONFIG_DISPATCH_TIME_BUDGET_US
+#define EHSHELL_CONFIG_DISPATCH_TIME_BUDGET_US     (2000)
+#endif
+
+/* 工作线程命令的输出通道大小，通道满时工作线程阻塞等待shell读出 */
+#ifndef EHSHELL_CONFIG_WORKER_CHANNEL_SIZE
+#define EHSHELL_CONFIG_WORKER_CHANNEL_SIZE         (1024)
+#endif
+
+/* shell从输出通道中每次读出的字节数 */
+#ifndef EHSHELL_CONFIG_WORKER_DRAIN_CHUNK
+#define EHSHELL_CONFIG_WORKER_DRAIN_CHUNK          (128)
+#endif
+
+#ifndef EHSHELL_CONFIG_WORKER_STACK_SIZE
+#define EHSHELL_CONFIG_WORKER_STACK_SIZE           (8192)
+#endif
+
+/* rz/sz 等待应答或数据包的超时时间(ms) */
+#ifndef EHSHELL_CONFIG_YMODEM_TIMEOUT_MS
+#define EHSHELL_CONFIG_YMODEM_TIMEOUT_MS           (3000)
+#endif
+
+/* rz/sz 传输中连续出错的最大重试次数 */
+#ifndef EHSHELL_CONFIG_YMODEM_MAX_RETRY
+#define EHSHELL_CONFIG_YMODEM_MAX_RETRY            (10)
+#endif
+
+/* rz/sz 等待对端启动传输的最大重试次数，每次间隔 EHSHELL_CONFIG_YMODEM_TIMEOUT_MS */
+#ifndef EHSHELL_CONFIG_YMODEM_START_RETRY
+#define EHSHELL_CONFIG_YMODEM_START_RETRY          (20)
+#endif
+
+#ifndef EHSHELL_CONFIG_YMODEM_FILE_NAME_MAX
+#define EHSHELL_CONFIG_YMODEM_FILE_NAME_MAX        (64)
+#endif
+
+/* 内置ram传输后端可接收的最大文件大小，0表示不启用ram后端 */
+#ifndef EHSHELL_CONFIG_YMODEM_RAM_MAX_SIZE
+#define EHSHELL_CONFIG_YMODEM_RAM_MAX_SIZE         (64 * 1024)
+#endif
+
+/* md 单次渲染输出的最大行数，每行16字节 */
+#ifndef EHSHELL_CONFIG_MEMORY_CHUNK_ROWS
+#define EHSHELL_CONFIG_MEMORY_CHUNK_ROWS           (16)
+#endif
+
+/* mfill/mcmp/msearch 单次处理的字节数，处理完一段后让出事件循环 */
+#ifndef EHSHELL_CONFIG_MEMORY_CHUNK_BYTES
+#define EHSHELL_CONFIG_MEMORY_CHUNK_BYTES          (4096)
+#endif
+
+/* mcmp/msearch 最多打印的结果条数 */
+#ifndef EHSHELL_CONFIG_MEMORY_REPORT_MAX
+#define EHSHELL_CONFIG_MEMORY_REPORT_MAX           (16)
+#endif
+
+/* 内存命令测试缓冲区大小，非0时地址参数可以写 test，用于主机端调试 */
+#ifndef EHSHELL_CONFIG_MEMORY_TEST_BUFFER_SIZE
+#define EHSHELL_CONFIG_MEMORY_TEST_BUFFER_SIZE     (0)
+#endif
+
+/* 机器模式输出帧的最大数据长度，输出先在shell中缓存，满或者流结束时封成一帧 */
+#ifndef EHSHELL_CONFIG_MACHINE_OUTPUT_CHUNK
+#define EHSHELL_CONFIG_MACHINE_OUTPUT_CHUNK        (256)
+#endif
+
+/* 命令arena的页大小，含页头，超过一页的申请使用独占的大页 */
+#ifndef EHSHELL_CONFIG_ARENA_PAGE_SIZE
+#define EHSHELL_CONFIG_ARENA_PAGE_SIZE             (1024)
+#endif
+
+/* 每个shell空闲页池保留的最大页数，超出的页释放回堆 */
+#ifndef EHSHELL_CONFIG_ARENA_POOL_PAGES
+#define EHSHELL_CONFIG_ARENA_POOL_PAGES            (2)
+#endif
+
+/* watch 虚拟屏幕的行列数，超出部分的输出被丢弃 */
+#ifndef EHSHELL_CONFIG_WATCH_ROWS
+#define EHSHELL_CONFIG_WATCH_ROWS                  (24)
+#endif
+
+#ifndef EHSHELL_CONFIG_WATCH_COLS
+#define EHSHELL_CONFIG_WATCH_COLS                  (80)
+#endif
+
+/* watch 未指定 -n 时的刷新间隔(ms) */
+#ifndef EHSHELL_CONFIG_WATCH_INTERVAL_MS
+#define EHSHELL_CONFIG_WATCH_INTERVAL_MS           (2000)
+#endif
+
+/* 共享日志环形缓冲区大小，必须是2的幂，写满后覆盖最旧的记录 */
+#ifndef EHSHELL_CONFIG_LOG_RING_SIZE
+#define EHSHELL_CONFIG_LOG_RING_SIZE               (4096)
+#endif
+
+/* 日志记录中模块名的最大长度，超出部分被截断 */
+#ifndef EHSHELL_CONFIG_LOG_MODULE_MAX
+#define EHSHELL_CONFIG_LOG_MODULE_MAX              (16)
+#endif
+
+/* 多生产者输入队列大小，必须是2的幂，0表示不启用 ehshell_input_write */
+#ifndef EHSHELL_CONFIG_INPUT_QUEUE_SIZE
+#define EHSHELL_CONFIG_INPUT_QUEUE_SIZE            (512)
+#endif
+
+/* 自适应输入缓冲区的统计窗口(ms)，每个窗口结束时判断是否缩小 */
+#ifndef EHSHELL_CONFIG_INPUT_ADAPT_WINDOW_MS
+#define EHSHELL_CONFIG_INPUT_ADAPT_WINDOW_MS       (2000)
+#endif
+
+/* 连续多少个窗口的最高占用低于四分之一时，自适应输入缓冲区减半 */
+#ifndef EHSHELL_CONFIG_INPUT_ADAPT_SHRINK_WINDOWS
+#define EHSHELL_CONFIG_INPUT_ADAPT_SHRINK_WINDOWS  (5)
+#endif
+
+/* 生成器输出每轮调度最多调用 next_chunk 的次数，之后让出事件循环 */
+#ifndef EHSHELL_CONFIG_GENERATE_PASS_CHUNKS
+#define EHSHELL_CONFIG_GENERATE_PASS_CHUNKS        (16)
+#endif
+
+/* 事件循环卡顿检测的默认预算(us)，单次命令回调或shell处理超过预算时记录，0表示不启用 */
+#ifndef EHSHELL_CONFIG_STALL_BUDGET_US
+#define EHSHELL_CONFIG_STALL_BUDGET_US             (10000)
+#endif
+
+/* 保留的最近卡顿记录数 */
+#ifndef EHSHELL_CONFIG_STALL_RING_SIZE
+#define EHSHELL_CONFIG_STALL_RING_SIZE             (16)
+#endif
+
+/* 按命令统计的卡顿排行表大小，满后替换最大耗时最小的一项 */
+#ifndef EHSHELL_CONFIG_STALL_OFFENDERS
+#define EHSHELL_CONFIG_STALL_OFFENDERS             (8)
+#endif
+
+/* 卡顿记录中命令名的最大长度，超出部分被截断 */
+#ifndef EHSHELL_CONFIG_STALL_NAME_MAX
+#define EHSHELL_CONFIG_STALL_NAME_MAX              (16)
+#endif
+
+/* 同时运行的预编译脚本数，解释器从静态池中分配 */
+#ifndef EHSHELL_CONFIG_SCRIPT_RUNNERS
+#define EHSHELL_CONFIG_SCRIPT_RUNNERS              (1)
+#endif
+
+/* 每个脚本缓存解析结果的命令数，超出部分每次执行时按名称查找 */
+#ifndef EHSHELL_CONFIG_SCRIPT_REFS_MAX
+#define EHSHELL_CONFIG_SCRIPT_REFS_MAX             (32)
+#endif
+
+/* 脚本中 repeat 循环的最大嵌套深度 */
+#ifndef EHSHELL_CONFIG_SCRIPT_LOOP_DEPTH
+#define EHSHELL_CONFIG_SCRIPT_LOOP_DEPTH           (4)
+#endif
+
+/* 脚本解释器每轮调度最多执行的指令数，之后让出事件循环，同步结束的命令也计入 */
+#ifndef EHSHELL_CONFIG_SCRIPT_STEP_BUDGET
+#define EHSHELL_CONFIG_SCRIPT_STEP_BUDGET          (32)
+#endif
+
+/* time 命令 -r 选项的最大重复次数，每次的耗时都保存下来计算中位数 */
+#ifndef EHSHELL_CONFIG_TIME_REPEAT_MAX
+#define EHSHELL_CONFIG_TIME_REPEAT_MAX             (64)
+#endif
+
+/* 堆分配跟踪表的大小，同时存活的分配超过此数时峰值偏小 */
+#ifndef EHSHELL_CONFIG_HEAP_TRACE_SLOTS
+#define EHSHELL_CONFIG_HEAP_TRACE_SLOTS            (128)
+#endif
+
+/* 镜像输出共享段的大小，输出结束时未写满的段也会立即分发，之后的输出追加到同一段 */
+#ifndef EHSHELL_CONFIG_MIRROR_SEG_SIZE
+#define EHSHELL_CONFIG_MIRROR_SEG_SIZE             (256)
+#endif
+
+/* 每个镜像输出端最多排队的共享段数，超出后新的输出对该输出端丢弃 */
+#ifndef EHSHELL_CONFIG_MIRROR_SINK_QUEUE
+#define EHSHELL_CONFIG_MIRROR_SINK_QUEUE           (8)
+#endif
+
 #ifdef __cplusplus
 #if __cplusplus
 }
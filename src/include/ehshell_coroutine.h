@@ -0,0 +1,177 @@
+/**
+ * @file ehshell_coroutine.h
+ * @brief ehshell 无栈协程，用于需要长时间运行或者交互的命令
+ *        协程体使用 do_event_function 的函数签名，恢复点保存在命令上下文中，
+ *        局部变量在挂起后不会保留，需要跨挂起点的变量请放到 ehshell_command_co_frame() 申请的帧中
+ *
+ *        static void do_xxx_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event){
+ *            struct xxx_frame *f = ehshell_command_co_frame(cmd_context, sizeof(struct xxx_frame));
+ *            EHSHELL_CO_BEGIN(cmd_context);
+ *            for(f->i = 0; f->i < 100000; f->i++){
+ *                EHSHELL_CO_AWAIT_WRITABLE(cmd_context, ehshell_event, 64);
+ *                if(EHSHELL_CO_CANCELLED(ehshell_event))
+ *                    break;
+ *                eh_stream_printf(ehshell_command_stream(cmd_context), "%d\r\n", f->i);
+ *                EHSHELL_CO_YIELD_EVERY(cmd_context, f->i, 64);
+ *            }
+ *            EHSHELL_CO_END(cmd_context);
+ *            ehshell_command_finish(cmd_context);
+ *        }
+ *
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-09
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _EHSHELL_COROUTINE_H_
+#define _EHSHELL_COROUTINE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ehshell.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+/**
+ * @brief                   获取协程恢复点，供 EHSHELL_CO_* 宏使用
+ * @param  cmd_context      命令上下文指针
+ * @return uint16_t*        恢复点指针，0表示从头开始
+ */
+extern uint16_t *ehshell_command_co_line(ehshell_cmd_context_t *cmd_context);
+
+/**
+ * @brief                   获取协程帧，第一次调用时申请并清零，命令结束时自动释放
+ * @param  cmd_context      命令上下文指针
+ * @param  size             帧大小，同一命令每次调用必须相同
+ * @return void*            帧指针，申请失败返回NULL
+ */
+extern void *ehshell_command_co_frame(ehshell_cmd_context_t *cmd_context, size_t size);
+
+/**
+ * @brief                   请求尽快以 EHSHELL_EVENT_RESUME 事件再次调用 do_event_function，
+ *                          用于把长循环切成多段，期间其他会话和事件可以得到处理
+ * @param  cmd_context      命令上下文指针
+ */
+extern void ehshell_command_resume_later(ehshell_cmd_context_t *cmd_context);
+
+/**
+ * @brief                   判断输出流是否有至少size字节的空间，没有空间时登记等待，
+ *                          空间足够后以 EHSHELL_EVENT_RESUME 事件唤醒命令，
+ *                          端口未提供 stream_write_space 时始终返回true
+ * @param  cmd_context      命令上下文指针
+ * @param  size             需要的空间大小
+ * @return bool             空间足够返回true
+ */
+extern bool ehshell_command_wait_writable(ehshell_cmd_context_t *cmd_context, size_t size);
+
+/**
+ * @brief                   启动命令定时器，到期后以 EHSHELL_EVENT_RESUME 事件唤醒命令
+ * @param  cmd_context      命令上下文指针
+ * @param  timeout_ms       超时时间(ms)
+ * @return int              成功返回0, 失败返回负数
+ */
+extern int ehshell_command_sleep(ehshell_cmd_context_t *cmd_context, uint32_t timeout_ms);
+
+/**
+ * @brief                   查询并清除命令定时器到期标志
+ * @param  cmd_context      命令上下文指针
+ * @return bool             定时器已经到期返回true
+ */
+extern bool ehshell_command_sleep_done(ehshell_cmd_context_t *cmd_context);
+
+/**
+ * @brief                   生成器回调，每次输出一小块内容，状态保存在 ehshell_command_co_frame() 申请的帧中
+ * @param  cmd_context      命令上下文指针
+ * @param  stream           命令输出流
+ * @return int              大于0表示还有内容，0表示输出完成，负数表示出错，作为命令的退出状态
+ */
+typedef int (*ehshell_next_chunk_t)(ehshell_cmd_context_t *cmd_context, struct stream_base *stream);
+
+/**
+ * @brief                   以生成器方式输出大量内容，在 do_function 解析完参数后调用，
+ *                          之后core在输出流有至少chunk_size字节的空间时调用next_chunk，
+ *                          每轮调度最多调用 EHSHELL_CONFIG_GENERATE_PASS_CHUNKS 次，或者本次调度的预算用完后让出事件循环，
+ *                          直到next_chunk返回0或负数，或者收到 SIGINT、shell退出事件时结束命令，
+ *                          期间不再调用命令的 do_event_function
+ * @param  cmd_context      命令上下文指针
+ * @param  next_chunk       生成器回调
+ * @param  chunk_size       每次调用next_chunk前需要的输出空间
+ * @return int              成功返回0，命令可能已经结束，之后不能再访问cmd_context，
+ *                          工作线程中的命令返回 EH_RET_NOT_SUPPORTED，需要自行结束命令
+ */
+extern int ehshell_command_generate(ehshell_cmd_context_t *cmd_context, ehshell_next_chunk_t next_chunk, size_t chunk_size);
+
+#define EHSHELL_CO_CANCELLED(ehshell_event) \
+    (((ehshell_event) & (EHSHELL_EVENT_SIGINT_REQUEST_QUIT | EHSHELL_EVENT_SHELL_EXIT)) != 0)
+
+#define EHSHELL_CO_BEGIN(cmd_context)                                               \
+    {                                                                               \
+        uint16_t *_ehshell_co_line = ehshell_command_co_line(cmd_context);          \
+        switch(*_ehshell_co_line){                                                  \
+            case 0:
+
+#define EHSHELL_CO_END(cmd_context)                                                 \
+            default:                                                                \
+                break;                                                              \
+        }                                                                           \
+        *_ehshell_co_line = 0;                                                      \
+    }
+
+/* 挂起直到cond成立，每次命令收到事件时重新求值 */
+#define EHSHELL_CO_AWAIT(cmd_context, cond)                                         \
+    do{                                                                             \
+        *_ehshell_co_line = (uint16_t)__LINE__;                                     \
+        /* fall through */                                                          \
+        case __LINE__:                                                              \
+        if(!(cond))                                                                 \
+            return;                                                                 \
+    }while(0)
+
+/* 让出事件循环，稍后以 EHSHELL_EVENT_RESUME 事件继续 */
+#define EHSHELL_CO_YIELD(cmd_context)                                               \
+    do{                                                                             \
+        *_ehshell_co_line = (uint16_t)__LINE__;                                     \
+        ehshell_command_resume_later(cmd_context);                                  \
+        return;                                                                     \
+        case __LINE__:;                                                             \
+    }while(0)
+
+/* 每执行n次让出一次，counter需要保存在协程帧中 */
+#define EHSHELL_CO_YIELD_EVERY(cmd_context, counter, n)                             \
+    do{                                                                             \
+        if(((counter) + 1) % (n) == 0)                                              \
+            EHSHELL_CO_YIELD(cmd_context);                                          \
+    }while(0)
+
+/* 等待重定向输入中至少有min字节可读，ringbuf和readable为输出参数 */
+#define EHSHELL_CO_INPUT_READY(cmd_context, ringbuf, readable, min)                 \
+    ((((ringbuf) = ehshell_command_input_ringbuf(cmd_context, &(readable))) != NULL) && (readable) >= (int32_t)(min))
+
+#define EHSHELL_CO_AWAIT_INPUT(cmd_context, ehshell_event, ringbuf, readable, min)  \
+    EHSHELL_CO_AWAIT(cmd_context, EHSHELL_CO_INPUT_READY(cmd_context, ringbuf, readable, min) || EHSHELL_CO_CANCELLED(ehshell_event))
+
+#define EHSHELL_CO_AWAIT_WRITABLE(cmd_context, ehshell_event, size)                 \
+    EHSHELL_CO_AWAIT(cmd_context, ehshell_command_wait_writable(cmd_context, size) || EHSHELL_CO_CANCELLED(ehshell_event))
+
+#define EHSHELL_CO_SLEEP(cmd_context, ehshell_event, ms)                            \
+    do{                                                                             \
+        ehshell_command_sleep(cmd_context, ms);                                     \
+        EHSHELL_CO_AWAIT(cmd_context, ehshell_command_sleep_done(cmd_context) || EHSHELL_CO_CANCELLED(ehshell_event)); \
+    }while(0)
+
+#define EHSHELL_CO_AWAIT_SIGINT(cmd_context, ehshell_event)                         \
+    EHSHELL_CO_AWAIT(cmd_context, EHSHELL_CO_CANCELLED(ehshell_event))
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _EHSHELL_COROUTINE_H_
@@ -0,0 +1,87 @@
+/**
+ * @file ehshell_exec.h
+ * @brief ehshell 无终端命令执行，用于把命令集开放给MQTT、CoAP、内部RPC等通道，
+ *        不需要创建ehshell实例，没有欢迎信息、提示符和行缓冲区，
+ *        命令输出直接写入请求方提供的缓冲区段，命令结束时通过回调返回退出状态
+ *
+ *        static char buf[256];
+ *        static struct ehshell_exec_segment seg = { .buf = buf, .size = sizeof(buf) };
+ *        static struct ehshell_exec_request req = { .output = &seg, .done = on_done };
+ *        ehshell_exec(&req, "md 0x20000000 64");
+ *
+ *        不支持 EHSHELL_COMMAND_REDIRECT_INPUT 和 EHSHELL_COMMAND_RUN_ON_WORKER 命令，
+ *        命令中 ehshell_command_get_shell() 返回NULL
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-22
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _EHSHELL_EXEC_H_
+#define _EHSHELL_EXEC_H_
+
+#include <stddef.h>
+#include <ehshell.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+struct ehshell_exec;
+
+struct ehshell_exec_segment{
+    char                            *buf;
+    size_t                           size;
+    size_t                           len;       /* 已写入的长度，由执行器填写 */
+    struct ehshell_exec_segment     *next;
+};
+
+struct ehshell_exec_request{
+    /* 输出段链表，按顺序写满，全部写满后的输出被丢弃，为NULL时丢弃全部输出 */
+    struct ehshell_exec_segment     *output;
+    /**
+     * @brief                   命令结束回调，每个成功启动的请求调用一次，可能在 ehshell_exec 返回前调用，
+     *                          回调返回后执行器不再访问request
+     * @param  request          请求指针
+     * @param  status           命令退出状态，见 ehshell_command_set_exit_status
+     */
+    void (*done)(struct ehshell_exec_request *request, int status);
+    void                            *user_data;
+    /* 以下由执行器填写 */
+    size_t                           output_len;
+    size_t                           dropped;   /* 输出段空间不足被丢弃的字节数 */
+    struct ehshell_exec             *exec;      /* 运行中的执行上下文，结束后为NULL */
+};
+
+/**
+ * @brief                   无终端执行命令字符串，末尾的 & 被忽略
+ * @param  request          请求，命令结束前必须保持有效
+ * @param  cmd_str          命令字符串
+ * @return int              启动成功返回0，失败返回负数且不会调用done回调，分片线程中返回 EH_RET_NOT_SUPPORTED
+ */
+extern int ehshell_exec(struct ehshell_exec_request *request, const char *cmd_str);
+
+/**
+ * @brief                   无终端执行预先解析的命令，不再解析字符串
+ * @param  request          请求，命令结束前必须保持有效
+ * @param  prepared         命令句柄，命令结束前不能释放
+ * @return int              启动成功返回0，失败返回负数且不会调用done回调，分片线程中返回 EH_RET_NOT_SUPPORTED
+ */
+extern int ehshell_exec_prepared(struct ehshell_exec_request *request, const ehshell_prepared_t *prepared);
+
+/**
+ * @brief                   请求取消正在执行的命令，相当于Ctrl+C，命令结束时仍然调用done回调
+ * @param  request          请求
+ */
+extern void ehshell_exec_cancel(struct ehshell_exec_request *request);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _EHSHELL_EXEC_H_
@@ -14,9 +14,11 @@
 #include <stdint.h>
 #include <eh.h>
 #include <eh_types.h>
+#include <eh_list.h>
 #include <eh_signal.h>
 #include <eh_formatio.h>
 #include <ehshell_config.h>
+#include <ehshell_timer.h>
 
 #ifdef __cplusplus
 #if __cplusplus
@@ -26,9 +28,11 @@ extern "C"{
 
 typedef struct eh_ringbuf eh_ringbuf_t;
 struct ehshell_config ;
+struct ehshell_machine;
 struct ehshell_command_info;
 typedef struct ehshell ehshell_t;
 enum ehshell_escape_char;
+enum ehshell_event;
 
 enum ehshell_state{
     EHSHELL_INIT = 0,
@@ -44,7 +48,32 @@ typedef struct ehshell_cmd_context{
     const struct ehshell_command_info   *command_info;
     ehshell_t                           *ehshell;
 #define EHSHELL_CMD_CONTEXT_FLAG_BACKGROUND     (1 << 0)
+#define EHSHELL_CMD_CONTEXT_FLAG_WORKER         (1 << 1)     /* 工作线程中的命令上下文 */
+#define EHSHELL_CMD_CONTEXT_FLAG_RESUME_PENDING (1 << 2)     /* 等待以 EHSHELL_EVENT_RESUME 恢复 */
+#define EHSHELL_CMD_CONTEXT_FLAG_SLEEP_DONE     (1 << 3)     /* 命令定时器已经到期 */
+#define EHSHELL_CMD_CONTEXT_FLAG_CAPTURE        (1 << 4)     /* 由其他命令启动，输出被捕获的子命令上下文 */
+#define EHSHELL_CMD_CONTEXT_FLAG_ARENA_LARGE    (1 << 5)     /* arena中有独占的大页 */
+#define EHSHELL_CMD_CONTEXT_FLAG_HEADLESS       (1 << 6)     /* 无终端执行的命令，ehshell为NULL */
     uint32_t                             flags;
+    struct stream_base                  *stream;
+    void                                *worker_job;
+    int                                  exit_status;
+    /* 协程帧 */
+    uint16_t                             co_line;
+    uint32_t                             co_wait_writable;
+    void                                *co_frame;
+    ehshell_timer_t                      co_timer;
+    /* 生成器输出，gen_next非NULL时事件由core处理 */
+    int                                (*gen_next)(struct ehshell_cmd_context *cmd_context, struct stream_base *stream);
+    uint32_t                             gen_chunk;
+    /* 捕获输出的子命令 */
+    struct ehshell_cmd_context          *capture_child;
+    struct ehshell_cmd_context          *capture_owner;
+    eh_clock_t                           capture_finish_time;   /* 子命令调用 ehshell_command_finish 的时间 */
+    /* arena页链，尾部的页用于bump分配 */
+    struct eh_list_head                  arena_pages;
+    uint16_t                             arena_page_count;
+    uint32_t                             arena_used;
 }ehshell_cmd_context_t;
 
 #ifdef CONFIG_PACKAGE_EHSHELL_USE_PASSWORD
@@ -57,8 +86,37 @@ struct ehshell{
     ehshell_cmd_context_t *cmd_background[CONFIG_PACKAGE_EHSHELL_MAX_BACKGROUND_COMMAND_SIZE];
     ehshell_cmd_context_t cmd_current;
     struct stream_function_no_cache stream;
-    eh_signal_base_t    sig_notify_process;
-    eh_signal_slot_t    slot_notify_process;
+    struct eh_list_head ready_node;         /* 挂入全局就绪队列，空链表表示未就绪 */
+    int32_t             dispatch_budget;    /* 本次调度剩余可处理的字节数，输入和端口输出都计入 */
+    uint8_t             co_rotor;           /* 下一轮调度最先恢复的命令序号 */
+    struct ehshell_machine *machine;        /* 机器模式状态，NULL表示交互模式 */
+    bool                machine_pending;    /* 在下一次复位时进入机器模式 */
+    struct eh_list_head arena_free;         /* 命令arena的空闲页池 */
+    uint16_t            arena_free_count;
+    uint32_t            arena_high_water;   /* 单次命令arena用量的最大值 */
+    struct ehshell_recorder *recorder;      /* 会话录制器，NULL表示未录制 */
+    uint32_t            record_input_pos;   /* 输入缓冲区中已录制到的位置 */
+    struct eh_list_head sinks;              /* 镜像输出端 */
+    struct ehshell_mirror_seg *mirror_seg;  /* 正在填充的共享输出段 */
+#if EHSHELL_CONFIG_INPUT_QUEUE_SIZE > 0
+    struct ehshell_input_queue *input_queue; /* ehshell_input_write 的多生产者队列 */
+#endif
+    /* 输入缓冲区占用统计和自适应大小 */
+    uint32_t            input_size;
+    uint32_t            input_high_water;
+    uint32_t            input_window_high;  /* 本窗口内的最高占用 */
+    uint32_t            input_saturations;
+    uint32_t            input_overflows;        /* 端口报告，原子更新 */
+    uint32_t            input_overflow_bytes;
+    uint32_t            input_overflows_seen;   /* 上次处理时看到的溢出次数 */
+    uint32_t            input_grows;
+    uint32_t            input_shrinks;
+    uint32_t            input_grow_failures;
+    uint8_t             input_low_windows;  /* 连续低占用的窗口数 */
+    ehshell_timer_t     input_adapt_timer;
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+    struct ehshell_shard *shard;            /* 所属分片，NULL表示在主事件循环中处理 */
+#endif
     enum ehshell_state state;
     union{
         struct{
@@ -73,8 +131,7 @@ struct ehshell{
 #ifdef CONFIG_PACKAGE_EHSHELL_USE_PASSWORD
     uint64_t            login_hash;
 #if CONFIG_PACKAGE_EHSHELL_PASSWORD_TIMEOUT > 0
-    eh_signal_slot_t    slot_1s_timer_process;
-    uint32_t            login_downcounter;
+    ehshell_timer_t     login_timer;
 #endif
 #endif
 
@@ -87,12 +144,231 @@ struct ehshell{
 
 extern enum ehshell_escape_char ehshell_escape_char_parse(struct ehshell* shell, const char input);
 
+struct ehshell_prepared{
+    const struct ehshell_command_info   *command_info;
+    int                                  argc;
+    bool                                 is_background;
+    const char                          *argv[EHSHELL_CONFIG_ARGC_MAX];
+    char                                 cmd_str[];
+};
+
 const struct ehshell_command_info* ehshell_command_find(ehshell_t *ehshell, const char *command);
+extern const struct ehshell_command_info* ehshell_command_lookup(const char *command);
+extern const struct ehshell_command_info* ehshell_subcommand_lookup(const struct ehshell_command_info *parent, const char *command);
+
+/**
+ * @brief                   按参数沿子命令表逐级向下查找，argc/argv调整为命中的子命令
+ * @return const struct ehshell_command_info* 最深一级命中的命令
+ */
+extern const struct ehshell_command_info* ehshell_command_descend(const struct ehshell_command_info *command_info,
+    int *argc, const char ***argv);
+
+/* 打印命令的子命令列表 */
+extern void ehshell_command_print_subcommands(struct stream_base *stream, const struct ehshell_command_info *command_info);
+
+/**
+ * @brief                   就地切分命令行，处理引号和转义
+ * @param  err              出错时返回错误描述
+ * @return int              返回参数个数，出错返回负数
+ */
+extern int ehshell_command_split(char *cmd_str, const char *argv[], const char **err);
+
+extern void ehshell_cmd_context_init(ehshell_cmd_context_t *ctx, ehshell_t *ehshell, 
+    const struct ehshell_command_info *command_info, struct stream_base *stream, uint32_t flags);
+
+struct ehshell_command_table{
+    struct ehshell_command_table           *retired;    /* 已被替换、等待释放的旧快照 */
+    size_t                                  count;
+    const struct ehshell_command_info      *commands[];
+};
+
+/* 当前命令注册表快照，按命令名有序，发布后不再修改 */
+extern const struct ehshell_command_table *ehshell_command_snapshot(void);
 
 extern size_t ehshell_commands_count(void);
 
+extern int _ehshell_command_run_form_string(ehshell_t *ehshell, char *cmd_str);
+
+/* 直接写入端口的输出，录制器在这里记录输出 */
+extern void ehshell_port_write(ehshell_t *shell, const char *buf, size_t len);
+extern void ehshell_recorder_output(ehshell_t *shell, const char *buf, size_t len);
+extern void ehshell_recorder_input(ehshell_t *shell);
+/* 端口输出复制到共享段，段写满时封口 */
+extern void ehshell_mirror_output(ehshell_t *shell, const char *buf, size_t len);
+/* 输出结束，未写满的段也立即分发，之后的输出继续追加到该段 */
+extern void ehshell_mirror_flush(ehshell_t *shell);
+extern void ehshell_mirror_destroy(ehshell_t *shell);
+
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+/* 分片调度，shell由 ehshell_create 分配到会话最少的分片，之后只在该分片线程中处理 */
+extern struct ehshell_shard *ehshell_shard_assign(void);
+extern void ehshell_shard_release(ehshell_t *shell);
+extern void ehshell_shard_notify(ehshell_t *shell);
+extern bool ehshell_shard_running(void);
+
+/* 分片线程自己的时间轮，ehshell_timer_wheel_poll 处理到期定时器并返回距下一次处理的毫秒数 */
+struct ehshell_timer_wheel;
+extern struct ehshell_timer_wheel *ehshell_timer_wheel_create(void);
+extern void ehshell_timer_wheel_destroy(struct ehshell_timer_wheel *w);
+extern void ehshell_timer_wheel_bind(struct ehshell_timer_wheel *w);
+extern uint32_t ehshell_timer_wheel_poll(struct ehshell_timer_wheel *w);
+/* 当前线程是否为分片线程，分片shell中的命令不能使用只在主事件循环中调度的无终端执行和logtail */
+extern bool ehshell_shard_self(void);
+#else
+#define ehshell_shard_self()    false
+#endif
+
+/*
+ * 全局共享状态(日志环、卡顿记录、堆跟踪表)的锁，
+ * 有分片线程或pthread工作线程时临界区不能互斥其他线程，使用pthread互斥锁，
+ * 此时这些状态不能在中断中访问，其他构建中为临界区
+ */
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0 || defined(CONFIG_PACKAGE_EHSHELL_WORKER_PTHREAD)
+#include <pthread.h>
+#define EHSHELL_THREADED                    1
+typedef pthread_mutex_t                     ehshell_lock_t;
+#define EHSHELL_LOCK_INIT                   PTHREAD_MUTEX_INITIALIZER
+#define ehshell_lock(lock)                  pthread_mutex_lock(lock)
+#define ehshell_unlock(lock)                pthread_mutex_unlock(lock)
+#else
+#define EHSHELL_THREADED                    0
+/* 持有期间中断关闭，保存的状态放在锁中不会被覆盖 */
+typedef struct{ eh_save_state_t state; }   ehshell_lock_t;
+#define EHSHELL_LOCK_INIT                   {0}
+#define ehshell_lock(lock)                  ((lock)->state = eh_enter_critical())
+#define ehshell_unlock(lock)                eh_exit_critical((lock)->state)
+#endif
+
+/* 处理一次就绪的shell，主事件循环和分片线程共用 */
+extern void ehshell_dispatch(ehshell_t *shell);
+
+/* 多生产者输入队列，drain返回true表示输入缓冲区已满，队列中还有数据 */
+extern struct ehshell_input_queue *ehshell_input_queue_create(void);
+extern void ehshell_input_queue_destroy(struct ehshell_input_queue *q);
+extern bool ehshell_input_queue_drain(ehshell_t *shell);
+
+/* 输入缓冲区自适应，ehshell_input_adapt 在处理开始时调用，扩大了缓冲区时返回true */
+extern void ehshell_input_adapt_init(ehshell_t *shell);
+extern bool ehshell_input_adapt(ehshell_t *shell, bool input_blocked);
+extern void ehshell_input_adapt_stop(ehshell_t *shell);
+
+/* 经过机器模式封帧的shell输出 */
+extern void ehshell_output_write(ehshell_t *shell, const char *buf, size_t len);
+extern void ehshell_output_finish(ehshell_t *shell);
+
+extern int ehshell_machine_start(ehshell_t *shell);
+extern void ehshell_machine_stop(ehshell_t *shell);
+extern void ehshell_machine_process(ehshell_t *shell);
+extern void ehshell_machine_output(ehshell_t *shell, const char *buf, size_t len);
+extern void ehshell_machine_flush(ehshell_t *shell);
+extern void ehshell_machine_command_end(ehshell_t *shell, int status);
+
+#if CONFIG_PACKAGE_EHSHELL_WORKER_NUM > 0
+extern int ehshell_worker_submit(ehshell_cmd_context_t *owner, int argc, const char *argv[]);
+extern void ehshell_worker_finish(ehshell_cmd_context_t *job_ctx);
+extern void ehshell_worker_post_event(ehshell_cmd_context_t *owner, enum ehshell_event ehshell_event);
+extern uint32_t ehshell_worker_take_events(ehshell_cmd_context_t *job_ctx);
+extern void ehshell_worker_detach(ehshell_cmd_context_t *owner);
+extern void ehshell_worker_process(ehshell_t *shell);
+#endif
+
 extern const struct ehshell_command_info  *ehshell_command_get(size_t index);
 
+extern void ehshell_command_post_event(ehshell_cmd_context_t *cmd_context, enum ehshell_event ehshell_event);
+
+/**
+ * @brief                   在owner中启动一个输出写入stream的子命令，child的存储由owner提供，
+ *                          子命令结束后owner以 EHSHELL_EVENT_RESUME 事件被唤醒
+ * @return int              成功返回0, 命令不存在或者不支持捕获时返回负数
+ */
+extern int ehshell_command_capture_start(ehshell_cmd_context_t *owner, ehshell_cmd_context_t *child,
+    struct stream_base *stream, int argc, const char *argv[]);
+/* 结束仍在运行的子命令，依次发送SIGINT和退出事件，仍未结束时强制回收 */
+extern void ehshell_command_capture_stop(ehshell_cmd_context_t *child);
+
+struct ehshell_arena_page;
+/* 申请至少size字节的arena页，优先从shell页池中取，shell为NULL时直接向堆申请 */
+extern struct ehshell_arena_page *ehshell_arena_page_get(ehshell_t *shell, size_t size);
+extern void ehshell_arena_page_put(ehshell_t *shell, struct ehshell_arena_page *page);
+extern void *ehshell_arena_page_buf(struct ehshell_arena_page *page);
+extern void ehshell_arena_destroy(ehshell_t *shell);
+extern void ehshell_command_arena_init(ehshell_cmd_context_t *cmd_context);
+extern void ehshell_command_arena_release(ehshell_cmd_context_t *cmd_context);
+/* 把src的arena页链移交给dst，用于工作线程命令结束时归还到shell */
+extern void ehshell_command_arena_transfer(ehshell_cmd_context_t *dst, ehshell_cmd_context_t *src);
+/* 不经过页池直接释放，用于shell已经销毁的工作线程命令 */
+extern void ehshell_command_arena_free(ehshell_cmd_context_t *cmd_context);
+
+struct ehshell_exec_request;
+struct ehshell_exec_segment;
+
+/* 无终端执行上下文，ehshell_exec 分配，脚本解释器等不能分配内存的场景由调用方提供 */
+struct ehshell_exec{
+    ehshell_cmd_context_t               ctx;
+    struct stream_function_no_cache     stream;
+    struct ehshell_exec_request        *request;
+    struct ehshell_exec_segment        *seg;        /* 当前写入的输出段 */
+    struct eh_list_head                 ready_node; /* 挂入就绪队列，空链表表示未就绪 */
+    bool                                is_static;  /* 调用方提供的存储，结束时不释放 */
+};
+
+/**
+ * @brief                   使用调用方提供的执行上下文无终端执行命令，不清空请求已有的输出，
+ *                          结束时回调 request->done，exec在回调之前已经不再使用
+ * @return int              启动成功返回0，失败返回负数且不会调用done回调
+ */
+extern int ehshell_exec_start_static(struct ehshell_exec_request *request, struct ehshell_exec *exec,
+    const struct ehshell_command_info *command_info, int argc, const char *argv[]);
+/* 无终端执行的命令结束，回调请求方并释放执行上下文 */
+extern void ehshell_exec_finish(ehshell_cmd_context_t *cmd_context);
+/* 无终端执行的命令请求恢复 */
+extern void ehshell_exec_notify(ehshell_cmd_context_t *cmd_context);
+
+extern void ehshell_command_co_init(ehshell_cmd_context_t *cmd_context);
+extern void ehshell_command_co_release(ehshell_cmd_context_t *cmd_context);
+extern void ehshell_command_co_process(ehshell_t *shell);
+extern void ehshell_command_co_resume(ehshell_t *shell, ehshell_cmd_context_t *cmd_context);
+extern void ehshell_command_generate_step(ehshell_cmd_context_t *cmd_context, uint32_t ehshell_event);
+/* 命令有事件待处理，通知所属shell或者无终端执行器 */
+extern void ehshell_command_notify(ehshell_cmd_context_t *cmd_context);
+
+/* 卡顿检测的计时点 */
+enum ehshell_stall_kind{
+    EHSHELL_STALL_FUNCTION = 0,     /* do_function */
+    EHSHELL_STALL_EVENT,            /* do_event_function */
+    EHSHELL_STALL_COMPLETE,         /* tab 补全 */
+    EHSHELL_STALL_PROCESSOR,        /* 一次完整的shell处理 */
+    EHSHELL_STALL_KIND_MAX,
+};
+
+#if EHSHELL_CONFIG_STALL_BUDGET_US > 0
+#define ehshell_stall_start() eh_get_clock_monotonic_time()
+extern void ehshell_stall_account(enum ehshell_stall_kind kind, const char *name, uint32_t event, eh_clock_t start);
+#else
+#define ehshell_stall_start() ((eh_clock_t)0)
+#define ehshell_stall_account(kind, name, event, start) do{ (void)(name); (void)(start); }while(0)
+#endif
+
+/* 调用命令的 do_function 并计时，命令可能同步结束，之后不能再访问 cmd_context */
+extern void ehshell_command_call(ehshell_cmd_context_t *cmd_context, int argc, const char *argv[]);
+
+/* 堆分配跟踪结果，由 CONFIG_PACKAGE_EHSHELL_HEAP_HOOK 启用的 eh_malloc/eh_free 包装函数统计 */
+struct ehshell_heap_stat{
+    uint32_t                            allocs;
+    uint32_t                            frees;      /* 包括跟踪开始前分配的内存 */
+    size_t                              bytes;      /* 分配的总字节数 */
+    size_t                              live;       /* 跟踪期间分配且尚未释放的字节数 */
+    size_t                              peak;
+    uint32_t                            untracked;  /* 跟踪表已满未记录大小的分配次数，峰值偏小 */
+};
+
+/**
+ * @brief                   开始跟踪堆分配，同一时间只能有一个跟踪
+ * @return int              成功返回0，已在跟踪返回 EH_RET_BUSY，未启用包装函数返回 EH_RET_NOT_SUPPORTED
+ */
+extern int ehshell_heap_trace_start(void);
+extern void ehshell_heap_trace_stop(struct ehshell_heap_stat *stat);
+
 #ifdef __cplusplus
 #if __cplusplus
 }
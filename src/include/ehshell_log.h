@@ -0,0 +1,55 @@
+/**
+ * @file ehshell_log.h
+ * @brief ehshell 共享日志环形缓冲区，日志只格式化和写入一次，
+ *        每个 logtail 订阅者持有独立的读游标，直接从缓冲区输出，
+ *        读得慢的订阅者被覆盖的记录计入丢弃数，不会阻塞写日志的一方
+ *
+ *        在平台的 eh_debug 输出函数中调用:
+ *        ehshell_log_write(EHSHELL_LOG_LEVEL_ERR, "EHSHELL", line, line_len);
+ *        Linux 主机上可以启用 CONFIG_PACKAGE_EHSHELL_BUILTIN_LOG_CAPTURE，
+ *        由 port/log_capture.c 捕获写到stderr的调试输出
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-25
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _EHSHELL_LOG_H_
+#define _EHSHELL_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ehshell.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+/* 与 eh_merrfl/eh_mwarnfl/eh_minfofl/eh_mdebugfl 对应 */
+enum ehshell_log_level{
+    EHSHELL_LOG_LEVEL_ERR = 0,
+    EHSHELL_LOG_LEVEL_WARN,
+    EHSHELL_LOG_LEVEL_INFO,
+    EHSHELL_LOG_LEVEL_DEBUG,
+};
+
+/**
+ * @brief                   写入一条已格式化的日志，可以在任意任务或工作线程中调用，
+ *                          文本超过缓冲区一半时被截断
+ * @param  level            日志等级
+ * @param  module           模块名，可以为NULL
+ * @param  text             日志文本，'\n' 输出时转换为 "\r\n"
+ * @param  len              文本长度
+ */
+extern void ehshell_log_write(enum ehshell_log_level level, const char *module, const char *text, size_t len);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _EHSHELL_LOG_H_
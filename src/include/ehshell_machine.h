@@ -0,0 +1,62 @@
+/**
+ * @file ehshell_machine.h
+ * @brief ehshell 机器模式，供自动化测试等程序化客户端使用
+ *        机器模式下不回显、不打印提示符、不做行编辑，请求和响应都是带ID的帧，
+ *        客户端可以连续发送多个请求，shell按顺序执行并逐个返回结果
+ *
+ *        帧格式(多字节字段为小端):
+ *        | sync(1) 0x1E | type(1) | id(2) | len(2) | payload(len) |
+ *
+ *        请求:  'Q' 执行payload中的命令行(不含换行)
+ *               'C' 取消正在执行的id请求(相当于Ctrl+C)，payload为空
+ *               'X' 退出机器模式，回到交互模式
+ *        响应:  'H' 进入机器模式，id为0，payload为协议版本字符串
+ *               'O' id请求的输出数据
+ *               'E' id请求结束，payload为4字节有符号退出状态，
+ *                   由 ehshell_command_set_exit_status 设置，命令执行失败时为负的错误码
+ *
+ *        进入方式: 交互模式下执行 machine 命令，或者在 ehshell_config.flags 中设置
+ *        EHSHELL_CONFIG_FLAG_MACHINE_MODE(登录完成后进入)
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-16
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _EHSHELL_MACHINE_H_
+#define _EHSHELL_MACHINE_H_
+
+#include <ehshell.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+#define EHSHELL_MACHINE_SYNC                0x1E
+#define EHSHELL_MACHINE_HEADER_SIZE         6
+#define EHSHELL_MACHINE_VERSION             "ehshell-machine/1"
+
+#define EHSHELL_MACHINE_REQ_EXEC            'Q'
+#define EHSHELL_MACHINE_REQ_CANCEL          'C'
+#define EHSHELL_MACHINE_REQ_EXIT            'X'
+
+#define EHSHELL_MACHINE_RSP_HELLO           'H'
+#define EHSHELL_MACHINE_RSP_OUTPUT          'O'
+#define EHSHELL_MACHINE_RSP_END             'E'
+
+/**
+ * @brief                   请求ehshell在当前命令结束后进入机器模式
+ * @param  ehshell          ehshell实例指针
+ */
+extern void ehshell_machine_enter(ehshell_t *ehshell);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _EHSHELL_MACHINE_H_
@@ -0,0 +1,97 @@
+/**
+ * @file ehshell_mirror.h
+ * @brief ehshell 会话镜像，一个shell的输出同时送到多个附加的输出端，用于远程协助和旁观，
+ *        输出先交给 ehshell_config 的 stream_write，再复制一次到引用计数的共享段中，
+ *        每个输出端只排队共享段的引用，不单独复制，
+ *        未写满的段在输出结束时就排入队列，之后的输出追加到该段，短小的回显不会占满队列
+ *
+ *        输出端的 write 不能阻塞，只写入一部分时剩余数据留在队列中，
+ *        传输层可写后调用 ehshell_sink_ready 继续发送，
+ *        队列中已有 EHSHELL_CONFIG_MIRROR_SINK_QUEUE 个段时新的段对该输出端丢弃，
+ *        慢速的输出端只会落后或丢帧，不会拖慢主会话
+ *
+ *        telnet 端口的 tmirror 命令把一个连接作为输出端附加到另一个客户端的会话，可作为端口侧的参考
+ *
+ *        除 ehshell_sink_input 外，所有函数和回调都在shell所在任务中调用，
+ *        分片shell为所属分片线程
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-06
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _EHSHELL_MIRROR_H_
+#define _EHSHELL_MIRROR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <eh_types.h>
+#include <eh_list.h>
+#include <ehshell.h>
+#include <ehshell_config.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+struct ehshell_mirror_seg;
+
+struct ehshell_sink{
+    const char *name;
+    /**
+     * @brief                   写出镜像数据，不能阻塞，回调中不能调用 ehshell_sink_detach
+     * @return int              返回接受的字节数，可以少于len，返回负数时输出端被移除
+     */
+    int (*write)(struct ehshell_sink *sink, const char *buf, size_t len);
+    void *user_data;
+#define EHSHELL_SINK_FLAG_INPUT         (1 << 0)    /* 允许通过 ehshell_sink_input 输入，否则只读 */
+    uint32_t flags;
+    /* 统计，由shell填写 */
+    uint64_t delivered;             /* 已写出的字节数 */
+    uint64_t dropped;               /* 队列满或者内存不足被丢弃的字节数 */
+    /* 以下内部使用 */
+    struct eh_list_head node;
+    ehshell_t *shell;
+    struct ehshell_mirror_seg *queue[EHSHELL_CONFIG_MIRROR_SINK_QUEUE];
+    uint16_t head;
+    uint16_t count;
+    uint16_t offset;                /* 队首段中已写出的长度 */
+};
+
+/**
+ * @brief                   附加输出端，只接收之后的输出
+ * @param  ehshell          ehshell实例指针
+ * @param  sink             输出端，生命周期必须大于附加时间
+ * @return int              成功返回0，已附加返回 EH_RET_EXISTS
+ */
+extern int ehshell_sink_attach(ehshell_t *ehshell, struct ehshell_sink *sink);
+
+/**
+ * @brief                   移除输出端，释放队列中的共享段，shell销毁时自动移除全部输出端
+ * @param  sink             输出端
+ */
+extern void ehshell_sink_detach(struct ehshell_sink *sink);
+
+/**
+ * @brief                   传输层重新可写，继续发送队列中的数据
+ * @param  sink             输出端
+ */
+extern void ehshell_sink_ready(struct ehshell_sink *sink);
+
+/**
+ * @brief                   从输出端向shell输入，经过 ehshell_input_write，可以在任意线程中调用
+ * @param  sink             输出端
+ * @return int              成功返回写入的字节数，只读输出端返回 EH_RET_NOT_SUPPORTED
+ */
+extern int ehshell_sink_input(struct ehshell_sink *sink, const void *buf, size_t len);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _EHSHELL_MIRROR_H_
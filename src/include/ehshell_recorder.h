@@ -0,0 +1,66 @@
+/**
+ * @file ehshell_recorder.h
+ * @brief ehshell 会话录制，记录带时间戳的输入和输出，配合 port/replay_shell.c 离线回放
+ *
+ *        录制格式:
+ *        | magic(4) "EHRC" | version(1) |
+ *        之后为连续的记录:
+ *        | type(1) 'I'输入 'O'输出 | 与上一条记录的时间差(us, varint) | len(varint) | data(len) |
+ *        varint 为 LEB128 无符号编码
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-24
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _EHSHELL_RECORDER_H_
+#define _EHSHELL_RECORDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <eh_types.h>
+#include <ehshell.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+#define EHSHELL_RECORDER_MAGIC          "EHRC"
+#define EHSHELL_RECORDER_VERSION        1
+#define EHSHELL_RECORDER_TYPE_INPUT     'I'
+#define EHSHELL_RECORDER_TYPE_OUTPUT    'O'
+
+struct ehshell_recorder{
+    /**
+     * @brief                   录制数据输出，在shell所在任务中调用，可以写文件、RAM缓冲区或者其他通道
+     */
+    void (*write)(struct ehshell_recorder *recorder, const void *buf, size_t len);
+    void *user_data;
+    /* 以下内部使用 */
+    eh_clock_t last_time;
+};
+
+/**
+ * @brief                   开始录制，先写入文件头，只记录之后到达的输入
+ * @param  ehshell          ehshell实例指针
+ * @param  recorder         录制器，生命周期必须大于录制时间
+ * @return int              成功返回0, 失败返回负数
+ */
+extern int ehshell_recorder_attach(ehshell_t *ehshell, struct ehshell_recorder *recorder);
+
+/**
+ * @brief                   停止录制
+ * @param  ehshell          ehshell实例指针
+ */
+extern void ehshell_recorder_detach(ehshell_t *ehshell);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _EHSHELL_RECORDER_H_
@@ -0,0 +1,104 @@
+/**
+ * @file ehshell_script.h
+ * @brief 预编译脚本，主机端用 tools/ehshell_script_compile.py 把shell脚本编译成字节码，
+ *        命令名去重后按字典序存放，参数预先切分成以'\0'结尾的字符串，
+ *        &&、||、if/else、while 和 repeat 编译成跳转指令，
+ *        设备端解释执行时不解析字符串也不分配内存，命令以无终端方式执行
+ *
+ *        #include "boot_script.h"      // 构建时由 ehshell_add_script() 生成
+ *        static struct ehshell_script boot = { .blob = boot_script, .size = sizeof(boot_script), .done = on_done };
+ *        ehshell_script_run(&boot);
+ *
+ *        启动时按名称一次性解析全部命令，当时还没有注册的命令在执行到时再查找，
+ *        命令表发生变化后缓存自动失效
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-04
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _EHSHELL_SCRIPT_H_
+#define _EHSHELL_SCRIPT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ehshell_exec.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+/*
+ * 字节码格式，多字节整数均为小端，偏移都是相对所在区域的字节偏移
+ *
+ *  0  'E' 'H' 'S' 'B'
+ *  4  u8  版本 EHSHELL_SCRIPT_VERSION
+ *  5  u8  使用的循环计数器个数
+ *  6  u16 命令引用个数 n
+ *  8  u16 代码长度
+ * 10  u16 字符串池长度
+ * 12  u16 x n 命令名在字符串池中的偏移，按字典序排列
+ *     代码
+ *     字符串池
+ */
+#define EHSHELL_SCRIPT_MAGIC            "EHSB"
+#define EHSHELL_SCRIPT_VERSION          1
+#define EHSHELL_SCRIPT_HEADER_SIZE      12
+
+enum ehshell_script_op{
+    EHSHELL_SCRIPT_OP_END = 0,      /* 结束，脚本状态为最后一条命令的状态 */
+    EHSHELL_SCRIPT_OP_RUN,          /* u16 命令引用, u8 argc, u16 x argc 参数偏移，argv[0]为命令名 */
+    EHSHELL_SCRIPT_OP_JMP,          /* u16 目标 */
+    EHSHELL_SCRIPT_OP_JZ,           /* u16 目标，上一条命令成功时跳转 */
+    EHSHELL_SCRIPT_OP_JNZ,          /* u16 目标，上一条命令失败时跳转 */
+    EHSHELL_SCRIPT_OP_SETCNT,       /* u8 计数器, u16 次数 */
+    EHSHELL_SCRIPT_OP_LOOP,         /* u8 计数器, u16 目标，计数器为0时跳转，否则减1 */
+    EHSHELL_SCRIPT_OP_MAX,
+};
+
+struct ehshell_script_runner;
+
+struct ehshell_script{
+    const uint8_t                   *blob;
+    size_t                           size;
+    /* 所有命令的输出依次写入，全部写满后的输出被丢弃，为NULL时丢弃全部输出 */
+    struct ehshell_exec_segment     *output;
+    /**
+     * @brief                   脚本结束回调，可能在 ehshell_script_run 返回前调用，
+     *                          回调返回后解释器不再访问script
+     * @param  script           脚本
+     * @param  status           最后执行的命令的退出状态，命令不存在时为 EH_RET_NOT_EXISTS
+     */
+    void (*done)(struct ehshell_script *script, int status);
+    void                            *user_data;
+    /* 以下由解释器填写 */
+    size_t                           output_len;
+    size_t                           dropped;
+    uint32_t                         commands;  /* 已执行的命令数 */
+    uint32_t                         lookups;   /* 解析缓存未命中、按名称查找的次数 */
+    struct ehshell_script_runner    *runner;    /* 运行中的解释器，结束后为NULL */
+};
+
+/**
+ * @brief                   开始执行预编译脚本，同时运行的脚本数受 EHSHELL_CONFIG_SCRIPT_RUNNERS 限制
+ * @param  script           脚本，结束前必须保持有效
+ * @return int              启动成功返回0，字节码无效或没有空闲解释器返回负数且不会调用done回调，分片线程中返回 EH_RET_NOT_SUPPORTED
+ */
+extern int ehshell_script_run(struct ehshell_script *script);
+
+/**
+ * @brief                   取消脚本，中断当前命令并不再执行后续指令，结束时仍然调用done回调
+ * @param  script           脚本
+ */
+extern void ehshell_script_cancel(struct ehshell_script *script);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _EHSHELL_SCRIPT_H_
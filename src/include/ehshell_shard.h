@@ -0,0 +1,67 @@
+/**
+ * @file ehshell_shard.h
+ * @brief 多核主机上的分片部署，配置 CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0 后启动N个分片线程，
+ *        带有 EHSHELL_CONFIG_FLAG_SHARDED 标志创建的shell分配到会话最少的分片，
+ *        之后该shell的处理、定时器和输出回调都只在所属分片线程中执行
+ *
+ *        分片shell的端口需要满足:
+ *        创建后设置用户数据，再调用 ehshell_notify_processor 开始处理
+ *        输入用 ehshell_input_write 写入，可以在任意线程中调用
+ *        stream_write 等输出回调在分片线程中被调用
+ *        ehshell_destroy 只能在分片线程中调用，例如 quit_shell 回调中
+ *
+ *        日志环、卡顿记录和堆跟踪表由互斥锁保护，分片shell中可以使用 stalls 和 time，
+ *        logtail、ehshell_exec_* 和 ehshell_script_run 依赖主循环的信号和就绪表，
+ *        在分片线程中分别报告不支持和返回 EH_RET_NOT_SUPPORTED
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-03-01
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _EHSHELL_SHARD_H_
+#define _EHSHELL_SHARD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+struct ehshell_shard_stat{
+    uint32_t        sessions;       /* 当前会话数 */
+    uint64_t        dispatches;     /* 处理shell的次数 */
+    uint64_t        busy_us;        /* 处理shell的累计时间 */
+};
+
+/**
+ * @brief                   获取分片线程数
+ * @return size_t           未启用分片时返回0
+ */
+extern size_t ehshell_shard_count(void);
+
+/**
+ * @brief                   限制新会话只分配到前n个分片，用于评估扩展性，已有会话不迁移
+ * @param  n                0或超过分片数时表示使用全部分片
+ */
+extern void ehshell_shard_set_limit(size_t n);
+
+/**
+ * @brief                   获取分片统计
+ * @param  index            分片序号
+ * @param  stat             输出统计
+ * @return int              成功返回0，序号无效返回负数
+ */
+extern int ehshell_shard_get_stat(size_t index, struct ehshell_shard_stat *stat);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _EHSHELL_SHARD_H_
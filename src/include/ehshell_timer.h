@@ -0,0 +1,81 @@
+/**
+ * @file ehshell_timer.h
+ * @brief ehshell 共享分层时间轮，用于登录超时、telnet协商、空闲断开等会话级定时
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-03
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _EHSHELL_TIMER_H_
+#define _EHSHELL_TIMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <eh_list.h>
+#include <autoconf.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+typedef struct ehshell_timer ehshell_timer_t;
+
+struct ehshell_timer{
+    struct eh_list_head     node;
+    /**
+     * @brief               定时器到期回调，回调前定时器已经从时间轮中摘除，
+     *                      可以在回调中重新启动定时器，或者释放定时器所在的内存
+     */
+    void                  (*callback)(ehshell_timer_t *timer, void *arg);
+    void                   *arg;
+    uint32_t                expires;        /* 到期时刻，单位为时间轮tick */
+    uint16_t                slot;           /* 所在时间轮槽位，level * slots + index */
+#if CONFIG_PACKAGE_EHSHELL_SHARD_NUM > 0
+    struct ehshell_timer_wheel *wheel;      /* 所在时间轮，启动定时器的线程决定 */
+#endif
+};
+
+/**
+ * @brief                   初始化定时器，使用前必须调用
+ * @param  timer            定时器指针
+ * @param  callback         到期回调函数
+ * @param  arg              回调参数
+ */
+extern void ehshell_timer_init(ehshell_timer_t *timer, void (*callback)(ehshell_timer_t *timer, void *arg), void *arg);
+
+/**
+ * @brief                   启动定时器，若定时器已经启动则重新计时，时间复杂度O(1)
+ *                          精度为 EHSHELL_CONFIG_TIMER_TICK_MS，超时时间向上取整，
+ *                          在分片线程中启动的定时器放入该分片的时间轮，回调也在该线程中执行
+ * @param  timer            定时器指针
+ * @param  timeout_ms       超时时间(ms)，超出时间轮范围的超时会被截断到最大值
+ * @return int              成功返回0, 失败返回负数
+ */
+extern int ehshell_timer_start(ehshell_timer_t *timer, uint32_t timeout_ms);
+
+/**
+ * @brief                   停止定时器，未启动的定时器可以重复停止，时间复杂度O(1)
+ * @param  timer            定时器指针
+ */
+extern void ehshell_timer_stop(ehshell_timer_t *timer);
+
+/**
+ * @brief                   判断定时器是否在运行
+ * @param  timer            定时器指针
+ * @return bool             运行中返回true
+ */
+static inline bool ehshell_timer_is_active(ehshell_timer_t *timer){
+    return !eh_list_empty(&timer->node);
+}
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _EHSHELL_TIMER_H_
@@ -0,0 +1,137 @@
+/**
+ * @file ehshell_uart.h
+ * @brief ehshell 字节流端口适配器，用于UART类设备，
+ *        接收端直接从DMA循环缓冲区把新数据段拷贝进输入缓冲区，
+ *        发送端把输出缓存后按DMA块发送，完成中断中接着发送下一块
+ *
+ *        接收使用循环DMA时，在中断中调用:
+ *        半满中断     ehshell_uart_rx_half_complete(uart);
+ *        全满中断     ehshell_uart_rx_full_complete(uart);
+ *        空闲中断     ehshell_uart_rx_idle(uart, DMA剩余计数);
+ *        不使用DMA时在接收中断中调用 ehshell_uart_rx_bytes()
+ *        发送完成中断中调用 ehshell_uart_tx_complete(uart);
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-27
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _EHSHELL_UART_H_
+#define _EHSHELL_UART_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <eh_ringbuf.h>
+#include <ehshell.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+struct ehshell_uart;
+
+struct ehshell_uart_ops{
+    /**
+     * @brief                   启动一次发送，发送完成后调用 ehshell_uart_tx_complete，
+     *                          可能在中断中被调用，buf在完成前保持有效
+     * @return int              成功返回0，失败返回负数，数据保留到下一次启动
+     */
+    int  (*tx_start)(struct ehshell_uart *uart, const uint8_t *buf, size_t len);
+    /**
+     * @brief                   可选，启动循环DMA接收
+     */
+    void (*rx_start)(struct ehshell_uart *uart, uint8_t *buf, size_t size);
+    /**
+     * @brief                   可选，停止收发
+     */
+    void (*stop)(struct ehshell_uart *uart);
+};
+
+struct ehshell_uart_param{
+    const struct ehshell_uart_ops  *ops;
+    void                           *user_data;
+    const char                     *host;
+    uint32_t                        input_ringbuf_size;
+    uint32_t                        input_ringbuf_max;  /* 大于 input_ringbuf_size 时启用自适应输入缓冲区 */
+    uint16_t                        input_linebuf_size;
+    uint8_t                        *rx_dma_buf;     /* 循环DMA接收缓冲区，NULL表示不使用DMA接收 */
+    uint32_t                        rx_dma_size;
+    uint32_t                        tx_buf_size;    /* 发送缓冲区大小 */
+    uint32_t                        tx_chunk_max;   /* 单次DMA发送的最大长度，0表示不限制 */
+};
+
+struct ehshell_uart{
+    const struct ehshell_uart_ops  *ops;
+    void                           *user_data;
+    ehshell_t                      *shell;
+    struct ehshell_config           config;
+    /* 接收 */
+    uint8_t                        *rx_dma_buf;
+    uint32_t                        rx_dma_size;
+    uint32_t                        rx_dma_pos;     /* DMA最后报告的写入位置 */
+    uint32_t                        rx_pending;     /* rx_dma_pos 之前还没有拷贝到输入缓冲区的字节数 */
+    /* 发送 */
+    eh_ringbuf_t                   *tx_ringbuf;
+    uint32_t                        tx_chunk_max;
+    uint32_t                        tx_inflight;    /* 正在发送的字节数，0表示空闲 */
+    /* 统计 */
+    uint32_t                        rx_bytes;
+    uint32_t                        rx_dropped;     /* 输入缓冲区满被丢弃的字节数 */
+    uint32_t                        tx_bytes;
+    uint32_t                        tx_dropped;     /* 发送缓冲区满被丢弃的字节数 */
+    uint32_t                        tx_chunks;
+};
+
+/**
+ * @brief                   初始化适配器并创建shell
+ * @param  uart             适配器，生命周期必须大于shell
+ * @param  param            参数
+ * @return int              成功返回0, 失败返回负数
+ */
+extern int ehshell_uart_init(struct ehshell_uart *uart, const struct ehshell_uart_param *param);
+
+/**
+ * @brief                   停止收发并销毁shell
+ */
+extern void ehshell_uart_deinit(struct ehshell_uart *uart);
+
+/**
+ * @brief                   DMA写入位置更新，拷贝 [上次位置, dma_pos) 的数据，最多两段，可在中断中调用
+ * @param  uart             适配器
+ * @param  dma_pos          DMA下一个写入位置，等于缓冲区大小表示写满一圈刚好回绕
+ */
+extern void ehshell_uart_rx_dma_update(struct ehshell_uart *uart, uint32_t dma_pos);
+
+/**
+ * @brief                   接收非DMA数据，可在中断中调用
+ */
+extern void ehshell_uart_rx_bytes(struct ehshell_uart *uart, const uint8_t *buf, size_t len);
+
+/**
+ * @brief                   当前DMA块发送完成，继续发送下一块，可在中断中调用
+ */
+extern void ehshell_uart_tx_complete(struct ehshell_uart *uart);
+
+static inline void ehshell_uart_rx_half_complete(struct ehshell_uart *uart){
+    ehshell_uart_rx_dma_update(uart, uart->rx_dma_size / 2);
+}
+
+static inline void ehshell_uart_rx_full_complete(struct ehshell_uart *uart){
+    ehshell_uart_rx_dma_update(uart, uart->rx_dma_size);
+}
+
+static inline void ehshell_uart_rx_idle(struct ehshell_uart *uart, uint32_t dma_remaining){
+    ehshell_uart_rx_dma_update(uart, uart->rx_dma_size - dma_remaining);
+}
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _EHSHELL_UART_H_
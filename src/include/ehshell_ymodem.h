@@ -0,0 +1,73 @@
+/**
+ * @file ehshell_ymodem.h
+ * @brief ehshell 文件传输，rz/sz 命令使用 YMODEM/YMODEM-g 协议，
+ *        文件数据通过注册的后端读写(flash、RAM缓冲区、文件系统等)
+ * @author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+ * @date 2026-02-12
+ *
+ * @copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+ *
+ */
+#ifndef _EHSHELL_YMODEM_H_
+#define _EHSHELL_YMODEM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <eh_list.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+struct ehshell_ymodem_backend{
+    const char *name;
+    /**
+     * @brief                   打开文件
+     * @param  path             文件名，rz时为发送端给出的文件名，sz时为命令行参数
+     * @param  is_write         rz时为true，sz时为false
+     * @param  size             rz时为发送端给出的文件大小(0表示未知)，sz时由后端填写文件大小
+     * @return void*            文件句柄，错误值由 eh_ptr_to_error() 获取
+     */
+    void *(*open)(const char *path, bool is_write, uint32_t *size);
+    /**
+     * @brief                   写入数据，rz时调用，数据按顺序写入，可以为NULL
+     * @return int              成功返回0, 失败返回负数，传输会被取消
+     */
+    int (*write)(void *handle, uint32_t offset, const uint8_t *buf, size_t len);
+    /**
+     * @brief                   读取数据，sz时调用，可以为NULL
+     * @return int              返回读取的字节数，0表示文件结束，失败返回负数
+     */
+    int (*read)(void *handle, uint32_t offset, uint8_t *buf, size_t len);
+    /**
+     * @brief                   关闭文件
+     * @param  status           传输结果，0表示传输完成，负数表示传输失败
+     */
+    void (*close)(void *handle, int status);
+    struct eh_list_head node;
+};
+
+/**
+ * @brief                   注册文件传输后端，backend生命周期必须大于注册时间
+ * @param  backend          后端指针
+ * @return int              成功返回0, 名字重复返回负数
+ */
+extern int ehshell_ymodem_backend_register(struct ehshell_ymodem_backend *backend);
+
+/**
+ * @brief                   注销文件传输后端，正在使用该后端的传输不受影响
+ * @param  backend          后端指针
+ */
+extern void ehshell_ymodem_backend_unregister(struct ehshell_ymodem_backend *backend);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif // _EHSHELL_YMODEM_H_
@@ -0,0 +1,410 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+@file ehshell_script_compile.py
+@brief 把shell脚本编译成 ehshell_script.h 描述的字节码，在主机端构建时运行
+
+       参数切分规则与 ehshell_command_split 相同: 空白分隔，单双引号，反斜杠转义，
+       另外未加引号的 ; 换行 && || 是分隔符，# 开始的注释到行尾结束
+
+       a && b || c
+       if a; then b; elif c; then d; else e; fi
+       while a; do b; done
+       repeat 3; do a; done
+
+       复合语句结束后的状态是最后执行的命令的状态，
+       -e 时单条命令失败立即结束脚本，与 sh 相同，条件和 && || 中的命令不受影响
+
+       ehshell_script_compile.py boot.sh -o boot_script.h [--name boot_script] [-e]
+                                 [--argc-max 8] [--loop-depth 4]
+       输出文件后缀为 .bin 时输出原始字节码，否则输出C数组，
+       --argc-max 和 --loop-depth 必须与设备端 EHSHELL_CONFIG_ARGC_MAX、
+       EHSHELL_CONFIG_SCRIPT_LOOP_DEPTH 一致，超出的脚本在构建时报错
+@author simon.xiaoapeng (simon.xiaoapeng@gmail.com)
+@date 2026-03-04
+
+@copyright Copyright (c) 2026  simon.xiaoapeng@gmail.com
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+MAGIC = b"EHSB"
+VERSION = 1
+# 字节码格式的上限，设备端配置的默认值见 ehshell_config.h
+ARGC_LIMIT = 255
+LOOP_DEPTH_LIMIT = 255
+ARGC_MAX_DEFAULT = 8
+LOOP_DEPTH_DEFAULT = 4
+
+OP_END, OP_RUN, OP_JMP, OP_JZ, OP_JNZ, OP_SETCNT, OP_LOOP = range(7)
+
+KEYWORDS = ("if", "then", "elif", "else", "fi", "while", "repeat", "do", "done")
+
+
+class ScriptError(Exception):
+    def __init__(self, line, msg):
+        super().__init__("line %d: %s" % (line, msg))
+
+
+class Word:
+    """quoted 为真时不能作为关键字或操作符"""
+    def __init__(self, text, line, quoted=False, op=False):
+        self.text = text
+        self.line = line
+        self.quoted = quoted
+        self.op = op
+
+    def is_op(self, text):
+        return self.op and self.text == text
+
+    def is_keyword(self, text):
+        return not self.op and not self.quoted and self.text == text
+
+
+def tokenize(src):
+    words = []
+    line = 1
+    i = 0
+    n = len(src)
+    while i < n:
+        c = src[i]
+        if c == "\n":
+            words.append(Word(";", line, op=True))
+            line += 1
+            i += 1
+            continue
+        if c.isspace():
+            i += 1
+            continue
+        if src.startswith("\\\n", i):
+            # 续行
+            line += 1
+            i += 2
+            continue
+        if c == "#":
+            while i < n and src[i] != "\n":
+                i += 1
+            continue
+        if c == ";":
+            words.append(Word(";", line, op=True))
+            i += 1
+            continue
+        if src.startswith("&&", i) or src.startswith("||", i):
+            words.append(Word(src[i:i + 2], line, op=True))
+            i += 2
+            continue
+        text = []
+        quoted = False
+        quote = None
+        start = line
+        while i < n:
+            c = src[i]
+            if c == "\\":
+                i += 1
+                if i >= n:
+                    break
+                if src[i] == "\n":
+                    # 续行
+                    line += 1
+                    i += 1
+                    continue
+                text.append(src[i])
+                quoted = True
+                i += 1
+                continue
+            if quote is None and c in "\"'":
+                quote = c
+                quoted = True
+                i += 1
+                continue
+            if quote is not None:
+                if c == quote:
+                    quote = None
+                elif c == "\n":
+                    line += 1
+                    text.append(c)
+                else:
+                    text.append(c)
+                i += 1
+                continue
+            if c.isspace() or c in ";#" or src.startswith("&&", i) or src.startswith("||", i):
+                break
+            text.append(c)
+            i += 1
+        if quote is not None:
+            raise ScriptError(start, "unterminated quote")
+        words.append(Word("".join(text), start, quoted=quoted))
+    words.append(Word(";", line, op=True))
+    return words
+
+
+class Compiler:
+    def __init__(self, words, errexit, argc_max, loop_depth_max):
+        self.words = words
+        self.pos = 0
+        self.errexit = errexit
+        self.argc_max = argc_max
+        self.loop_depth_max = loop_depth_max
+        self.code = bytearray()
+        self.commands = []          # 每条RUN指令的参数
+        self.runs = []              # (RUN指令偏移, 命令序号)
+        self.exit_patches = []
+        self.loop_depth = 0
+        self.loop_max = 0
+        self.condition = 0
+
+    # ---- 词法辅助 ----
+    def peek(self):
+        return self.words[self.pos]
+
+    def next(self):
+        w = self.words[self.pos]
+        self.pos += 1
+        return w
+
+    def skip_separators(self):
+        while self.pos < len(self.words) and self.peek().is_op(";"):
+            self.pos += 1
+
+    def expect_keyword(self, kw):
+        self.skip_separators()
+        w = self.next() if self.pos < len(self.words) else None
+        if w is None or not w.is_keyword(kw):
+            raise ScriptError(w.line if w else self.words[-1].line, "expected '%s'" % kw)
+
+    def at_end(self):
+        return self.pos >= len(self.words)
+
+    # ---- 代码生成 ----
+    def emit(self, *data):
+        self.code += bytes(data)
+
+    def emit_jump(self, op, target=0):
+        at = len(self.code)
+        self.code += struct.pack("<BH", op, target)
+        return at + 1
+
+    def patch(self, at, target):
+        struct.pack_into("<H", self.code, at, target)
+
+    def emit_run(self, argv, line):
+        if len(argv) > self.argc_max:
+            raise ScriptError(line, "too many arguments, %d > argc max %d" % (len(argv), self.argc_max))
+        self.runs.append((len(self.code), len(self.commands)))
+        self.commands.append(argv)
+        # 命令引用和参数偏移在链接时填写
+        self.code += bytes(4 + 2 * len(argv))
+
+    # ---- 语法 ----
+    def compile_list(self, terminators):
+        """编译到 terminators 中的关键字为止，返回遇到的关键字"""
+        while True:
+            self.skip_separators()
+            if self.at_end():
+                if terminators:
+                    raise ScriptError(self.words[-1].line, "unexpected end of script")
+                return None
+            w = self.peek()
+            if not w.op and not w.quoted and w.text in terminators:
+                return w.text
+            self.compile_and_or()
+
+    def compile_and_or(self):
+        single = self.compile_command()
+        while not self.at_end() and (self.peek().is_op("&&") or self.peek().is_op("||")):
+            op = self.next()
+            single = False
+            # 跳过的命令不改变状态，后面的 && || 继续按原状态判断
+            skip = self.emit_jump(OP_JNZ if op.text == "&&" else OP_JZ)
+            self.skip_separators()
+            self.compile_command()
+            self.patch(skip, len(self.code))
+        if single and self.errexit and not self.condition:
+            self.exit_patches.append(self.emit_jump(OP_JNZ))
+
+    def compile_command(self):
+        """返回是否为单条简单命令"""
+        w = self.peek()
+        if w.op:
+            raise ScriptError(w.line, "unexpected '%s'" % w.text)
+        if w.is_keyword("if"):
+            self.compile_if()
+            return False
+        if w.is_keyword("while"):
+            self.compile_while()
+            return False
+        if w.is_keyword("repeat"):
+            self.compile_repeat()
+            return False
+        if not w.quoted and w.text in KEYWORDS:
+            raise ScriptError(w.line, "unexpected '%s'" % w.text)
+        argv = []
+        while not self.at_end() and not self.peek().op:
+            argv.append(self.next().text)
+        # 与 ehshell_exec 一致，末尾的 & 被忽略
+        if len(argv) > 1 and argv[-1] == "&":
+            argv.pop()
+        self.emit_run(argv, w.line)
+        return True
+
+    def compile_if(self):
+        end_patches = []
+        self.next()
+        while True:
+            self.compile_condition("then")
+            else_patch = self.emit_jump(OP_JNZ)
+            kw = self.compile_list(("elif", "else", "fi"))
+            self.next()
+            if kw == "fi":
+                self.patch(else_patch, len(self.code))
+                break
+            end_patches.append(self.emit_jump(OP_JMP))
+            self.patch(else_patch, len(self.code))
+            if kw == "else":
+                self.compile_list(("fi",))
+                self.next()
+                break
+        for at in end_patches:
+            self.patch(at, len(self.code))
+
+    def compile_condition(self, terminator):
+        # 条件中的命令失败时不触发 -e
+        self.condition += 1
+        self.compile_list((terminator,))
+        self.next()
+        self.condition -= 1
+
+    def compile_while(self):
+        self.next()
+        top = len(self.code)
+        self.compile_condition("do")
+        end_patch = self.emit_jump(OP_JNZ)
+        self.compile_list(("done",))
+        self.next()
+        self.emit_jump(OP_JMP, top)
+        self.patch(end_patch, len(self.code))
+
+    def compile_repeat(self):
+        w = self.next()
+        count = self.next() if not self.at_end() else None
+        if count is None or count.op or not re.fullmatch(r"\d+", count.text) or int(count.text) > 0xffff:
+            raise ScriptError(w.line, "repeat needs a count 0-65535")
+        slot = self.loop_depth
+        if slot >= self.loop_depth_max:
+            raise ScriptError(w.line, "repeat nested too deep, loop depth max %d" % self.loop_depth_max)
+        self.loop_depth += 1
+        self.loop_max = max(self.loop_max, self.loop_depth)
+        self.expect_keyword("do")
+        self.emit(OP_SETCNT, slot, *struct.pack("<H", int(count.text)))
+        top = len(self.code)
+        self.code += struct.pack("<BBH", OP_LOOP, slot, 0)
+        self.compile_list(("done",))
+        self.next()
+        self.emit_jump(OP_JMP, top)
+        struct.pack_into("<H", self.code, top + 2, len(self.code))
+        self.loop_depth -= 1
+
+    def compile(self):
+        self.compile_list(())
+        end = len(self.code)
+        self.emit(OP_END)
+        for at in self.exit_patches:
+            self.patch(at, end)
+        if len(self.code) > 0xffff:
+            raise ScriptError(self.words[-1].line, "script too large")
+        return self.link()
+
+    # ---- 链接 ----
+    def link(self):
+        pool = bytearray()
+        offsets = {}
+
+        def intern(s):
+            if s not in offsets:
+                offsets[s] = len(pool)
+                pool.extend(s.encode("utf-8") + b"\0")
+            return offsets[s]
+
+        # 命令表按strcmp顺序排列，设备端一次归并完成解析
+        names = sorted(set(argv[0] for argv in self.commands), key=lambda s: s.encode("utf-8"))
+        ref_index = {name: i for i, name in enumerate(names)}
+        refs = [intern(name) for name in names]
+        for at, idx in self.runs:
+            argv = self.commands[idx]
+            struct.pack_into("<BHB", self.code, at, OP_RUN, ref_index[argv[0]], len(argv))
+            for i, arg in enumerate(argv):
+                struct.pack_into("<H", self.code, at + 4 + 2 * i, intern(arg))
+        if not pool:
+            pool.append(0)
+        if len(pool) > 0xffff or len(refs) > 0xffff:
+            raise ScriptError(self.words[-1].line, "script too large")
+        blob = bytearray(MAGIC)
+        blob += struct.pack("<BBHHH", VERSION, self.loop_max, len(refs), len(self.code), len(pool))
+        for off in refs:
+            blob += struct.pack("<H", off)
+        blob += self.code
+        blob += pool
+        return bytes(blob)
+
+
+def compile_script(src, errexit=False, argc_max=ARGC_MAX_DEFAULT, loop_depth_max=LOOP_DEPTH_DEFAULT):
+    return Compiler(tokenize(src), errexit, argc_max, loop_depth_max).compile()
+
+
+def to_c_array(blob, name, source):
+    guard = "_%s_H_" % name.upper()
+    out = []
+    out.append("/* generated by ehshell_script_compile.py from %s, do not edit */" % source)
+    out.append("#ifndef %s" % guard)
+    out.append("#define %s" % guard)
+    out.append("")
+    out.append("#include <stdint.h>")
+    out.append("")
+    out.append("static const uint8_t %s[%d] = {" % (name, len(blob)))
+    for i in range(0, len(blob), 16):
+        out.append("    " + ", ".join("0x%02x" % b for b in blob[i:i + 16]) + ",")
+    out.append("};")
+    out.append("")
+    out.append("#endif // %s" % guard)
+    out.append("")
+    return "\n".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="compile a shell script into ehshell bytecode")
+    parser.add_argument("script")
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("-n", "--name", help="C array name, default is the output file name")
+    parser.add_argument("-e", "--errexit", action="store_true", help="stop at the first failed command")
+    parser.add_argument("--argc-max", type=int, default=ARGC_MAX_DEFAULT,
+                        help="EHSHELL_CONFIG_ARGC_MAX of the target, default %d" % ARGC_MAX_DEFAULT)
+    parser.add_argument("--loop-depth", type=int, default=LOOP_DEPTH_DEFAULT,
+                        help="EHSHELL_CONFIG_SCRIPT_LOOP_DEPTH of the target, default %d" % LOOP_DEPTH_DEFAULT)
+    args = parser.parse_args()
+    if not 1 <= args.argc_max <= ARGC_LIMIT:
+        parser.error("--argc-max must be 1-%d" % ARGC_LIMIT)
+    if not 0 <= args.loop_depth <= LOOP_DEPTH_LIMIT:
+        parser.error("--loop-depth must be 0-%d" % LOOP_DEPTH_LIMIT)
+    with open(args.script, "r", encoding="utf-8") as f:
+        src = f.read()
+    try:
+        blob = compile_script(src, args.errexit, args.argc_max, args.loop_depth)
+    except ScriptError as e:
+        sys.stderr.write("%s: %s\n" % (args.script, e))
+        return 1
+    if args.output.endswith(".bin"):
+        with open(args.output, "wb") as f:
+            f.write(blob)
+        return 0
+    name = args.name or re.sub(r"\W", "_", os.path.splitext(os.path.basename(args.output))[0])
+    with open(args.output, "w", encoding="utf-8") as f:
+        f.write(to_c_array(blob, name, os.path.basename(args.script)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())